@@ -0,0 +1,36 @@
+#pragma once
+/*
+Allocator returning memory aligned to Align bytes (default: one cache line)
+Useful for SIMD loads and to keep arrays from sharing cache lines with other data
+*/
+
+#include <cstddef>
+#include <new> // std::align_val_t
+
+template <typename T, size_t Align = 64>
+class AlignedAllocator{
+    static_assert((Align & (Align - 1)) == 0, "Alignment must be a power of two");
+    static_assert(Align >= alignof(T), "Alignment must be at least alignof(T)");
+
+public:
+    using value_type = T;
+    static constexpr size_t alignment = Align;
+
+    // Needed because of the non-type template parameter
+    template <typename U>
+    struct rebind{ using other = AlignedAllocator<U, Align>; };
+
+    AlignedAllocator() noexcept = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Align>&) noexcept {}
+
+    T* allocate(size_t n){
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{Align}));
+    }
+    void deallocate(T* p, size_t) noexcept {
+        ::operator delete(p, std::align_val_t{Align});
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Align>&) const noexcept { return true; }
+};
@@ -0,0 +1,138 @@
+/*
+Tests and benchmark for the bump-pointer arena (see arena.hpp)
+
+The benchmark simulates handling a request: split a payload into fields, store them in a vector
+of strings and an index keyed by field number, and collect the field lengths in a Vector. The
+same code runs with the default heap (std::pmr::new_delete_resource, every string and node freed
+one by one) and with an Arena that is reset after each request.
+Arguments: number of requests and fields per request
+*/
+
+#include "arena.hpp"
+#include "vector.hpp"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <memory_resource>
+#include <unordered_map>
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+
+void test_bump(){
+    Arena arena(1024);
+    char* a = static_cast<char*>(arena.allocate(10, 1));
+    char* b = static_cast<char*>(arena.allocate(10, 1));
+    assert(b == a + 10); // adjacent
+
+    void* aligned = arena.allocate(1, 256);
+    assert(reinterpret_cast<uintptr_t>(aligned) % 256 == 0);
+
+    // Freeing the last allocation gives its space back, anything else is a no-op
+    void* c = arena.allocate(16, 8);
+    arena.deallocate(c, 16, 8);
+    assert(arena.allocate(16, 8) == c);
+    arena.deallocate(a, 10, 1);
+    assert(arena.allocate(1, 1) != a);
+
+    // Alignments that aren't powers of two are rejected, even with room left in the chunk
+    bool threw = false;
+    try{ (void)arena.allocate(8, 24); }
+    catch(const std::bad_alloc&){ threw = true; }
+    assert(threw);
+}
+
+void test_chunks_and_reset(){
+    Arena arena(1024);
+    for(int i=0; i<100; ++i) arena.allocate(100);
+    size_t chunks = arena.chunks();
+    size_t capacity = arena.capacity();
+    assert(chunks > 1 && capacity >= 100 * 100);
+
+    // A request bigger than any chunk gets its own
+    void* big = arena.allocate(size_t{1} << 20);
+    assert(big && arena.chunks() == chunks + 1);
+
+    // After reset the same work reuses the chunks instead of allocating new ones
+    arena.reset();
+    for(int i=0; i<100; ++i) arena.allocate(100);
+    arena.allocate(size_t{1} << 20);
+    assert(arena.chunks() == chunks + 1);
+
+    arena.release();
+    assert(arena.chunks() == 0 && arena.capacity() == 0);
+    assert(arena.allocate(8)); // usable again
+}
+
+void test_adapters(){
+    Arena arena;
+    {
+        Vector<int, ArenaAllocator<int>> v{ArenaAllocator<int>(arena)};
+        for(int i=0; i<10000; ++i) v.push_back(i);
+        for(int i=0; i<10000; ++i) assert(v[i] == i);
+    }
+    {
+        std::pmr::vector<std::pmr::string> names(&arena);
+        names.emplace_back("a string that is too long for the small string optimization");
+        names.emplace_back("another one");
+        assert(names[0].get_allocator().resource() == &arena); // propagated to the elements
+        std::pmr::unordered_map<int, std::pmr::string> index(&arena);
+        index.emplace(1, names[0]);
+        assert(index.at(1) == names[0]);
+    }
+    arena.reset();
+}
+
+// One request: the containers and their elements all come from resource
+size_t handle_request(std::pmr::memory_resource* resource, const std::string& payload, size_t fields){
+    std::pmr::vector<std::pmr::string> parts(resource);
+    parts.reserve(fields);
+    std::pmr::unordered_map<size_t, std::pmr::string> index(resource);
+    Vector<size_t, std::pmr::polymorphic_allocator<size_t>> lengths{std::pmr::polymorphic_allocator<size_t>(resource)};
+    size_t field_length = payload.size() / fields;
+    for(size_t i=0; i<fields; ++i){
+        parts.emplace_back(payload.data() + i * field_length, field_length);
+        index.emplace(i, parts.back());
+        lengths.push_back(parts.back().size());
+    }
+    size_t total = 0;
+    for(size_t i=0; i<lengths.size(); ++i) total += lengths[i] + index.at(i).front();
+    return total;
+}
+
+template <typename Reset>
+void Benchmark(const char* name, std::pmr::memory_resource* resource, Reset reset, size_t requests, size_t fields){
+    std::string payload(fields * 40, 'x');
+    std::vector<double> latencies;
+    latencies.reserve(requests);
+    size_t checksum = 0;
+    for(size_t r=0; r<requests; ++r){
+        auto start = std::chrono::high_resolution_clock::now();
+        checksum += handle_request(resource, payload, fields);
+        reset(); // the bulk free is part of the request
+        auto end = std::chrono::high_resolution_clock::now();
+        latencies.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p){ return latencies[static_cast<size_t>(p * (latencies.size() - 1))]; };
+    std::cout << name << "  p50: " << percentile(0.5) << " us  p99: " << percentile(0.99)
+              << " us  max: " << latencies.back() << " us  (checksum " << checksum << ")" << std::endl;
+}
+
+int main(int argc, char** argv){
+    test_bump();
+    test_chunks_and_reset();
+    test_adapters();
+    std::cout << "All arena tests passed!\n";
+
+    size_t requests = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000;
+    size_t fields = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 500;
+    if(requests == 0 || fields == 0) return 0;
+    std::cout << requests << " requests of " << fields << " fields" << std::endl;
+    Benchmark("new/delete", std::pmr::new_delete_resource(), []{}, requests, fields);
+    Arena arena;
+    Benchmark("arena     ", &arena, [&]{ arena.reset(); }, requests, fields);
+}
@@ -0,0 +1,180 @@
+#pragma once
+/*
+Bump-pointer arena (monotonic allocator) for short-lived data such as everything one request needs
+
+    Arena arena;
+    Vector<int, ArenaAllocator<int>> v{ArenaAllocator<int>(arena)};
+    std::pmr::vector<std::pmr::string> names(&arena); // Arena is a std::pmr::memory_resource
+    ...
+    arena.reset(); // frees everything at once
+
+allocate() rounds the current position up to the requested alignment and moves it forward, so
+it is a few instructions and consecutive allocations are adjacent in memory. Individual frees
+do nothing, except that freeing the most recent allocation gives its space back (which lets a
+Vector that grows last in the arena reuse its old buffer).
+
+Memory comes from a chain of chunks. When the current chunk is full the arena moves on to the
+next one, allocating it if needed, each new chunk twice the size of the previous one (up to
+MaxChunkSize, or bigger for a single large allocation). reset() keeps the chunks and rewinds to
+the first one in O(1), so a warmed up arena that is reset after every request doesn't allocate
+at all; release() gives the chunks back to the system.
+
+Objects in the arena are not destroyed by reset(): use it for trivially destructible data or
+destroy the containers first.
+*/
+
+#include <cstddef>
+#include <cstdint> // uintptr_t
+#include <new> // std::bad_alloc, std::align_val_t
+#include <memory_resource>
+#include <algorithm>
+#include <utility>
+
+class Arena : public std::pmr::memory_resource{
+public:
+    static constexpr size_t DefaultChunkSize = size_t{64} << 10;
+    static constexpr size_t MaxChunkSize = size_t{16} << 20;
+
+    explicit Arena(size_t first_chunk_size = DefaultChunkSize) : next_chunk_size_(std::max(first_chunk_size, sizeof(Chunk))) {}
+    ~Arena(){ release(); }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t bytes, size_t align = alignof(std::max_align_t)){
+        if(align == 0 || (align & (align - 1)) != 0) throw std::bad_alloc();
+        char* p = align_up(cur_, align);
+        // Compare sizes rather than pointers so p + bytes can't overflow
+        if(cur_ && p <= end_ && bytes <= static_cast<size_t>(end_ - p)){
+            last_ = cur_;
+            cur_ = p + bytes;
+            return p;
+        }
+        return allocate_slow(bytes, align);
+    }
+
+    // Only the most recent allocation is actually freed
+    void deallocate(void* p, size_t bytes, size_t = alignof(std::max_align_t)) noexcept {
+        if(static_cast<char*>(p) + bytes == cur_){
+            cur_ = last_;
+        }
+    }
+
+    // Free everything, keeping the chunks for reuse
+    void reset() noexcept {
+        current_ = head_;
+        if(head_) set_chunk(head_);
+    }
+
+    // Free everything and give the chunks back
+    void release() noexcept {
+        while(head_){
+            Chunk* next = head_->next;
+            ::operator delete(head_, head_->size);
+            head_ = next;
+        }
+        current_ = tail_ = nullptr;
+        cur_ = end_ = last_ = nullptr;
+    }
+
+    // The arena's footprint
+    size_t capacity() const noexcept {
+        size_t total = 0;
+        for(Chunk* c=head_; c; c=c->next) total += c->size;
+        return total;
+    }
+    size_t chunks() const noexcept {
+        size_t n = 0;
+        for(Chunk* c=head_; c; c=c->next) ++n;
+        return n;
+    }
+
+private:
+    // Header at the start of each chunk, the usable bytes follow it
+    struct Chunk{
+        Chunk* next;
+        size_t size; // including the header
+        char* begin() noexcept { return reinterpret_cast<char*>(this + 1); }
+        char* end() noexcept { return reinterpret_cast<char*>(this) + size; }
+    };
+
+    static char* align_up(char* p, size_t align) noexcept {
+        auto bits = reinterpret_cast<uintptr_t>(p);
+        return reinterpret_cast<char*>((bits + align - 1) & ~(uintptr_t{align} - 1));
+    }
+
+    void set_chunk(Chunk* c) noexcept {
+        cur_ = last_ = c->begin();
+        end_ = c->end();
+    }
+
+    void* allocate_slow(size_t bytes, size_t align){
+        // Try the chunks left over from before the last reset, skipping ones that are too small
+        while(current_ && current_->next){
+            current_ = current_->next;
+            set_chunk(current_);
+            char* p = align_up(cur_, align);
+            if(p <= end_ && bytes <= static_cast<size_t>(end_ - p)){
+                cur_ = p + bytes;
+                return p;
+            }
+        }
+        // New chunk at the end of the chain, a single big allocation gets a chunk of its own size
+        size_t needed = sizeof(Chunk) + bytes + align;
+        if(needed < bytes) throw std::bad_alloc();
+        size_t size = std::max(next_chunk_size_, needed);
+        Chunk* c = static_cast<Chunk*>(::operator new(size));
+        c->next = nullptr;
+        c->size = size;
+        if(tail_) tail_->next = c;
+        else head_ = c;
+        tail_ = current_ = c;
+        next_chunk_size_ = std::min(next_chunk_size_ * 2, MaxChunkSize);
+
+        set_chunk(c);
+        char* p = align_up(cur_, align);
+        cur_ = p + bytes;
+        return p;
+    }
+
+    // std::pmr::memory_resource interface
+    void* do_allocate(size_t bytes, size_t align) override { return allocate(bytes, align); }
+    void do_deallocate(void* p, size_t bytes, size_t align) override { deallocate(p, bytes, align); }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    Chunk* head_ = nullptr;
+    Chunk* tail_ = nullptr;
+    Chunk* current_ = nullptr;
+    char* cur_ = nullptr;  // next free byte in current_
+    char* end_ = nullptr;  // end of current_
+    char* last_ = nullptr; // cur_ before the most recent allocation
+    size_t next_chunk_size_;
+};
+
+// std::allocator compatible adapter, e.g. Vector<T, ArenaAllocator<T>>.
+// Copies share the arena, which must outlive the container
+template <typename T>
+class ArenaAllocator{
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena& arena) noexcept : arena_(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena_(other.arena()) {}
+
+    T* allocate(size_t n){
+        if(n > SIZE_MAX / sizeof(T)) throw std::bad_alloc();
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* p, size_t n) noexcept {
+        arena_->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    Arena* arena() const noexcept { return arena_; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept { return arena_ == other.arena(); }
+
+private:
+    Arena* arena_;
+};
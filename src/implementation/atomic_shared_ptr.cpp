@@ -0,0 +1,154 @@
+/*
+Tests and benchmark for Custom::atomic_shared_ptr (see atomic_shared_ptr.hpp)
+
+The benchmark publishes configuration snapshots from one writer thread while N readers keep
+loading the latest one, with atomic_shared_ptr and with a mutex around a shared_ptr.
+Arguments: maximum number of readers (default 64) and milliseconds per run (default 200)
+*/
+
+#include "atomic_shared_ptr.hpp"
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <string>
+#include <cassert>
+#include <cstdlib>
+
+struct Config{
+    static inline std::atomic<int> live{0};
+    int64_t version;
+    std::string name;
+    Config(int64_t v, std::string n) : version(v), name(std::move(n)) { ++live; }
+    ~Config(){ --live; }
+};
+
+void test_single_thread(){
+    {
+        Custom::atomic_shared_ptr<Config> atomic;
+        assert(!atomic.load());
+        assert(atomic.is_lock_free());
+
+        atomic.store(Custom::make_shared<Config>(1, "one"));
+        Custom::shared_ptr<Config> first = atomic.load();
+        assert(first->version == 1 && first.use_count() == 2); // ours + the atomic's
+
+        Custom::shared_ptr<Config> old = atomic.exchange(Custom::make_shared<Config>(2, "two"));
+        assert(old.get() == first.get());
+        assert(atomic.load()->version == 2);
+
+        // Fails: stored value is "two", expected is "one". expected gets the current value
+        Custom::shared_ptr<Config> expected = first;
+        assert(!atomic.compare_exchange_strong(expected, Custom::make_shared<Config>(3, "three")));
+        assert(expected->version == 2);
+        // Succeeds now
+        assert(atomic.compare_exchange_strong(expected, Custom::make_shared<Config>(3, "three")));
+        assert(atomic.load()->version == 3);
+        assert(expected.use_count() == 1); // the atomic let go of "two"
+
+        atomic = Custom::shared_ptr<Config>(); // store null
+        assert(!atomic.load());
+    }
+    assert(Config::live == 0);
+}
+
+void test_concurrent(){
+    {
+        Custom::atomic_shared_ptr<Config> atomic(Custom::make_shared<Config>(0, "v0"));
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> readers;
+        for(int t=0; t<4; ++t){
+            readers.emplace_back([&]{
+                int64_t last = 0;
+                while(!stop.load(std::memory_order_relaxed)){
+                    Custom::shared_ptr<Config> snapshot = atomic.load();
+                    // Versions only go up, and the snapshot is alive and consistent
+                    assert(snapshot->version >= last);
+                    assert(snapshot->name == "v" + std::to_string(snapshot->version));
+                    last = snapshot->version;
+                }
+            });
+        }
+        for(int64_t v=1; v<=20000; ++v){
+            if(v % 2){
+                atomic.store(Custom::make_shared<Config>(v, "v" + std::to_string(v)));
+            }
+            else{
+                Custom::shared_ptr<Config> expected = atomic.load();
+                bool swapped = atomic.compare_exchange_strong(expected, Custom::make_shared<Config>(v, "v" + std::to_string(v)));
+                assert(swapped); // single writer, nothing else changes it
+                (void)swapped;
+            }
+        }
+        stop = true;
+        for(auto& t : readers) t.join();
+        assert(atomic.load()->version == 20000);
+    }
+    assert(Config::live == 0); // nothing leaked, nothing freed twice (run under ASan)
+}
+
+// Baseline: the mutex-protected shared_ptr we have today
+class LockedConfig{
+public:
+    explicit LockedConfig(Custom::shared_ptr<Config> p) : ptr_(std::move(p)) {}
+    Custom::shared_ptr<Config> load() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return ptr_;
+    }
+    void store(Custom::shared_ptr<Config> p){
+        std::lock_guard<std::mutex> lock(mtx_);
+        ptr_ = std::move(p);
+    }
+private:
+    mutable std::mutex mtx_;
+    Custom::shared_ptr<Config> ptr_;
+};
+
+template <typename Holder>
+double reads_per_second(Holder& holder, size_t readers, int ms){
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> total{0};
+    std::vector<std::thread> threads;
+    for(size_t t=0; t<readers; ++t){
+        threads.emplace_back([&]{
+            uint64_t count = 0;
+            int64_t sum = 0;
+            while(!stop.load(std::memory_order_relaxed)){
+                sum += holder.load()->version;
+                ++count;
+            }
+            total += count + (sum < 0); // use sum so the loads aren't optimized out
+        });
+    }
+    // One writer publishing a new snapshot every 100 microseconds
+    std::thread writer([&]{
+        for(int64_t v=1; !stop.load(std::memory_order_relaxed); ++v){
+            holder.store(Custom::make_shared<Config>(v, "config"));
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    stop = true;
+    for(auto& t : threads) t.join();
+    writer.join();
+    return total.load() * 1000.0 / ms;
+}
+
+int main(int argc, char** argv){
+    test_single_thread();
+    test_concurrent();
+    std::cout << "All atomic_shared_ptr tests passed!\n";
+
+    size_t max_readers = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64;
+    int ms = argc > 2 ? std::atoi(argv[2]) : 200;
+    std::cout << "Reads per second with one concurrent writer" << std::endl;
+    for(size_t readers = 1; readers <= max_readers; readers *= 2){
+        Custom::atomic_shared_ptr<Config> atomic(Custom::make_shared<Config>(0, "config"));
+        LockedConfig locked(Custom::make_shared<Config>(0, "config"));
+        double a = reads_per_second(atomic, readers, ms);
+        double l = reads_per_second(locked, readers, ms);
+        std::cout << readers << " reader(s)  atomic_shared_ptr: " << a / 1e6 << " M/s"
+                  << "  mutex + shared_ptr: " << l / 1e6 << " M/s" << std::endl;
+    }
+}
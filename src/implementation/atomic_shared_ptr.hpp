@@ -0,0 +1,157 @@
+#pragma once
+/*
+Lock-free atomic Custom::shared_ptr using split reference counting
+
+The whole state is one 64-bit word: the control block pointer in the low 48 bits (user space
+addresses on x86-64 and ARM64 fit) and an "external" count in the high 16 bits. The control
+block's own ref_count holds one reference for the atomic itself.
+
+load():  1. fetch_add on the external count pins the control block: whoever replaces it must first
+            account for our pin, so it can't be freed under us
+         2. take a real reference on the control block
+         3. give the pin back: decrement the external count if the word still holds the same block,
+            otherwise the replacer has already converted our pin into a reference on the block,
+            so we drop one reference instead
+exchange(): swaps the word, then adds the external count of the old word to the old block's count
+            (one for each pin still outstanding) and hands the atomic's reference to the caller.
+
+Every operation is a handful of atomic instructions on one word, so it is lock-free wherever
+std::atomic<uint64_t> is (always on x86-64). At most 65535 threads can be inside load() at once.
+*/
+
+#include "custom.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cassert>
+
+namespace Custom{
+    template <typename T>
+    class atomic_shared_ptr{
+        using Block = detail::ControlBlock<MultiThreaded>;
+
+        static constexpr int PointerBits = 48;
+        static constexpr uint64_t PointerMask = (uint64_t{1} << PointerBits) - 1;
+        static constexpr uint64_t OnePin = uint64_t{1} << PointerBits;
+
+        static uint64_t pack(Block* cb) noexcept {
+            auto bits = reinterpret_cast<uintptr_t>(cb);
+            assert((bits & ~PointerMask) == 0 && "control block address does not fit in 48 bits");
+            return bits;
+        }
+        static Block* block(uint64_t word) noexcept { return reinterpret_cast<Block*>(word & PointerMask); }
+        static int pins(uint64_t word) noexcept { return static_cast<int>(word >> PointerBits); }
+
+        static shared_ptr<T> adopt(Block* cb) noexcept {
+            return cb ? shared_ptr<T>(static_cast<T*>(cb->get_object()), cb) : shared_ptr<T>();
+        }
+
+        // Take a strong reference to the block in word, which is pinned by the caller
+        static Block* take_ref(Block* cb) noexcept {
+            if(cb) cb->add_ref();
+            return cb;
+        }
+
+        // Turn the pins left on a replaced word into references, the replaced word's own
+        // reference now belongs to the caller
+        static Block* settle(uint64_t old_word) noexcept {
+            Block* cb = block(old_word);
+            if(cb && pins(old_word) > 0) cb->add_refs(pins(old_word));
+            return cb;
+        }
+
+    public:
+        atomic_shared_ptr() noexcept : word_(0) {}
+
+        // Takes over desired's reference
+        explicit atomic_shared_ptr(shared_ptr<T> desired) noexcept : word_(pack(desired.control_block)) {
+            desired.ptr = nullptr;
+            desired.control_block = nullptr;
+        }
+
+        atomic_shared_ptr(const atomic_shared_ptr&) = delete;
+        atomic_shared_ptr& operator=(const atomic_shared_ptr&) = delete;
+
+        // Must not race with other operations on this object
+        ~atomic_shared_ptr(){
+            uint64_t word = word_.load(std::memory_order_acquire);
+            if(Block* cb = block(word)) cb->release();
+        }
+
+        shared_ptr<T> load() const noexcept {
+            // 1. Pin: acquire pairs with the release in exchange, so the object is fully constructed
+            uint64_t word = word_.fetch_add(OnePin, std::memory_order_acquire);
+            // 2. Our own reference, the block is alive because of the pin
+            Block* cb = take_ref(block(word));
+            // 3. Unpin
+            unpin(cb);
+            return adopt(cb);
+        }
+
+        void store(shared_ptr<T> desired) noexcept {
+            exchange(std::move(desired)); // the returned old value is released here
+        }
+
+        shared_ptr<T> exchange(shared_ptr<T> desired) noexcept {
+            uint64_t new_word = pack(desired.control_block);
+            desired.ptr = nullptr;
+            desired.control_block = nullptr; // the atomic now owns this reference
+            uint64_t old_word = word_.exchange(new_word, std::memory_order_acq_rel);
+            return adopt(settle(old_word));
+        }
+
+        // Succeeds if the stored pointer equals expected (same control block); otherwise loads the
+        // current value into expected
+        bool compare_exchange_strong(shared_ptr<T>& expected, shared_ptr<T> desired) noexcept {
+            uint64_t new_word = pack(desired.control_block);
+            uint64_t current = word_.load(std::memory_order_relaxed);
+            for(;;){
+                while(block(current) == expected.control_block){
+                    // A changing pin count isn't a real change, so retry until the pointer itself differs
+                    if(word_.compare_exchange_weak(current, new_word, std::memory_order_acq_rel, std::memory_order_relaxed)){
+                        desired.ptr = nullptr;
+                        desired.control_block = nullptr;
+                        if(Block* old = settle(current)) old->release(); // the atomic's old reference
+                        return true;
+                    }
+                }
+                // Fail with the value actually seen. If the word went back to expected's block after the
+                // compare, failing would be spurious, so compare again
+                shared_ptr<T> observed = load();
+                if(observed.control_block != expected.control_block){
+                    expected = std::move(observed);
+                    return false;
+                }
+                current = word_.load(std::memory_order_relaxed);
+            }
+        }
+
+        bool compare_exchange_weak(shared_ptr<T>& expected, shared_ptr<T> desired) noexcept {
+            return compare_exchange_strong(expected, std::move(desired));
+        }
+
+        operator shared_ptr<T>() const noexcept { return load(); }
+        atomic_shared_ptr& operator=(shared_ptr<T> desired) noexcept {
+            store(std::move(desired));
+            return *this;
+        }
+
+        bool is_lock_free() const noexcept { return word_.is_lock_free(); }
+
+    private:
+        void unpin(Block* cb) const noexcept {
+            uint64_t current = word_.load(std::memory_order_relaxed);
+            // Only a word that still holds our block and has pins can contain ours. Pins on the same
+            // block are interchangeable, so taking one from a later store of the same block is fine
+            while(block(current) == cb && pins(current) > 0){
+                // Release: our add_ref must be visible before a replacer can drop the atomic's reference
+                if(word_.compare_exchange_weak(current, current - OnePin, std::memory_order_release, std::memory_order_relaxed)){
+                    return;
+                }
+            }
+            // Replaced meanwhile: exchange() converted our pin into a reference, give it back
+            if(cb) cb->release();
+        }
+
+        mutable std::atomic<uint64_t> word_;
+    };
+}
@@ -1,289 +1,14 @@
 /*
-This is an example of a memory efficient vector
+Tests for the memory efficient vector in vector.hpp
 */
 
-#include <new> // placement new
-#include <utility> // std::exchange, std::move, std::forward
-#include <memory>
-#include <cstddef>
+#include "vector.hpp"
 #include <iostream>
-#include <initializer_list>
-#include <stdexcept> // std::out_of_range exception
+#include <string>
 #include <cassert>
-#include <iterator>
 #include <algorithm>
-#include <cassert>
 #include <vector>
-
-template <typename T, typename Alloc = std::allocator<T>>
-class Vector{
-    using Traits = std::allocator_traits<Alloc>;
-
-public:
-    // types (these must exist in accordance with the CPP standard)
-    using value_type = T;
-    using allocator_type = Alloc;
-    
-    // Default constructor
-    Vector() noexcept : Vector{Alloc()} {}
-
-    // Allocator-accepting ctor
-    explicit Vector(const Alloc& alloc) noexcept 
-    : alloc_(alloc), data_(nullptr), size_(0), capacity_(0) {}
-
-    // Reserve but don't construct
-    explicit Vector(size_t n, const Alloc& alloc = Alloc())
-    : alloc_(alloc), data_(Traits::allocate(alloc_, n)), size_(0), capacity_(n) {}
-
-    // Use placement new to copy construct n elements
-    explicit Vector(size_t n, const T& val, const Alloc& alloc = Alloc())
-    : Vector(n, alloc) {
-        size_ = n;
-        for(size_t i=0; i<size_; i++){
-            Traits::construct(alloc_, data_+i, val);
-            // new(data_+i) T(val); // placement new
-        }
-    }
-
-    // Initialize using initialzer list
-    Vector(std::initializer_list<T> list, const Alloc& alloc = Alloc())
-    : Vector(alloc) {
-        for(const T& v: list){
-            push_back(v);
-        }
-    }
-    // Copy constructor
-    Vector(const Vector& other) 
-    : Vector(other.size_, other.alloc_) {
-        size_ = other.size_;
-        for(size_t i=0; i<size_; ++i){
-            Traits::construct(alloc_, data_+i, other.data_[i]);
-            // new(data_+i) T(other.data_[i]);
-        }
-    }
-    // Move constructor
-    Vector(Vector&& other) noexcept 
-    :   alloc_(std::move(other.alloc_)),
-        data_(std::exchange(other.data_, nullptr)), 
-        size_(std::exchange(other.size_, 0)),
-        capacity_(std::exchange(other.capacity_, 0)) {}
-    
-    friend void swap(Vector& a, Vector& b) noexcept {
-        using std::swap;
-        swap(a.data_, b.data_);
-        swap(a.size_, b.size_);
-        swap(a.capacity_, b.capacity_);
-        swap(a.alloc_, b.alloc_);
-    }
-    // Copy assignment operator 
-    Vector& operator=(const Vector& other) {
-        if(this==&other) return *this;
-        // Copy and swap
-        Vector temp(other); // Make copy using copy constructor
-        swap(*this, temp);
-        return *this;
-    }
-    // Move assignment operator
-    Vector& operator=(Vector&& other) noexcept {
-        if(this==&other) return *this;
-        clear();
-        if(data_){
-            Traits::deallocate(alloc_, data_, capacity_);
-            // ::operator delete(data_);
-        }
-        using std::exchange;
-        size_ = exchange(other.size_, 0);
-        capacity_ = exchange(other.capacity_, 0);
-        data_ = exchange(other.data_, nullptr);
-        return *this;
-    }
-
-    ~Vector() noexcept {
-        clear();
-        if(data_){
-            Traits::deallocate(alloc_, data_, capacity_);
-            // ::operator delete(data_);
-        }
-    }
-    // Reserve raw memory
-    void reserve(size_t n){
-        if(n <= capacity_) return;
-        T* newdata = Traits::allocate(alloc_, n);
-        // T* newdata = allocate(n);
-        // Copy the data
-        for(size_t i=0; i<size_; ++i){
-            Traits::construct(alloc_, newdata + i, std::move(data_[i]));
-            Traits::destroy(alloc_, data_+i);
-            // new (newdata + i) T(std::move(data_[i]));
-            // data_[i].~T(); // Destroy the old object
-        }
-        // Delete the previous heap block
-        if(data_){
-            Traits::deallocate(alloc_, data_, capacity_);
-        }
-        // ::operator delete(data_);
-        data_ = newdata;
-        capacity_ = n;
-    }
-
-    // Function to forward constructor arguments and insert
-    template<typename... Args>
-    void emplace_back(Args&&... args){
-        if(size_>=capacity_){
-            reserve(capacity_? capacity_ * 2 : 1);
-        }
-        Traits::construct(alloc_, data_ + size_, std::forward<Args>(args)...);
-        // new (data_ + size_) T(std::forward<Args>(args)...);
-        ++size_;
-    }
-    
-    void push_back(const T& val){ emplace_back(val); }
-    void push_back(T&& val){ emplace_back(std::move(val)); }
-
-    void pop_back(){
-        if(size_>0){
-            --size_;
-            Traits::destroy(alloc_, data_+size_);
-            // data_[size_].~T();
-        }
-    }
-
-    // Resize and default construct
-    void resize(size_t n){
-        if(n < size_){
-            for(size_t i=n; i<size_; ++i){
-                Traits::destroy(alloc_, data_+i);
-                // data_[i].~T();
-            }
-        }
-        reserve(n);
-        for (size_t i = size_; i < n; ++i){
-            Traits::construct(alloc_, data_ + i);
-        }
-        size_ = n;
-    }
-    // Resize and value construct
-    void resize(size_t n, const T& val){
-        if(n < size_){
-            for(size_t i=n; i<size_; ++i){
-                Traits::destroy(alloc_, data_+i);
-                // data_[i].~T();
-            }
-        }
-        reserve(n);
-        // Default construct the new elements
-        for(size_t i=size_; i<n; i++){
-            Traits::construct(alloc_, data_+i, val);
-            // new(data_ + i) T(val);
-        }
-        size_ = n;
-    }
-
-    void shrink_to_fit(){
-        if(size_==0){
-            Traits::deallocate(alloc_, data_, capacity_);
-            // ::operator delete(data_);
-            data_ = nullptr;
-            capacity_=0;
-        }
-        else{
-            T* newdata = Traits::allocate(alloc_, size_);
-            // T* newdata = allocate(size_);
-            // Copy the data
-            for(size_t i=0; i<size_; ++i){
-                Traits::construct(alloc_, newdata + i, std::move(data_[i]));
-                Traits::destroy(alloc_, data_ + i);
-                // new (newdata + i) T(std::move(data_[i]));
-                // data_[i].~T();
-            }
-            Traits::deallocate(alloc_, data_, capacity_);
-            // ::operator delete(data_);
-            data_ = newdata;
-            capacity_ = size_;
-        }
-    }
-
-    // Clear the vector, keep the capacity
-    void clear() noexcept {
-        for(size_t i=0; i<size_; i++){
-            Traits::destroy(alloc_, data_+i);
-            // data_[i].~T();
-        }
-        size_ = 0;
-    }
-
-    // Accessors
-    T& front() {
-        if(empty()) throw std::logic_error("Vector is empty");
-        return data_[0]; 
-    }
-    const T& front() const {
-        if(empty()) throw std::logic_error("Vector is empty");
-        return data_[0];
-    }
-    T& back() {
-        if(empty()) throw std::logic_error("Vector is empty");
-        return data_[size_-1];
-    }
-    const T& back() const {
-        if(empty()) throw std::logic_error("Vector is empty");
-        return data_[size_-1];
-    }
-
-    T& operator[](size_t i){ return data_[i]; }
-    const T& operator[](size_t i) const { return data_[i]; }
-
-    // Bounds-checked accessors
-    T& at(size_t i){
-        if(i>=size_) throw std::out_of_range("Index out of range");
-        return data_[i];
-    }
-    const T& at(size_t i) const {
-        if(i>=size_) throw std::out_of_range("Index out of range");
-        return data_[i];
-    }
-
-    using iterator = T*;
-    using const_iterator = const T*;
-    using reverse_iterator = std::reverse_iterator<iterator>;
-    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
-
-    // Mutable iterators
-    iterator begin() noexcept { return data_; }
-    iterator end() noexcept { return data_ + size_; }
-    // Const iterators
-    const_iterator begin() const noexcept { return data_; }
-    const_iterator end() const noexcept { return data_ + size_; }
-    // Read only iterators
-    const_iterator cbegin() const noexcept { return data_; }
-    const_iterator cend() const noexcept { return data_ + size_; }
-
-    // Mutable reverse iterator
-    reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
-    reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
-    // Const reverse iterators
-    const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
-    const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
-    // Read only reverse iterators
-    const_reverse_iterator crbegin() const noexcept { return const_reverse_iterator(end()); }
-    const_reverse_iterator crend() const noexcept { return const_reverse_iterator(begin()); }
-
-    size_t capacity() const noexcept { return capacity_; }
-    size_t size() const noexcept { return size_; }
-    bool empty() const noexcept { return size_ == 0;}
-    
-    allocator_type get_allocator() const noexcept { return alloc_; }
-
-private:
-    // Function to heap allocate raw memory for n instances of T
-    // static T* allocate(size_t n){
-    //     return static_cast<T*>(::operator new(n * sizeof(T)));
-    // }
-
-    Alloc alloc_;
-    T* data_;
-    size_t size_, capacity_;
-};
+#include <stdexcept>
 
 void test_default_ctor() {
     Vector<int> v;
@@ -405,6 +130,49 @@ void test_iterators(){
         assert(v2.begin()[i] == expected_sorted[i]);
 }
 
+// Copies throw once the countdown reaches zero (no move constructor, so reserve has to copy)
+struct Flaky {
+    static inline int copies_left = -1; // -1: never throw
+    static inline int live = 0;
+    int value;
+    Flaky(int v = 0) : value(v) { ++live; }
+    Flaky(const Flaky& other) : value(other.value) {
+        if (copies_left == 0) throw std::runtime_error("copy failed");
+        if (copies_left > 0) --copies_left;
+        ++live;
+    }
+    ~Flaky() { --live; }
+};
+
+void test_strong_guarantee() {
+    {
+        Vector<Flaky> v;
+        v.reserve(4);
+        for (int i = 0; i < 4; ++i) v.emplace_back(i);
+        // The third copy into the new block fails: the old block is left as it was
+        Flaky::copies_left = 2;
+        bool thrown = false;
+        try { v.reserve(16); } catch (const std::runtime_error&) { thrown = true; }
+        assert(thrown && v.size() == 4 && v.capacity() == 4 && Flaky::live == 4);
+        for (int i = 0; i < 4; ++i) assert(v[i].value == i);
+
+        // resize: the first new element is built, the second throws and the first is destroyed again
+        Flaky::copies_left = -1;
+        v.reserve(16);
+        Flaky::copies_left = 1;
+        thrown = false;
+        try { v.resize(8, Flaky(9)); } catch (const std::runtime_error&) { thrown = true; }
+        assert(thrown && v.size() == 4 && Flaky::live == 4);
+        Flaky::copies_left = -1;
+
+        // Growing from one of the vector's own elements
+        v.resize(40, v[3]);
+        v.push_back(v[0]);
+        assert(v.size() == 41 && v[39].value == 3 && v[40].value == 0);
+    }
+    assert(Flaky::live == 0);
+}
+
 int main() {
     test_default_ctor();
     test_push_pop();
@@ -414,6 +182,7 @@ int main() {
     test_swap();
     test_at_exception();
     test_iterators();
+    test_strong_guarantee();
 
     std::cout << "All Vector<> tests passed!\n";
     return 0;
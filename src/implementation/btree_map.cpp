@@ -0,0 +1,328 @@
+/*
+Tests and benchmark for the B+-tree map and set (see btree_map.hpp)
+
+The tests replay random inserts and erases on a BTreeMap and a std::map and check the tree's
+structure after every step, with tiny nodes (4 elements) so that splits, borrows and merges
+happen all the time, and with the default size. Bulk loading is checked for every size around
+the node boundaries, and erasing with key copies that throw leaves the tree unchanged.
+The benchmark fills a BTreeMap (256 and 1024 byte nodes) and a std::map of uint64_t pairs with n
+random keys, bulk loads them from sorted input, looks up every key in random order, scans ranges
+of 100 elements from random starting points and iterates over everything, in ns per element.
+Arguments: number of entries (10000000 takes about 1 GB with std::map)
+*/
+
+#include "btree_map.hpp"
+#include "tracking_allocator.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <cstdlib>
+
+// 4 elements per leaf and 4 keys per inner node
+template <typename K, typename V>
+using TinyMap = BTreeMap<K, V, std::less<K>, 16>;
+
+template <typename Map, typename Ref>
+bool same(const Map& map, const Ref& ref){
+    return map.size() == ref.size() && std::equal(map.begin(), map.end(), ref.begin(), ref.end())
+        && std::equal(map.rbegin(), map.rend(), ref.rbegin(), ref.rend());
+}
+
+template <typename Map>
+void test_random_ops(int steps, int keys){
+    std::mt19937 gen(11);
+    Map map;
+    std::map<int, int> ref;
+    for(int step=0; step<steps; ++step){
+        int key = static_cast<int>(gen() % static_cast<unsigned>(keys));
+        switch(gen() % 5){
+            case 0:
+            case 1: {
+                auto [it, inserted] = map.insert({key, step});
+                assert(inserted == ref.insert({key, step}).second && it->first == key);
+                break;
+            }
+            case 2:
+                map.insert_or_assign(key, step);
+                ref.insert_or_assign(key, step);
+                break;
+            case 3:
+                assert(map.erase(key) == ref.erase(key));
+                break;
+            default:
+                // Erase through an iterator: the returned one is the next element
+                if(auto it = map.lower_bound(key); it != map.end()){
+                    auto next = ref.erase(ref.find(it->first));
+                    auto after = map.erase(it);
+                    assert((after == map.end()) == (next == ref.end()));
+                    if(next != ref.end()) assert(after->first == next->first);
+                }
+        }
+        assert(map.valid());
+        if(step % 997 == 0) assert(same(map, ref));
+    }
+    assert(same(map, ref));
+    // Everything out again
+    while(!map.empty()){
+        int key = map.begin()->first;
+        if(gen() % 2) key = std::prev(map.end())->first;
+        assert(map.erase(key) == 1 && map.valid());
+    }
+}
+
+void test_bulk_load(){
+    for(int n=0; n<=300; ++n){
+        std::vector<std::pair<int, int>> sorted(static_cast<size_t>(n));
+        for(int i=0; i<n; ++i) sorted[static_cast<size_t>(i)] = {i * 2, i};
+        TinyMap<int, int> tiny(sorted_unique, sorted.begin(), sorted.end());
+        assert(tiny.valid() && std::equal(tiny.begin(), tiny.end(), sorted.begin(), sorted.end(),
+                                          [](const auto& a, const auto& b){ return a.first == b.first && a.second == b.second; }));
+        // Still a normal tree afterwards
+        for(int i=0; i<n; i+=3) tiny[i * 2 + 1] = -1;
+        for(int i=0; i<n; i+=2) tiny.erase(i * 2);
+        assert(tiny.valid());
+
+        BTreeMap<int, int> wide(sorted_unique, sorted.begin(), sorted.end());
+        assert(wide.valid() && wide.size() == static_cast<size_t>(n));
+    }
+    std::vector<int> big(100000);
+    std::iota(big.begin(), big.end(), 0);
+    BTreeSet<int> set(sorted_unique, big.begin(), big.end());
+    assert(set.valid() && set.size() == big.size() && *set.rbegin() == 99999);
+    // Full leaves: about size / LeafSlots of them, a few levels
+    assert(set.height() <= 4);
+
+    std::vector<int> unsorted = {1, 2, 3, 3, 4};
+    bool threw = false;
+    try{ BTreeSet<int> bad(sorted_unique, unsorted.begin(), unsorted.end()); }
+    catch(const std::invalid_argument&){ threw = true; }
+    assert(threw);
+}
+
+void test_api(){
+    BTreeMap<std::string, int> m = {{"b", 2}, {"a", 1}, {"d", 4}};
+    assert(m.size() == 3 && m.begin()->first == "a" && m.at("d") == 4);
+    assert(m.try_emplace("c", 3).second && !m.try_emplace("c", 30).second && m["c"] == 3);
+    assert(!m.insert_or_assign("c", 33).second && m.at("c") == 33);
+    assert(m.emplace("e", 5).second && m["f"] == 0 && m.size() == 6);
+    assert(m.lower_bound("bb")->first == "c" && m.upper_bound("c")->first == "d");
+    auto [lo, hi] = m.equal_range("c");
+    assert(lo->first == "c" && hi->first == "d");
+    auto [lo2, hi2] = m.equal_range("cc");
+    assert(lo2 == hi2 && lo2->first == "d");
+    assert(m.find("zz") == m.end() && m.upper_bound("zz") == m.end() && m.count("a") == 1);
+
+    bool threw = false;
+    try{ (void)m.at("zz"); }
+    catch(const std::out_of_range&){ threw = true; }
+    assert(threw);
+
+    // Bidirectional iterators, from the end too
+    auto last = m.end();
+    assert((--last)->first == "f" && std::prev(last)->first == "e");
+    std::string keys;
+    for(auto it = m.rbegin(); it != m.rend(); ++it) keys += it->first;
+    assert(keys == "fedcba");
+
+    // Copies are independent, moves leave an empty map
+    auto copy = m;
+    copy["a"] = 100;
+    assert(m["a"] == 1 && !(copy == m));
+    copy["a"] = 1;
+    assert(copy == m && copy.valid());
+    auto moved = std::move(copy);
+    assert(moved == m && copy.empty() && copy.begin() == copy.end());
+    copy = moved;
+    assert(copy == m);
+
+    // Range erase returns the first element kept
+    auto it = m.erase(m.find("b"), m.find("e"));
+    assert(it->first == "e" && m.size() == 3 && m.valid());
+    it = m.erase(m.begin(), m.end());
+    assert(it == m.end() && m.empty());
+
+    // Heterogeneous lookup with a transparent comparison
+    BTreeMap<std::string, int, std::less<>> names = {{"x", 1}};
+    assert(names.contains(std::string_view("x")) && names.find("y") == names.end());
+    assert(names.erase(std::string_view("x")) == 1);
+
+    // Move only values, reverse order
+    BTreeMap<int, std::unique_ptr<int>, std::greater<int>> owners;
+    for(int i=0; i<1000; ++i) owners.try_emplace(i, std::make_unique<int>(i));
+    assert(owners.begin()->first == 999 && *owners.at(5) == 5 && owners.valid());
+}
+
+void test_large_and_sets(){
+    // Strings of different lengths, default node size, enough for 3 levels
+    BTreeSet<std::string> words;
+    std::set<std::string> ref;
+    std::mt19937 gen(3);
+    for(int i=0; i<50000; ++i){
+        std::string w = std::to_string(gen() % 30000) + std::string(gen() % 20, 'x');
+        if(gen() % 4 == 0){
+            assert(words.erase(w) == ref.erase(w));
+        }
+        else assert(words.insert(w).second == ref.insert(w).second);
+    }
+    assert(words.valid() && std::equal(words.begin(), words.end(), ref.begin(), ref.end()));
+    static_assert(std::is_same_v<decltype(*words.begin()), const std::string&>); // keys can't be changed in place
+
+    test_random_ops<BTreeMap<int, int>>(100000, 20000);
+    test_random_ops<BTreeMap<int, int, std::less<int>, 64>>(50000, 5000);
+}
+
+// Key whose copies throw while fail is set, moves never do
+struct FlakyKey{
+    static inline bool fail = false;
+    int value;
+    FlakyKey(int v) : value(v) {}
+    FlakyKey(const FlakyKey& other) : value(other.value){ if(fail) throw std::runtime_error("copy failed"); }
+    FlakyKey(FlakyKey&&) noexcept = default;
+    FlakyKey& operator=(const FlakyKey& other){
+        if(fail) throw std::runtime_error("copy failed");
+        value = other.value;
+        return *this;
+    }
+    FlakyKey& operator=(FlakyKey&&) noexcept = default;
+    auto operator<=>(const FlakyKey&) const = default;
+};
+
+// An erase that borrows from a sibling leaf copies a new separator: if that throws, nothing is erased
+void test_exceptions(){
+    BTreeMap<FlakyKey, int, std::less<FlakyKey>, 64> m;
+    std::map<int, int> ref;
+    std::mt19937 gen(5);
+    for(int i=0; i<500; ++i){
+        int key = static_cast<int>(gen() % 2000);
+        m.insert_or_assign(FlakyKey(key), i);
+        ref.insert_or_assign(key, i);
+    }
+    int threw = 0;
+    FlakyKey::fail = true;
+    for(int i=0; i<300; ++i){
+        int key = static_cast<int>(gen() % 2000);
+        try{
+            assert(m.erase(FlakyKey(key)) == ref.erase(key));
+        }
+        catch(const std::runtime_error&){
+            ++threw;
+            assert(ref.contains(key) && m.contains(FlakyKey(key)));
+        }
+        assert(m.valid() && m.size() == ref.size());
+    }
+    FlakyKey::fail = false;
+    assert(threw > 0);
+    for(const auto& [k, v] : ref) assert(m.at(FlakyKey(k)) == v);
+}
+
+void test_allocator(){
+    using Alloc = TrackingAllocator<std::pair<const int, std::string>>;
+    {
+        BTreeMap<int, std::string, std::less<int>, 256, Alloc> m(std::less<int>(), Alloc("btree_map"));
+        for(int i=0; i<10000; ++i) m[i * 7 % 10000] = std::to_string(i);
+        for(int i=0; i<10000; i+=2) m.erase(i);
+        auto copy = m;
+        assert(copy.size() == 5000 && copy.valid());
+        assert(tracking::stats("btree_map").live_bytes() > 0);
+    }
+    // Leaves and inner nodes both go through the rebound allocator
+    assert(tracking::stats("btree_map").live_bytes() == 0);
+}
+
+template <typename F>
+double time_ms(F f){
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// ns per element: insert, bulk load, find, range scan, full scan
+template <typename Map>
+void run(const char* name, const std::vector<uint64_t>& keys, const std::vector<std::pair<uint64_t, uint64_t>>& sorted){
+    size_t n = keys.size();
+    double per = 1e6 / static_cast<double>(n);
+    volatile uint64_t sink = 0;
+    Map map;
+    double insert = time_ms([&]{ for(uint64_t k : keys) map.emplace(k, k); });
+    // std::map's closest thing is inserting at the end with a hint
+    double bulk = time_ms([&]{
+        if constexpr (requires { Map(sorted_unique, sorted.begin(), sorted.end()); }){
+            Map loaded(sorted_unique, sorted.begin(), sorted.end());
+            sink = loaded.size();
+        }
+        else{
+            Map loaded;
+            for(const auto& p : sorted) loaded.emplace_hint(loaded.end(), p);
+            sink = loaded.size();
+        }
+    });
+    double find = time_ms([&]{
+        uint64_t sum = 0;
+        for(uint64_t k : keys) sum += map.find(k)->second;
+        sink = sum;
+    });
+    // n / 100 scans of 100 elements from random starting keys
+    double range = time_ms([&]{
+        uint64_t sum = 0;
+        for(size_t i=0; i<n; i+=100){
+            auto it = map.lower_bound(keys[i]);
+            for(int j=0; j<100 && it != map.end(); ++j, ++it) sum += it->second;
+        }
+        sink = sum;
+    });
+    double scan = time_ms([&]{
+        uint64_t sum = 0;
+        for(const auto& [k, v] : map) sum += v;
+        sink = sum;
+    });
+    std::cout << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << insert * per << std::setw(10) << bulk * per << std::setw(10) << find * per
+              << std::setw(10) << range * per << std::setw(10) << scan * per << "\n";
+    std::cout.unsetf(std::ios::fixed);
+}
+
+void Benchmark(size_t n){
+    std::mt19937_64 gen(42);
+    std::vector<uint64_t> keys(n);
+    for(auto& k : keys) k = gen();
+    std::vector<std::pair<uint64_t, uint64_t>> sorted;
+    sorted.reserve(n);
+    for(uint64_t k : keys) sorted.emplace_back(k, k);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    using Small = BTreeMap<uint64_t, uint64_t>;
+    using Large = BTreeMap<uint64_t, uint64_t, std::less<uint64_t>, 1024>;
+    std::cout << "\n" << std::left << std::setw(22) << "map" << std::right << std::setw(10) << "insert" << std::setw(10) << "bulk"
+              << std::setw(10) << "find" << std::setw(10) << "range" << std::setw(10) << "scan" << "   (ns per element)\n";
+    run<Small>("BTreeMap 256 B nodes", keys, sorted);
+    run<Large>("BTreeMap 1 KB nodes", keys, sorted);
+    run<std::map<uint64_t, uint64_t>>("std::map", keys, sorted);
+    std::cout << "Leaves of " << Small::LeafSlots << " and " << Large::LeafSlots << " elements\n";
+}
+
+int main(int argc, char** argv){
+    test_random_ops<TinyMap<int, int>>(30000, 500);
+    test_random_ops<TinyMap<int, int>>(30000, 5000);
+    test_bulk_load();
+    test_api();
+    test_large_and_sets();
+    test_exceptions();
+    test_allocator();
+    std::cout << "All B+-tree tests passed!\n";
+
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::cout << n << " entries" << std::endl;
+    Benchmark(n);
+}
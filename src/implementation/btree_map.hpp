@@ -0,0 +1,962 @@
+#pragma once
+/*
+B+-tree: ordered map and set with cache line sized nodes and linked leaves
+
+    BTreeMap<uint64_t, Order> orders;
+    orders.try_emplace(42, order);
+    for(auto it = orders.lower_bound(from); it != orders.end() && it->first < to; ++it) fill(it->second);
+    BTreeMap<int, double> prices(sorted_unique, sorted.begin(), sorted.end()); // bulk load, O(n)
+    BTreeSet<std::string> names = {"b", "a"};
+
+std::map and std::set (see src/stl_containers.cpp) are red-black trees with one node per element:
+every step of a lookup and every ++ of an iterator is a pointer to a node somewhere else in
+memory, usually a cache miss. Here the elements sit in leaves of NodeBytes (256 by default, 4 cache
+lines) holding about NodeBytes / sizeof(element) of them in order, and the leaves are linked, so a
+range scan reads whole arrays and moves to the next leaf with one pointer. Inner nodes only hold
+separator keys (copies of keys, K must be copyable) and child pointers, so a tree of a million
+16 byte elements is about 4 levels instead of 20.
+
+Nodes are kept at least half full (a full node splits in two, an underfull one borrows from a
+sibling or merges with it), except the root. Bulk loading from a sorted range without duplicates
+(the sorted_unique tag, like C++23's std::flat_map) fills the leaves completely and builds the
+inner levels bottom up, instead of n inserts; unsorted input throws std::invalid_argument.
+
+Same interface as std::map / std::set for lookups and iterators (bidirectional, reverse, lower /
+upper_bound, equal_range; heterogeneous lookup with a transparent Compare like std::less<>), but
+insert and erase move elements inside and between nodes, so they invalidate all iterators and
+references, like Vector's (erase returns a valid iterator to the next element). Map elements are
+moved as std::pair<K, V> and handed out as std::pair<const K, V>, through a union of the two like
+absl::btree_map's slots. Reading the inactive member of that union isn't defined by the standard;
+like absl we rely on GCC and Clang treating the two pairs as the same object (see MapPolicy).
+Moving elements is assumed not to throw; a failing allocation or key copy leaves the tree
+unchanged. The allocator is rebound for the two kinds of node (see tracking_allocator.hpp).
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Tag for constructors taking sorted input without duplicates
+struct sorted_unique_t{ explicit sorted_unique_t() = default; };
+inline constexpr sorted_unique_t sorted_unique{};
+
+namespace btree_detail{
+    // Lookup argument type: K (deduced) with a transparent Compare, Key otherwise (see flat_hash_map.hpp)
+    template <bool Transparent>
+    struct KeyArg{ template <typename K, typename Key> using type = Key; };
+    template <>
+    struct KeyArg<true>{ template <typename K, typename Key> using type = K; };
+
+    template <typename Compare>
+    concept Transparent = requires { typename Compare::is_transparent; };
+
+    template <typename K, typename V>
+    struct MapPolicy{
+        using key_type = K;
+        using value_type = std::pair<const K, V>;
+        // Both pair types over the same bytes, as absl's map slots do: the tree only constructs,
+        // moves, assigns and destroys mutable_value (the key can't move out of value, it's const),
+        // iterators hand out value. mutable_value stays the active member, so using value is still
+        // undefined behaviour in the standard. It relies on the same implementation guarantee as
+        // absl's btree (same layout, K and const K only differ in cv, union type punning allowed by
+        // GCC and Clang). Keeping value active would mean copying every key that shifts
+        union slot_type{
+            std::pair<K, V> mutable_value;
+            value_type value;
+
+            template <typename... Args> requires std::is_constructible_v<std::pair<K, V>, Args...>
+            slot_type(Args&&... args) : mutable_value(std::forward<Args>(args)...) {}
+            slot_type(const slot_type& other) : mutable_value(other.mutable_value) {}
+            slot_type(slot_type&& other) noexcept(std::is_nothrow_move_constructible_v<std::pair<K, V>>)
+                : mutable_value(std::move(other.mutable_value)) {}
+            slot_type& operator=(slot_type&& other) noexcept(std::is_nothrow_move_assignable_v<std::pair<K, V>>){
+                mutable_value = std::move(other.mutable_value);
+                return *this;
+            }
+            ~slot_type(){ std::destroy_at(&mutable_value); }
+        };
+        static constexpr bool constant_iterators = false;
+        static const K& key(const slot_type& s){ return s.mutable_value.first; }
+        static const K& key(const value_type& v){ return v.first; }
+        static value_type& element(slot_type& s){ return s.value; }
+        static const value_type& element(const slot_type& s){ return s.value; }
+    };
+
+    template <typename K>
+    struct SetPolicy{
+        using key_type = K;
+        using value_type = K;
+        using slot_type = K;
+        static constexpr bool constant_iterators = true;
+        static const K& key(const K& k){ return k; }
+        static K& element(K& s){ return s; }
+    };
+
+    // Slots that fit in bytes after a header, at least 4
+    constexpr size_t fit(size_t bytes, size_t header, size_t each){
+        return std::max<size_t>(4, bytes > header ? (bytes - header) / each : 0);
+    }
+
+    // The tree shared by BTreeMap and BTreeSet
+    template <typename Policy, typename Compare, size_t NodeBytes, typename Alloc>
+    class Tree{
+    protected:
+        using K = typename Policy::key_type;
+        using slot_type = typename Policy::slot_type;
+
+        struct Inner;
+        struct Node{
+            explicit Node(bool leaf) : leaf(leaf) {}
+            Inner* parent = nullptr;
+            uint16_t position = 0;  // index in parent->children
+            uint16_t count = 0;     // elements of a leaf, keys of an inner node
+            bool leaf;
+        };
+
+    public:
+        static constexpr size_t LeafSlots = fit(NodeBytes, sizeof(Node) + 2 * sizeof(void*), sizeof(slot_type));
+        static constexpr size_t InnerSlots = fit(NodeBytes, sizeof(Node) + sizeof(void*), sizeof(K) + sizeof(void*));
+        static_assert(LeafSlots < 65536 && InnerSlots < 65536, "node too large for 16 bit counts");
+
+    protected:
+        static constexpr size_t LeafMin = LeafSlots / 2;
+        static constexpr size_t InnerMin = (InnerSlots - 1) / 2;
+
+        struct Leaf : Node{
+            Leaf() : Node(true) {}
+            slot_type* slots(){ return reinterpret_cast<slot_type*>(storage); }
+            const slot_type* slots() const { return reinterpret_cast<const slot_type*>(storage); }
+            const K& key(size_t i) const { return Policy::key(slots()[i]); }
+
+            Leaf* prev = nullptr;
+            Leaf* next = nullptr;
+            alignas(slot_type) unsigned char storage[LeafSlots * sizeof(slot_type)];
+        };
+
+        // children[i] holds the keys below keys[i], children[i + 1] the ones from keys[i] on
+        struct Inner : Node{
+            Inner() : Node(false) {}
+            K* keys(){ return reinterpret_cast<K*>(storage); }
+            const K* keys() const { return reinterpret_cast<const K*>(storage); }
+
+            alignas(K) unsigned char storage[InnerSlots * sizeof(K)];
+            Node* children[InnerSlots + 1];
+        };
+
+        using LeafTraits = typename std::allocator_traits<Alloc>::template rebind_traits<Leaf>;
+        using LeafAlloc = typename LeafTraits::allocator_type;
+        using InnerTraits = typename std::allocator_traits<Alloc>::template rebind_traits<Inner>;
+        using InnerAlloc = typename InnerTraits::allocator_type;
+
+        template <typename Key>
+        using key_arg = typename KeyArg<Transparent<Compare>>::template type<Key, K>;
+
+    public:
+        using key_type = K;
+        using value_type = typename Policy::value_type;
+        using size_type = size_t;
+        using difference_type = std::ptrdiff_t;
+        using key_compare = Compare;
+        using allocator_type = Alloc;
+        using reference = value_type&;
+        using const_reference = const value_type&;
+
+        template <bool Const>
+        class Iterator{
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = Tree::value_type;
+            using difference_type = std::ptrdiff_t;
+            using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+            using reference = std::conditional_t<Const, const value_type&, value_type&>;
+
+            Iterator() = default;
+            // iterator -> const_iterator
+            template <bool OtherConst> requires (Const && !OtherConst)
+            Iterator(const Iterator<OtherConst>& other) : leaf_(other.leaf_), pos_(other.pos_) {}
+
+            reference operator*() const { return Policy::element(leaf_->slots()[pos_]); }
+            pointer operator->() const { return &**this; }
+            // The end iterator is one past the last element of the last leaf
+            Iterator& operator++(){
+                if(++pos_ == leaf_->count && leaf_->next){
+                    leaf_ = leaf_->next;
+                    pos_ = 0;
+                }
+                return *this;
+            }
+            Iterator& operator--(){
+                if(pos_ == 0){
+                    leaf_ = leaf_->prev;
+                    pos_ = leaf_->count;
+                }
+                --pos_;
+                return *this;
+            }
+            Iterator operator++(int){ auto old = *this; ++*this; return old; }
+            Iterator operator--(int){ auto old = *this; --*this; return old; }
+            friend bool operator==(const Iterator& a, const Iterator& b){ return a.leaf_ == b.leaf_ && a.pos_ == b.pos_; }
+
+        private:
+            friend class Tree;
+            template <bool> friend class Iterator;
+            Iterator(Leaf* leaf, size_t pos) : leaf_(leaf), pos_(pos) {}
+
+            Leaf* leaf_ = nullptr;
+            size_t pos_ = 0;
+        };
+
+        using const_iterator = Iterator<true>;
+        using iterator = std::conditional_t<Policy::constant_iterators, const_iterator, Iterator<false>>;
+        using reverse_iterator = std::reverse_iterator<iterator>;
+        using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+        Tree() : Tree(Compare()) {}
+        explicit Tree(const Compare& comp, const Alloc& alloc = Alloc()) : comp_(comp), alloc_(alloc) {}
+        explicit Tree(const Alloc& alloc) : Tree(Compare(), alloc) {}
+        template <std::input_iterator It>
+        Tree(It first, It last, const Compare& comp = Compare(), const Alloc& alloc = Alloc()) : Tree(comp, alloc) {
+            insert(first, last);
+        }
+        // Bulk load: first..last must be sorted by comp without equal keys
+        template <std::input_iterator It>
+        Tree(sorted_unique_t, It first, It last, const Compare& comp = Compare(), const Alloc& alloc = Alloc()) : Tree(comp, alloc) {
+            build_sorted(first, last);
+        }
+        Tree(std::initializer_list<value_type> list, const Compare& comp = Compare(), const Alloc& alloc = Alloc())
+            : Tree(list.begin(), list.end(), comp, alloc) {}
+
+        Tree(const Tree& other)
+            : comp_(other.comp_), alloc_(LeafTraits::select_on_container_copy_construction(other.alloc_)) {
+            build_sorted(other.begin(), other.end());
+        }
+        Tree(Tree&& other) noexcept : comp_(other.comp_), alloc_(std::move(other.alloc_)) { steal(other); }
+
+        Tree& operator=(const Tree& other){
+            if(this != &other){
+                clear();
+                comp_ = other.comp_;
+                build_sorted(other.begin(), other.end());
+            }
+            return *this;
+        }
+        Tree& operator=(Tree&& other) noexcept(LeafTraits::propagate_on_container_move_assignment::value || LeafTraits::is_always_equal::value){
+            if(this == &other) return *this;
+            clear();
+            comp_ = other.comp_;
+            if constexpr (LeafTraits::propagate_on_container_move_assignment::value || LeafTraits::is_always_equal::value){
+                if constexpr (LeafTraits::propagate_on_container_move_assignment::value) alloc_ = std::move(other.alloc_);
+                steal(other);
+            }
+            else if(alloc_ == other.alloc_) steal(other);
+            else{
+                // Different memory: move the elements one by one
+                build_sorted(std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()));
+                other.clear();
+            }
+            return *this;
+        }
+        Tree& operator=(std::initializer_list<value_type> list){
+            clear();
+            insert(list);
+            return *this;
+        }
+
+        ~Tree(){ clear(); }
+
+        // Iterators
+        iterator begin(){ return iterator(first_, 0); }
+        iterator end(){ return iterator(last_, last_ ? last_->count : 0); }
+        const_iterator begin() const { return const_cast<Tree*>(this)->begin(); }
+        const_iterator end() const { return const_cast<Tree*>(this)->end(); }
+        const_iterator cbegin() const { return begin(); }
+        const_iterator cend() const { return end(); }
+        reverse_iterator rbegin(){ return reverse_iterator(end()); }
+        reverse_iterator rend(){ return reverse_iterator(begin()); }
+        const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+        const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+        // Capacity
+        bool empty() const noexcept { return size_ == 0; }
+        size_t size() const noexcept { return size_; }
+        // Levels of nodes, 0 when empty
+        size_t height() const noexcept {
+            size_t h = 0;
+            for(const Node* n = root_; n; n = n->leaf ? nullptr : static_cast<const Inner*>(n)->children[0]) ++h;
+            return h;
+        }
+
+        void clear() noexcept {
+            if(root_) destroy(root_);
+            root_ = nullptr;
+            first_ = last_ = nullptr;
+            size_ = 0;
+        }
+
+        void swap(Tree& other) noexcept {
+            using std::swap;
+            swap(root_, other.root_);
+            swap(first_, other.first_);
+            swap(last_, other.last_);
+            swap(size_, other.size_);
+            swap(comp_, other.comp_);
+            if constexpr (LeafTraits::propagate_on_container_swap::value) swap(alloc_, other.alloc_);
+        }
+        friend void swap(Tree& a, Tree& b) noexcept { a.swap(b); }
+
+        // Insertion: nothing happens if the key is already there (the iterator points to it)
+        std::pair<iterator, bool> insert(const value_type& v){ return emplace(v); }
+        std::pair<iterator, bool> insert(value_type&& v){ return emplace(std::move(v)); }
+        template <std::input_iterator It>
+        void insert(It first, It last){
+            for(; first != last; ++first) emplace(*first);
+        }
+        void insert(std::initializer_list<value_type> list){ insert(list.begin(), list.end()); }
+
+        // Builds the element first to find its key
+        template <typename... Args>
+        std::pair<iterator, bool> emplace(Args&&... args){
+            slot_type slot(std::forward<Args>(args)...);
+            const K& key = Policy::key(slot);
+            return insert_unique(key, [&]{ return std::move(slot); });
+        }
+
+        // Lookup
+        template <typename Key = K>
+        iterator find(const key_arg<Key>& key){
+            iterator it = lower_bound(key);
+            return it != end() && !comp_(key, Policy::key(*it)) ? it : end();
+        }
+        template <typename Key = K>
+        const_iterator find(const key_arg<Key>& key) const { return const_cast<Tree*>(this)->find(key); }
+        template <typename Key = K>
+        bool contains(const key_arg<Key>& key) const { return find(key) != end(); }
+        template <typename Key = K>
+        size_t count(const key_arg<Key>& key) const { return contains(key) ? 1 : 0; }
+
+        // First element not less than key
+        template <typename Key = K>
+        iterator lower_bound(const key_arg<Key>& key){
+            if(!root_) return end();
+            Leaf* leaf = find_leaf(key);
+            return make_iterator(leaf, lower_index(leaf, key));
+        }
+        template <typename Key = K>
+        const_iterator lower_bound(const key_arg<Key>& key) const { return const_cast<Tree*>(this)->lower_bound(key); }
+
+        // First element greater than key
+        template <typename Key = K>
+        iterator upper_bound(const key_arg<Key>& key){
+            if(!root_) return end();
+            Leaf* leaf = find_leaf(key);
+            return make_iterator(leaf, upper_index(leaf, key));
+        }
+        template <typename Key = K>
+        const_iterator upper_bound(const key_arg<Key>& key) const { return const_cast<Tree*>(this)->upper_bound(key); }
+
+        template <typename Key = K>
+        std::pair<iterator, iterator> equal_range(const key_arg<Key>& key){
+            iterator it = find(key);
+            return {it == end() ? lower_bound(key) : it, it == end() ? lower_bound(key) : std::next(it)};
+        }
+        template <typename Key = K>
+        std::pair<const_iterator, const_iterator> equal_range(const key_arg<Key>& key) const {
+            auto [lo, hi] = const_cast<Tree*>(this)->equal_range(key);
+            return {lo, hi};
+        }
+
+        // Erasure: invalidates iterators, returns the one after the erased element(s)
+        template <typename Key = K>
+        size_t erase(const key_arg<Key>& key){
+            iterator it = find(key);
+            if(it == end()) return 0;
+            erase(it);
+            return 1;
+        }
+        iterator erase(const_iterator pos){ return erase_at(pos.leaf_, pos.pos_); }
+        iterator erase(iterator pos) requires (!std::is_same_v<iterator, const_iterator>) { return erase(const_iterator(pos)); }
+        iterator erase(const_iterator first, const_iterator last){
+            if(first == begin() && last == end()){
+                clear();
+                return end();
+            }
+            // last is invalidated by the first erase, remember its key
+            std::optional<K> stop;
+            if(last != end()) stop.emplace(Policy::key(*last));
+            iterator it(first.leaf_, first.pos_);
+            while(it != end() && (!stop || comp_(Policy::key(*it), *stop))) it = erase(it);
+            return it;
+        }
+
+        key_compare key_comp() const { return comp_; }
+        allocator_type get_allocator() const { return allocator_type(alloc_); }
+
+        friend bool operator==(const Tree& a, const Tree& b){
+            return a.size_ == b.size_ && std::equal(a.begin(), a.end(), b.begin());
+        }
+
+        // Checks the structure (for tests): node sizes, key order, parent links, leaf links, depth
+        bool valid() const {
+            if(!root_) return size_ == 0 && !first_ && !last_;
+            if(root_->parent) return false;
+            size_t depth = 0, leaves_depth = 0, count = 0;
+            const Leaf* prev = nullptr;
+            if(!valid(root_, nullptr, nullptr, depth, leaves_depth, count, prev)) return false;
+            return count == size_ && prev == last_ && !last_->next && !first_->prev;
+        }
+
+    protected:
+        template <typename Key>
+        size_t lower_index(const Leaf* leaf, const Key& key) const {
+            size_t lo = 0, hi = leaf->count;
+            while(lo < hi){
+                size_t mid = (lo + hi) / 2;
+                if(comp_(leaf->key(mid), key)) lo = mid + 1;
+                else hi = mid;
+            }
+            return lo;
+        }
+        template <typename Key>
+        size_t upper_index(const Leaf* leaf, const Key& key) const {
+            size_t lo = 0, hi = leaf->count;
+            while(lo < hi){
+                size_t mid = (lo + hi) / 2;
+                if(comp_(key, leaf->key(mid))) hi = mid;
+                else lo = mid + 1;
+            }
+            return lo;
+        }
+        // The child whose range holds key: the first separator greater than key
+        template <typename Key>
+        size_t child_index(const Inner* node, const Key& key) const {
+            size_t lo = 0, hi = node->count;
+            while(lo < hi){
+                size_t mid = (lo + hi) / 2;
+                if(comp_(key, node->keys()[mid])) hi = mid;
+                else lo = mid + 1;
+            }
+            return lo;
+        }
+        template <typename Key>
+        Leaf* find_leaf(const Key& key) const {
+            Node* n = root_;
+            while(!n->leaf){
+                auto* inner = static_cast<Inner*>(n);
+                n = inner->children[child_index(inner, key)];
+            }
+            return static_cast<Leaf*>(n);
+        }
+
+        // Past the end of a leaf is the start of the next one, except for the last leaf (end())
+        iterator make_iterator(Leaf* leaf, size_t pos){
+            if(pos == leaf->count && leaf->next) return iterator(leaf->next, 0);
+            return iterator(leaf, pos);
+        }
+
+        // Inserts make() unless key is there. make() runs before the tree changes
+        template <typename Key, typename Make>
+        std::pair<iterator, bool> insert_unique(const Key& key, Make make){
+            Leaf* leaf = nullptr;
+            size_t i = 0;
+            if(root_){
+                leaf = find_leaf(key);
+                i = lower_index(leaf, key);
+                if(i < leaf->count && !comp_(key, leaf->key(i))) return {iterator(leaf, i), false};
+            }
+            slot_type slot = make();
+            if(!root_){
+                leaf = root_leaf();
+            }
+            else if(leaf->count == LeafSlots){
+                auto [target, at] = split_leaf(leaf, i);
+                leaf = target;
+                i = at;
+            }
+            insert_at(leaf->slots(), leaf->count, i, std::move(slot));
+            ++leaf->count;
+            ++size_;
+            return {iterator(leaf, i), true};
+        }
+
+        Leaf* root_leaf(){
+            Leaf* leaf = new_leaf();
+            root_ = first_ = last_ = leaf;
+            return leaf;
+        }
+
+        // Inner nodes a split of leaf needs: one per full ancestor, and a new root
+        class Spares{
+        public:
+            Spares(Tree& tree, const Leaf* leaf) : tree_(tree) {
+                size_t needed = 0;
+                const Inner* p = leaf->parent;
+                while(p && p->count == InnerSlots){
+                    ++needed;
+                    p = p->parent;
+                }
+                if(!p) ++needed;
+                nodes_.reserve(needed);
+                try{
+                    for(size_t i=0; i<needed; ++i) nodes_.push_back(tree_.new_inner());
+                }
+                catch(...){
+                    for(Inner* n : nodes_) tree_.free_inner(n);
+                    throw;
+                }
+            }
+            ~Spares(){ for(Inner* n : nodes_) tree_.free_inner(n); }
+            Inner* take(){
+                Inner* n = nodes_.back();
+                nodes_.pop_back();
+                return n;
+            }
+
+        private:
+            Tree& tree_;
+            std::vector<Inner*> nodes_;
+        };
+
+        // Splits a full leaf in two halves; returns the leaf and position where index i ends up
+        std::pair<Leaf*, size_t> split_leaf(Leaf* leaf, size_t i){
+            size_t mid = LeafSlots / 2;
+            // Everything that can throw first
+            K separator = leaf->key(mid);
+            Spares spares(*this, leaf);
+            Leaf* right = new_leaf();
+
+            move_to(leaf->slots() + mid, leaf->slots() + leaf->count, right->slots());
+            right->count = static_cast<uint16_t>(leaf->count - mid);
+            leaf->count = static_cast<uint16_t>(mid);
+            right->prev = leaf;
+            right->next = leaf->next;
+            if(leaf->next) leaf->next->prev = right;
+            else last_ = right;
+            leaf->next = right;
+
+            insert_into_parent(leaf, std::move(separator), right, spares);
+            if(i <= mid) return {leaf, i};
+            return {right, i - mid};
+        }
+
+        // right goes after left in left's parent, separated by key
+        void insert_into_parent(Node* left, K&& key, Node* right, Spares& spares){
+            Inner* parent = left->parent;
+            if(!parent){
+                Inner* root = spares.take();
+                std::construct_at(root->keys(), std::move(key));
+                set_child(root, 0, left);
+                set_child(root, 1, right);
+                root->count = 1;
+                root_ = root;
+                return;
+            }
+            if(parent->count == InnerSlots){
+                split_inner(parent, spares);
+                parent = left->parent;
+            }
+            size_t at = left->position;
+            insert_at(parent->keys(), parent->count, at, std::move(key));
+            insert_child(parent, at + 1, right);
+            ++parent->count;
+        }
+
+        // The middle key moves up, the keys and children after it go to a new node
+        void split_inner(Inner* node, Spares& spares){
+            Inner* right = spares.take();
+            size_t mid = node->count / 2;
+            K up = std::move(node->keys()[mid]);
+            move_to(node->keys() + mid + 1, node->keys() + node->count, right->keys());
+            std::destroy_at(node->keys() + mid);
+            for(size_t j=mid+1; j<=node->count; ++j) set_child(right, j - mid - 1, node->children[j]);
+            right->count = static_cast<uint16_t>(node->count - mid - 1);
+            node->count = static_cast<uint16_t>(mid);
+            insert_into_parent(node, std::move(up), right, spares);
+        }
+
+        // Returns the iterator to the element after the erased one, wherever rebalancing moved it
+        iterator erase_at(Leaf* leaf, size_t i){
+            if(leaf == root_ || leaf->count > LeafMin){
+                remove_from_leaf(leaf, i);
+                if(leaf == root_ && leaf->count == 0){
+                    free_leaf(leaf);
+                    root_ = first_ = last_ = nullptr;
+                    return end();
+                }
+                return make_iterator(leaf, i);
+            }
+
+            // The leaf drops below the minimum. Borrowing changes a separator, whose copy is made
+            // before anything moves, so a throwing key copy leaves the tree unchanged
+            Inner* parent = leaf->parent;
+            size_t pos = leaf->position;
+            Leaf* left = pos > 0 ? static_cast<Leaf*>(parent->children[pos - 1]) : nullptr;
+            Leaf* right = pos < parent->count ? static_cast<Leaf*>(parent->children[pos + 1]) : nullptr;
+            if(left && left->count > LeafMin){
+                // Borrow the last element of the left sibling
+                K separator = left->key(left->count - 1);
+                remove_from_leaf(leaf, i);
+                insert_at(leaf->slots(), leaf->count, 0, std::move(left->slots()[left->count - 1]));
+                std::destroy_at(left->slots() + left->count - 1);
+                --left->count;
+                ++leaf->count;
+                parent->keys()[pos - 1] = std::move(separator);
+                return make_iterator(leaf, i + 1);
+            }
+            if(right && right->count > LeafMin){
+                // Borrow the first element of the right sibling, its second one becomes the separator
+                K separator = right->key(1);
+                remove_from_leaf(leaf, i);
+                std::construct_at(leaf->slots() + leaf->count, std::move(right->slots()[0]));
+                ++leaf->count;
+                erase_from(right->slots(), right->count, 0);
+                --right->count;
+                parent->keys()[pos] = std::move(separator);
+                return make_iterator(leaf, i);
+            }
+            remove_from_leaf(leaf, i);
+            if(left){
+                size_t at = left->count + i;
+                merge_leaves(left, leaf, pos - 1);
+                return make_iterator(left, at);
+            }
+            merge_leaves(leaf, right, pos);
+            return make_iterator(leaf, i);
+        }
+
+        void remove_from_leaf(Leaf* leaf, size_t i){
+            erase_from(leaf->slots(), leaf->count, i);
+            --leaf->count;
+            --size_;
+        }
+
+        // b (the child after separator k of their parent) is appended to a and freed
+        void merge_leaves(Leaf* a, Leaf* b, size_t k){
+            move_to(b->slots(), b->slots() + b->count, a->slots() + a->count);
+            a->count = static_cast<uint16_t>(a->count + b->count);
+            a->next = b->next;
+            if(b->next) b->next->prev = a;
+            else last_ = a;
+            free_leaf(b);
+            remove_separator(a->parent, k);
+        }
+
+        void merge_inner(Inner* a, Inner* b, size_t k){
+            Inner* parent = a->parent;
+            std::construct_at(a->keys() + a->count, std::move(parent->keys()[k]));
+            move_to(b->keys(), b->keys() + b->count, a->keys() + a->count + 1);
+            for(size_t j=0; j<=b->count; ++j) set_child(a, a->count + 1 + j, b->children[j]);
+            a->count = static_cast<uint16_t>(a->count + b->count + 1);
+            free_inner(b);
+            remove_separator(parent, k);
+        }
+
+        // Removes keys[k] and children[k + 1] (already merged away), then fixes node if it is too small
+        void remove_separator(Inner* node, size_t k){
+            erase_from(node->keys(), node->count, k);
+            for(size_t c=k+1; c<node->count; ++c) set_child(node, c, node->children[c + 1]);
+            --node->count;
+            if(node == root_){
+                if(node->count == 0){
+                    root_ = node->children[0];
+                    root_->parent = nullptr;
+                    root_->position = 0;
+                    free_inner(node);
+                }
+                return;
+            }
+            if(node->count >= InnerMin) return;
+
+            Inner* parent = node->parent;
+            size_t pos = node->position;
+            Inner* left = pos > 0 ? static_cast<Inner*>(parent->children[pos - 1]) : nullptr;
+            Inner* right = pos < parent->count ? static_cast<Inner*>(parent->children[pos + 1]) : nullptr;
+            if(left && left->count > InnerMin){
+                // Rotate right: the separator comes down, the left sibling's last key goes up
+                insert_at(node->keys(), node->count, 0, std::move(parent->keys()[pos - 1]));
+                insert_child(node, 0, left->children[left->count]);
+                ++node->count;
+                parent->keys()[pos - 1] = std::move(left->keys()[left->count - 1]);
+                std::destroy_at(left->keys() + left->count - 1);
+                --left->count;
+            }
+            else if(right && right->count > InnerMin){
+                std::construct_at(node->keys() + node->count, std::move(parent->keys()[pos]));
+                set_child(node, node->count + 1u, right->children[0]);
+                ++node->count;
+                parent->keys()[pos] = std::move(right->keys()[0]);
+                erase_from(right->keys(), right->count, 0);
+                for(size_t c=0; c<right->count; ++c) set_child(right, c, right->children[c + 1]);
+                --right->count;
+            }
+            else if(left) merge_inner(left, node, pos - 1);
+            else merge_inner(node, right, pos);
+        }
+
+        // Shifts a[i, n) up by one and puts x at i
+        template <typename T>
+        static void insert_at(T* a, size_t n, size_t i, T&& x){
+            if(i == n){
+                std::construct_at(a + n, std::move(x));
+                return;
+            }
+            std::construct_at(a + n, std::move(a[n - 1]));
+            std::move_backward(a + i, a + n - 1, a + n);
+            a[i] = std::move(x);
+        }
+        // Shifts a[i + 1, n) down by one over a[i], the last one is destroyed
+        template <typename T>
+        static void erase_from(T* a, size_t n, size_t i){
+            std::move(a + i + 1, a + n, a + i);
+            std::destroy_at(a + n - 1);
+        }
+        // Moves [first, last) into uninitialized memory and destroys the originals
+        template <typename T>
+        static void move_to(T* first, T* last, T* out){
+            for(; first != last; ++first, ++out){
+                std::construct_at(out, std::move(*first));
+                std::destroy_at(first);
+            }
+        }
+
+        static void set_child(Inner* node, size_t i, Node* child){
+            node->children[i] = child;
+            child->parent = node;
+            child->position = static_cast<uint16_t>(i);
+        }
+        // Shifts children[at, count] up by one and puts child at at
+        static void insert_child(Inner* node, size_t at, Node* child){
+            for(size_t j=node->count+1u; j>at; --j) set_child(node, j, node->children[j - 1]);
+            set_child(node, at, child);
+        }
+
+        static const K& min_key(const Node* n){
+            while(!n->leaf) n = static_cast<const Inner*>(n)->children[0];
+            return static_cast<const Leaf*>(n)->key(0);
+        }
+
+        // Full leaves left to right, then each level of inner nodes over the one below it
+        template <typename It>
+        void build_sorted(It first, It last){
+            std::vector<Node*> level;
+            std::vector<Inner*> inners;
+            try{
+                Leaf* leaf = nullptr;
+                for(; first != last; ++first){
+                    if(!leaf || leaf->count == LeafSlots){
+                        Leaf* next = new_leaf();
+                        next->prev = leaf;
+                        if(leaf) leaf->next = next;
+                        else first_ = next;
+                        last_ = leaf = next;
+                        level.push_back(leaf);
+                    }
+                    std::construct_at(leaf->slots() + leaf->count, *first);
+                    ++leaf->count;
+                    ++size_;
+                    const K* prev = leaf->count > 1 ? &leaf->key(leaf->count - 2u) : leaf->prev ? &leaf->prev->key(leaf->prev->count - 1u) : nullptr;
+                    if(prev && !comp_(*prev, leaf->key(leaf->count - 1u))) throw std::invalid_argument("bulk load input is not sorted and unique");
+                }
+                // The last leaf takes elements from the one before it to be at least half full
+                if(level.size() > 1 && leaf->count < LeafMin){
+                    Leaf* prev = leaf->prev;
+                    size_t moved = (prev->count + leaf->count) / 2 - leaf->count;
+                    for(size_t j=leaf->count; j-->0; ){
+                        std::construct_at(leaf->slots() + j + moved, std::move(leaf->slots()[j]));
+                        std::destroy_at(leaf->slots() + j);
+                    }
+                    move_to(prev->slots() + prev->count - moved, prev->slots() + prev->count, leaf->slots());
+                    prev->count = static_cast<uint16_t>(prev->count - moved);
+                    leaf->count = static_cast<uint16_t>(leaf->count + moved);
+                }
+                // Parents with as even a number of children as possible, so every one is at least half full
+                while(level.size() > 1){
+                    size_t m = level.size(), parents = (m + InnerSlots) / (InnerSlots + 1);
+                    std::vector<Node*> up;
+                    for(size_t p=0, at=0; p<parents; ++p){
+                        size_t take = m / parents + (p < m % parents ? 1 : 0);
+                        Inner* node = new_inner();
+                        inners.push_back(node);
+                        for(size_t j=0; j<take; ++j){
+                            set_child(node, j, level[at + j]);
+                            if(j > 0){
+                                std::construct_at(node->keys() + j - 1, min_key(level[at + j]));
+                                ++node->count;
+                            }
+                        }
+                        up.push_back(node);
+                        at += take;
+                    }
+                    level = std::move(up);
+                }
+                root_ = level.empty() ? nullptr : level[0];
+            }
+            catch(...){
+                // Nothing is linked to the root yet: free the leaves by their links and the inner nodes by the list
+                for(Inner* node : inners){
+                    std::destroy(node->keys(), node->keys() + node->count);
+                    free_inner(node);
+                }
+                for(Leaf* leaf = first_; leaf; ){
+                    Leaf* next = leaf->next;
+                    std::destroy(leaf->slots(), leaf->slots() + leaf->count);
+                    free_leaf(leaf);
+                    leaf = next;
+                }
+                root_ = nullptr;
+                first_ = last_ = nullptr;
+                size_ = 0;
+                throw;
+            }
+        }
+
+        void steal(Tree& other){
+            root_ = std::exchange(other.root_, nullptr);
+            first_ = std::exchange(other.first_, nullptr);
+            last_ = std::exchange(other.last_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+        }
+
+        void destroy(Node* n) noexcept {
+            if(n->leaf){
+                auto* leaf = static_cast<Leaf*>(n);
+                std::destroy(leaf->slots(), leaf->slots() + leaf->count);
+                free_leaf(leaf);
+                return;
+            }
+            auto* inner = static_cast<Inner*>(n);
+            for(size_t i=0; i<=inner->count; ++i) destroy(inner->children[i]);
+            std::destroy(inner->keys(), inner->keys() + inner->count);
+            free_inner(inner);
+        }
+
+        Leaf* new_leaf(){
+            Leaf* p = LeafTraits::allocate(alloc_, 1);
+            return std::construct_at(p);
+        }
+        void free_leaf(Leaf* p) noexcept {
+            std::destroy_at(p);
+            LeafTraits::deallocate(alloc_, p, 1);
+        }
+        Inner* new_inner(){
+            InnerAlloc alloc(alloc_);
+            Inner* p = InnerTraits::allocate(alloc, 1);
+            return std::construct_at(p);
+        }
+        void free_inner(Inner* p) noexcept {
+            InnerAlloc alloc(alloc_);
+            std::destroy_at(p);
+            InnerTraits::deallocate(alloc, p, 1);
+        }
+
+        // Keys of n within [lo, hi) (null: unbounded), sizes and links right, leaves at one depth and in order
+        bool valid(const Node* n, const K* lo, const K* hi, size_t depth, size_t& leaves_depth, size_t& count, const Leaf*& prev) const {
+            bool root = n == root_;
+            auto in_range = [&](const K& k){ return (!lo || !comp_(k, *lo)) && (!hi || comp_(k, *hi)); };
+            if(n->leaf){
+                auto* leaf = static_cast<const Leaf*>(n);
+                if(leaf->count == 0 || leaf->count > LeafSlots || (!root && leaf->count < LeafMin)) return false;
+                if(leaves_depth == 0) leaves_depth = depth + 1;
+                if(leaves_depth != depth + 1 || leaf->prev != prev || (prev ? prev->next != leaf : first_ != leaf)) return false;
+                for(size_t i=0; i<leaf->count; ++i){
+                    if(!in_range(leaf->key(i)) || (i > 0 && !comp_(leaf->key(i - 1), leaf->key(i)))) return false;
+                }
+                count += leaf->count;
+                prev = leaf;
+                return true;
+            }
+            auto* inner = static_cast<const Inner*>(n);
+            if(inner->count == 0 || inner->count > InnerSlots || (!root && inner->count < InnerMin)) return false;
+            for(size_t i=0; i<inner->count; ++i){
+                if(!in_range(inner->keys()[i]) || (i > 0 && !comp_(inner->keys()[i - 1], inner->keys()[i]))) return false;
+            }
+            for(size_t i=0; i<=inner->count; ++i){
+                const Node* child = inner->children[i];
+                if(child->parent != inner || child->position != i) return false;
+                const K* child_lo = i > 0 ? &inner->keys()[i - 1] : lo;
+                const K* child_hi = i < inner->count ? &inner->keys()[i] : hi;
+                if(!valid(child, child_lo, child_hi, depth + 1, leaves_depth, count, prev)) return false;
+            }
+            return true;
+        }
+
+        Node* root_ = nullptr;
+        Leaf* first_ = nullptr;
+        Leaf* last_ = nullptr;
+        size_t size_ = 0;
+        [[no_unique_address]] Compare comp_;
+        [[no_unique_address]] LeafAlloc alloc_;
+    };
+}
+
+template <typename K, typename V, typename Compare = std::less<K>, size_t NodeBytes = 256,
+          typename Alloc = std::allocator<std::pair<const K, V>>>
+class BTreeMap : public btree_detail::Tree<btree_detail::MapPolicy<K, V>, Compare, NodeBytes, Alloc>{
+    using Base = btree_detail::Tree<btree_detail::MapPolicy<K, V>, Compare, NodeBytes, Alloc>;
+    template <typename Key>
+    using key_arg = typename Base::template key_arg<Key>;
+
+public:
+    using mapped_type = V;
+    using typename Base::iterator;
+    using typename Base::const_iterator;
+    using Base::Base;
+    using Base::operator=;
+
+    // Constructs the value from args only if the key isn't there
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args){ return try_emplace_impl(key, std::forward<Args>(args)...); }
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args){ return try_emplace_impl(std::move(key), std::forward<Args>(args)...); }
+
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const K& key, M&& value){ return insert_or_assign_impl(key, std::forward<M>(value)); }
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(K&& key, M&& value){ return insert_or_assign_impl(std::move(key), std::forward<M>(value)); }
+
+    V& operator[](const K& key){ return try_emplace(key).first->second; }
+    V& operator[](K&& key){ return try_emplace(std::move(key)).first->second; }
+
+    template <typename Key = K>
+    V& at(const key_arg<Key>& key){
+        auto it = this->find(key);
+        if(it == this->end()) throw std::out_of_range("BTreeMap::at: key not found");
+        return it->second;
+    }
+    template <typename Key = K>
+    const V& at(const key_arg<Key>& key) const { return const_cast<BTreeMap*>(this)->at(key); }
+
+private:
+    template <typename Key, typename... Args>
+    std::pair<iterator, bool> try_emplace_impl(Key&& key, Args&&... args){
+        const K& k = key;
+        return this->insert_unique(k, [&]{
+            return typename Base::slot_type(std::piecewise_construct, std::forward_as_tuple(std::forward<Key>(key)),
+                                            std::forward_as_tuple(std::forward<Args>(args)...));
+        });
+    }
+
+    template <typename Key, typename M>
+    std::pair<iterator, bool> insert_or_assign_impl(Key&& key, M&& value){
+        auto result = try_emplace_impl(std::forward<Key>(key), std::forward<M>(value));
+        if(!result.second) result.first->second = std::forward<M>(value);
+        return result;
+    }
+};
+
+template <typename K, typename Compare = std::less<K>, size_t NodeBytes = 256, typename Alloc = std::allocator<K>>
+class BTreeSet : public btree_detail::Tree<btree_detail::SetPolicy<K>, Compare, NodeBytes, Alloc>{
+    using Base = btree_detail::Tree<btree_detail::SetPolicy<K>, Compare, NodeBytes, Alloc>;
+
+public:
+    using Base::Base;
+    using Base::operator=;
+};
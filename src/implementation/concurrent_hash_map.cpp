@@ -0,0 +1,217 @@
+/*
+Tests and benchmark for the concurrent hash map (see concurrent_hash_map.hpp)
+
+The tests run writers and readers at the same time (check with -fsanitize=thread): counters
+updated from every thread, disjoint inserts and erases, and readers that must always find the keys
+inserted before they started while segments are resizing under them.
+The benchmark runs a read-heavy (99% find, 1% insert_or_assign / erase) and a write-heavy (50/50)
+mix of random keys on 1, 2, 4 ... threads, with a std::unordered_map behind one std::mutex (as in
+src/mutex.cpp), behind one std::shared_mutex, and the ConcurrentHashMap, in millions of operations
+per second over all threads.
+Arguments: operations per mix, number of keys, largest thread count
+*/
+
+#include "concurrent_hash_map.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <random>
+#include <cassert>
+#include <cstdlib>
+
+void test_single_thread(){
+    ConcurrentHashMap<std::string, int> m(4);
+    assert(m.segments() == 4 && m.empty());
+    assert(m.insert("a", 1) && !m.insert("a", 2));
+    assert(m.find("a") == 1 && !m.find("b"));
+    assert(!m.insert_or_assign("a", 3) && m.insert_or_assign("b", 4));
+    assert(m.update("a", [](int& v){ v *= 10; }) && m.find("a") == 30);
+    assert(!m.update("c", [](int& v){ v = 0; }) && !m.contains("c"));
+    m.upsert("c", [](int& v){ v += 5; });
+    m.upsert("c", [](int& v){ v += 5; });
+    assert(m.find("c") == 10);
+    int seen = 0;
+    assert(m.visit("b", [&](const int& v){ seen = v; }) && seen == 4);
+    assert(m.erase("b") && !m.erase("b") && m.size() == 2);
+
+    // Grow through many incremental resizes and compare with std::unordered_map
+    ConcurrentHashMap<int, int> big(2);
+    std::unordered_map<int, int> ref;
+    std::mt19937 gen(5);
+    bool resized = false;
+    for(int i=0; i<200000; ++i){
+        int key = static_cast<int>(gen() % 50000);
+        switch(gen() % 4){
+            case 0: assert(big.insert(key, i) == ref.insert({key, i}).second); break;
+            case 1: assert(big.insert_or_assign(key, i) == ref.insert_or_assign(key, i).second); break;
+            case 2: assert(big.erase(key) == (ref.erase(key) == 1)); break;
+            default: assert(big.update(key, [](int& v){ ++v; }) == ref.contains(key)); if(ref.contains(key)) ++ref[key];
+        }
+        resized |= big.resizing() > 0;
+        if(i % 9973 == 0){
+            assert(big.size() == ref.size());
+            for(auto& [k, v] : ref) assert(big.find(k) == v);
+        }
+    }
+    assert(resized);
+    size_t visited = 0;
+    big.for_each([&](int k, int v){ assert(ref.at(k) == v); ++visited; });
+    assert(visited == ref.size());
+
+    big.reserve(100000);
+    assert(big.resizing() == 0 && big.size() == ref.size());
+    big.clear();
+    assert(big.empty() && !big.contains(1));
+}
+
+void test_counters(){
+    ConcurrentHashMap<int, long> counts(8);
+    constexpr int Threads = 8, PerThread = 20000, Keys = 100;
+    std::vector<std::thread> threads;
+    for(int t=0; t<Threads; ++t){
+        threads.emplace_back([&, t]{
+            for(int i=0; i<PerThread; ++i) counts.upsert((i + t) % Keys, [](long& c){ ++c; }, 0L);
+        });
+    }
+    for(auto& t : threads) t.join();
+    long total = 0;
+    counts.for_each([&](int, long c){ total += c; });
+    assert(total == long(Threads) * PerThread && counts.size() == Keys);
+}
+
+void test_readers_during_resize(){
+    ConcurrentHashMap<int, int> m(4);
+    constexpr int Stable = 1000, Writers = 3, PerWriter = 100000;
+    for(int k=0; k<Stable; ++k) m.insert(k, -k);
+    std::atomic<bool> done{false};
+    std::atomic<long> misses{0};
+    std::vector<std::thread> threads;
+    // Readers: the stable keys never move out of sight, whatever the writers do
+    for(int r=0; r<2; ++r){
+        threads.emplace_back([&]{
+            while(!done.load()){
+                for(int k=0; k<Stable; ++k){
+                    auto v = m.find(k);
+                    if(!v || *v != -k) misses.fetch_add(1);
+                }
+            }
+        });
+    }
+    // Writers: their own key ranges, inserted and half erased again
+    std::vector<std::thread> writers;
+    for(int w=0; w<Writers; ++w){
+        writers.emplace_back([&, w]{
+            int base = Stable + w * PerWriter;
+            for(int i=0; i<PerWriter; ++i) assert(m.insert_or_assign(base + i, i));
+            for(int i=0; i<PerWriter; i+=2) assert(m.erase(base + i));
+        });
+    }
+    for(auto& t : writers) t.join();
+    done = true;
+    for(auto& t : threads) t.join();
+    assert(misses == 0);
+    assert(m.size() == size_t(Stable + Writers * PerWriter / 2));
+    for(int w=0; w<Writers; ++w){
+        int base = Stable + w * PerWriter;
+        assert(!m.contains(base) && m.find(base + 1) == 1);
+    }
+}
+
+// The same three operations on every map
+template <typename Mutex, template <typename> typename ReadLock>
+class LockedMap{
+public:
+    bool find(uint64_t key) const {
+        ReadLock<Mutex> lock(mtx_);
+        return map_.find(key) != map_.end();
+    }
+    void insert_or_assign(uint64_t key, uint64_t value){
+        std::lock_guard<Mutex> lock(mtx_);
+        map_.insert_or_assign(key, value);
+    }
+    void erase(uint64_t key){
+        std::lock_guard<Mutex> lock(mtx_);
+        map_.erase(key);
+    }
+private:
+    mutable Mutex mtx_;
+    std::unordered_map<uint64_t, uint64_t> map_;
+};
+
+class Striped{
+public:
+    bool find(uint64_t key) const { return map_.contains(key); }
+    void insert_or_assign(uint64_t key, uint64_t value){ map_.insert_or_assign(key, value); }
+    void erase(uint64_t key){ map_.erase(key); }
+private:
+    ConcurrentHashMap<uint64_t, uint64_t> map_;
+};
+
+template <typename F>
+double time_ms(F f){
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Millions of operations per second. Half the keys are there at the start; writes insert or erase
+template <typename Map>
+double run(size_t ops, size_t keys, size_t threads, int write_percent){
+    Map map;
+    for(uint64_t k=0; k<keys; k+=2) map.insert_or_assign(k, k);
+    std::atomic<size_t> found{0};
+    double ms = time_ms([&]{
+        std::vector<std::thread> pool;
+        for(size_t t=0; t<threads; ++t){
+            pool.emplace_back([&, t]{
+                std::mt19937_64 gen(t + 1);
+                size_t hits = 0;
+                for(size_t i=0; i<ops / threads; ++i){
+                    uint64_t r = gen();
+                    uint64_t key = r % keys;
+                    int dice = static_cast<int>((r >> 40) % 100);
+                    if(dice >= write_percent) hits += map.find(key);
+                    else if(dice % 2 == 0) map.insert_or_assign(key, r);
+                    else map.erase(key);
+                }
+                found += hits;
+            });
+        }
+        for(auto& t : pool) t.join();
+    });
+    return static_cast<double>(ops) / ms / 1000.0;
+}
+
+void Benchmark(size_t ops, size_t keys, size_t max_threads){
+    for(int write_percent : {1, 50}){
+        std::cout << "\n" << 100 - write_percent << "% reads " << std::left << std::setw(9) << "threads" << std::right
+                  << std::setw(12) << "mutex" << std::setw(14) << "shared_mutex" << std::setw(12) << "concurrent" << "   (Mops/s)\n";
+        for(size_t t=1; t<=max_threads; t*=2){
+            double a = run<LockedMap<std::mutex, std::lock_guard>>(ops, keys, t, write_percent);
+            double b = run<LockedMap<std::shared_mutex, std::shared_lock>>(ops, keys, t, write_percent);
+            double c = run<Striped>(ops, keys, t, write_percent);
+            std::cout << std::setw(18) << t << std::fixed << std::setprecision(1)
+                      << std::setw(12) << a << std::setw(14) << b << std::setw(12) << c << "\n";
+            std::cout.unsetf(std::ios::fixed);
+        }
+    }
+}
+
+int main(int argc, char** argv){
+    test_single_thread();
+    test_counters();
+    test_readers_during_resize();
+    std::cout << "All concurrent hash map tests passed!\n";
+
+    size_t ops = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4000000;
+    size_t keys = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1 << 20;
+    size_t max_threads = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 64;
+    std::cout << ops << " operations on " << keys << " keys, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    Benchmark(ops, keys, max_threads);
+}
@@ -0,0 +1,266 @@
+#pragma once
+/*
+Concurrent hash map: striped reader-writer locks over FlatHashMap segments, resized incrementally
+
+    ConcurrentHashMap<std::string, Quote> quotes;
+    quotes.insert_or_assign("AAPL", quote);                 // from any thread
+    if(auto q = quotes.find("AAPL")) use(*q);                // a copy, taken under a shared lock
+    quotes.update("AAPL", [](Quote& q){ q.bid += 0.01; });  // fn runs under the segment's lock
+    quotes.erase("AAPL");
+
+One std::mutex around a std::unordered_map (as in src/mutex.cpp) serializes every lookup. Here
+the keys are split by hash into a power of 2 of segments, each a FlatHashMap (see
+flat_hash_map.hpp) with its own std::shared_mutex on its own cache line. Readers of a segment
+share its lock and only wait for a writer of the same segment, writers only exclude the keys of
+their segment. With 4 segments per hardware thread two random operations rarely meet.
+
+Resizing: a segment that is nearly full doesn't rehash everything at once while holding its lock.
+Its table becomes the old table, a new one twice as large is allocated, and every following write to
+the segment first moves a few (Migrate) entries from the old table to the new one. Lookups check
+both until the old one is empty. A key is in exactly one of the two tables. The only full rehash
+left is FlatHashMap's in place cleanup of tombstones, which doesn't grow the table.
+
+Lookups return copies (std::optional<V>), since a reference would outlive the lock; update() and
+visit() run a function on the element under the lock instead, so they must not call back into the
+map (the locks aren't recursive). size() and for_each() lock one segment at a time, so they aren't a
+snapshot of the whole map while other threads write.
+*/
+
+#include "flat_hash_map.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+
+template <typename K, typename V, typename Hash = std::hash<K>, typename Eq = std::equal_to<K>,
+          typename Alloc = std::allocator<std::pair<const K, V>>>
+class ConcurrentHashMap{
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using Table = FlatHashMap<K, V, Hash, Eq, Alloc>;
+
+    // Entries moved from the old table by each write to a resizing segment
+    static constexpr size_t Migrate = 8;
+
+    // 0: 4 segments per hardware thread, at least 16. Rounded up to a power of 2
+    explicit ConcurrentHashMap(size_t segments = 0, const Hash& hash = Hash(), const Eq& eq = Eq(), const Alloc& alloc = Alloc())
+        : hash_(hash) {
+        if(segments == 0) segments = std::max<size_t>(16, 4 * std::thread::hardware_concurrency());
+        segments = std::bit_ceil(segments);
+        shift_ = std::min(63, 64 - std::countr_zero(segments));
+        count_ = segments;
+        segments_ = std::make_unique<Segment[]>(segments);
+        for(size_t i=0; i<segments; ++i){
+            segments_[i].table = Table(0, hash, eq, alloc);
+            segments_[i].release_old();
+        }
+    }
+
+    ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+    ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+
+    // A copy of the value, if the key is there
+    std::optional<V> find(const K& key) const {
+        const Segment& s = segment(key);
+        std::shared_lock lock(s.mtx);
+        if(const V* v = s.lookup(key)) return *v;
+        return std::nullopt;
+    }
+
+    bool contains(const K& key) const {
+        const Segment& s = segment(key);
+        std::shared_lock lock(s.mtx);
+        return s.lookup(key) != nullptr;
+    }
+
+    // fn(const V&) under the shared lock, false if the key isn't there
+    template <typename F>
+    bool visit(const K& key, F&& fn) const {
+        const Segment& s = segment(key);
+        std::shared_lock lock(s.mtx);
+        const V* v = s.lookup(key);
+        if(!v) return false;
+        std::invoke(std::forward<F>(fn), *v);
+        return true;
+    }
+
+    // True if the key was inserted, false if it was there (and is left alone)
+    template <typename M>
+    bool insert(const K& key, M&& value){
+        Segment& s = segment(key);
+        std::unique_lock lock(s.mtx);
+        s.prepare_write();
+        if(s.old.contains(key)) return false;
+        return s.table.try_emplace(key, std::forward<M>(value)).second;
+    }
+
+    // True if the key was inserted, false if an existing value was replaced
+    template <typename M>
+    bool insert_or_assign(const K& key, M&& value){
+        Segment& s = segment(key);
+        std::unique_lock lock(s.mtx);
+        s.prepare_write();
+        if(V* v = s.old_value(key)){
+            *v = std::forward<M>(value);
+            return false;
+        }
+        return s.table.insert_or_assign(key, std::forward<M>(value)).second;
+    }
+
+    // fn(V&) under the exclusive lock, false if the key isn't there
+    template <typename F>
+    bool update(const K& key, F&& fn){
+        Segment& s = segment(key);
+        std::unique_lock lock(s.mtx);
+        s.prepare_write();
+        V* v = s.lookup(key);
+        if(!v) return false;
+        std::invoke(std::forward<F>(fn), *v);
+        return true;
+    }
+
+    // fn(V&) on the value of key, inserted as V(args...) first if it isn't there
+    template <typename F, typename... Args>
+    void upsert(const K& key, F&& fn, Args&&... args){
+        Segment& s = segment(key);
+        std::unique_lock lock(s.mtx);
+        s.prepare_write();
+        V* v = s.old_value(key);
+        if(!v) v = &s.table.try_emplace(key, std::forward<Args>(args)...).first->second;
+        std::invoke(std::forward<F>(fn), *v);
+    }
+
+    bool erase(const K& key){
+        Segment& s = segment(key);
+        std::unique_lock lock(s.mtx);
+        s.prepare_write();
+        return s.table.erase(key) == 1 || s.erase_old(key);
+    }
+
+    // Not a snapshot when other threads are writing
+    size_t size() const {
+        size_t n = 0;
+        for(size_t i=0; i<count_; ++i){
+            std::shared_lock lock(segments_[i].mtx);
+            n += segments_[i].table.size() + segments_[i].old.size();
+        }
+        return n;
+    }
+    bool empty() const { return size() == 0; }
+    size_t segments() const { return count_; }
+
+    // fn(const K&, const V&) on every element, one segment at a time under its shared lock
+    template <typename F>
+    void for_each(F fn) const {
+        for(size_t i=0; i<count_; ++i){
+            std::shared_lock lock(segments_[i].mtx);
+            for(const auto& [k, v] : segments_[i].old) fn(k, v);
+            for(const auto& [k, v] : segments_[i].table) fn(k, v);
+        }
+    }
+
+    void clear(){
+        for(size_t i=0; i<count_; ++i){
+            std::unique_lock lock(segments_[i].mtx);
+            segments_[i].table.clear();
+            segments_[i].release_old();
+        }
+    }
+
+    // Room for n elements in total, spread evenly (each segment rehashes at once, not incrementally)
+    void reserve(size_t n){
+        for(size_t i=0; i<count_; ++i){
+            std::unique_lock lock(segments_[i].mtx);
+            segments_[i].finish_migration();
+            segments_[i].table.reserve((n + count_ - 1) / count_);
+        }
+    }
+
+    // Segments still moving entries to their new table
+    size_t resizing() const {
+        size_t n = 0;
+        for(size_t i=0; i<count_; ++i){
+            std::shared_lock lock(segments_[i].mtx);
+            n += !segments_[i].old.empty();
+        }
+        return n;
+    }
+
+private:
+    struct alignas(64) Segment{
+        mutable std::shared_mutex mtx;
+        Table table;                        // new entries go here
+        Table old;                          // being emptied into table after a resize
+        typename Table::iterator cursor = old.end(); // next entry of old to move
+
+        template <typename Map>
+        static auto value_in(Map& map, const K& key) -> decltype(&map.begin()->second) {
+            auto it = map.find(key);
+            return it == map.end() ? nullptr : &it->second;
+        }
+        const V* lookup(const K& key) const {
+            const V* v = value_in(table, key);
+            return v || old.empty() ? v : value_in(old, key);
+        }
+        V* lookup(const K& key){ return const_cast<V*>(std::as_const(*this).lookup(key)); }
+        V* old_value(const K& key){ return old.empty() ? nullptr : value_in(old, key); }
+
+        bool erase_old(const K& key){
+            if(old.empty()) return false;
+            auto it = old.find(key);
+            if(it == old.end()) return false;
+            // Keep the cursor on a full slot
+            if(it == cursor) cursor = old.erase(it);
+            else old.erase(it);
+            return true;
+        }
+
+        // Before every write: move a few entries, or start a resize if the table is getting full.
+        // Above 25/32 full FlatHashMap would double the table itself when it runs out of empty slots
+        void prepare_write(){
+            if(!old.empty()) migrate(Migrate);
+            else if(table.size() >= table.capacity() / 32 * 25 && table.capacity() >= 32){
+                old = std::move(table);
+                table = Table(0, old.hash_function(), old.key_eq(), old.get_allocator());
+                table.reserve(old.size() * 2);
+                cursor = old.begin();
+                migrate(Migrate);
+            }
+        }
+
+        void migrate(size_t n){
+            for(; n > 0 && cursor != old.end(); --n){
+                table.insert(std::move(*cursor));
+                cursor = old.erase(cursor);
+            }
+            if(old.empty()) release_old();
+        }
+
+        void finish_migration(){
+            if(!old.empty()) migrate(old.size());
+        }
+
+        // Frees the old table's memory (clear() would keep it)
+        void release_old(){
+            old = Table(0, table.hash_function(), table.key_eq(), table.get_allocator());
+            cursor = old.end();
+        }
+    };
+
+    // The top bits of the mixed hash, FlatHashMap uses the low ones
+    size_t index(const K& key) const { return (flat_detail::mix(hash_(key)) >> shift_) & (count_ - 1); }
+    const Segment& segment(const K& key) const { return segments_[index(key)]; }
+    Segment& segment(const K& key){ return segments_[index(key)]; }
+
+    [[no_unique_address]] Hash hash_;
+    int shift_;
+    size_t count_;
+    std::unique_ptr<Segment[]> segments_;
+};
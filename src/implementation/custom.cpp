@@ -40,6 +40,10 @@ int main(){
     // Reference count drops to 0 after reset
     std::cout << "Reference count of Bob: " << p3.use_count() << std::endl;
 
+    // make_shared allocates the object and its reference counts together
+    auto p5 = Custom::make_shared<Person>("Alice");
+    p5->sayname();
+
     // Now, uncomment the following will result in nullptr access error
     // p3->sayname();
 
@@ -1,99 +1,365 @@
+#pragma once
 #include <iostream>
 #include <string>
 #include <atomic> // For thread-safe access to reference counters
+#include <memory> // std::allocator, std::allocator_traits
+#include <utility> // std::forward, std::swap
+#include <stdexcept>
+#include <type_traits>
+#include <concepts>
+#include <cstddef>
 
 namespace Custom{
-    // Custom unique_ptr
+    // Default deleters, delete for single objects and delete[] for arrays
     template <typename T>
-    class unique_ptr{
-    private:
-        T* ptr;
+    struct default_delete{
+        default_delete() noexcept = default;
+        // A deleter for Derived can be turned into one for Base
+        template <typename U> requires std::is_convertible_v<U*, T*>
+        default_delete(const default_delete<U>&) noexcept {}
+
+        void operator()(T* p) const noexcept {
+            static_assert(sizeof(T) > 0, "can't delete an incomplete type");
+            delete p;
+        }
+    };
 
-    public:
-        explicit unique_ptr(T* p = nullptr) : ptr(p) {}
-        ~unique_ptr(){ delete ptr; }
+    template <typename T>
+    struct default_delete<T[]>{
+        void operator()(T* p) const noexcept {
+            static_assert(sizeof(T) > 0, "can't delete an incomplete type");
+            delete[] p;
+        }
+    };
 
-        // Delete the copy constructor and the copy assignment operator
-        unique_ptr(const unique_ptr&) = delete;
-        unique_ptr& operator=(const unique_ptr&) = delete;
+    namespace detail{
+        // Deleter::pointer if it has one (e.g. a handle type that isn't a raw pointer), T* otherwise
+        template <typename T, typename Deleter>
+        struct unique_pointer{ using type = T*; };
+        template <typename T, typename Deleter> requires requires{ typename std::remove_reference_t<Deleter>::pointer; }
+        struct unique_pointer<T, Deleter>{ using type = typename std::remove_reference_t<Deleter>::pointer; };
+
+        // Ownership logic shared by unique_ptr<T> and unique_ptr<T[]>.
+        // [[no_unique_address]] gives the deleter the empty-base optimization without inheriting
+        // from it (which would also rule out final classes and function pointers): a stateless
+        // deleter takes no space, so the smart pointer stays one word
+        template <typename T, typename Deleter>
+        class unique_ptr_base{
+        public:
+            using pointer = typename unique_pointer<T, Deleter>::type;
+            using element_type = T;
+            using deleter_type = Deleter;
+
+            // Like std::unique_ptr, only for deleters that are usable when value initialized
+            // (a function pointer deleter would be null)
+            unique_ptr_base() noexcept requires (std::is_default_constructible_v<Deleter> && !std::is_pointer_v<Deleter>)
+                : ptr(nullptr), deleter() {}
+            explicit unique_ptr_base(pointer p) noexcept requires (std::is_default_constructible_v<Deleter> && !std::is_pointer_v<Deleter>)
+                : ptr(p), deleter() {}
+            unique_ptr_base(pointer p, const Deleter& d) noexcept : ptr(p), deleter(d) {}
+            unique_ptr_base(pointer p, Deleter&& d) noexcept : ptr(p), deleter(std::move(d)) {}
+            ~unique_ptr_base(){
+                if(ptr != nullptr) deleter(ptr);
+            }
 
-        // Move constructor
-        unique_ptr(unique_ptr&& other) noexcept : ptr(other.ptr){
-            other.ptr = nullptr;
-        }
+            // Delete the copy constructor and the copy assignment operator
+            unique_ptr_base(const unique_ptr_base&) = delete;
+            unique_ptr_base& operator=(const unique_ptr_base&) = delete;
 
-        // Move assignment operator
-        unique_ptr& operator=(unique_ptr&& other) noexcept{
-            if(this != &other){
-                delete ptr;
-                ptr = other.ptr;
-                other.ptr = nullptr;
+            // Move constructor
+            unique_ptr_base(unique_ptr_base&& other) noexcept
+                : ptr(std::exchange(other.ptr, nullptr)), deleter(std::forward<Deleter>(other.deleter)) {}
+
+            // Move assignment operator
+            unique_ptr_base& operator=(unique_ptr_base&& other) noexcept {
+                if(this != &other){
+                    reset(other.release());
+                    deleter = std::forward<Deleter>(other.deleter);
+                }
+                return *this;
             }
-            return *this;
-        }
 
-        T& operator*() const {
-            if(!ptr){
+            pointer get() const noexcept {
+                return ptr;
+            }
+            Deleter& get_deleter() noexcept { return deleter; }
+            const Deleter& get_deleter() const noexcept { return deleter; }
+
+            pointer release() noexcept {
+                return std::exchange(ptr, nullptr);
+            }
+
+            void reset(pointer newptr = nullptr) noexcept {
+                pointer old = std::exchange(ptr, newptr);
+                if(old != nullptr) deleter(old);
+            }
+
+            void swap(unique_ptr_base& other) noexcept {
+                std::swap(ptr, other.ptr);
+                std::swap(deleter, other.deleter);
+            }
+
+            explicit operator bool() const noexcept {
+                return ptr != nullptr;
+            }
+
+        protected:
+            pointer ptr;
+            [[no_unique_address]] Deleter deleter;
+        };
+    }
+
+    // Custom unique_ptr
+    template <typename T, typename Deleter = default_delete<T>>
+    class unique_ptr : public detail::unique_ptr_base<T, Deleter>{
+        using Base = detail::unique_ptr_base<T, Deleter>;
+
+    public:
+        using typename Base::pointer;
+        using Base::Base;
+
+        unique_ptr() noexcept = default;
+
+        // Converting move, e.g. unique_ptr<Derived> to unique_ptr<Base>
+        template <typename U, typename E>
+            requires (!std::is_array_v<U> && std::is_convertible_v<typename unique_ptr<U, E>::pointer, pointer>
+                      && std::is_convertible_v<E, Deleter>)
+        unique_ptr(unique_ptr<U, E>&& other) noexcept
+            : Base(other.release(), std::forward<E>(other.get_deleter())) {}
+
+        std::add_lvalue_reference_t<T> operator*() const {
+            if(!this->ptr){
                 throw std::runtime_error("Null pointer access");
             }
-            return *ptr;
+            return *this->ptr;
         }
-        T* operator->() const { 
-            if(!ptr){
+        pointer operator->() const {
+            if(!this->ptr){
                 throw std::runtime_error("Null pointer access");
             }
-            return ptr;
-        }
-        T* get() const {
-            return ptr;
+            return this->ptr;
         }
+    };
+
+    // Array version: delete[] by default, operator[] instead of * and ->
+    template <typename T, typename Deleter>
+    class unique_ptr<T[], Deleter> : public detail::unique_ptr_base<T, Deleter>{
+        using Base = detail::unique_ptr_base<T, Deleter>;
+
+    public:
+        using Base::Base;
+
+        unique_ptr() noexcept = default;
 
-        T* release() {
-            T* temp = ptr;
-            ptr = nullptr;
-            return temp;
+        T& operator[](size_t i) const {
+            if(!this->ptr){
+                throw std::runtime_error("Null pointer access");
+            }
+            return this->ptr[i];
         }
+    };
 
-        void reset(T* newptr = nullptr){
-            delete ptr;
-            ptr = newptr;
+    template <typename T, typename Deleter>
+    void swap(unique_ptr<T, Deleter>& a, unique_ptr<T, Deleter>& b) noexcept {
+        a.swap(b);
+    }
+
+    // make_unique<T>(args...) / make_unique<T[]>(n): value-initialized, like new T() / new T[n]()
+    template <typename T, typename... Args> requires (!std::is_array_v<T>)
+    unique_ptr<T> make_unique(Args&&... args){
+        return unique_ptr<T>(new T(std::forward<Args>(args)...));
+    }
+    template <typename T> requires std::is_unbounded_array_v<T>
+    unique_ptr<T> make_unique(size_t n){
+        return unique_ptr<T>(new std::remove_extent_t<T>[n]());
+    }
+
+    // Default-initialized: trivial types (e.g. a buffer about to be overwritten) are left
+    // uninitialized instead of being zeroed first
+    template <typename T> requires (!std::is_array_v<T>)
+    unique_ptr<T> make_unique_for_overwrite(){
+        return unique_ptr<T>(new T);
+    }
+    template <typename T> requires std::is_unbounded_array_v<T>
+    unique_ptr<T> make_unique_for_overwrite(size_t n){
+        return unique_ptr<T>(new std::remove_extent_t<T>[n]);
+    }
+
+    // Reference counting policies for shared_ptr / weak_ptr
+
+    // Default: atomic counts, safe to copy and drop pointers to the same object from many threads.
+    // Increments are relaxed: a new reference can only be made from an existing one, which already
+    // keeps the object alive, so there is nothing to synchronize with. The decrement is a release
+    // so every owner's writes to the object happen before the count reaches zero, and the thread
+    // that sees zero does an acquire load before destroying the object so it sees those writes
+    // (an acquire load of the count rather than a fence, because ThreadSanitizer understands it)
+    struct MultiThreaded{
+        using count_type = std::atomic<int>;
+
+        static void increment(count_type& c, int n = 1) noexcept {
+            c.fetch_add(n, std::memory_order_relaxed);
         }
-        explicit operator bool() const {
-            return ptr != nullptr;
+        // Returns true when the last reference was dropped
+        static bool decrement(count_type& c) noexcept {
+            if(c.fetch_sub(1, std::memory_order_release) == 1){
+                (void)c.load(std::memory_order_acquire);
+                return true;
+            }
+            return false;
+        }
+        // Increment unless the count is zero (used by weak_ptr::lock)
+        static bool increment_if_nonzero(count_type& c) noexcept {
+            int count = c.load(std::memory_order_relaxed);
+            while(count != 0){
+                if(c.compare_exchange_weak(count, count + 1, std::memory_order_acq_rel, std::memory_order_relaxed)){
+                    return true;
+                }
+            }
+            return false;
+        }
+        static int load(const count_type& c) noexcept {
+            return c.load(std::memory_order_relaxed);
         }
     };
 
+    // Plain integer counts for objects that never leave one thread
+    struct SingleThreaded{
+        using count_type = int;
+
+        static void increment(count_type& c) noexcept { ++c; }
+        static bool decrement(count_type& c) noexcept { return --c == 0; }
+        static bool increment_if_nonzero(count_type& c) noexcept {
+            if(c == 0) return false;
+            ++c;
+            return true;
+        }
+        static int load(const count_type& c) noexcept { return c; }
+    };
+
+    // Satisfied by the policies above (and ones derived from them, like Deferred). make_shared and
+    // allocate_shared use it to tell make_shared<T, Policy>() from make_shared<T, Arg>(arg)
+    template <typename P>
+    concept RefCountPolicy = requires(typename P::count_type& c){
+        P::increment(c);
+        { P::decrement(c) } -> std::same_as<bool>;
+        { P::increment_if_nonzero(c) } -> std::same_as<bool>;
+    };
+
+    namespace detail{
+        // Type-erased control block shared by shared_ptr and weak_ptr.
+        // weak_count is the number of weak_ptrs plus one while any shared_ptr exists, so the
+        // block is freed by whoever drops the last reference of either kind
+        template <typename Policy>
+        struct ControlBlock{
+            typename Policy::count_type ref_count{1}; // Strong reference count
+            typename Policy::count_type weak_count{1}; // Weak reference count (+1 for all strong references)
+
+            virtual ~ControlBlock() = default;
+            virtual void destroy_object() noexcept = 0; // ref_count reached 0
+            virtual void destroy_block() noexcept = 0;  // weak_count reached 0
+            virtual void* get_object() noexcept = 0; // The managed object (used by atomic_shared_ptr)
+
+            void add_ref() noexcept { Policy::increment(ref_count); }
+            // Several references at once, only needed by atomic_shared_ptr (MultiThreaded)
+            void add_refs(int n) noexcept { Policy::increment(ref_count, n); }
+            // Only take a strong reference if the object is still alive (used by weak_ptr::lock)
+            bool try_add_ref() noexcept { return Policy::increment_if_nonzero(ref_count); }
+            void release() noexcept {
+                if(Policy::decrement(ref_count)){
+                    // Policies with retire() (Deferred) destroy the object later on another thread
+                    if constexpr (requires{ Policy::retire(nullptr, nullptr); }){
+                        Policy::retire(this, [](void* p) noexcept {
+                            auto* cb = static_cast<ControlBlock*>(p);
+                            cb->destroy_object();
+                            cb->release_weak();
+                        });
+                    }
+                    else{
+                        destroy_object();
+                        release_weak();
+                    }
+                }
+            }
+            void add_weak() noexcept { Policy::increment(weak_count); }
+            void release_weak() noexcept {
+                if(Policy::decrement(weak_count)){
+                    destroy_block();
+                }
+            }
+            int use_count() const noexcept { return Policy::load(ref_count); }
+        };
+
+        // Created by shared_ptr(T*): the object was allocated separately with new
+        template <typename T, typename Policy>
+        struct PointerControlBlock : ControlBlock<Policy>{
+            T* ptr;
+            explicit PointerControlBlock(T* p) : ptr(p) {}
+            void destroy_object() noexcept override { delete ptr; }
+            void destroy_block() noexcept override { delete this; }
+            void* get_object() noexcept override { return ptr; }
+        };
+
+        // Created by make_shared / allocate_shared: the object lives inside the control block,
+        // so there is one allocation and the counts share cache lines with the object
+        template <typename T, typename Alloc, typename Policy>
+        struct InlineControlBlock : ControlBlock<Policy>{
+            using BlockAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<InlineControlBlock>;
+            using ObjectAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+
+            template <typename... Args>
+            InlineControlBlock(const Alloc& a, Args&&... args) : alloc(a) {
+                ObjectAlloc object_alloc(alloc);
+                std::allocator_traits<ObjectAlloc>::construct(object_alloc, object(), std::forward<Args>(args)...);
+            }
+
+            T* object() noexcept { return reinterpret_cast<T*>(&storage); }
+            void* get_object() noexcept override { return object(); }
+
+            void destroy_object() noexcept override {
+                ObjectAlloc object_alloc(alloc);
+                std::allocator_traits<ObjectAlloc>::destroy(object_alloc, object());
+            }
+            void destroy_block() noexcept override {
+                BlockAlloc block_alloc(alloc);
+                std::allocator_traits<BlockAlloc>::destroy(block_alloc, this);
+                std::allocator_traits<BlockAlloc>::deallocate(block_alloc, this, 1);
+            }
+
+            alignas(T) unsigned char storage[sizeof(T)];
+            Alloc alloc;
+        };
+    }
+
     // Forward declaration of weak_ptr
-    template <typename T>
+    template <typename T, typename Policy = MultiThreaded>
     class weak_ptr;
 
-    // Custom shared_ptr
+    // Forward declaration of atomic_shared_ptr (atomic_shared_ptr.hpp)
     template <typename T>
+    class atomic_shared_ptr;
+
+    // Custom shared_ptr
+    // Stores the object pointer next to the control block pointer, so dereferencing doesn't
+    // have to go through the control block. Policy selects atomic (default) or plain reference counts
+    template <typename T, typename Policy = MultiThreaded>
     class shared_ptr{
     private:
-        // Control block to store the pointer and reference counts
-        struct ControlBlock{
-            T* ptr;     // Pointer to the resource
-            std::atomic<int> ref_count; // Strong reference count
-            std::atomic<int> weak_count; // Weak reference count
-            
-            ControlBlock(T* p) : ptr(p), ref_count(1), weak_count(0) {}
-            ~ControlBlock() { delete ptr; }
-        } *control_block; // Pointer to ControlBlock struct
+        T* ptr; // Pointer to the resource
+        detail::ControlBlock<Policy>* control_block; // Pointer to the reference counts
+
+        // Adopt a control block that already holds a strong reference for us
+        shared_ptr(T* p, detail::ControlBlock<Policy>* cb) noexcept : ptr(p), control_block(cb) {}
 
-    private:
         void release(){
-            if(control_block && --control_block->ref_count==0){
-                delete control_block->ptr;
-                if(control_block->weak_count==0){
-                    delete control_block;
-                }
+            if(control_block){
+                control_block->release();
             }
         }
 
     public:
         // Contructor
-        explicit shared_ptr(T* p = nullptr) : control_block(p ? new ControlBlock(p) : nullptr) {}
+        explicit shared_ptr(T* p = nullptr)
+        : ptr(p), control_block(p ? new detail::PointerControlBlock<T, Policy>(p) : nullptr) {}
 
         // Destructor
         ~shared_ptr() {
@@ -101,107 +367,108 @@ namespace Custom{
         }
 
         // Copy constructor
-        shared_ptr(const shared_ptr& other) noexcept : control_block(other.control_block) {
+        shared_ptr(const shared_ptr& other) noexcept : ptr(other.ptr), control_block(other.control_block) {
             if (control_block){
-                ++control_block->ref_count;
+                control_block->add_ref();
             }
         }
 
-        // Copy constructor from weak_ptr
-        shared_ptr(const weak_ptr<T>& weak) : control_block(weak.control_block) {
-            if(control_block){
-                ++control_block->ref_count;
+        // Copy constructor from weak_ptr, empty if the object has already been destroyed
+        shared_ptr(const weak_ptr<T, Policy>& weak) noexcept : ptr(nullptr), control_block(nullptr) {
+            if(weak.control_block && weak.control_block->try_add_ref()){
+                ptr = weak.ptr;
+                control_block = weak.control_block;
             }
         }
 
         // Copy assignment operator
         shared_ptr& operator=(const shared_ptr& other) noexcept {
-            if(this != &other){
-                release(); // Since the current instance is being overwritten
-                control_block = other.control_block;
-                if(control_block){
-                    ++control_block->ref_count;
-                }
-            }
+            // Copy and swap, safe even if other is owned by the object we release
+            shared_ptr(other).swap(*this);
             return *this;
         }
 
         // Move constructor
-        shared_ptr(shared_ptr&& other) noexcept : control_block(other.control_block){
+        shared_ptr(shared_ptr&& other) noexcept : ptr(other.ptr), control_block(other.control_block){
+            other.ptr = nullptr;
             other.control_block = nullptr;
         }
 
         // Move assignment operator
         shared_ptr& operator=(shared_ptr&& other) noexcept {
-            if(this != &other){
-                release();
-                control_block = other.control_block;
-                other.control_block = nullptr;
-            }
+            shared_ptr(std::move(other)).swap(*this);
             return *this;
         }
 
+        void swap(shared_ptr& other) noexcept {
+            std::swap(ptr, other.ptr);
+            std::swap(control_block, other.control_block);
+        }
+
         // Dereference operator
-        T& operator*(){
-            if(!control_block || !control_block->ptr){
+        T& operator*() const {
+            if(!ptr){
                 throw std::runtime_error("Deferencing nullptr");
             }
-            return *control_block->ptr;
+            return *ptr;
         }
 
         // Arrow operator
-        T* operator->(){
-            if(!control_block || !control_block->ptr){
+        T* operator->() const {
+            if(!ptr){
                 throw std::runtime_error("Deferencing nullptr");
             }
-            return control_block->ptr;
+            return ptr;
         }
 
         // Raw pointer
         T* get() const {
-            return control_block ? control_block->ptr : nullptr;
+            return ptr;
         }
 
         // Reset shared pointer
         void reset(T* new_ptr = nullptr){
-            release();
-            control_block = new_ptr ? new ControlBlock(new_ptr) : nullptr;
+            shared_ptr(new_ptr).swap(*this);
         }
 
         // Get reference count
         int use_count() const {
-            return control_block ? control_block->ref_count.load() : 0;
+            return control_block ? control_block->use_count() : 0;
         }
 
         // Explicit conversion to bool
         explicit operator bool() const {
-            return control_block && control_block->ptr;
+            return ptr != nullptr;
         }
 
-        friend class weak_ptr<T>;
+        friend class weak_ptr<T, Policy>;
+        friend class atomic_shared_ptr<T>;
+        template <typename U, RefCountPolicy P, typename Alloc, typename... Args>
+        friend shared_ptr<U, P> allocate_shared(const Alloc& alloc, Args&&... args);
     };
 
     // Weak pointer (non-owning reference to an object managed by shared pointer)
-    template <typename T>
+    template <typename T, typename Policy>
     class weak_ptr{
     private:
-        typename shared_ptr<T>::ControlBlock* control_block;
+        T* ptr;
+        detail::ControlBlock<Policy>* control_block;
 
     private:
         void release(){
-            if(control_block && --control_block->weak_count==0 && control_block->ref_count==0){
-                delete control_block;
+            if(control_block){
+                control_block->release_weak();
             }
         }
     
     public:
         // Contructor
-        weak_ptr() : control_block(nullptr) {}
+        weak_ptr() : ptr(nullptr), control_block(nullptr) {}
 
         // Contructor from shared pointer
-        weak_ptr(const shared_ptr<T>& shared) : control_block(shared.control_block) {
+        weak_ptr(const shared_ptr<T, Policy>& shared) : ptr(shared.ptr), control_block(shared.control_block) {
             if(control_block){
-                ++control_block->weak_count;
+                control_block->add_weak();
             }
         }
 
@@ -211,23 +478,79 @@ namespace Custom{
         }
 
         // Copy constructor
-        weak_ptr(const weak_ptr& other) : control_block(other.control_block) {
+        weak_ptr(const weak_ptr& other) : ptr(other.ptr), control_block(other.control_block) {
             if(control_block){
-                ++control_block->weak_count;
+                control_block->add_weak();
             }
         }
 
         // Move constructor
-        weak_ptr(weak_ptr&& other) noexcept : control_block(other.control_block) {
+        weak_ptr(weak_ptr&& other) noexcept : ptr(other.ptr), control_block(other.control_block) {
+            other.ptr = nullptr;
             other.control_block = nullptr;
         }
 
+        // Copy assignment operator
+        weak_ptr& operator=(const weak_ptr& other){
+            weak_ptr(other).swap(*this);
+            return *this;
+        }
+
+        // Move assignment operator
+        weak_ptr& operator=(weak_ptr&& other) noexcept {
+            weak_ptr(std::move(other)).swap(*this);
+            return *this;
+        }
+
+        void swap(weak_ptr& other) noexcept {
+            std::swap(ptr, other.ptr);
+            std::swap(control_block, other.control_block);
+        }
+
         // Lock: Create a shared_ptr if the resource is still valid
-        shared_ptr<T> lock() const {
-            if(control_block && control_block->ref_count > 0){
-                return shared_ptr<T>(*this);
-            }
-            return shared_ptr<T>(); // otherwise return an empty shared pointer
+        shared_ptr<T, Policy> lock() const {
+            return shared_ptr<T, Policy>(*this); // empty if the resource is gone
+        }
+
+        bool expired() const {
+            return !control_block || control_block->use_count() == 0;
         }
+
+        friend class shared_ptr<T, Policy>;
     };
+
+    // Construct the object and its reference counts in a single allocation from alloc.
+    // allocate_shared<T, Policy>(alloc, args...) picks the policy, allocate_shared<T>(alloc, args...)
+    // and allocate_shared<T, Alloc, Args...>(...) work like std::allocate_shared
+    template <typename T, RefCountPolicy Policy, typename Alloc, typename... Args>
+    shared_ptr<T, Policy> allocate_shared(const Alloc& alloc, Args&&... args){
+        using Block = detail::InlineControlBlock<T, Alloc, Policy>;
+        using BlockAlloc = typename Block::BlockAlloc;
+        using BlockTraits = std::allocator_traits<BlockAlloc>;
+
+        BlockAlloc block_alloc(alloc);
+        Block* block = BlockTraits::allocate(block_alloc, 1);
+        try{
+            BlockTraits::construct(block_alloc, block, alloc, std::forward<Args>(args)...);
+        }
+        catch(...){
+            BlockTraits::deallocate(block_alloc, block, 1);
+            throw;
+        }
+        return shared_ptr<T, Policy>(block->object(), block);
+    }
+    template <typename T, typename Alloc, typename... Args>
+    shared_ptr<T> allocate_shared(const Alloc& alloc, Args&&... args){
+        return Custom::allocate_shared<T, MultiThreaded>(alloc, std::forward<Args>(args)...);
+    }
+
+    // Construct the object and its reference counts in a single allocation. Same split as above
+    template <typename T, RefCountPolicy Policy, typename... Args>
+    shared_ptr<T, Policy> make_shared(Args&&... args){
+        return Custom::allocate_shared<T, Policy>(std::allocator<T>(), std::forward<Args>(args)...);
+    }
+    template <typename T, typename... Args>
+    shared_ptr<T> make_shared(Args&&... args){
+        return Custom::allocate_shared<T, MultiThreaded>(std::allocator<T>(), std::forward<Args>(args)...);
+    }
 }
\ No newline at end of file
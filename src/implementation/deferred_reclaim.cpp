@@ -0,0 +1,136 @@
+/*
+Tests and benchmark for the Deferred reclamation policy (see deferred_reclaim.hpp)
+
+The benchmark repeatedly builds a large tree and measures how long the latency critical thread
+spends dropping the last reference to it, with the default policy (destructor runs inline)
+and with Deferred (destructor runs on the Reclaimer's thread).
+Arguments: nodes per tree and number of trees
+*/
+
+#include "deferred_reclaim.hpp"
+#include "intrusive_ptr.hpp"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+
+struct Counted{
+    static inline std::atomic<int> live{0};
+    Counted(){ ++live; }
+    ~Counted(){ --live; }
+};
+
+void test_deferred_shared_ptr(){
+    auto p = Custom::make_shared<Counted, Custom::Deferred>();
+    Custom::weak_ptr<Counted, Custom::Deferred> weak = p;
+    assert(Counted::live == 1);
+    p.reset();
+    // Unreachable right away, even if the destructor hasn't run yet
+    assert(weak.expired() && !weak.lock());
+    Custom::Reclaimer::instance().flush();
+    assert(Counted::live == 0);
+
+    Custom::shared_ptr<Counted, Custom::Deferred> raw(new Counted);
+    raw.reset();
+    Custom::Reclaimer::instance().flush();
+    assert(Counted::live == 0);
+}
+
+struct IntrusiveCounted : Counted, Custom::ref_counted<IntrusiveCounted, Custom::Deferred>{};
+
+void test_deferred_intrusive_ptr(){
+    {
+        auto p = Custom::make_intrusive<IntrusiveCounted>();
+        assert(Counted::live == 1);
+    }
+    Custom::Reclaimer::instance().flush();
+    assert(Counted::live == 0);
+}
+
+struct Nested : Counted{
+    Custom::shared_ptr<Nested, Custom::Deferred> left, right;
+};
+
+Custom::shared_ptr<Nested, Custom::Deferred> build_nested(int depth){
+    auto node = Custom::make_shared<Nested, Custom::Deferred>();
+    if(depth > 1){
+        node->left = build_nested(depth - 1);
+        node->right = build_nested(depth - 1);
+    }
+    return node;
+}
+
+void test_flush_nested(){
+    // Each level is retired by the destructors of the one above, one epoch per level
+    auto root = build_nested(6);
+    assert(Counted::live == 63);
+    root.reset();
+    Custom::Reclaimer::instance().flush();
+    assert(Counted::live == 0);
+}
+
+void test_bounded(){
+    // With no room in the queue, destruction happens inline
+    auto& reclaimer = Custom::Reclaimer::instance();
+    size_t old_max = reclaimer.max_pending();
+    reclaimer.set_max_pending(0);
+    {
+        auto p = Custom::make_shared<Counted, Custom::Deferred>();
+    }
+    assert(Counted::live == 0);
+    reclaimer.set_max_pending(old_max);
+}
+
+template <typename Policy>
+struct Tree{
+    Custom::shared_ptr<Tree, Policy> left, right;
+    int64_t payload[4] = {};
+};
+
+template <typename Policy>
+Custom::shared_ptr<Tree<Policy>, Policy> build(size_t nodes){
+    if(nodes == 0) return Custom::shared_ptr<Tree<Policy>, Policy>();
+    auto node = Custom::make_shared<Tree<Policy>, Policy>();
+    size_t rest = nodes - 1;
+    node->left = build<Policy>(rest / 2);
+    node->right = build<Policy>(rest - rest / 2);
+    return node;
+}
+
+template <typename Policy>
+void Benchmark(const char* name, size_t nodes, size_t trees){
+    std::vector<double> latencies;
+    for(size_t i=0; i<trees; ++i){
+        auto root = build<Policy>(nodes);
+        auto start = std::chrono::high_resolution_clock::now();
+        root.reset(); // the latency critical release
+        auto end = std::chrono::high_resolution_clock::now();
+        latencies.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        if constexpr (std::is_same_v<Policy, Custom::Deferred>){
+            // Keep the backlog from one tree out of the next measurement
+            Custom::Reclaimer::instance().flush();
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p){ return latencies[static_cast<size_t>(p * (latencies.size() - 1))]; };
+    std::cout << name << "  release latency p50: " << percentile(0.5) << " us"
+              << "  p99: " << percentile(0.99) << " us"
+              << "  max: " << latencies.back() << " us" << std::endl;
+}
+
+int main(int argc, char** argv){
+    test_deferred_shared_ptr();
+    test_deferred_intrusive_ptr();
+    test_flush_nested();
+    test_bounded();
+    std::cout << "All deferred reclamation tests passed!\n";
+
+    size_t nodes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    size_t trees = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100;
+    std::cout << trees << " trees of " << nodes << " nodes" << std::endl;
+    Benchmark<Custom::MultiThreaded>("inline  ", nodes, trees);
+    Benchmark<Custom::Deferred>("deferred", nodes, trees);
+}
@@ -0,0 +1,139 @@
+#pragma once
+/*
+Deferred destruction for Custom::shared_ptr / Custom::intrusive_ptr
+
+    Custom::shared_ptr<Tree, Custom::Deferred> root = Custom::make_shared<Tree, Custom::Deferred>();
+
+With the Deferred policy, the thread that drops the last reference doesn't run the destructor:
+it appends the object to the current epoch of the Reclaimer (a mutex, a push_back into reserved
+storage and maybe a notify) and returns. A background thread takes whole epochs and destroys
+them. Children released by those destructors are retired again and go into a later epoch.
+
+Reference counting already guarantees nobody can reach an object whose count is zero
+(weak_ptr::lock fails once it is zero), so epochs here only order the work: flush() waits until
+the queue is empty and the worker is idle, so the later epochs of a nested structure are done too.
+(With other threads retiring all the time it waits for them as well.)
+
+Memory is bounded: once max_pending() objects are waiting, retire() destroys inline instead of
+queueing, which is the old behaviour. Objects retired during static destruction, after the
+Reclaimer is gone, are not supported.
+*/
+
+#include "custom.hpp"
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+namespace Custom{
+    class Reclaimer{
+    public:
+        using Destroy = void (*)(void*) noexcept;
+
+        static Reclaimer& instance(){
+            static Reclaimer reclaimer;
+            return reclaimer;
+        }
+
+        // Queue p for destruction by destroy(p). Never blocks on the destruction itself
+        void retire(void* p, Destroy destroy) noexcept {
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if(current_.size() < max_pending_){
+                    bool was_empty = current_.empty();
+                    current_.push_back(Retired{p, destroy}); // capacity is reserved, no allocation
+                    if(was_empty) work_cv_.notify_one();
+                    return;
+                }
+            }
+            // Backlog is full, fall back to destroying on the calling thread
+            destroy(p);
+        }
+
+        // Block until everything retired before this call, and everything their destructors
+        // retired in turn, has been destroyed
+        void flush(){
+            std::unique_lock<std::mutex> lock(mtx_);
+            work_cv_.notify_one();
+            done_cv_.wait(lock, [this]{ return current_.empty() && !busy_; });
+        }
+
+        size_t pending() const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            return current_.size();
+        }
+
+        size_t max_pending() const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            return max_pending_;
+        }
+        void set_max_pending(size_t n){
+            std::lock_guard<std::mutex> lock(mtx_);
+            max_pending_ = n;
+            current_.reserve(n); // the worker grows batch_ before it swaps the two
+        }
+
+        Reclaimer(const Reclaimer&) = delete;
+        Reclaimer& operator=(const Reclaimer&) = delete;
+
+    private:
+        struct Retired{
+            void* p;
+            Destroy destroy;
+        };
+
+        Reclaimer(){
+            current_.reserve(max_pending_);
+            batch_.reserve(max_pending_);
+            worker_ = std::thread([this]{ run(); });
+        }
+
+        ~Reclaimer(){
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                stop_ = true;
+            }
+            work_cv_.notify_one();
+            worker_.join();
+        }
+
+        void run(){
+            std::unique_lock<std::mutex> lock(mtx_);
+            for(;;){
+                work_cv_.wait(lock, [this]{ return stop_ || !current_.empty(); });
+                if(current_.empty()) return; // stopping and drained
+
+                // Take the whole epoch. batch_ is empty here, so this is the only safe place to grow
+                // it; after the swap current_ has room for max_pending_ and retire() never allocates
+                if(batch_.capacity() < max_pending_) batch_.reserve(max_pending_);
+                batch_.swap(current_);
+                busy_ = true;
+                lock.unlock();
+                for(const Retired& r : batch_){
+                    r.destroy(r.p); // may retire more objects into the next epoch
+                }
+                batch_.clear();
+                lock.lock();
+                busy_ = false;
+                if(current_.empty()) done_cv_.notify_all();
+            }
+        }
+
+        mutable std::mutex mtx_;
+        std::condition_variable work_cv_; // wakes the worker
+        std::condition_variable done_cv_; // wakes flush()
+        std::vector<Retired> current_; // epoch being filled by retire()
+        std::vector<Retired> batch_;   // epoch being destroyed by the worker
+        size_t max_pending_ = size_t{1} << 16;
+        bool busy_ = false; // destroying batch_
+        bool stop_ = false;
+        std::thread worker_;
+    };
+
+    // Atomic counts like MultiThreaded, destruction handed to the Reclaimer
+    struct Deferred : MultiThreaded{
+        static void retire(void* p, Reclaimer::Destroy destroy) noexcept {
+            Reclaimer::instance().retire(p, destroy);
+        }
+    };
+}
@@ -0,0 +1,206 @@
+/*
+Tests and benchmark for the fused SIMD expression templates (see expression.hpp)
+
+The tests compare every instruction set against plain loops over the same expression. The
+benchmark evaluates bandwidth bound expressions of 2 to 8 arrays, fused (one pass) and eagerly
+(one simd.hpp kernel per operation, each writing a temporary array), and reports GB/s counted
+as the bytes a fused pass must move: one read per operand and one write.
+Arguments: array length and repetitions
+*/
+
+#include "expression.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cassert>
+#include <cstdlib>
+
+constexpr simd::Isa AllIsas[] = {simd::Isa::Scalar, simd::Isa::SSE2, simd::Isa::AVX2, simd::Isa::AVX512, simd::Isa::NEON};
+
+template <typename T>
+simd::Array<T> random_array(size_t n, unsigned seed){
+    std::mt19937 gen(seed);
+    simd::Array<T> a(n);
+    for(size_t i=0; i<n; ++i){
+        if constexpr (std::is_integral_v<T>) a[i] = static_cast<T>(gen()); // full range, so products wrap
+        else a[i] = static_cast<T>(std::uniform_real_distribution<double>(0.5, 2.0)(gen)); // safe to divide by
+    }
+    return a;
+}
+
+template <typename T>
+bool close(T a, T b, size_t n){
+    if constexpr (std::is_integral_v<T>) return a == b;
+    else return std::abs(a - b) <= std::numeric_limits<T>::epsilon() * 4 * (n + 1) * std::max(T{1}, std::abs(b));
+}
+
+template <typename T>
+void test_elementwise(){
+    for(simd::Isa isa : AllIsas){
+        if(!simd::supported(isa)) continue;
+        simd::expression_isa() = isa;
+        for(size_t n=0; n<=70; ++n){
+            auto a = random_array<T>(n, 1), b = random_array<T>(n, 2), c = random_array<T>(n, 3);
+
+            // Floating point within a rounding or two: a * b + c may be contracted into an fma
+            simd::Array<T> r = a + b * c - a;
+            assert(r.size() == n);
+            for(size_t i=0; i<n; ++i){
+                T expected = simd::Sub::apply(simd::Add::apply(a[i], simd::Mul::apply(b[i], c[i])), a[i]);
+                assert(close(r[i], expected, 1));
+            }
+
+            // Scalars on either side, and min/max
+            r = T{3} * simd::max(a, b) + simd::min(b, c) * T{2};
+            for(size_t i=0; i<n; ++i){
+                T expected = simd::Add::apply(simd::Mul::apply(T{3}, std::max(a[i], b[i])), simd::Mul::apply(std::min(b[i], c[i]), T{2}));
+                assert(close(r[i], expected, 1));
+            }
+
+            if constexpr (std::is_floating_point_v<T>){
+                r = (a + b) / c;
+                for(size_t i=0; i<n; ++i) assert(r[i] == (a[i] + b[i]) / c[i]);
+            }
+        }
+    }
+    simd::expression_isa() = simd::best_isa();
+}
+
+template <typename T>
+void test_reductions(){
+    for(simd::Isa isa : AllIsas){
+        if(!simd::supported(isa)) continue;
+        simd::expression_isa() = isa;
+        for(size_t n=0; n<=70; ++n){
+            auto a = random_array<T>(n, 4), b = random_array<T>(n, 5);
+            T sum{}, dot{};
+            for(size_t i=0; i<n; ++i){
+                sum = simd::Add::apply(sum, simd::Sub::apply(a[i], b[i]));
+                dot = simd::Add::apply(dot, simd::Mul::apply(a[i], b[i]));
+            }
+            assert(close(simd::sum(a - b), sum, n));
+            assert(close(simd::sum(a * b), dot, n));
+            assert(close(simd::sum(a * b), simd::dot(a.data(), b.data(), n), n)); // same as the dot kernel
+            if(n > 0){
+                T lo = a[0] + b[0], hi = lo;
+                for(size_t i=0; i<n; ++i){
+                    lo = std::min(lo, simd::Add::apply(a[i], b[i]));
+                    hi = std::max(hi, simd::Add::apply(a[i], b[i]));
+                }
+                assert(simd::min(a + b) == lo);
+                assert(simd::max(a + b) == hi);
+            }
+        }
+    }
+    simd::expression_isa() = simd::best_isa();
+}
+
+void test_assignment(){
+    simd::Array<float> a = {1, 2, 3, 4, 5};
+    simd::Array<float> b = {5, 4, 3, 2, 1};
+
+    // Reading and writing the same array
+    a = a + b;
+    for(size_t i=0; i<5; ++i) assert(a[i] == 6);
+    a += b * 2.0f;
+    assert(a[0] == 16 && a[4] == 8);
+    a *= a;
+    assert(a[0] == 256 && a[4] == 64);
+
+    // Assigning to an array of another length replaces its storage
+    simd::Array<float> c;
+    c = a - b;
+    assert(c.size() == 5 && c[0] == 251);
+
+    // Aligned storage
+    simd::Array<float> d(100);
+    assert(reinterpret_cast<uintptr_t>(d.data()) % 64 == 0);
+
+    bool threw = false;
+    simd::Array<float> shorter(4);
+    try{ simd::Array<float> r = a + shorter; }
+    catch(const std::invalid_argument&){ threw = true; }
+    assert(threw);
+
+    threw = false;
+    try{ simd::max(c - c + shorter * 0.0f); }
+    catch(const std::invalid_argument&){ threw = true; }
+    assert(threw);
+
+    threw = false;
+    simd::Array<float> empty;
+    try{ simd::min(empty * 2.0f); }
+    catch(const std::invalid_argument&){ threw = true; }
+    assert(threw);
+    assert(simd::sum(empty + empty) == 0);
+}
+
+template <typename F>
+double gb_per_s(size_t reps, size_t bytes, F f){
+    f(); // warm up: page in the output
+    auto start = std::chrono::high_resolution_clock::now();
+    for(size_t r=0; r<reps; ++r) f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return static_cast<double>(bytes) * reps / std::chrono::duration<double>(end - start).count() / 1e9;
+}
+
+void Benchmark(size_t n, size_t reps){
+    std::vector<simd::Array<float>> in;
+    for(unsigned i=0; i<8; ++i) in.push_back(random_array<float>(n, i));
+    auto &a = in[0], &b = in[1], &c = in[2], &d = in[3], &e = in[4], &f = in[5], &g = in[6], &h = in[7];
+    simd::Array<float> out(n), t1(n), t2(n), t3(n), t4(n);
+
+    auto add = [&](const simd::Array<float>& x, const simd::Array<float>& y, simd::Array<float>& r){ simd::add(x.data(), y.data(), r.data(), n); };
+    auto mul = [&](const simd::Array<float>& x, const simd::Array<float>& y, simd::Array<float>& r){ simd::mul(x.data(), y.data(), r.data(), n); };
+
+    struct Case{ const char* name; size_t operands; std::function<void()> fused, eager; };
+    Case cases[] = {
+        {"a + b", 2,
+            [&]{ out = a + b; },
+            [&]{ add(a, b, out); }},
+        {"a * b + c * d", 4,
+            [&]{ out = a * b + c * d; },
+            [&]{ mul(a, b, t1); mul(c, d, t2); add(t1, t2, out); }},
+        {"a * b + c * d + e * f", 6,
+            [&]{ out = a * b + c * d + e * f; },
+            [&]{ mul(a, b, t1); mul(c, d, t2); mul(e, f, t3); add(t1, t2, t4); add(t4, t3, out); }},
+        {"(a + b) * (c + d) + (e + f) * (g + h)", 8,
+            [&]{ out = (a + b) * (c + d) + (e + f) * (g + h); },
+            [&]{ add(a, b, t1); add(c, d, t2); mul(t1, t2, t3); add(e, f, t1); add(g, h, t2); mul(t1, t2, t4); add(t3, t4, out); }},
+    };
+
+    std::cout << std::left << std::setw(40) << "\nexpression (GB/s)" << std::right << std::setw(10) << "fused" << std::setw(10) << "eager" << "\n";
+    for(auto& cs : cases){
+        size_t bytes = (cs.operands + 1) * n * sizeof(float);
+        std::cout << std::left << std::setw(39) << cs.name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(10) << gb_per_s(reps, bytes, cs.fused)
+                  << std::setw(10) << gb_per_s(reps, bytes, cs.eager) << "\n";
+    }
+    std::cout.unsetf(std::ios::fixed);
+
+    volatile float sink = 0;
+    std::cout << std::left << std::setw(39) << "sum(a * b)" << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << gb_per_s(reps, 2 * n * sizeof(float), [&]{ sink = simd::sum(a * b); })
+              << std::setw(10) << gb_per_s(reps, 2 * n * sizeof(float), [&]{ mul(a, b, t1); sink = simd::sum(t1.data(), n); }) << "\n";
+    std::cout.unsetf(std::ios::fixed);
+}
+
+int main(int argc, char** argv){
+    test_elementwise<float>();
+    test_elementwise<double>();
+    test_elementwise<int32_t>();
+    test_reductions<float>();
+    test_reductions<double>();
+    test_reductions<int32_t>();
+    test_assignment();
+    std::cout << "All expression template tests passed! Evaluating with " << simd::name(simd::expression_isa()) << "\n";
+
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1 << 22; // 16MB per array, well past the caches
+    size_t reps = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20;
+    std::cout << n << " elements, " << reps << " repetitions" << std::endl;
+    Benchmark(n, reps);
+}
@@ -0,0 +1,271 @@
+#pragma once
+/*
+Expression templates for fused SIMD array arithmetic
+
+    simd::Array<float> a(n), b(n), c(n), d(n);
+    simd::Array<float> r = a + b * c - d;   // one loop, no temporary arrays
+    float s = simd::sum(a * b);              // dot product, also fused
+    r = simd::max(a, b) * 0.5f;
+
+An arithmetic operator on arrays doesn't compute anything: it returns a small node that remembers
+its operands (Binary<Left, Right, Op>), so a + b * c - d is a tree of types. Assigning it to an
+Array, or reducing it, runs a single loop that loads one register from every operand, evaluates
+the whole tree in registers and stores the result once. Memory traffic is one read per operand
+and one write, instead of a read, read, write per operation with eager evaluation.
+
+All nodes derive from Expr<Derived> (CRTP, like src/crtp.cpp), which gives them a scalar
+operator[] and size() without virtual calls. The SIMD evaluation (expression_kernels.inl) is
+compiled for every instruction set of simd.hpp and dispatched at runtime; the scalar fallback
+simply calls operator[] on the tree.
+
+Operands must have the same element type (float, double or int32_t) and length; scalars of that
+type are broadcast. Division is only for floating point. Arrays are held by reference in the
+tree, so an expression must not outlive its arrays (don't store it in an auto variable past a
+statement that destroys them).
+*/
+
+#include "simd.hpp"
+#include "vector.hpp"
+#include "aligned_allocator.hpp"
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+
+namespace simd{
+    template <typename Derived>
+    class Expr{
+    public:
+        const Derived& self() const { return static_cast<const Derived&>(*this); }
+        auto operator[](size_t i) const { return self()[i]; }
+        size_t size() const { return self().size(); }
+    };
+
+    // Operations: a tag with the scalar version, the SIMD versions are in expression_kernels.inl
+    struct Add{ template <typename T> static T apply(T a, T b){ return detail::scalar_add(a, b); } };
+    struct Sub{
+        template <typename T> static T apply(T a, T b){
+            if constexpr (std::is_integral_v<T>) return static_cast<T>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b));
+            else return a - b;
+        }
+    };
+    struct Mul{ template <typename T> static T apply(T a, T b){ return detail::scalar_mul(a, b); } };
+    struct Div{ template <typename T> static T apply(T a, T b){ return a / b; } };
+    struct Min{ template <typename T> static T apply(T a, T b){ return detail::scalar_min(a, b); } };
+    struct Max{ template <typename T> static T apply(T a, T b){ return detail::scalar_max(a, b); } };
+
+    template <Element T>
+    class Array;
+
+    // A scalar broadcast to every element
+    template <typename T>
+    class Scalar : public Expr<Scalar<T>>{
+    public:
+        using value_type = T;
+        explicit Scalar(T value) : value(value) {}
+        T operator[](size_t) const { return value; }
+        size_t size() const { return 0; } // matches any length
+        T value;
+    };
+
+    namespace detail{
+        // Arrays are stored by reference, intermediate nodes (small, temporary) by value
+        template <typename E>
+        struct is_array : std::false_type {};
+        template <typename T>
+        struct is_array<Array<T>> : std::true_type {};
+        template <typename E>
+        using operand = std::conditional_t<is_array<E>::value, const E&, const E>;
+    }
+
+    template <typename Left, typename Right, typename Op>
+    class Binary : public Expr<Binary<Left, Right, Op>>{
+    public:
+        using value_type = typename Left::value_type;
+        static_assert(std::is_same_v<value_type, typename Right::value_type>, "operands must have the same element type");
+        static_assert(!std::is_same_v<Op, Div> || std::is_floating_point_v<value_type>, "division is only for float and double");
+
+        Binary(const Left& left, const Right& right) : left(left), right(right) {
+            if(left.size() && right.size() && left.size() != right.size()){
+                throw std::invalid_argument("Array expression operands have different lengths");
+            }
+        }
+        value_type operator[](size_t i) const { return Op::apply(left[i], right[i]); }
+        size_t size() const { return left.size() ? left.size() : right.size(); }
+
+        detail::operand<Left> left;
+        detail::operand<Right> right;
+    };
+
+    // Aligned storage, so loads in the fused loop don't split cache lines
+    template <Element T>
+    class Array : public Expr<Array<T>>{
+    public:
+        using value_type = T;
+
+        Array() = default;
+        explicit Array(size_t n, T value = T{}) : data_(n, value) {}
+        Array(std::initializer_list<T> values) : data_(values) {}
+        // Evaluate an expression
+        template <typename E>
+        Array(const Expr<E>& e) : data_(e.size(), T{}) {
+            assign(e.self());
+        }
+        template <typename E>
+        Array& operator=(const Expr<E>& e){
+            if(e.size() != size()){
+                // Evaluate into new storage, the expression may read from this array
+                Array result(e);
+                std::swap(data_, result.data_);
+            }
+            else{
+                assign(e.self()); // elementwise, so reading and writing the same array is fine
+            }
+            return *this;
+        }
+        template <typename E>
+        Array& operator+=(const Expr<E>& e){ return *this = *this + e; }
+        template <typename E>
+        Array& operator*=(const Expr<E>& e){ return *this = *this * e; }
+
+        T& operator[](size_t i){ return data_[i]; }
+        const T& operator[](size_t i) const { return data_[i]; }
+        size_t size() const { return data_.size(); }
+        T* data(){ return data_.data(); }
+        const T* data() const { return data_.data(); }
+
+    private:
+        template <typename E>
+        void assign(const E& e);
+
+        Vector<T, AlignedAllocator<T>> data_;
+    };
+
+    // Wrap scalars so they can be mixed with arrays
+    template <typename E>
+    const E& as_expr(const Expr<E>& e){ return e.self(); }
+    template <Element T>
+    Scalar<T> as_expr(T value){ return Scalar<T>(value); }
+
+    template <typename A, typename B>
+    concept Operands = (std::is_base_of_v<Expr<std::remove_cvref_t<A>>, std::remove_cvref_t<A>>
+                        || std::is_base_of_v<Expr<std::remove_cvref_t<B>>, std::remove_cvref_t<B>>);
+
+    template <typename Op, typename A, typename B>
+    auto make_binary(const A& a, const B& b){
+        using L = std::remove_cvref_t<decltype(as_expr(a))>;
+        using R = std::remove_cvref_t<decltype(as_expr(b))>;
+        return Binary<L, R, Op>(as_expr(a), as_expr(b));
+    }
+
+    template <typename A, typename B> requires Operands<A, B>
+    auto operator+(const A& a, const B& b){ return make_binary<Add>(a, b); }
+    template <typename A, typename B> requires Operands<A, B>
+    auto operator-(const A& a, const B& b){ return make_binary<Sub>(a, b); }
+    template <typename A, typename B> requires Operands<A, B>
+    auto operator*(const A& a, const B& b){ return make_binary<Mul>(a, b); }
+    template <typename A, typename B> requires Operands<A, B>
+    auto operator/(const A& a, const B& b){ return make_binary<Div>(a, b); }
+    // Elementwise min/max of two expressions
+    template <typename A, typename B> requires Operands<A, B>
+    auto min(const A& a, const B& b){ return make_binary<Min>(a, b); }
+    template <typename A, typename B> requires Operands<A, B>
+    auto max(const A& a, const B& b){ return make_binary<Max>(a, b); }
+
+    // Per instruction set: assign<E>(out, e, n) and reduce<Op, E>(e, n, identity)
+    namespace scalar{
+        template <typename E, typename T>
+        void assign(T* out, const E& e, size_t n){
+            for(size_t i=0; i<n; ++i) out[i] = e[i];
+        }
+        template <typename Op, typename E, typename T>
+        T reduce(const E& e, size_t n, T identity){
+            T result = identity;
+            for(size_t i=0; i<n; ++i) result = Op::apply(result, e[i]);
+            return result;
+        }
+    }
+
+#ifdef SIMD_X86
+#pragma GCC push_options
+#pragma GCC target("sse2")
+    namespace sse2{
+#include "expression_kernels.inl"
+    }
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+    namespace avx2{
+#include "expression_kernels.inl"
+    }
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+    namespace avx512{
+#include "expression_kernels.inl"
+    }
+#pragma GCC pop_options
+#endif
+
+#ifdef SIMD_NEON
+    namespace neon{
+#include "expression_kernels.inl"
+    }
+#endif
+
+    // Instruction set used for expressions, Scalar evaluates with operator[] only
+    inline Isa& expression_isa(){
+        static Isa isa = best_isa();
+        return isa;
+    }
+
+    template <Element T>
+    template <typename E>
+    void Array<T>::assign(const E& e){
+        T* out = data_.data();
+        size_t n = data_.size();
+        switch(expression_isa()){
+#ifdef SIMD_X86
+            case Isa::SSE2: sse2::assign(out, e, n); return;
+            case Isa::AVX2: avx2::assign(out, e, n); return;
+            case Isa::AVX512: avx512::assign(out, e, n); return;
+#endif
+#ifdef SIMD_NEON
+            case Isa::NEON: neon::assign(out, e, n); return;
+#endif
+            default: scalar::assign(out, e, n); return;
+        }
+    }
+
+    template <typename Op, typename E, typename T = typename E::value_type>
+    T reduce(const Expr<E>& expr, T identity){
+        const E& e = expr.self();
+        size_t n = e.size();
+        switch(expression_isa()){
+#ifdef SIMD_X86
+            case Isa::SSE2: return sse2::reduce<Op>(e, n, identity);
+            case Isa::AVX2: return avx2::reduce<Op>(e, n, identity);
+            case Isa::AVX512: return avx512::reduce<Op>(e, n, identity);
+#endif
+#ifdef SIMD_NEON
+            case Isa::NEON: return neon::reduce<Op>(e, n, identity);
+#endif
+            default: return scalar::reduce<Op>(e, n, identity);
+        }
+    }
+
+    // Reductions of a whole expression in the same single pass
+    template <typename E>
+    auto sum(const Expr<E>& e){ return reduce<Add>(e, typename E::value_type{}); }
+    template <typename E>
+    auto min(const Expr<E>& e){
+        if(e.size() == 0) throw std::invalid_argument("simd::min of an empty expression");
+        return reduce<Min>(e, std::numeric_limits<typename E::value_type>::max());
+    }
+    template <typename E>
+    auto max(const Expr<E>& e){
+        if(e.size() == 0) throw std::invalid_argument("simd::max of an empty expression");
+        return reduce<Max>(e, std::numeric_limits<typename E::value_type>::lowest());
+    }
+}
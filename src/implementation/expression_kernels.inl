@@ -0,0 +1,83 @@
+/*
+SIMD evaluation of expression trees (see expression.hpp), against the register types V<T> of simd.hpp.
+Included once per instruction set inside its namespace and #pragma GCC target region, like
+simd_kernels.inl. No #pragma once on purpose.
+
+load(node, i) evaluates lanes i .. i + width - 1 of a node in a register: arrays are loaded,
+scalars broadcast and Binary nodes combine their operands' registers, so the compiler inlines
+the whole tree into one sequence of instructions. For the last n % width elements load_tail
+reads the arrays with load_partial (simd_kernels.inl), so the tail is one more pass through the
+same register code. Reductions finish their tail with the scalar operator[]. With fma
+available GCC may contract a * b + c into one fma (-ffp-contract=fast is its default), so
+floating point results can differ from unfused scalar loops in the last bit.
+*/
+
+template <typename T>
+inline typename V<T>::reg apply(Add, typename V<T>::reg a, typename V<T>::reg b){ return V<T>::add(a, b); }
+template <typename T>
+inline typename V<T>::reg apply(Sub, typename V<T>::reg a, typename V<T>::reg b){ return V<T>::sub(a, b); }
+template <typename T>
+inline typename V<T>::reg apply(Mul, typename V<T>::reg a, typename V<T>::reg b){ return V<T>::mul(a, b); }
+template <typename T>
+inline typename V<T>::reg apply(Div, typename V<T>::reg a, typename V<T>::reg b){ return V<T>::div(a, b); }
+template <typename T>
+inline typename V<T>::reg apply(Min, typename V<T>::reg a, typename V<T>::reg b){ return V<T>::min(a, b); }
+template <typename T>
+inline typename V<T>::reg apply(Max, typename V<T>::reg a, typename V<T>::reg b){ return V<T>::max(a, b); }
+
+template <typename T>
+inline typename V<T>::reg load(const Array<T>& a, size_t i){ return V<T>::load(a.data() + i); }
+
+template <typename T>
+inline typename V<T>::reg load(const Scalar<T>& s, size_t){ return V<T>::set1(s.value); }
+
+template <typename Left, typename Right, typename Op>
+inline typename V<typename Left::value_type>::reg load(const Binary<Left, Right, Op>& e, size_t i){
+    return apply<typename Left::value_type>(Op{}, load(e.left, i), load(e.right, i));
+}
+
+template <typename T>
+inline typename V<T>::reg load_tail(const Array<T>& a, size_t i, size_t rest){ return load_partial(a.data() + i, rest, T{}); }
+
+template <typename T>
+inline typename V<T>::reg load_tail(const Scalar<T>& s, size_t, size_t){ return V<T>::set1(s.value); }
+
+template <typename Left, typename Right, typename Op>
+inline typename V<typename Left::value_type>::reg load_tail(const Binary<Left, Right, Op>& e, size_t i, size_t rest){
+    return apply<typename Left::value_type>(Op{}, load_tail(e.left, i, rest), load_tail(e.right, i, rest));
+}
+
+template <typename E, typename T>
+void assign(T* out, const E& e, size_t n){
+    constexpr size_t W = V<T>::width;
+    size_t i = 0;
+    for(; i + W <= n; i += W){
+        V<T>::store(out + i, load(e, i));
+    }
+    if(i < n){
+        store_partial(out + i, load_tail(e, i, n - i), n - i);
+    }
+}
+
+template <typename Op, typename E, typename T>
+T reduce(const E& e, size_t n, T identity){
+    constexpr size_t W = V<T>::width;
+    auto acc0 = V<T>::set1(identity), acc1 = acc0;
+    size_t i = 0;
+    // Two accumulators: enough to overlap the adds with the loads of a memory bound expression
+    for(; i + 2 * W <= n; i += 2 * W){
+        acc0 = apply<T>(Op{}, acc0, load(e, i));
+        acc1 = apply<T>(Op{}, acc1, load(e, i + W));
+    }
+    for(; i + W <= n; i += W){
+        acc0 = apply<T>(Op{}, acc0, load(e, i));
+    }
+    alignas(64) T lanes[W];
+    V<T>::store(lanes, apply<T>(Op{}, acc0, acc1));
+    T result = identity;
+    for(T lane : lanes) result = Op::apply(result, lane);
+    for(; i < n; ++i){
+        result = Op::apply(result, e[i]);
+    }
+    return result;
+}
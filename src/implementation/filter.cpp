@@ -0,0 +1,179 @@
+/*
+Tests and benchmark for the vectorized filter (see filter.hpp)
+
+The tests compare every instruction set with std::copy_if for all small lengths (every tail of a
+register), every predicate, in place and out of place. The benchmark filters random int32 and
+float arrays with a threshold chosen to keep 1% to 99% of the elements, with a views::filter
+loop, std::copy_if, the branchless scalar loop and the SIMD kernels, in ns per input element.
+The branchy loops are slowest around 50%, where the branch is least predictable.
+Arguments: array length, repetitions
+*/
+
+#include "filter.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <span>
+#include <random>
+#include <cassert>
+#include <cstring>
+#include <cstdlib>
+
+constexpr simd::Isa FilterIsas[] = {simd::Isa::Scalar, simd::Isa::AVX2, simd::Isa::AVX512};
+
+// Uniform in [0, 100), so x < s keeps about s% of the elements
+template <typename T>
+std::vector<T> random_values(size_t n, unsigned seed = 1){
+    std::mt19937 gen(seed);
+    std::vector<T> v(n);
+    for(auto& x : v){
+        if constexpr (std::is_integral_v<T>) x = static_cast<T>(gen() % 100);
+        else x = static_cast<T>(std::uniform_real_distribution<double>(0.0, 100.0)(gen));
+    }
+    return v;
+}
+
+// Bitwise, so NaNs compare equal
+template <typename T>
+bool same(const std::vector<T>& expected, const T* out){
+    return expected.empty() || std::memcmp(expected.data(), out, expected.size() * sizeof(T)) == 0;
+}
+
+template <typename T, typename P>
+void check(const std::vector<T>& v, P pred, simd::Isa isa){
+    std::vector<T> expected;
+    std::copy_if(v.begin(), v.end(), std::back_inserter(expected), pred);
+    std::vector<T> out(v.size());
+    T* end = simd::filter_into(v.data(), v.data() + v.size(), out.data(), pred, isa);
+    assert(static_cast<size_t>(end - out.data()) == expected.size());
+    assert(same(expected, out.data()));
+
+    auto in_place = v;
+    end = simd::compact(in_place.data(), in_place.data() + in_place.size(), pred, isa);
+    assert(static_cast<size_t>(end - in_place.data()) == expected.size());
+    assert(same(expected, in_place.data()));
+}
+
+template <typename T>
+void test_predicates(){
+    for(simd::Isa isa : FilterIsas){
+        if(!simd::supported(isa)) continue;
+        for(size_t n=0; n<=70; ++n){
+            auto v = random_values<T>(n, static_cast<unsigned>(n));
+            for(T x : {T(0), T(50), T(99)}) v.push_back(x); // equal values
+            check(v, simd::less_than(T(50)), isa);
+            check(v, simd::less_equal(T(50)), isa);
+            check(v, simd::greater_than(T(50)), isa);
+            check(v, simd::greater_equal(T(50)), isa);
+            check(v, simd::equal_to(T(50)), isa);
+            check(v, simd::not_equal_to(T(50)), isa);
+            check(v, simd::between(T(20), T(30)), isa);
+            check(v, simd::less_than(T(10)) || simd::greater_equal(T(90)), isa);
+            check(v, simd::between(T(0), T(100)) && simd::not_equal_to(T(0)), isa);
+        }
+        auto big = random_values<T>(100003);
+        check(big, simd::less_than(T(1)), isa);
+        check(big, simd::less_than(T(99)), isa);
+        check(big, simd::less_than(T(-1)), isa);  // nothing
+        check(big, simd::less_than(T(100)), isa); // everything
+    }
+}
+
+void test_special_values(){
+    std::vector<float> f = {NAN, 1.0f, -INFINITY, 0.0f, -0.0f, INFINITY, NAN, 2.0f, 3.0f, -1.0f};
+    for(simd::Isa isa : FilterIsas){
+        if(!simd::supported(isa)) continue;
+        check(f, simd::less_than(1.5f), isa);        // NaN compares false
+        check(f, simd::not_equal_to(1.0f), isa);     // ... except with !=
+        check(f, simd::equal_to(0.0f), isa);         // -0 == 0
+        std::vector<int32_t> i = {INT32_MIN, INT32_MAX, 0, -1, 1, INT32_MIN, 5, 6, 7, 8, 9};
+        check(i, simd::greater_than(INT32_MIN), isa);
+        check(i, simd::less_equal(-1), isa);
+    }
+}
+
+void test_containers(){
+    std::vector<double> d = {1.5, -2.0, 3.0, 0.5, 7.0};
+    std::vector<double> out(d.size());
+    auto end = simd::filter_into(d, out.begin(), simd::greater_than(1.0));
+    assert(end - out.begin() == 3 && out[0] == 1.5 && out[2] == 7.0);
+
+    auto kept = simd::compact(d, simd::less_than(1.0));
+    d.erase(kept, d.end());
+    assert(d == (std::vector<double>{-2.0, 0.5}));
+
+    Vector<int32_t> v;
+    for(int32_t x=0; x<100; ++x) v.push_back(x);
+    auto vend = simd::compact(v, simd::equal_to(7) || simd::equal_to(70));
+    assert(vend - v.begin() == 2 && v[0] == 7 && v[1] == 70);
+
+    // A span leaves the rest of the array alone
+    std::vector<int32_t> a(64, 1);
+    std::span<int32_t> half(a.data(), 32);
+    simd::compact(half, simd::equal_to(0));
+    assert(std::all_of(a.begin() + 32, a.end(), [](int32_t x){ return x == 1; }));
+
+    // Predicates are ordinary function objects too
+    auto pred = simd::between(2, 5);
+    assert(!pred(1) && pred(2) && pred(4) && !pred(5));
+}
+
+template <typename F>
+double time_ms(F f){
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template <typename T>
+void Benchmark(const char* type, size_t n, size_t reps){
+    auto v = random_values<T>(n);
+    std::vector<T> out(n);
+    std::cout << "\n" << std::left << std::setw(10) << type << std::right << std::setw(14) << "views::filter" << std::setw(10) << "copy_if";
+    for(simd::Isa isa : FilterIsas) std::cout << std::setw(10) << simd::name(isa);
+    std::cout << "   (ns per element)\n";
+    volatile size_t sink = 0;
+    for(int percent : {1, 10, 25, 50, 75, 90, 99}){
+        auto pred = simd::less_than(static_cast<T>(percent));
+        double per = 1e6 / static_cast<double>(n * reps);
+        double t_view = time_ms([&]{
+            for(size_t r=0; r<reps; ++r){
+                T* o = out.data();
+                for(T x : v | std::views::filter(pred)) *o++ = x;
+                sink = static_cast<size_t>(o - out.data());
+            }
+        });
+        double t_copy = time_ms([&]{
+            for(size_t r=0; r<reps; ++r) sink = static_cast<size_t>(std::copy_if(v.begin(), v.end(), out.begin(), pred) - out.begin());
+        });
+        std::cout << std::left << std::setw(10) << (std::to_string(percent) + "%") << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(14) << t_view * per << std::setw(10) << t_copy * per;
+        for(simd::Isa isa : FilterIsas){
+            if(!simd::supported(isa)){ std::cout << std::setw(10) << "-"; continue; }
+            double t = time_ms([&]{
+                for(size_t r=0; r<reps; ++r) sink = static_cast<size_t>(simd::filter_into(v.data(), v.data() + n, out.data(), pred, isa) - out.data());
+            });
+            std::cout << std::setw(10) << t * per;
+        }
+        std::cout << "\n";
+        std::cout.unsetf(std::ios::fixed);
+    }
+}
+
+int main(int argc, char** argv){
+    test_predicates<int32_t>();
+    test_predicates<float>();
+    test_predicates<double>();
+    test_special_values();
+    test_containers();
+    std::cout << "All filter tests passed! Filtering with " << simd::name(simd::filter_isa()) << "\n";
+
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1 << 16; // fits in L2, so the branches matter more than memory
+    size_t reps = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200;
+    Benchmark<int32_t>("int32", n, reps);
+    Benchmark<float>("float", n, reps);
+}
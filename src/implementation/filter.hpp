@@ -0,0 +1,264 @@
+#pragma once
+/*
+Vectorized filter: copies (or keeps in place) the elements that satisfy a simple predicate
+
+    auto end = simd::filter_into(v, out.begin(), simd::greater_than(0.5f));  // like std::copy_if
+    auto kept = simd::compact(v, simd::between(10, 20) || simd::equal_to(-1));  // like std::remove_if(!pred)
+
+A materialized replacement for std::views::filter (see src/ranges.cpp) when the predicate is a
+comparison with a constant. views::filter tests one element at a time and branches on the result,
+which the branch predictor gets wrong about half the time when the data is random (a selectivity
+around 50%). Here W elements are loaded into a register, compared in one instruction into a bit
+mask, and the selected lanes are written packed to the output without any branch on the data:
+AVX-512 has a compress store for it, AVX2 permutes the selected lanes to the front with a
+permutation looked up by the mask (the table of simd_sort.hpp) and stores the whole register,
+then moves the output pointer by popcount(mask). The scalar fallback and the tails use the
+branchless form of the same loop (write every element, advance the output only if it's kept).
+
+Predicates: less_than, less_equal, greater_than, greater_equal, equal_to, not_equal_to (x op value)
+and between(lo, hi) (lo <= x < hi), combined with && and ||. They also work as ordinary function
+objects, e.g. with std::copy_if. Elements are float, double or int32_t, in contiguous ranges.
+The output needs room for the whole input: the AVX2 path stores full registers, so it may write
+past the returned end (never past out + n). The output may be the input (that's compact).
+*/
+
+#include "simd.hpp"
+#include "simd_sort.hpp"
+#include "vector.hpp"
+#include <bit>
+#include <memory>
+#include <ranges>
+#include <type_traits>
+
+namespace simd{
+    enum class Cmp{ LT, LE, GT, GE, EQ, NE };
+
+    // x cmp value
+    template <Element T, Cmp C>
+    struct Compare{
+        using value_type = T;
+        T value;
+        bool operator()(T x) const {
+            switch(C){
+                case Cmp::LT: return x < value;
+                case Cmp::LE: return x <= value;
+                case Cmp::GT: return x > value;
+                case Cmp::GE: return x >= value;
+                case Cmp::EQ: return x == value;
+                case Cmp::NE: return x != value;
+            }
+            return false;
+        }
+    };
+
+    template <typename L, typename R>
+    struct And{
+        using value_type = typename L::value_type;
+        L left;
+        R right;
+        bool operator()(value_type x) const { return left(x) && right(x); }
+    };
+
+    template <typename L, typename R>
+    struct Or{
+        using value_type = typename L::value_type;
+        L left;
+        R right;
+        bool operator()(value_type x) const { return left(x) || right(x); }
+    };
+
+    namespace filter_detail{
+        template <typename P> struct is_predicate : std::false_type {};
+        template <typename T, Cmp C> struct is_predicate<Compare<T, C>> : std::true_type {};
+        template <typename L, typename R> struct is_predicate<And<L, R>> : std::true_type {};
+        template <typename L, typename R> struct is_predicate<Or<L, R>> : std::true_type {};
+    }
+
+    template <typename P>
+    concept Predicate = filter_detail::is_predicate<P>::value;
+
+    template <Element T> Compare<T, Cmp::LT> less_than(T value){ return {value}; }
+    template <Element T> Compare<T, Cmp::LE> less_equal(T value){ return {value}; }
+    template <Element T> Compare<T, Cmp::GT> greater_than(T value){ return {value}; }
+    template <Element T> Compare<T, Cmp::GE> greater_equal(T value){ return {value}; }
+    template <Element T> Compare<T, Cmp::EQ> equal_to(T value){ return {value}; }
+    template <Element T> Compare<T, Cmp::NE> not_equal_to(T value){ return {value}; }
+
+    // Both sides must test the same element type
+    template <Predicate L, Predicate R> requires std::is_same_v<typename L::value_type, typename R::value_type>
+    And<L, R> operator&&(L left, R right){ return {left, right}; }
+    template <Predicate L, Predicate R> requires std::is_same_v<typename L::value_type, typename R::value_type>
+    Or<L, R> operator||(L left, R right){ return {left, right}; }
+
+    // lo <= x < hi
+    template <Element T>
+    And<Compare<T, Cmp::GE>, Compare<T, Cmp::LT>> between(T lo, T hi){ return {{lo}, {hi}}; }
+
+    namespace filter_detail{
+        // Branchless scalar filter: every element is written, the output only advances past kept ones
+        template <typename T, typename P>
+        size_t filter(const T* in, size_t n, T* out, const P& pred){
+            size_t k = 0;
+            for(size_t i=0; i<n; ++i){
+                T x = in[i]; // read before writing, out may be in
+                out[k] = x;
+                k += pred(x) ? 1 : 0;
+            }
+            return k;
+        }
+    }
+
+#ifdef SIMD_X86
+    // Filter<T> adds to V<T>:
+    //   compare<C>(v, c)      bit mask of the lanes with v C c
+    //   compress(out, v, mask)   writes the lanes in mask packed to out, returns how many.
+    //                            AVX2 writes a full register at out
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+    namespace avx2{
+        template <typename T> struct Filter;
+
+        template <> struct Filter<float>{
+            using reg = __m256;
+            template <Cmp C> static unsigned compare(reg v, reg c){
+                constexpr int imm = C == Cmp::LT ? _CMP_LT_OQ : C == Cmp::LE ? _CMP_LE_OQ : C == Cmp::GT ? _CMP_GT_OQ
+                                  : C == Cmp::GE ? _CMP_GE_OQ : C == Cmp::EQ ? _CMP_EQ_OQ : _CMP_NEQ_UQ;
+                return _mm256_movemask_ps(_mm256_cmp_ps(v, c, imm));
+            }
+            static size_t compress(float* out, reg v, unsigned mask){
+                _mm256_storeu_ps(out, Sort<float>::permute(v, sort_detail::compress_table<8, 1>[mask].data()));
+                return std::popcount(mask);
+            }
+        };
+
+        template <> struct Filter<double>{
+            using reg = __m256d;
+            template <Cmp C> static unsigned compare(reg v, reg c){
+                constexpr int imm = C == Cmp::LT ? _CMP_LT_OQ : C == Cmp::LE ? _CMP_LE_OQ : C == Cmp::GT ? _CMP_GT_OQ
+                                  : C == Cmp::GE ? _CMP_GE_OQ : C == Cmp::EQ ? _CMP_EQ_OQ : _CMP_NEQ_UQ;
+                return _mm256_movemask_pd(_mm256_cmp_pd(v, c, imm));
+            }
+            static size_t compress(double* out, reg v, unsigned mask){
+                _mm256_storeu_pd(out, Sort<double>::permute(v, sort_detail::compress_table<4, 2>[mask].data()));
+                return std::popcount(mask);
+            }
+        };
+
+        template <> struct Filter<int32_t>{
+            using reg = __m256i;
+            static unsigned bits(reg r){ return static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(r))); }
+            // Only > and == for integers: the others are swapped or negated
+            template <Cmp C> static unsigned compare(reg v, reg c){
+                if constexpr (C == Cmp::LT) return bits(_mm256_cmpgt_epi32(c, v));
+                else if constexpr (C == Cmp::LE) return ~bits(_mm256_cmpgt_epi32(v, c)) & 0xFF;
+                else if constexpr (C == Cmp::GT) return bits(_mm256_cmpgt_epi32(v, c));
+                else if constexpr (C == Cmp::GE) return ~bits(_mm256_cmpgt_epi32(c, v)) & 0xFF;
+                else if constexpr (C == Cmp::EQ) return bits(_mm256_cmpeq_epi32(v, c));
+                else return ~bits(_mm256_cmpeq_epi32(v, c)) & 0xFF;
+            }
+            static size_t compress(int32_t* out, reg v, unsigned mask){
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), Sort<int32_t>::permute(v, sort_detail::compress_table<8, 1>[mask].data()));
+                return std::popcount(mask);
+            }
+        };
+
+#include "filter_kernels.inl"
+    }
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+    namespace avx512{
+        template <typename T> struct Filter;
+
+        template <> struct Filter<float>{
+            using reg = __m512;
+            template <Cmp C> static unsigned compare(reg v, reg c){
+                constexpr int imm = C == Cmp::LT ? _CMP_LT_OQ : C == Cmp::LE ? _CMP_LE_OQ : C == Cmp::GT ? _CMP_GT_OQ
+                                  : C == Cmp::GE ? _CMP_GE_OQ : C == Cmp::EQ ? _CMP_EQ_OQ : _CMP_NEQ_UQ;
+                return _mm512_cmp_ps_mask(v, c, imm);
+            }
+            static size_t compress(float* out, reg v, unsigned mask){
+                _mm512_mask_compressstoreu_ps(out, static_cast<__mmask16>(mask), v);
+                return std::popcount(mask);
+            }
+        };
+
+        template <> struct Filter<double>{
+            using reg = __m512d;
+            template <Cmp C> static unsigned compare(reg v, reg c){
+                constexpr int imm = C == Cmp::LT ? _CMP_LT_OQ : C == Cmp::LE ? _CMP_LE_OQ : C == Cmp::GT ? _CMP_GT_OQ
+                                  : C == Cmp::GE ? _CMP_GE_OQ : C == Cmp::EQ ? _CMP_EQ_OQ : _CMP_NEQ_UQ;
+                return _mm512_cmp_pd_mask(v, c, imm);
+            }
+            static size_t compress(double* out, reg v, unsigned mask){
+                _mm512_mask_compressstoreu_pd(out, static_cast<__mmask8>(mask), v);
+                return std::popcount(mask);
+            }
+        };
+
+        template <> struct Filter<int32_t>{
+            using reg = __m512i;
+            template <Cmp C> static unsigned compare(reg v, reg c){
+                constexpr int imm = C == Cmp::LT ? _MM_CMPINT_LT : C == Cmp::LE ? _MM_CMPINT_LE : C == Cmp::GT ? _MM_CMPINT_NLE
+                                  : C == Cmp::GE ? _MM_CMPINT_NLT : C == Cmp::EQ ? _MM_CMPINT_EQ : _MM_CMPINT_NE;
+                return _mm512_cmp_epi32_mask(v, c, imm);
+            }
+            static size_t compress(int32_t* out, reg v, unsigned mask){
+                _mm512_mask_compressstoreu_epi32(out, static_cast<__mmask16>(mask), v);
+                return std::popcount(mask);
+            }
+        };
+
+#include "filter_kernels.inl"
+    }
+#pragma GCC pop_options
+#endif // SIMD_X86
+
+    // Best instruction set with filter kernels, Scalar is the branchless scalar loop
+    inline Isa filter_isa(){
+        return sort_isa();
+    }
+
+    // Copies the elements of [first, last) with pred(x) to out, in order, returns the end of the output.
+    // out needs room for last - first elements
+    template <Element T, Predicate P> requires std::is_same_v<typename P::value_type, T>
+    T* filter_into(const T* first, const T* last, T* out, P pred, Isa isa = filter_isa()){
+        check_sort_isa(isa);
+        size_t n = static_cast<size_t>(last - first);
+        switch(isa){
+#ifdef SIMD_X86
+            case Isa::AVX2: return out + avx2::filter(first, n, out, pred);
+            case Isa::AVX512: return out + avx512::filter(first, n, out, pred);
+#endif
+            default: return out + filter_detail::filter(first, n, out, pred);
+        }
+    }
+
+    // Keeps the elements with pred(x) at the front, in order, returns the end of them
+    template <Element T, Predicate P> requires std::is_same_v<typename P::value_type, T>
+    T* compact(T* first, T* last, P pred, Isa isa = filter_isa()){
+        return filter_into(first, last, first, pred, isa);
+    }
+
+    // Contiguous ranges: std::vector, std::array, std::span, C arrays. out is a contiguous iterator
+    template <std::ranges::contiguous_range R, std::contiguous_iterator O, Predicate P>
+        requires std::is_same_v<std::ranges::range_value_t<R>, typename P::value_type> && std::is_same_v<std::iter_value_t<O>, typename P::value_type>
+    O filter_into(R&& r, O out, P pred){
+        auto* p = std::ranges::data(r);
+        auto* o = std::to_address(out);
+        return out + (filter_into(p, p + std::ranges::size(r), o, pred) - o);
+    }
+
+    template <std::ranges::contiguous_range R, Predicate P> requires std::is_same_v<std::ranges::range_value_t<R>, typename P::value_type>
+    auto compact(R&& r, P pred){
+        auto* p = std::ranges::data(r);
+        return std::ranges::begin(r) + (compact(p, p + std::ranges::size(r), pred) - p);
+    }
+
+    // Vector, also when its iterators are the checked (non contiguous) ones
+    template <Element T, typename Alloc, Predicate P> requires std::is_same_v<typename P::value_type, T>
+    typename Vector<T, Alloc>::iterator compact(Vector<T, Alloc>& v, P pred){
+        return v.begin() + (compact(v.data(), v.data() + v.size(), pred) - v.data());
+    }
+}
@@ -0,0 +1,32 @@
+/*
+Generic filter kernels (see filter.hpp), written against V<T> of simd.hpp and Filter<T>.
+Included once per instruction set inside its namespace and #pragma GCC target region, like
+simd_kernels.inl. No #pragma once on purpose.
+*/
+
+// Bit mask of the lanes of v that satisfy the predicate
+template <typename T, Cmp C>
+inline unsigned lanes(const Compare<T, C>& p, typename V<T>::reg v){
+    return Filter<T>::template compare<C>(v, V<T>::set1(p.value));
+}
+template <typename T, typename L, typename R>
+inline unsigned lanes(const And<L, R>& p, typename V<T>::reg v){
+    return lanes<T>(p.left, v) & lanes<T>(p.right, v);
+}
+template <typename T, typename L, typename R>
+inline unsigned lanes(const Or<L, R>& p, typename V<T>::reg v){
+    return lanes<T>(p.left, v) | lanes<T>(p.right, v);
+}
+
+// Writes the elements of in[0, n) with pred(x) packed to out, returns how many. out may be in:
+// a register is loaded before anything is written at or after it
+template <typename T, typename P>
+size_t filter(const T* in, size_t n, T* out, const P& pred){
+    constexpr size_t W = V<T>::width;
+    size_t k = 0, i = 0;
+    for(; i + W <= n; i += W){
+        auto v = V<T>::load(in + i);
+        k += Filter<T>::compress(out + k, v, lanes<T>(pred, v));
+    }
+    return k + filter_detail::filter(in + i, n - i, out + k, pred);
+}
@@ -0,0 +1,351 @@
+/*
+Tests and benchmark for the flat hash map and set (see flat_hash_map.hpp)
+
+The tests replay random inserts, lookups and erases on a FlatHashMap and a std::unordered_map
+and compare them after every step, churn erases to exercise tombstones, and check heterogeneous
+lookup, copies and moves, exceptions (also in the middle of a rehash), values built from an element of the map
+itself and that a TrackingAllocator gets back every byte.
+The benchmark inserts n random 64-bit keys, looks all of them up (hits), looks up n keys that
+aren't there (misses) and erases them all, with FlatHashMap and std::unordered_map, for n = 1K,
+10K, ... up to the largest size, in ns per operation. Small sizes are repeated.
+Arguments: largest number of entries (100000000 needs about 10 GB with std::unordered_map)
+*/
+
+#include "flat_hash_map.hpp"
+#include "tracking_allocator.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <random>
+#include <cassert>
+#include <cstdlib>
+
+// Keys that all land in the same group, to force long probe sequences
+struct BadHash{
+    size_t operator()(int x) const { return static_cast<size_t>(x % 4); }
+};
+
+// std::string keys looked up by std::string_view or const char*
+struct StringHash{
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+template <typename Map, typename Ref>
+bool same(const Map& map, const Ref& ref){
+    if(map.size() != ref.size()) return false;
+    size_t visited = 0;
+    for(const auto& [k, v] : map){
+        auto it = ref.find(k);
+        if(it == ref.end() || it->second != v) return false;
+        ++visited;
+    }
+    return visited == ref.size();
+}
+
+template <typename Hash>
+void test_random_ops(){
+    std::mt19937 gen(7);
+    FlatHashMap<int, int, Hash> map;
+    std::unordered_map<int, int> ref;
+    for(int step=0; step<200000; ++step){
+        int key = static_cast<int>(gen() % 2000);
+        switch(gen() % 6){
+            case 0: {
+                auto [it, inserted] = map.insert({key, step});
+                assert(inserted == ref.insert({key, step}).second && it->first == key);
+                break;
+            }
+            case 1:
+                map.insert_or_assign(key, step);
+                ref.insert_or_assign(key, step);
+                break;
+            case 2:
+                assert(map.erase(key) == ref.erase(key));
+                break;
+            case 3: {
+                auto it = map.find(key);
+                assert((it == map.end()) == !ref.contains(key));
+                if(it != map.end()) assert(it->second == ref[key]);
+                break;
+            }
+            case 4:
+                map[key] += 1;
+                ref[key] += 1;
+                break;
+            default:
+                // Erase through an iterator, the next one is still valid
+                if(auto it = map.find(key); it != map.end()){
+                    auto next = map.erase(it);
+                    ref.erase(key);
+                    assert(next == map.end() || ref.contains(next->first));
+                }
+        }
+        if(step % 10007 == 0) assert(same(map, ref));
+    }
+    assert(same(map, ref));
+    // The load stays under 7/8 and tombstones don't make the table grow forever
+    assert(map.load_factor() <= map.max_load_factor());
+    assert(map.capacity() < 8192);
+}
+
+void test_api(){
+    FlatHashMap<std::string, int> m = {{"one", 1}, {"two", 2}};
+    assert(m.size() == 2 && m.at("two") == 2);
+    auto [it, inserted] = m.try_emplace("three", 3);
+    assert(inserted && it->second == 3);
+    assert(!m.try_emplace("three", 30).second && m["three"] == 3);
+    assert(!m.insert_or_assign("three", 33).second && m.at("three") == 33);
+    assert(m.emplace("four", 4).second && !m.emplace("four", 44).second);
+    assert(m["five"] == 0 && m.size() == 5);
+    assert(m.count("one") == 1 && !m.contains("six"));
+
+    bool threw = false;
+    try{ (void)m.at("six"); }
+    catch(const std::out_of_range&){ threw = true; }
+    assert(threw);
+
+    // Copies are independent, moves leave an empty map
+    auto copy = m;
+    copy["one"] = 100;
+    assert(m["one"] == 1 && copy == copy && !(copy == m));
+    copy["one"] = 1;
+    assert(copy == m);
+    auto moved = std::move(copy);
+    assert(moved == m && copy.empty() && copy.begin() == copy.end());
+    copy = moved;
+    assert(copy == m);
+    moved = std::move(copy);
+    assert(moved == m);
+
+    // Erase everything while iterating
+    for(auto i = m.begin(); i != m.end(); ) i = m.erase(i);
+    assert(m.empty() && m.begin() == m.end());
+    m.clear();
+
+    FlatHashMap<int, int> big;
+    big.reserve(1000);
+    size_t capacity = big.capacity();
+    for(int i=0; i<1000; ++i) big[i] = i;
+    assert(big.capacity() == capacity);
+    big.clear();
+    assert(big.empty() && big.capacity() == capacity && !big.contains(5));
+
+    // Move only values
+    FlatHashMap<int, std::unique_ptr<int>> owners;
+    for(int i=0; i<100; ++i) owners.try_emplace(i, std::make_unique<int>(i));
+    assert(*owners.at(42) == 42);
+}
+
+void test_heterogeneous(){
+    FlatHashMap<std::string, int, StringHash, std::equal_to<>> m;
+    m["apple"] = 1;
+    m["pear"] = 2;
+    std::string_view key = "apple";
+    assert(m.find(key) != m.end() && m.contains("pear") && m.at(std::string_view("pear")) == 2);
+    assert(m.erase(std::string_view("pear")) == 1 && !m.contains("pear"));
+
+    FlatHashSet<std::string, StringHash, std::equal_to<>> s = {"x", "y"};
+    assert(s.contains(std::string_view("x")) && s.count("z") == 0);
+}
+
+void test_set(){
+    FlatHashSet<uint64_t> s;
+    std::unordered_set<uint64_t> ref;
+    std::mt19937_64 gen(3);
+    for(int i=0; i<100000; ++i){
+        uint64_t x = gen() % 50000;
+        if(gen() % 3 == 0) assert(s.erase(x) == ref.erase(x));
+        else assert(s.insert(x).second == ref.insert(x).second);
+    }
+    assert(s.size() == ref.size());
+    for(uint64_t x : s) assert(ref.contains(x));
+    static_assert(std::is_same_v<decltype(*s.begin()), const uint64_t&>); // keys can't be changed in place
+
+    FlatHashSet<int> small = {3, 1, 2, 3};
+    assert(small.size() == 3);
+    assert(small == (FlatHashSet<int>{1, 2, 3}));
+}
+
+// Throws on the nth construction
+struct Fragile{
+    static inline int countdown = -1;
+    int value;
+    Fragile(int v) : value(v){ if(--countdown == 0) throw std::runtime_error("construction failed"); }
+    Fragile(const Fragile&) = default;
+};
+
+void test_exceptions(){
+    FlatHashMap<int, Fragile> m;
+    for(int i=0; i<10; ++i) m.try_emplace(i, i);
+    Fragile::countdown = 1;
+    bool threw = false;
+    try{ m.try_emplace(10, 10); }
+    catch(const std::runtime_error&){ threw = true; }
+    assert(threw && m.size() == 10 && !m.contains(10));
+    Fragile::countdown = -1;
+    m.try_emplace(10, 10);
+    assert(m.size() == 11 && m.at(10).value == 10);
+}
+
+// Key whose copies throw once the countdown reaches zero
+struct FlakyKey{
+    static inline int copies_left = -1; // -1: never throw
+    static inline int live = 0;
+    int value;
+    FlakyKey(int v) : value(v){ ++live; }
+    FlakyKey(const FlakyKey& other) : value(other.value){
+        if(copies_left == 0) throw std::runtime_error("copy failed");
+        if(copies_left > 0) --copies_left;
+        ++live;
+    }
+    ~FlakyKey(){ --live; }
+    bool operator==(const FlakyKey& other) const { return value == other.value; }
+};
+
+struct FlakyKeyHash{
+    size_t operator()(const FlakyKey& k) const { return std::hash<int>{}(k.value); }
+};
+
+void test_rehash_exceptions(){
+    {
+        FlatHashMap<FlakyKey, std::string, FlakyKeyHash> m;
+        m.reserve(14);
+        while(m.size() < flat_detail::growth(m.capacity())){
+            int i = static_cast<int>(m.size());
+            m.try_emplace(FlakyKey(i), std::to_string(i));
+        }
+        // The next insert rehashes, the 5th key copy fails: the old table is untouched
+        size_t size = m.size(), capacity = m.capacity();
+        int live = FlakyKey::live;
+        FlakyKey::copies_left = 4;
+        bool threw = false;
+        try{ m.try_emplace(FlakyKey(100), "new"); }
+        catch(const std::runtime_error&){ threw = true; }
+        FlakyKey::copies_left = -1;
+        assert(threw && m.size() == size && m.capacity() == capacity && FlakyKey::live == live);
+        size_t visited = 0;
+        for(const auto& [k, v] : m){
+            assert(v == std::to_string(k.value));
+            ++visited;
+        }
+        assert(visited == size && !m.contains(FlakyKey(100)));
+        for(int i=0; i<static_cast<int>(size); ++i) assert(m.at(FlakyKey(i)) == std::to_string(i));
+
+        // Without the failure it goes through
+        m.try_emplace(FlakyKey(100), "new");
+        assert(m.size() == size + 1 && m.capacity() > capacity && m.at(FlakyKey(100)) == "new");
+    }
+    assert(FlakyKey::live == 0);
+}
+
+// The value is built from an element of the map itself, right when the insert rehashes
+void test_aliasing(){
+    FlatHashMap<int, std::string> m;
+    m.reserve(14);
+    while(m.size() < flat_detail::growth(m.capacity())){
+        int i = static_cast<int>(m.size());
+        m[i] = "value " + std::to_string(i);
+    }
+    size_t capacity = m.capacity();
+    m.try_emplace(100, m.at(3));
+    assert(m.capacity() > capacity && m.at(100) == "value 3");
+
+    while(m.size() < flat_detail::growth(m.capacity())) m[static_cast<int>(m.size()) + 1000] = "filler";
+    capacity = m.capacity();
+    m.insert_or_assign(200, m.at(4));
+    assert(m.capacity() > capacity && m.at(200) == "value 4");
+}
+
+void test_allocator(){
+    using Alloc = TrackingAllocator<std::pair<const int, std::string>>;
+    {
+        FlatHashMap<int, std::string, std::hash<int>, std::equal_to<int>, Alloc> m(0, {}, {}, Alloc("flat_hash_map"));
+        for(int i=0; i<10000; ++i) m[i] = std::to_string(i);
+        for(int i=0; i<10000; i+=2) m.erase(i);
+        auto copy = m;
+        assert(copy.size() == 5000 && copy.at(9999) == "9999");
+        assert(tracking::stats("flat_hash_map").live_bytes() > 0);
+    }
+    // Slots and control bytes both go through the rebound allocator
+    assert(tracking::stats("flat_hash_map").live_bytes() == 0);
+    assert(tracking::stats("flat_hash_map").allocations() > 2);
+}
+
+template <typename F>
+double time_ms(F f){
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// ns per operation for insert, find hit, find miss, erase
+template <typename Map>
+std::vector<double> run(const std::vector<uint64_t>& keys, const std::vector<uint64_t>& missing, size_t reps){
+    double insert = 0, hit = 0, miss = 0, erase = 0;
+    volatile size_t sink = 0;
+    for(size_t r=0; r<reps; ++r){
+        Map map;
+        insert += time_ms([&]{ for(uint64_t k : keys) map[k] = k; });
+        hit += time_ms([&]{
+            size_t found = 0;
+            for(uint64_t k : keys) found += map.find(k) != map.end();
+            sink = found;
+        });
+        miss += time_ms([&]{
+            size_t found = 0;
+            for(uint64_t k : missing) found += map.find(k) != map.end();
+            sink = found;
+        });
+        erase += time_ms([&]{ for(uint64_t k : keys) map.erase(k); });
+        assert(map.empty());
+    }
+    double per = 1e6 / static_cast<double>(keys.size() * reps);
+    return {insert * per, hit * per, miss * per, erase * per};
+}
+
+void Benchmark(size_t max_n){
+    std::cout << "\n" << std::left << std::setw(12) << "entries" << std::setw(16) << "map" << std::right
+              << std::setw(10) << "insert" << std::setw(10) << "find hit" << std::setw(10) << "find miss" << std::setw(10) << "erase"
+              << "   (ns per operation)\n";
+    std::mt19937_64 gen(42);
+    for(size_t n=1000; n<=max_n; n*=10){
+        // Odd keys are in the map, even ones are misses
+        std::vector<uint64_t> keys(n), missing(n);
+        for(size_t i=0; i<n; ++i){
+            keys[i] = gen() | 1;
+            missing[i] = gen() & ~uint64_t(1);
+        }
+        size_t reps = std::max<size_t>(1, 1000000 / n);
+        auto flat = run<FlatHashMap<uint64_t, uint64_t>>(keys, missing, reps);
+        auto node = run<std::unordered_map<uint64_t, uint64_t>>(keys, missing, reps);
+        for(auto [name, t] : {std::pair{"FlatHashMap", &flat}, std::pair{"unordered_map", &node}}){
+            std::cout << std::left << std::setw(12) << n << std::setw(16) << name << std::right << std::fixed << std::setprecision(1);
+            for(double x : *t) std::cout << std::setw(10) << x;
+            std::cout << "\n";
+        }
+        std::cout.unsetf(std::ios::fixed);
+    }
+}
+
+int main(int argc, char** argv){
+    test_random_ops<std::hash<int>>();
+    test_random_ops<BadHash>();
+    test_api();
+    test_heterogeneous();
+    test_set();
+    test_exceptions();
+    test_rehash_exceptions();
+    test_aliasing();
+    test_allocator();
+    std::cout << "All flat hash map tests passed! Groups of " << flat_detail::Group::width << " control bytes\n";
+
+    size_t max_n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    Benchmark(max_n);
+}
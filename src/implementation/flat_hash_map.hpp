@@ -0,0 +1,715 @@
+#pragma once
+/*
+Swiss table: flat (open addressing) hash map and set with SIMD probing
+
+    FlatHashMap<std::string, int> counts;
+    ++counts["apple"];
+    counts.try_emplace("pear", 3);
+    if(auto it = counts.find("apple"); it != counts.end()) it->second = 0;
+    counts.erase("pear");
+    FlatHashSet<uint64_t> seen = {1, 2, 3};
+
+Drop-in for most uses of std::unordered_map / std::unordered_set (see src/stl_containers.cpp),
+which allocate a node per element and follow a pointer (a cache miss) to reach it. Here the
+elements live in one array of slots, next to a parallel array of one control byte per slot:
+Empty, Deleted, or for a full slot the low 7 bits of its hash (H2). A lookup uses the other bits
+(H1) to pick a position, loads the 16 control bytes from there into an SSE2 register and compares
+all of them with H2 in one instruction. Only the slots whose byte matches (1 in 128 false positives)
+have their key compared, so a lookup usually touches one group of control bytes and one slot. If
+the group has an Empty byte the key isn't in the table, otherwise probing moves to the next group
+(quadratic steps of 16). Without SSE2 a portable group of 8 bytes is matched with 64-bit arithmetic.
+
+The capacity is a power of 2 minus 1, with at most 7/8 of the slots full. The first 15 control bytes
+are copied after the end, so a group can be loaded at any position without wrapping. Erasing
+leaves a Deleted marker (a tombstone, so probes for other keys keep going) only if the slot may be
+in the middle of a probe sequence: if the 16 bytes around it contain an Empty byte no probe ever
+found that window full, so the slot becomes Empty again. Tombstones are dropped at the next rehash.
+
+Differences from std: iterators and references are invalidated by any rehash (insertion past the
+load limit, reserve), like Vector's, and erase doesn't invalidate other iterators. Map elements are
+std::pair<const K, V>, so a rehash copies them unless that move can't throw (reserve() up front
+avoids rehashing). If a copy throws the rehash is undone and the table is left as it was.
+Heterogeneous lookup: if both Hash and Eq have is_transparent, find / contains / count / at / erase
+take anything they accept, e.g. a std::string_view for std::string keys without building a string.
+The allocator is rebound for the slots and the control bytes (see tracking_allocator.hpp).
+*/
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace flat_detail{
+    using ctrl_t = int8_t;
+    constexpr ctrl_t Empty = -128;   // 0b10000000
+    constexpr ctrl_t Deleted = -2;   // 0b11111110
+    constexpr ctrl_t Sentinel = -1;  // 0b11111111, after the last slot. Full slots are 0b0xxxxxxx
+
+    // Positions of the set bits of a group comparison, lowest first. Bits has one bit per
+    // control byte (SSE2, Shift 0) or one per byte of a 64-bit word (portable, Shift 3)
+    template <typename Bits, int Width, int Shift>
+    class BitMask{
+    public:
+        explicit BitMask(Bits bits) : bits_(bits) {}
+        explicit operator bool() const { return bits_ != 0; }
+        int lowest() const { return std::countr_zero(bits_) >> Shift; }
+        int leading_zeros() const {
+            constexpr int unused = static_cast<int>(sizeof(Bits) * 8) - (Width << Shift);
+            return (std::countl_zero(bits_) - unused) >> Shift;
+        }
+
+        // for(int i : mask)
+        int operator*() const { return lowest(); }
+        BitMask& operator++(){ bits_ &= bits_ - 1; return *this; }
+        BitMask begin() const { return *this; }
+        BitMask end() const { return BitMask(0); }
+        bool operator!=(const BitMask& other) const { return bits_ != other.bits_; }
+
+    private:
+        Bits bits_;
+    };
+
+#if defined(__SSE2__) && !defined(FLAT_HASH_PORTABLE)
+    struct Group{
+        static constexpr size_t width = 16;
+        using Mask = BitMask<uint16_t, 16, 0>;
+
+        explicit Group(const ctrl_t* p) : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) {}
+        Mask match(ctrl_t h2) const { return bits(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2))); }
+        Mask empty() const { return match(Empty); }
+        // Empty and Deleted are the bytes below Sentinel (signed)
+        Mask empty_or_deleted() const { return bits(_mm_cmpgt_epi8(_mm_set1_epi8(Sentinel), ctrl)); }
+
+        static Mask bits(__m128i r){ return Mask(static_cast<uint16_t>(_mm_movemask_epi8(r))); }
+        __m128i ctrl;
+    };
+#else
+    // 8 control bytes in a 64-bit word (little endian), the result has the top bit of each matching byte
+    struct Group{
+        static constexpr size_t width = 8;
+        using Mask = BitMask<uint64_t, 8, 3>;
+        static constexpr uint64_t lsbs = 0x0101010101010101ull;
+        static constexpr uint64_t msbs = 0x8080808080808080ull;
+
+        explicit Group(const ctrl_t* p){ std::memcpy(&ctrl, p, sizeof(ctrl)); }
+        // Bytes equal to h2 become zero; the zero byte test can also flag a byte above a real match
+        // (a false positive, harmless since the key is compared anyway)
+        Mask match(ctrl_t h2) const {
+            uint64_t x = ctrl ^ (lsbs * static_cast<uint8_t>(h2));
+            return Mask((x - lsbs) & ~x & msbs);
+        }
+        // Empty is the only byte with the top bit set and bit 1 clear, Empty and Deleted the only ones with bit 0 clear
+        Mask empty() const { return Mask(ctrl & ~(ctrl << 6) & msbs); }
+        Mask empty_or_deleted() const { return Mask(ctrl & ~(ctrl << 7) & msbs); }
+
+        uint64_t ctrl;
+    };
+#endif
+
+    // std::hash of integers is the identity: mix all bits into the low ones (H1) and the top ones
+    inline size_t mix(size_t h){
+        __uint128_t m = static_cast<__uint128_t>(h) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(m) ^ static_cast<size_t>(m >> 64);
+    }
+    inline size_t h1(size_t hash){ return hash >> 7; }
+    inline ctrl_t h2(size_t hash){ return static_cast<ctrl_t>(hash & 0x7F); }
+
+    // Groups visited by a lookup: offsets h1, h1 + 16, h1 + 48, h1 + 96... modulo the capacity
+    struct Probe{
+        Probe(size_t hash, size_t mask) : mask(mask), offset(h1(hash) & mask) {}
+        size_t slot(int i) const { return (offset + static_cast<size_t>(i)) & mask; }
+        void next(){
+            index += Group::width;
+            offset = (offset + index) & mask;
+        }
+        size_t mask, offset, index = 0;
+    };
+
+    // Full slots allowed in a table of capacity slots: 7/8, leaving an Empty byte in every probe
+    inline size_t growth(size_t capacity){
+        if(Group::width == 8 && capacity == 7) return 6;
+        return capacity - capacity / 8;
+    }
+
+    template <typename Hash, typename Eq>
+    concept Transparent = requires { typename Hash::is_transparent; typename Eq::is_transparent; };
+
+    // Lookup argument type: K (deduced, an alias template that is just K) or always Key
+    template <bool Transparent>
+    struct KeyArg{ template <typename K, typename Key> using type = Key; };
+    template <>
+    struct KeyArg<true>{ template <typename K, typename Key> using type = K; };
+
+    template <typename K, typename V>
+    struct MapPolicy{
+        using key_type = K;
+        using value_type = std::pair<const K, V>;
+        static constexpr bool constant_iterators = false;
+        static const K& key(const value_type& v){ return v.first; }
+    };
+
+    template <typename K>
+    struct SetPolicy{
+        using key_type = K;
+        using value_type = K;
+        static constexpr bool constant_iterators = true;
+        static const K& key(const value_type& v){ return v; }
+    };
+
+    // The table shared by FlatHashMap and FlatHashSet
+    template <typename Policy, typename Hash, typename Eq, typename Alloc>
+    class RawTable{
+    protected:
+        using SlotTraits = typename std::allocator_traits<Alloc>::template rebind_traits<typename Policy::value_type>;
+        using SlotAlloc = typename SlotTraits::allocator_type;
+        using CtrlTraits = typename std::allocator_traits<Alloc>::template rebind_traits<ctrl_t>;
+        using CtrlAlloc = typename CtrlTraits::allocator_type;
+
+        // K when lookups are heterogeneous, key_type otherwise
+        template <typename K>
+        using key_arg = typename KeyArg<Transparent<Hash, Eq>>::template type<K, typename Policy::key_type>;
+
+    public:
+        using key_type = typename Policy::key_type;
+        using value_type = typename Policy::value_type;
+        using size_type = size_t;
+        using difference_type = std::ptrdiff_t;
+        using hasher = Hash;
+        using key_equal = Eq;
+        using allocator_type = Alloc;
+        using reference = value_type&;
+        using const_reference = const value_type&;
+
+        template <bool Const>
+        class Iterator{
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = RawTable::value_type;
+            using difference_type = std::ptrdiff_t;
+            using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+            using reference = std::conditional_t<Const, const value_type&, value_type&>;
+
+            Iterator() = default;
+            // iterator -> const_iterator
+            template <bool OtherConst> requires (Const && !OtherConst)
+            Iterator(const Iterator<OtherConst>& other) : ctrl_(other.ctrl_), slot_(other.slot_) {}
+
+            reference operator*() const { return *slot_; }
+            pointer operator->() const { return slot_; }
+            Iterator& operator++(){
+                ++ctrl_;
+                ++slot_;
+                skip_empty();
+                return *this;
+            }
+            Iterator operator++(int){ auto old = *this; ++*this; return old; }
+            friend bool operator==(const Iterator& a, const Iterator& b){ return a.ctrl_ == b.ctrl_; }
+
+        private:
+            friend class RawTable;
+            template <bool> friend class Iterator;
+            Iterator(const ctrl_t* ctrl, value_type* slot) : ctrl_(ctrl), slot_(slot) {}
+            // Empty and Deleted are below Sentinel, which stops the loop at the end
+            void skip_empty(){
+                while(*ctrl_ < Sentinel){
+                    ++ctrl_;
+                    ++slot_;
+                }
+            }
+
+            const ctrl_t* ctrl_ = nullptr;
+            value_type* slot_ = nullptr;
+        };
+
+        using const_iterator = Iterator<true>;
+        using iterator = std::conditional_t<Policy::constant_iterators, const_iterator, Iterator<false>>;
+
+        RawTable() : RawTable(0) {}
+        explicit RawTable(size_t bucket_count, const Hash& hash = Hash(), const Eq& eq = Eq(), const Alloc& alloc = Alloc())
+            : hash_(hash), eq_(eq), alloc_(alloc) {
+            if(bucket_count > 0) reserve(bucket_count);
+        }
+        explicit RawTable(const Alloc& alloc) : RawTable(0, Hash(), Eq(), alloc) {}
+        template <std::input_iterator It>
+        RawTable(It first, It last, size_t bucket_count = 0, const Hash& hash = Hash(), const Eq& eq = Eq(), const Alloc& alloc = Alloc())
+            : RawTable(bucket_count, hash, eq, alloc) {
+            insert(first, last);
+        }
+        RawTable(std::initializer_list<value_type> list, size_t bucket_count = 0, const Hash& hash = Hash(), const Eq& eq = Eq(), const Alloc& alloc = Alloc())
+            : RawTable(list.begin(), list.end(), bucket_count, hash, eq, alloc) {}
+
+        RawTable(const RawTable& other)
+            : RawTable(other, SlotTraits::select_on_container_copy_construction(other.alloc_)) {}
+        RawTable(const RawTable& other, const Alloc& alloc) : RawTable(0, other.hash_, other.eq_, alloc) {
+            copy_from(other);
+        }
+        RawTable(RawTable&& other) noexcept
+            : ctrl_(std::exchange(other.ctrl_, nullptr)), slots_(std::exchange(other.slots_, nullptr)),
+              size_(std::exchange(other.size_, 0)), capacity_(std::exchange(other.capacity_, 0)),
+              growth_left_(std::exchange(other.growth_left_, 0)),
+              hash_(std::move(other.hash_)), eq_(std::move(other.eq_)), alloc_(std::move(other.alloc_)) {}
+
+        RawTable& operator=(const RawTable& other){
+            if(this != &other){
+                clear();
+                hash_ = other.hash_;
+                eq_ = other.eq_;
+                copy_from(other);
+            }
+            return *this;
+        }
+        RawTable& operator=(RawTable&& other) noexcept(SlotTraits::propagate_on_container_move_assignment::value || SlotTraits::is_always_equal::value){
+            if(this == &other) return *this;
+            if constexpr (SlotTraits::propagate_on_container_move_assignment::value || SlotTraits::is_always_equal::value){
+                release();
+                if constexpr (SlotTraits::propagate_on_container_move_assignment::value) alloc_ = std::move(other.alloc_);
+                steal(other);
+            }
+            else if(alloc_ == other.alloc_){
+                release();
+                steal(other);
+            }
+            else{
+                // Different memory: move the elements one by one
+                clear();
+                hash_ = other.hash_;
+                eq_ = other.eq_;
+                reserve(other.size_);
+                for(auto& v : other) insert_unique(std::move(const_cast<value_type&>(v)));
+                other.clear();
+            }
+            return *this;
+        }
+        RawTable& operator=(std::initializer_list<value_type> list){
+            clear();
+            insert(list);
+            return *this;
+        }
+
+        ~RawTable(){ release(); }
+
+        // Iterators
+        iterator begin(){
+            if(size_ == 0) return end();
+            iterator it(ctrl_, slots_);
+            it.skip_empty();
+            return it;
+        }
+        iterator end(){ return iterator(ctrl_ + capacity_, slots_ + capacity_); }
+        const_iterator begin() const { return const_cast<RawTable*>(this)->begin(); }
+        const_iterator end() const { return const_cast<RawTable*>(this)->end(); }
+        const_iterator cbegin() const { return begin(); }
+        const_iterator cend() const { return end(); }
+
+        // Capacity
+        bool empty() const noexcept { return size_ == 0; }
+        size_t size() const noexcept { return size_; }
+        size_t capacity() const noexcept { return capacity_; }
+        float load_factor() const noexcept { return capacity_ ? static_cast<float>(size_) / static_cast<float>(capacity_) : 0.0f; }
+        static constexpr float max_load_factor() noexcept { return 7.0f / 8.0f; }
+
+        // Room for n elements without rehashing
+        void reserve(size_t n){
+            if(n <= size_ + growth_left_) return;
+            size_t capacity = 1;
+            while(growth(capacity) < n) capacity = capacity * 2 + 1;
+            resize(capacity);
+        }
+
+        // Destroys the elements, keeps the capacity
+        void clear() noexcept {
+            if(capacity_ == 0) return;
+            destroy_elements();
+            reset_ctrl();
+            size_ = 0;
+            growth_left_ = growth(capacity_);
+        }
+
+        void swap(RawTable& other) noexcept {
+            using std::swap;
+            swap(ctrl_, other.ctrl_);
+            swap(slots_, other.slots_);
+            swap(size_, other.size_);
+            swap(capacity_, other.capacity_);
+            swap(growth_left_, other.growth_left_);
+            swap(hash_, other.hash_);
+            swap(eq_, other.eq_);
+            if constexpr (SlotTraits::propagate_on_container_swap::value) swap(alloc_, other.alloc_);
+        }
+        friend void swap(RawTable& a, RawTable& b) noexcept { a.swap(b); }
+
+        // Insertion: nothing happens if the key is already there (the iterator points to it)
+        std::pair<iterator, bool> insert(const value_type& v){ return emplace_value(v); }
+        std::pair<iterator, bool> insert(value_type&& v){ return emplace_value(std::move(v)); }
+        template <std::input_iterator It>
+        void insert(It first, It last){
+            if constexpr (std::forward_iterator<It>) reserve(size_ + static_cast<size_t>(std::distance(first, last)));
+            for(; first != last; ++first) insert(*first);
+        }
+        void insert(std::initializer_list<value_type> list){ insert(list.begin(), list.end()); }
+
+        // Builds the element first to find its key
+        template <typename... Args>
+        std::pair<iterator, bool> emplace(Args&&... args){
+            return emplace_value(value_type(std::forward<Args>(args)...));
+        }
+
+        // Lookup
+        template <typename K = key_type>
+        iterator find(const key_arg<K>& key){
+            size_t index = find_index(key);
+            return index == capacity_ ? end() : iterator_at(index);
+        }
+        template <typename K = key_type>
+        const_iterator find(const key_arg<K>& key) const { return const_cast<RawTable*>(this)->find(key); }
+        template <typename K = key_type>
+        bool contains(const key_arg<K>& key) const { return find_index(key) != capacity_; }
+        template <typename K = key_type>
+        size_t count(const key_arg<K>& key) const { return contains(key) ? 1 : 0; }
+
+        // Erasure: other iterators stay valid
+        template <typename K = key_type>
+        size_t erase(const key_arg<K>& key){
+            size_t index = find_index(key);
+            if(index == capacity_) return 0;
+            erase_at(index);
+            return 1;
+        }
+        // Returns the iterator after pos
+        iterator erase(const_iterator pos){
+            size_t index = static_cast<size_t>(pos.ctrl_ - ctrl_);
+            erase_at(index);
+            iterator next(ctrl_ + index, slots_ + index);
+            next.skip_empty();
+            return next;
+        }
+        iterator erase(iterator pos) requires (!std::is_same_v<iterator, const_iterator>) { return erase(const_iterator(pos)); }
+
+        hasher hash_function() const { return hash_; }
+        key_equal key_eq() const { return eq_; }
+        allocator_type get_allocator() const { return allocator_type(alloc_); }
+
+        // Same elements (for maps also the same values), in any order
+        friend bool operator==(const RawTable& a, const RawTable& b){
+            if(a.size_ != b.size_) return false;
+            for(const auto& v : a){
+                auto it = b.find(Policy::key(v));
+                if(it == b.end() || !(*it == v)) return false;
+            }
+            return true;
+        }
+
+    protected:
+        iterator iterator_at(size_t index){ return iterator(ctrl_ + index, slots_ + index); }
+
+        template <typename K>
+        size_t hash_of(const K& key) const { return mix(hash_(key)); }
+
+        // Index of the slot with key, or capacity_
+        template <typename K>
+        size_t find_index(const K& key) const { return size_ == 0 ? capacity_ : find_index(key, hash_of(key)); }
+        template <typename K>
+        size_t find_index(const K& key, size_t hash) const {
+            if(size_ == 0) return capacity_;
+            ctrl_t tag = h2(hash);
+            Probe probe(hash, capacity_);
+            for(;;){
+                Group group(ctrl_ + probe.offset);
+                for(int i : group.match(tag)){
+                    size_t index = probe.slot(i);
+                    if(eq_(Policy::key(slots_[index]), key)) return index;
+                }
+                if(group.empty()) return capacity_;
+                probe.next();
+            }
+        }
+
+        // The slot with key (false) or a new slot marked full for it (true), to be constructed by the caller
+        template <typename K>
+        std::pair<size_t, bool> find_or_prepare_insert(const K& key){
+            size_t hash = hash_of(key);
+            size_t index = find_index(key, hash);
+            if(index != capacity_) return {index, false};
+            return {prepare_insert(hash), true};
+        }
+
+        // Whether prepare_insert(hash) rehashes, freeing the current elements
+        bool insert_grows(size_t hash) const {
+            return capacity_ == 0 || (growth_left_ == 0 && ctrl_[find_first_non_full(hash)] != Deleted);
+        }
+
+        size_t prepare_insert(size_t hash){
+            size_t target = capacity_ ? find_first_non_full(hash) : 0;
+            // Reusing a tombstone doesn't take any of the growth left
+            if(capacity_ == 0 || (growth_left_ == 0 && ctrl_[target] != Deleted)){
+                grow();
+                target = find_first_non_full(hash);
+            }
+            growth_left_ -= ctrl_[target] == Empty ? 1 : 0;
+            set_ctrl(target, h2(hash));
+            ++size_;
+            return target;
+        }
+
+        // Constructs the element in the slot from prepare_insert, which is released if that throws
+        template <typename... Args>
+        void construct_at(size_t index, Args&&... args){
+            try{
+                SlotTraits::construct(alloc_, slots_ + index, std::forward<Args>(args)...);
+            }
+            catch(...){
+                --size_;
+                erase_ctrl(index);
+                throw;
+            }
+        }
+
+        template <typename V>
+        std::pair<iterator, bool> emplace_value(V&& v){
+            auto [index, inserted] = find_or_prepare_insert(Policy::key(v));
+            if(inserted) construct_at(index, std::forward<V>(v));
+            return {iterator_at(index), inserted};
+        }
+
+        // For elements known not to be in the table (copies, rehashing). The slot is marked full
+        // only once the element is built, so a throwing constructor leaves the table consistent
+        template <typename V>
+        void insert_unique(V&& v){
+            size_t hash = hash_of(Policy::key(v));
+            size_t target = find_first_non_full(hash);
+            SlotTraits::construct(alloc_, slots_ + target, std::forward<V>(v));
+            growth_left_ -= ctrl_[target] == Empty ? 1 : 0;
+            set_ctrl(target, h2(hash));
+            ++size_;
+        }
+
+        size_t find_first_non_full(size_t hash) const {
+            Probe probe(hash, capacity_);
+            for(;;){
+                auto mask = Group(ctrl_ + probe.offset).empty_or_deleted();
+                if(mask) return probe.slot(mask.lowest());
+                probe.next();
+            }
+        }
+
+        // The byte and its copy after the end (the first width - 1 bytes are mirrored)
+        void set_ctrl(size_t index, ctrl_t c){
+            constexpr size_t cloned = Group::width - 1;
+            ctrl_[index] = c;
+            ctrl_[((index - cloned) & capacity_) + (cloned & capacity_)] = c;
+        }
+
+        void erase_at(size_t index){
+            SlotTraits::destroy(alloc_, slots_ + index);
+            --size_;
+            erase_ctrl(index);
+        }
+
+        // Empty if no probe can have seen a full window around index, Deleted otherwise
+        void erase_ctrl(size_t index){
+            size_t before = (index - Group::width) & capacity_;
+            auto empty_after = Group(ctrl_ + index).empty();
+            auto empty_before = Group(ctrl_ + before).empty();
+            bool never_full = empty_before && empty_after
+                && static_cast<size_t>(empty_after.lowest() + empty_before.leading_zeros()) < Group::width;
+            set_ctrl(index, never_full ? Empty : Deleted);
+            growth_left_ += never_full ? 1 : 0;
+        }
+
+        // Full table: double it, unless it is mostly tombstones, then just rehash in place
+        void grow(){
+            if(capacity_ == 0) resize(1);
+            else if(size_ <= capacity_ / 32 * 25) resize(capacity_);
+            else resize(capacity_ * 2 + 1);
+        }
+
+        // Strong guarantee: the elements are copied unless their move can't throw (map elements
+        // have a const key, so usually they are copied), and if one throws the new arrays are
+        // released and the old table is left as it was
+        void resize(size_t capacity){
+            ctrl_t* old_ctrl = ctrl_;
+            value_type* old_slots = slots_;
+            size_t old_capacity = capacity_;
+            size_t old_size = size_;
+            size_t old_growth_left = growth_left_;
+
+            CtrlAlloc ctrl_alloc(alloc_);
+            ctrl_ = CtrlTraits::allocate(ctrl_alloc, capacity + Group::width);
+            try{
+                slots_ = SlotTraits::allocate(alloc_, capacity);
+            }
+            catch(...){
+                CtrlTraits::deallocate(ctrl_alloc, ctrl_, capacity + Group::width);
+                ctrl_ = old_ctrl;
+                throw;
+            }
+            capacity_ = capacity;
+            reset_ctrl();
+            size_ = 0;
+            try{
+                for(size_t i=0; i<old_capacity; ++i){
+                    if(old_ctrl[i] >= 0) insert_unique(std::move_if_noexcept(old_slots[i]));
+                }
+            }
+            catch(...){
+                destroy_elements();
+                deallocate(ctrl_, slots_, capacity_);
+                ctrl_ = old_ctrl;
+                slots_ = old_slots;
+                size_ = old_size;
+                capacity_ = old_capacity;
+                growth_left_ = old_growth_left;
+                throw;
+            }
+            growth_left_ = growth(capacity) - size_;
+
+            if(old_capacity > 0){
+                if constexpr (!std::is_trivially_destructible_v<value_type>){
+                    for(size_t i=0; i<old_capacity; ++i){
+                        if(old_ctrl[i] >= 0) SlotTraits::destroy(alloc_, old_slots + i);
+                    }
+                }
+                deallocate(old_ctrl, old_slots, old_capacity);
+            }
+        }
+
+        void reset_ctrl(){
+            std::memset(ctrl_, static_cast<uint8_t>(Empty), capacity_ + Group::width);
+            ctrl_[capacity_] = Sentinel;
+        }
+
+        void copy_from(const RawTable& other){
+            reserve(other.size_);
+            for(const auto& v : other) insert_unique(v);
+        }
+
+        void steal(RawTable& other){
+            ctrl_ = std::exchange(other.ctrl_, nullptr);
+            slots_ = std::exchange(other.slots_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            capacity_ = std::exchange(other.capacity_, 0);
+            growth_left_ = std::exchange(other.growth_left_, 0);
+            hash_ = std::move(other.hash_);
+            eq_ = std::move(other.eq_);
+        }
+
+        void destroy_elements(){
+            if constexpr (!std::is_trivially_destructible_v<value_type>){
+                for(size_t i=0; i<capacity_; ++i){
+                    if(ctrl_[i] >= 0) SlotTraits::destroy(alloc_, slots_ + i);
+                }
+            }
+        }
+
+        void deallocate(ctrl_t* ctrl, value_type* slots, size_t capacity){
+            CtrlAlloc ctrl_alloc(alloc_);
+            CtrlTraits::deallocate(ctrl_alloc, ctrl, capacity + Group::width);
+            SlotTraits::deallocate(alloc_, slots, capacity);
+        }
+
+        void release(){
+            if(capacity_ == 0) return;
+            destroy_elements();
+            deallocate(ctrl_, slots_, capacity_);
+            ctrl_ = nullptr;
+            slots_ = nullptr;
+            size_ = capacity_ = growth_left_ = 0;
+        }
+
+        ctrl_t* ctrl_ = nullptr;       // capacity_ + 1 (Sentinel) + width - 1 (mirrored) bytes
+        value_type* slots_ = nullptr;
+        size_t size_ = 0;
+        size_t capacity_ = 0;          // 0 or 2^k - 1
+        size_t growth_left_ = 0;       // Empty slots that may still be filled before a rehash
+        [[no_unique_address]] Hash hash_;
+        [[no_unique_address]] Eq eq_;
+        [[no_unique_address]] SlotAlloc alloc_;
+    };
+}
+
+template <typename K, typename V, typename Hash = std::hash<K>, typename Eq = std::equal_to<K>,
+          typename Alloc = std::allocator<std::pair<const K, V>>>
+class FlatHashMap : public flat_detail::RawTable<flat_detail::MapPolicy<K, V>, Hash, Eq, Alloc>{
+    using Base = flat_detail::RawTable<flat_detail::MapPolicy<K, V>, Hash, Eq, Alloc>;
+    template <typename Key>
+    using key_arg = typename Base::template key_arg<Key>;
+
+public:
+    using mapped_type = V;
+    using typename Base::iterator;
+    using typename Base::const_iterator;
+    using Base::Base;
+    using Base::operator=;
+
+    // Constructs the value from args only if the key isn't there
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args){ return try_emplace_impl(key, std::forward<Args>(args)...); }
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args){ return try_emplace_impl(std::move(key), std::forward<Args>(args)...); }
+
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const K& key, M&& value){ return insert_or_assign_impl(key, std::forward<M>(value)); }
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(K&& key, M&& value){ return insert_or_assign_impl(std::move(key), std::forward<M>(value)); }
+
+    V& operator[](const K& key){ return try_emplace(key).first->second; }
+    V& operator[](K&& key){ return try_emplace(std::move(key)).first->second; }
+
+    template <typename Key = K>
+    V& at(const key_arg<Key>& key){
+        auto it = this->find(key);
+        if(it == this->end()) throw std::out_of_range("FlatHashMap::at: key not found");
+        return it->second;
+    }
+    template <typename Key = K>
+    const V& at(const key_arg<Key>& key) const { return const_cast<FlatHashMap*>(this)->at(key); }
+
+private:
+    // args may refer to an element of the map (m.try_emplace(k, m.at(j))): if the insert rehashes,
+    // the value is built first, before the old slots are freed
+    template <typename Key, typename... Args>
+    std::pair<iterator, bool> try_emplace_impl(Key&& key, Args&&... args){
+        size_t hash = this->hash_of(key);
+        size_t index = this->find_index(key, hash);
+        if(index != this->capacity_) return {this->iterator_at(index), false};
+        if(this->insert_grows(hash)){
+            V value(std::forward<Args>(args)...);
+            index = this->prepare_insert(hash);
+            this->construct_at(index, std::piecewise_construct, std::forward_as_tuple(std::forward<Key>(key)),
+                               std::forward_as_tuple(std::move(value)));
+        }
+        else{
+            index = this->prepare_insert(hash);
+            this->construct_at(index, std::piecewise_construct, std::forward_as_tuple(std::forward<Key>(key)),
+                               std::forward_as_tuple(std::forward<Args>(args)...));
+        }
+        return {this->iterator_at(index), true};
+    }
+
+    template <typename Key, typename M>
+    std::pair<iterator, bool> insert_or_assign_impl(Key&& key, M&& value){
+        auto result = try_emplace_impl(std::forward<Key>(key), std::forward<M>(value));
+        if(!result.second) result.first->second = std::forward<M>(value);
+        return result;
+    }
+};
+
+template <typename K, typename Hash = std::hash<K>, typename Eq = std::equal_to<K>, typename Alloc = std::allocator<K>>
+class FlatHashSet : public flat_detail::RawTable<flat_detail::SetPolicy<K>, Hash, Eq, Alloc>{
+    using Base = flat_detail::RawTable<flat_detail::SetPolicy<K>, Hash, Eq, Alloc>;
+
+public:
+    using Base::Base;
+    using Base::operator=;
+};
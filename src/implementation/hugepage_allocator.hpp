@@ -0,0 +1,144 @@
+#pragma once
+/*
+Linux allocator for very large buffers, usable as Vector<T, HugePageAllocator<T>>
+
+Requests of at least hugepage::MmapThreshold bytes are mapped directly with mmap, rounded up to
+a multiple of 2MB and aligned to a 2MB boundary, then marked with madvise(MADV_HUGEPAGE) so the
+kernel backs them with transparent huge pages (one TLB entry per 2MB instead of per 4KB).
+Smaller requests go through ::operator new like std::allocator.
+
+With Populate = true the mapping is pre-faulted right after the madvise call. MAP_POPULATE itself
+would fault the pages in before the huge page advice is applied (and they would end up as 4KB
+pages), so we use MADV_POPULATE_WRITE when the kernel has it and touch one byte per page otherwise.
+
+reallocate() grows a mapping with mremap, so Vector::reserve doesn't copy trivially copyable
+elements: the kernel just moves the page table entries (into a 2MB aligned reservation, so the
+buffer stays huge page aligned when it can't grow in place).
+*/
+
+#include <sys/mman.h>
+#include <cstddef>
+#include <cstdint> // uintptr_t
+#include <cstring> // std::memcpy
+#include <new> // std::bad_alloc, std::align_val_t
+#include <algorithm>
+
+namespace hugepage{
+    inline constexpr size_t HugePageSize = size_t{2} << 20; // 2MB on x86-64 and most ARM64 kernels
+    inline constexpr size_t MmapThreshold = HugePageSize;
+
+    inline size_t round_up(size_t bytes){
+        return (bytes + HugePageSize - 1) & ~(HugePageSize - 1);
+    }
+
+    inline void populate(void* p, size_t len){
+#ifdef MADV_POPULATE_WRITE
+        if(madvise(p, len, MADV_POPULATE_WRITE) == 0) return;
+#endif
+        // Older kernels: write one byte per page to fault it in
+        volatile char* bytes = static_cast<char*>(p);
+        for(size_t i=0; i<len; i+=4096){
+            bytes[i] = 0;
+        }
+    }
+
+    // Reserve len bytes (a multiple of HugePageSize) of address space aligned to a huge page boundary
+    inline char* map_aligned(size_t len, int prot){
+        // Over-map by one huge page and trim, mmap only guarantees 4KB alignment
+        size_t padded = len + HugePageSize;
+        void* raw = mmap(nullptr, padded, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(raw == MAP_FAILED) throw std::bad_alloc();
+
+        char* base = static_cast<char*>(raw);
+        char* aligned = reinterpret_cast<char*>(
+            (reinterpret_cast<uintptr_t>(base) + HugePageSize - 1) & ~(HugePageSize - 1));
+        size_t head = aligned - base;
+        size_t tail = padded - head - len;
+        if(head) munmap(base, head);
+        if(tail) munmap(aligned + len, tail);
+        return aligned;
+    }
+
+    // Map len bytes (a multiple of HugePageSize) aligned to a huge page boundary
+    inline void* map(size_t len, bool prefault){
+        char* aligned = map_aligned(len, PROT_READ | PROT_WRITE);
+        madvise(aligned, len, MADV_HUGEPAGE); // only advice, ignore failure (e.g. THP disabled)
+        if(prefault) populate(aligned, len);
+        return aligned;
+    }
+
+    // Resize a mapping from map(), keeping it huge page aligned. MREMAP_MAYMOVE alone may move it
+    // to any 4KB boundary, so a move goes into an aligned reservation with MREMAP_FIXED instead
+    inline void* remap(void* p, size_t old_len, size_t new_len){
+        void* q = mremap(p, old_len, new_len, 0); // in place: shrinking, or free space after p
+        if(q != MAP_FAILED) return q;
+        char* target = map_aligned(new_len, PROT_NONE);
+        q = mremap(p, old_len, new_len, MREMAP_MAYMOVE | MREMAP_FIXED, target); // replaces the reservation
+        if(q == MAP_FAILED){
+            munmap(target, new_len);
+            throw std::bad_alloc();
+        }
+        return q;
+    }
+}
+
+template <typename T, bool Populate = false>
+class HugePageAllocator{
+public:
+    using value_type = T;
+
+    // Needed because of the non-type template parameter
+    template <typename U>
+    struct rebind{ using other = HugePageAllocator<U, Populate>; };
+
+    HugePageAllocator() noexcept = default;
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U, Populate>&) noexcept {}
+
+    T* allocate(size_t n){
+        size_t bytes = n * sizeof(T);
+        if(bytes < hugepage::MmapThreshold){
+            return static_cast<T*>(::operator new(bytes, std::align_val_t{alignof(T)}));
+        }
+        return static_cast<T*>(hugepage::map(hugepage::round_up(bytes), Populate));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        size_t bytes = n * sizeof(T);
+        if(bytes < hugepage::MmapThreshold){
+            ::operator delete(p, std::align_val_t{alignof(T)});
+        }
+        else{
+            munmap(p, hugepage::round_up(bytes));
+        }
+    }
+
+    // Grow (or shrink) a block allocated with n_old elements. Only valid for trivially copyable T
+    T* reallocate(T* p, size_t n_old, size_t n_new){
+        if(!p) return allocate(n_new);
+        size_t old_bytes = n_old * sizeof(T);
+        size_t new_bytes = n_new * sizeof(T);
+
+        if(old_bytes >= hugepage::MmapThreshold && new_bytes >= hugepage::MmapThreshold){
+            size_t old_len = hugepage::round_up(old_bytes);
+            size_t new_len = hugepage::round_up(new_bytes);
+            if(old_len == new_len) return p;
+            // The kernel extends the mapping in place if it can, otherwise moves the pages
+            void* q = hugepage::remap(p, old_len, new_len);
+            if(new_len > old_len){
+                madvise(q, new_len, MADV_HUGEPAGE);
+                if(Populate) hugepage::populate(static_cast<char*>(q) + old_len, new_len - old_len);
+            }
+            return static_cast<T*>(q);
+        }
+
+        // Crossing the mmap threshold, fall back to allocate + copy
+        T* q = allocate(n_new);
+        std::memcpy(q, p, std::min(old_bytes, new_bytes));
+        deallocate(p, n_old);
+        return q;
+    }
+
+    template <typename U>
+    bool operator==(const HugePageAllocator<U, Populate>&) const noexcept { return true; }
+};
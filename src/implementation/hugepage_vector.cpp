@@ -0,0 +1,118 @@
+/*
+Tests and benchmark for Vector<T, HugePageAllocator<T>> (see hugepage_allocator.hpp)
+
+The benchmark fills a buffer and then scans it sequentially and in random order, once with
+std::allocator and once with huge pages (with and without pre-faulting).
+Pass the buffer size in GB as the first argument, e.g. ./hugepage_vector 8
+Check AnonHugePages in /proc/meminfo while it runs to confirm THP is being used
+*/
+
+#include "vector.hpp"
+#include "hugepage_allocator.hpp"
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cassert>
+#include <string>
+
+void test_small_and_large(){
+    // Small buffers come from operator new, large ones from mmap
+    Vector<int, HugePageAllocator<int>> v;
+    const size_t n = 3 * hugepage::MmapThreshold / sizeof(int); // crosses the threshold while growing
+    for(size_t i=0; i<n; ++i) v.push_back(static_cast<int>(i));
+    assert(v.size() == n);
+    for(size_t i=0; i<n; ++i) assert(v[i] == static_cast<int>(i));
+    assert(reinterpret_cast<uintptr_t>(v.data()) % hugepage::HugePageSize == 0);
+}
+
+void test_reserve_keeps_data(){
+    Vector<uint64_t, HugePageAllocator<uint64_t, true>> v;
+    v.resize(hugepage::MmapThreshold / sizeof(uint64_t), 7);
+    v.reserve(v.capacity() * 4); // mremap path
+    assert(reinterpret_cast<uintptr_t>(v.data()) % hugepage::HugePageSize == 0);
+    for(auto x : v) assert(x == 7);
+    v.resize(v.capacity(), 9);
+    assert(v.front() == 7 && v.back() == 9);
+}
+
+void test_remap_alignment(){
+    // Two buffers growing in turn: each one's mapping is usually blocked by the other, so mremap moves it
+    Vector<uint64_t, HugePageAllocator<uint64_t>> a, b;
+    size_t n = hugepage::MmapThreshold / sizeof(uint64_t);
+    for(int round=0; round<6; ++round){
+        a.resize(n * (round + 1), round);
+        b.resize(n * (round + 1), round);
+        a.reserve(a.size() + n / 2);
+        b.reserve(b.size() + n / 2);
+        assert(reinterpret_cast<uintptr_t>(a.data()) % hugepage::HugePageSize == 0);
+        assert(reinterpret_cast<uintptr_t>(b.data()) % hugepage::HugePageSize == 0);
+    }
+    for(size_t i=0; i<a.size(); ++i) assert(a[i] == i / n);
+}
+
+void test_push_back_own_element(){
+    // The argument is a reference into the block that mremap moves away while growing
+    Vector<long, HugePageAllocator<long>> v;
+    v.push_back(42);
+    const size_t n = 2 * hugepage::MmapThreshold / sizeof(long);
+    for(size_t i=1; i<n; ++i) v.push_back(v[0]);
+    for(size_t i=0; i<n; ++i) assert(v[i] == 42);
+
+    // Same with a non trivially copyable element (allocate + move path)
+    Vector<std::string, HugePageAllocator<std::string>> s;
+    s.push_back(std::string(40, 'x'));
+    for(int i=0; i<1000; ++i) s.push_back(s.back());
+    assert(s.size() == 1001 && s[1000] == std::string(40, 'x'));
+}
+
+void test_non_trivial(){
+    // Not trivially copyable: Vector falls back to allocate + move construct
+    Vector<std::string, HugePageAllocator<std::string>> v;
+    for(int i=0; i<200000; ++i) v.emplace_back(std::to_string(i));
+    assert(v[123456] == "123456");
+}
+
+template <typename V>
+void Benchmark(const std::string& name, size_t n){
+    using clock = std::chrono::high_resolution_clock;
+    auto ms = [](auto d){ return std::chrono::duration<double, std::milli>(d).count(); };
+
+    auto start = clock::now();
+    V v;
+    v.resize(n); // value-initialization is the first touch
+    auto filled = clock::now();
+
+    uint64_t sum = 0;
+    for(size_t i=0; i<n; ++i) sum += v[i];
+    auto sequential = clock::now();
+
+    // xorshift so the index computation stays in registers and the loads dominate
+    uint64_t x = 88172645463325252ull;
+    for(size_t i=0; i<n / 8; ++i){
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        sum += v[x % n];
+    }
+    auto random = clock::now();
+
+    std::cout << name << "  fill: " << ms(filled - start) << " ms"
+              << "  sequential: " << ms(sequential - filled) << " ms"
+              << "  random: " << ms(random - sequential) << " ms"
+              << "  (checksum " << sum << ")" << std::endl;
+}
+
+int main(int argc, char** argv){
+    test_small_and_large();
+    test_reserve_keeps_data();
+    test_remap_alignment();
+    test_push_back_own_element();
+    test_non_trivial();
+    std::cout << "All HugePageAllocator tests passed!\n";
+
+    double gb = argc > 1 ? std::atof(argv[1]) : 1.0;
+    size_t n = static_cast<size_t>(gb * (1ull << 30)) / sizeof(uint64_t);
+    std::cout << "Scanning " << gb << " GB" << std::endl;
+    Benchmark<Vector<uint64_t>>("std::allocator            ", n);
+    Benchmark<Vector<uint64_t, HugePageAllocator<uint64_t>>>("HugePageAllocator         ", n);
+    Benchmark<Vector<uint64_t, HugePageAllocator<uint64_t, true>>>("HugePageAllocator populate", n);
+}
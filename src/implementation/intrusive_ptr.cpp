@@ -0,0 +1,166 @@
+/*
+Tests and benchmark for Custom::intrusive_ptr (see intrusive_ptr.hpp)
+
+The benchmark builds a random graph where every node holds pointers to its neighbours, once with
+Custom::shared_ptr (make_shared) and once with intrusive_ptr, then compares the heap bytes per
+node and the time of a random walk that copies a pointer at every step.
+Arguments: number of nodes and number of steps
+*/
+
+#include "intrusive_ptr.hpp"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <cassert>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <memory> // std::allocator
+#include <atomic>
+
+// Heap bytes taken by the benchmark's nodes, so it can report the memory per node. Counted per type
+// (an allocator for make_shared's blocks, class operator new for intrusive nodes) rather than by
+// replacing the global operator new, which GCC flags as mismatched with the free() behind it
+static std::atomic<size_t> allocated_bytes{0};
+
+template <typename T>
+struct CountingAllocator{
+    using value_type = T;
+    CountingAllocator() = default;
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n){
+        allocated_bytes.fetch_add(n * sizeof(T), std::memory_order_relaxed);
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, size_t n) noexcept { std::allocator<T>().deallocate(p, n); }
+};
+
+struct Tracked : Custom::ref_counted<Tracked>{
+    static inline int live = 0;
+    int value;
+    explicit Tracked(int v) : value(v) { ++live; }
+    Tracked(const Tracked& other) : ref_counted(other), value(other.value) { ++live; }
+    ~Tracked(){ --live; }
+
+    Custom::intrusive_ptr<Tracked> self(){ return Custom::intrusive_ptr<Tracked>(this); }
+};
+
+struct Local : Custom::ref_counted<Local, Custom::SingleThreaded>{
+    int value = 5;
+};
+
+void test_basics(){
+    static_assert(sizeof(Custom::intrusive_ptr<Tracked>) == sizeof(void*));
+    {
+        auto p = Custom::make_intrusive<Tracked>(3);
+        assert(p.use_count() == 1 && p->value == 3);
+        {
+            Custom::intrusive_ptr<Tracked> q = p;
+            auto r = q.get()->self(); // a new owner from the raw pointer
+            assert(p.use_count() == 3 && r == p);
+        }
+        assert(p.use_count() == 1);
+        Custom::intrusive_ptr<Tracked> moved = std::move(p);
+        assert(!p && moved.use_count() == 1);
+
+        // Copying the object gives a fresh count
+        Custom::intrusive_ptr<Tracked> copy(new Tracked(*moved));
+        assert(copy.use_count() == 1 && moved.use_count() == 1);
+    }
+    assert(Tracked::live == 0);
+
+    auto local = Custom::make_intrusive<Local>();
+    auto local2 = local;
+    assert(local2.use_count() == 2 && local->value == 5);
+}
+
+void test_threads(){
+    {
+        auto p = Custom::make_intrusive<Tracked>(1);
+        std::vector<std::thread> threads;
+        for(int t=0; t<4; ++t){
+            threads.emplace_back([p]{
+                for(int i=0; i<10000; ++i){
+                    Custom::intrusive_ptr<Tracked> copy = p;
+                    assert(copy->value == 1);
+                }
+            });
+        }
+        p.reset();
+        for(auto& t : threads) t.join();
+    }
+    assert(Tracked::live == 0);
+}
+
+constexpr int Degree = 4;
+
+struct SharedNode{
+    int64_t value = 0;
+    Custom::shared_ptr<SharedNode> next[Degree];
+};
+
+struct IntrusiveNode : Custom::ref_counted<IntrusiveNode>{
+    int64_t value = 0;
+    Custom::intrusive_ptr<IntrusiveNode> next[Degree];
+
+    static void* operator new(size_t n){
+        allocated_bytes.fetch_add(n, std::memory_order_relaxed);
+        return ::operator new(n);
+    }
+    static void operator delete(void* p, size_t n) noexcept { ::operator delete(p, n); }
+};
+
+template <typename Ptr, typename MakeNode>
+void Benchmark(const char* name, size_t n, size_t steps, MakeNode make_node){
+    // Every node points at Degree random nodes (cycles included). Keep all nodes in a list
+    // so we can break the cycles at the end
+    std::vector<Ptr> nodes;
+    nodes.reserve(n);
+    size_t before = allocated_bytes;
+    for(size_t i=0; i<n; ++i){
+        nodes.push_back(make_node());
+        nodes.back()->value = static_cast<int64_t>(i);
+    }
+    size_t node_bytes = allocated_bytes - before;
+    uint64_t x = 88172645463325252ull;
+    auto next_random = [&x]{ x ^= x << 13; x ^= x >> 7; x ^= x << 17; return x; };
+    for(auto& node : nodes){
+        for(auto& edge : node->next){
+            edge = nodes[next_random() % n];
+        }
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    Ptr current = nodes[0];
+    int64_t sum = 0;
+    for(size_t i=0; i<steps; ++i){
+        sum += current->value;
+        current = current->next[next_random() % Degree]; // copy: one increment, one decrement
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::cout << name << "  " << sizeof(Ptr) << " byte pointer, "
+              << static_cast<double>(node_bytes) / n << " heap bytes per node, walk: "
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms (sum " << sum << ")" << std::endl;
+
+    for(auto& node : nodes){
+        for(auto& edge : node->next) edge.reset();
+    }
+}
+
+int main(int argc, char** argv){
+    test_basics();
+    test_threads();
+    std::cout << "All intrusive_ptr tests passed!\n";
+
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t steps = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000000;
+    std::cout << n << " nodes, " << steps << " steps" << std::endl;
+    Benchmark<Custom::shared_ptr<SharedNode>>("shared_ptr   ", n, steps, []{
+        return Custom::allocate_shared<SharedNode>(CountingAllocator<SharedNode>()); // make_shared with counting
+    });
+    Benchmark<Custom::intrusive_ptr<IntrusiveNode>>("intrusive_ptr", n, steps, []{ return Custom::make_intrusive<IntrusiveNode>(); });
+}
@@ -0,0 +1,134 @@
+#pragma once
+/*
+Intrusive reference counting: the count lives inside the object
+
+    struct Node : Custom::ref_counted<Node> { ... };
+    Custom::intrusive_ptr<Node> p = Custom::make_intrusive<Node>(...);
+
+intrusive_ptr is a single pointer, there is no control block and no weak count, and copying it
+only touches the object's own cache line. The CRTP base deletes the object as the derived type,
+so no virtual destructor is needed. Policy is Custom::MultiThreaded (atomic count, the default)
+or Custom::SingleThreaded (plain int), like shared_ptr.
+
+A new object starts with a count of 0 and every intrusive_ptr constructed from a raw pointer adds
+one, so an object can safely hand out intrusive_ptr<T>(this).
+*/
+
+#include "custom.hpp"
+#include <utility>
+#include <stdexcept>
+
+namespace Custom{
+    template <typename Derived, typename Policy = MultiThreaded>
+    class ref_counted{
+    public:
+        void add_ref() const noexcept { Policy::increment(ref_count_); }
+        void release() const noexcept {
+            if(Policy::decrement(ref_count_)){
+                if constexpr (requires{ Policy::retire(nullptr, nullptr); }){
+                    Policy::retire(const_cast<Derived*>(static_cast<const Derived*>(this)),
+                                   [](void* p) noexcept { delete static_cast<Derived*>(p); });
+                }
+                else{
+                    delete static_cast<const Derived*>(this);
+                }
+            }
+        }
+        int use_count() const noexcept { return Policy::load(ref_count_); }
+
+    protected:
+        ref_counted() noexcept = default;
+        // Copying an object must not copy its count
+        ref_counted(const ref_counted&) noexcept {}
+        ref_counted& operator=(const ref_counted&) noexcept { return *this; }
+        ~ref_counted() = default;
+
+    private:
+        mutable typename Policy::count_type ref_count_{0};
+    };
+
+    template <typename T>
+    class intrusive_ptr{
+    private:
+        T* ptr;
+
+    public:
+        // Contructor
+        intrusive_ptr() noexcept : ptr(nullptr) {}
+        explicit intrusive_ptr(T* p) noexcept : ptr(p) {
+            if(ptr) ptr->add_ref();
+        }
+
+        // Destructor
+        ~intrusive_ptr(){
+            if(ptr) ptr->release();
+        }
+
+        // Copy constructor
+        intrusive_ptr(const intrusive_ptr& other) noexcept : ptr(other.ptr) {
+            if(ptr) ptr->add_ref();
+        }
+
+        // Copy assignment operator
+        intrusive_ptr& operator=(const intrusive_ptr& other) noexcept {
+            intrusive_ptr(other).swap(*this);
+            return *this;
+        }
+
+        // Move constructor
+        intrusive_ptr(intrusive_ptr&& other) noexcept : ptr(std::exchange(other.ptr, nullptr)) {}
+
+        // Move assignment operator
+        intrusive_ptr& operator=(intrusive_ptr&& other) noexcept {
+            intrusive_ptr(std::move(other)).swap(*this);
+            return *this;
+        }
+
+        void swap(intrusive_ptr& other) noexcept {
+            std::swap(ptr, other.ptr);
+        }
+
+        // Dereference operator
+        T& operator*() const {
+            if(!ptr){
+                throw std::runtime_error("Deferencing nullptr");
+            }
+            return *ptr;
+        }
+
+        // Arrow operator
+        T* operator->() const {
+            if(!ptr){
+                throw std::runtime_error("Deferencing nullptr");
+            }
+            return ptr;
+        }
+
+        // Raw pointer
+        T* get() const noexcept {
+            return ptr;
+        }
+
+        void reset(T* new_ptr = nullptr) noexcept {
+            intrusive_ptr(new_ptr).swap(*this);
+        }
+
+        int use_count() const noexcept {
+            return ptr ? ptr->use_count() : 0;
+        }
+
+        // Explicit conversion to bool
+        explicit operator bool() const noexcept {
+            return ptr != nullptr;
+        }
+
+        friend bool operator==(const intrusive_ptr& a, const intrusive_ptr& b) noexcept {
+            return a.ptr == b.ptr;
+        }
+    };
+
+    template <typename T, typename... Args>
+    intrusive_ptr<T> make_intrusive(Args&&... args){
+        return intrusive_ptr<T>(new T(std::forward<Args>(args)...));
+    }
+}
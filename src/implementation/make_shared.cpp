@@ -0,0 +1,171 @@
+/*
+Tests and benchmark for Custom::make_shared / Custom::allocate_shared (see custom.hpp)
+
+Custom::shared_ptr<T>(new T) is the two allocation layout (object + separate control block),
+make_shared puts the object inside the control block.
+Pass the number of objects as the first argument
+*/
+
+#include "custom.hpp"
+#include <iostream>
+#include <chrono>
+#include <cassert>
+#include <cstdlib>
+#include <string>
+#include <type_traits>
+
+// Allocator that counts the allocations made through it (and through its rebound copies)
+template <typename T>
+struct CountingAllocator{
+    using value_type = T;
+    int* count;
+
+    explicit CountingAllocator(int* c) : count(c) {}
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) : count(other.count) {}
+
+    T* allocate(size_t n){
+        ++*count;
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, size_t n){
+        --*count;
+        std::allocator<T>().deallocate(p, n);
+    }
+};
+
+struct Widget{
+    std::string name;
+    int id;
+    Widget(std::string n, int i) : name(std::move(n)), id(i) {}
+};
+
+void test_make_shared(){
+    auto p = Custom::make_shared<Widget>("gear", 7);
+    assert(p->name == "gear" && (*p).id == 7);
+    assert(p.use_count() == 1);
+    {
+        Custom::shared_ptr<Widget> q = p;
+        assert(p.use_count() == 2 && q.get() == p.get());
+    }
+    assert(p.use_count() == 1);
+}
+
+void test_weak_ptr(){
+    Custom::weak_ptr<Widget> weak;
+    {
+        auto p = Custom::make_shared<Widget>("bolt", 1);
+        weak = p;
+        assert(!weak.expired());
+        assert(weak.lock()->id == 1);
+    }
+    // The object is destroyed, the block stays alive for the weak_ptr
+    assert(weak.expired());
+    assert(!weak.lock());
+}
+
+void test_allocate_shared_single_allocation(){
+    int live = 0;
+    {
+        auto p = Custom::allocate_shared<Widget>(CountingAllocator<Widget>(&live), "nut", 3);
+        assert(live == 1); // object and counts share one block
+        Custom::weak_ptr<Widget> weak(p);
+        p.reset();
+        assert(live == 1); // still referenced by the weak_ptr
+    }
+    assert(live == 0);
+}
+
+void test_constructor_throws(){
+    struct Throws{
+        Throws(){ throw std::runtime_error("ctor failed"); }
+    };
+    int live = 0;
+    bool thrown = false;
+    try{
+        Custom::allocate_shared<Throws>(CountingAllocator<Throws>(&live));
+    }
+    catch(const std::runtime_error&){
+        thrown = true;
+    }
+    assert(thrown && live == 0);
+}
+
+void test_explicit_arguments(){
+    // Explicit argument types work like std::make_shared, only policies pick the policy
+    std::string name = "washer";
+    auto p = Custom::make_shared<Widget, std::string&, int>(name, 2);
+    static_assert(std::is_same_v<decltype(p), Custom::shared_ptr<Widget>>);
+    assert(p->name == "washer" && p->id == 2);
+
+    auto q = Custom::make_shared<Widget, Custom::SingleThreaded>("pin", 5);
+    static_assert(std::is_same_v<decltype(q), Custom::shared_ptr<Widget, Custom::SingleThreaded>>);
+    assert(q->id == 5);
+
+    int live = 0;
+    {
+        using Alloc = CountingAllocator<Widget>;
+        auto r = Custom::allocate_shared<Widget, Alloc>(Alloc(&live), name, 4);
+        static_assert(std::is_same_v<decltype(r), Custom::shared_ptr<Widget>>);
+        auto s = Custom::allocate_shared<Widget, Custom::SingleThreaded>(Alloc(&live), "rivet", 6);
+        assert(live == 2 && r->id == 4 && s->name == "rivet");
+    }
+    assert(live == 0);
+}
+
+struct Node{
+    int64_t value;
+    Custom::shared_ptr<Node> next;
+    explicit Node(int64_t v) : value(v) {}
+};
+
+template <typename MakeNode>
+void Benchmark(const std::string& name, size_t n, MakeNode make_node){
+    using clock = std::chrono::high_resolution_clock;
+    auto ms = [](auto d){ return std::chrono::duration<double, std::milli>(d).count(); };
+
+    auto start = clock::now();
+    for(size_t i=0; i<n; ++i){
+        Custom::shared_ptr<Node> p = make_node(static_cast<int64_t>(i));
+        p->value++;
+    }
+    auto churned = clock::now();
+
+    // Build a list, then walk it by copying the shared_ptr each step (touches the counts)
+    Custom::shared_ptr<Node> head;
+    for(size_t i=0; i<n; ++i){
+        Custom::shared_ptr<Node> node = make_node(static_cast<int64_t>(i));
+        node->next = std::move(head);
+        head = std::move(node);
+    }
+    auto built = clock::now();
+    int64_t sum = 0;
+    for(Custom::shared_ptr<Node> p = head; p; p = p->next){
+        sum += p->value;
+    }
+    auto walked = clock::now();
+
+    std::cout << name << "  create/destroy: " << ms(churned - start) << " ms"
+              << "  build list: " << ms(built - churned) << " ms"
+              << "  traverse: " << ms(walked - built) << " ms (sum " << sum << ")" << std::endl;
+
+    // Unlink iteratively, the recursive destructor would overflow the stack on a long list
+    while(head){
+        Custom::shared_ptr<Node> next = std::move(head->next);
+        head = std::move(next);
+    }
+}
+
+int main(int argc, char** argv){
+    test_make_shared();
+    test_weak_ptr();
+    test_allocate_shared_single_allocation();
+    test_constructor_throws();
+    test_explicit_arguments();
+    std::cout << "All make_shared tests passed!\n";
+
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000000;
+    std::cout << n << " objects" << std::endl;
+    Benchmark("shared_ptr(new T)", n, [](int64_t v){ return Custom::shared_ptr<Node>(new Node(v)); });
+    Benchmark("make_shared      ", n, [](int64_t v){ return Custom::make_shared<Node>(v); });
+}
@@ -0,0 +1,163 @@
+/*
+Tests and benchmark for MappedVector (see mapped_vector.hpp)
+
+The benchmark compares rebuilding a dataset in a Vector at startup with reopening a MappedVector
+that was built by a previous run. Pass the number of elements as the first argument
+*/
+
+#include "vector.hpp"
+#include "mapped_vector.hpp"
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <cassert>
+#include <cstdlib>
+#include <string>
+
+struct Point{
+    double x, y;
+    int id;
+};
+
+std::string temp_file(const std::string& name){
+    auto path = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove(path);
+    return path.string();
+}
+
+void test_persist_and_reopen(){
+    std::string path = temp_file("mapped_vector_test.bin");
+    {
+        MappedVector<Point> v(path);
+        assert(v.empty());
+        for(int i=0; i<1000; ++i) v.push_back(Point{i * 0.5, i * 2.0, i});
+        v.pop_back();
+        assert(v.size() == 999);
+        assert(v.capacity() >= 999);
+    }
+    {
+        MappedVector<Point> v(path);
+        assert(v.size() == 999);
+        assert(v.back().id == 998 && v[10].x == 5.0);
+        v.resize(5000, Point{1, 1, -1}); // grows the file
+        v.sync();
+    }
+    {
+        // Read-only mappings see the same data and reject modification
+        const MappedVector<Point> v(path, MappedVector<Point>::Mode::ReadOnly);
+        assert(v.size() == 5000 && v.read_only());
+        assert(v[998].id == 998 && v.at(4999).id == -1);
+        bool thrown = false;
+        try{
+            const_cast<MappedVector<Point>&>(v).push_back(Point{});
+        }
+        catch(const std::logic_error&){
+            thrown = true;
+        }
+        assert(thrown);
+    }
+    std::filesystem::remove(path);
+}
+
+void test_wrong_type(){
+    std::string path = temp_file("mapped_vector_type.bin");
+    {
+        MappedVector<int> v(path);
+        v.push_back(1);
+    }
+    bool thrown = false;
+    try{
+        MappedVector<double> v(path);
+    }
+    catch(const std::runtime_error&){
+        thrown = true;
+    }
+    assert(thrown);
+    std::filesystem::remove(path);
+}
+
+void test_missing_read_only(){
+    bool thrown = false;
+    try{
+        MappedVector<int> v(temp_file("mapped_vector_missing.bin"), MappedVector<int>::Mode::ReadOnly);
+    }
+    catch(const std::system_error&){
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+void test_reader_while_writer_grows(){
+    std::string path = temp_file("mapped_vector_grow.bin");
+    MappedVector<int> writer(path);
+    writer.resize(100, 7);
+    const MappedVector<int> reader(path, MappedVector<int>::Mode::ReadOnly);
+    assert(reader.size() == 100);
+
+    // The writer's header now counts elements past the end of the reader's mapping
+    for(int i=0; i<100000; ++i) writer.push_back(i);
+    assert(reader.size() <= reader.capacity() && reader.size() < writer.size());
+    long sum = 0;
+    for(int x : reader) sum += x;
+    assert(sum >= 700);
+
+    MappedVector<int> moved = std::move(writer);
+    assert(writer.size() == 0 && writer.empty());
+    assert(moved.size() == 100100);
+    std::filesystem::remove(path);
+}
+
+void test_push_back_own_element(){
+    // The argument is a reference into the mapping that mremap moves while growing
+    std::string path = temp_file("mapped_vector_self.bin");
+    {
+        MappedVector<int> m(path);
+        m.push_back(42);
+        for(int i=0; i<100000; ++i) m.push_back(m[0]);
+        m.resize(300000, m.back());
+        assert(m.size() == 300000);
+        for(int x : m) assert(x == 42);
+    }
+    std::filesystem::remove(path);
+}
+
+int main(int argc, char** argv){
+    test_persist_and_reopen();
+    test_wrong_type();
+    test_missing_read_only();
+    test_reader_while_writer_grows();
+    test_push_back_own_element();
+    std::cout << "All MappedVector tests passed!\n";
+
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000000;
+    std::string path = temp_file("mapped_vector_bench.bin");
+    using clock = std::chrono::high_resolution_clock;
+    auto ms = [](auto d){ return std::chrono::duration<double, std::milli>(d).count(); };
+
+    // What a restart costs today: rebuild the whole dataset
+    auto start = clock::now();
+    Vector<Point> rebuilt;
+    for(size_t i=0; i<n; ++i) rebuilt.push_back(Point{i * 0.5, i * 2.0, static_cast<int>(i)});
+    auto end = clock::now();
+    std::cout << "Rebuild Vector of " << n << " elements: " << ms(end - start) << " ms" << std::endl;
+
+    {
+        MappedVector<Point> v(path);
+        v.reserve(n);
+        for(size_t i=0; i<n; ++i) v.push_back(rebuilt[i]);
+    }
+
+    // Restart with a persistent vector: open + mmap, pages come in lazily
+    start = clock::now();
+    MappedVector<Point> reopened(path, MappedVector<Point>::Mode::ReadOnly);
+    end = clock::now();
+    std::cout << "Reopen MappedVector:  " << ms(end - start) << " ms" << std::endl;
+
+    start = clock::now();
+    double sum = 0;
+    for(const Point& p : reopened) sum += p.x;
+    end = clock::now();
+    std::cout << "First scan of the mapping: " << ms(end - start) << " ms (sum " << sum << ")" << std::endl;
+
+    std::filesystem::remove(path);
+}
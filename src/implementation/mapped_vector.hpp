@@ -0,0 +1,268 @@
+#pragma once
+/*
+A persistent vector of trivially copyable elements backed by a memory-mapped file
+
+The file starts with a small header holding the size and capacity, followed by the elements.
+Because the elements live directly in the mapping, reopening a file is just open + mmap: no
+parsing, and pages are only read from disk when they are touched.
+Growth works like Vector (capacity doubles) but with ftruncate + mremap instead of allocate + move.
+
+Opening with Mode::ReadOnly maps the file PROT_READ / MAP_SHARED, so any number of processes
+on a host share the same page cache pages. Modifying members throw std::logic_error in that
+mode (writing through operator[] would fault, use the const accessors).
+A reader only sees the elements that fit in the length it mapped at open, even if a writer in
+another process has grown the file since (size() is clamped to that).
+*/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm> // std::min
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility> // std::exchange
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+
+template <typename T>
+class MappedVector{
+    static_assert(std::is_trivially_copyable_v<T>, "MappedVector stores raw bytes, T must be trivially copyable");
+    static_assert(alignof(T) <= 64, "Elements start 64 bytes into the mapping");
+
+    // Kept at the start of the file. 64 bytes so the elements are cache line aligned
+    struct alignas(64) Header{
+        uint64_t magic;
+        uint64_t elem_size;
+        uint64_t size;
+        uint64_t capacity;
+    };
+    static constexpr uint64_t Magic = 0x31564d5050414d56; // "VMAPPMV1"
+
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    enum class Mode{ ReadWrite, ReadOnly };
+
+    // Open (or create, in ReadWrite mode) the file at path
+    explicit MappedVector(const std::string& path, Mode mode = Mode::ReadWrite)
+    : mode_(mode) {
+        int flags = mode == Mode::ReadOnly ? O_RDONLY : (O_RDWR | O_CREAT);
+        fd_ = ::open(path.c_str(), flags, 0644);
+        if(fd_ < 0) throw std::system_error(errno, std::generic_category(), "open " + path);
+
+        struct stat st;
+        if(::fstat(fd_, &st) < 0) fail("fstat");
+        size_t file_size = static_cast<size_t>(st.st_size);
+
+        if(file_size == 0){
+            if(mode == Mode::ReadOnly){
+                close();
+                throw std::runtime_error("MappedVector: " + path + " is empty");
+            }
+            // New file: write an empty header
+            resize_file(bytes_for(0));
+            map(bytes_for(0));
+            *header() = Header{Magic, sizeof(T), 0, 0};
+            return;
+        }
+
+        if(file_size < sizeof(Header)){
+            close();
+            throw std::runtime_error("MappedVector: " + path + " is too small");
+        }
+        map(file_size);
+        const Header* h = header();
+        if(h->magic != Magic || h->elem_size != sizeof(T) || bytes_for(h->capacity) > file_size
+            || h->size > h->capacity){
+            unmap();
+            close();
+            throw std::runtime_error("MappedVector: " + path + " has an invalid header");
+        }
+    }
+
+    // Not copyable, a mapping has a single owner
+    MappedVector(const MappedVector&) = delete;
+    MappedVector& operator=(const MappedVector&) = delete;
+
+    MappedVector(MappedVector&& other) noexcept
+    :   mode_(other.mode_),
+        fd_(std::exchange(other.fd_, -1)),
+        base_(std::exchange(other.base_, nullptr)),
+        length_(std::exchange(other.length_, 0)) {}
+
+    MappedVector& operator=(MappedVector&& other) noexcept {
+        if(this == &other) return *this;
+        unmap();
+        close();
+        mode_ = other.mode_;
+        fd_ = std::exchange(other.fd_, -1);
+        base_ = std::exchange(other.base_, nullptr);
+        length_ = std::exchange(other.length_, 0);
+        return *this;
+    }
+
+    ~MappedVector() noexcept {
+        unmap();
+        close();
+    }
+
+    void reserve(size_t n){
+        check_writable();
+        if(n <= capacity()) return;
+        size_t len = bytes_for(n);
+        resize_file(len);
+        // Shared file mappings can be grown in place, the kernel moves the mapping if it has to
+        void* p = ::mremap(base_, length_, len, MREMAP_MAYMOVE);
+        if(p == MAP_FAILED) fail("mremap");
+        base_ = static_cast<char*>(p);
+        length_ = len;
+        header()->capacity = n;
+    }
+
+    template <typename... Args>
+    void emplace_back(Args&&... args){
+        check_writable();
+        // Built first: args may refer into the mapping, which reserve's mremap can move
+        T value(std::forward<Args>(args)...);
+        if(size() >= capacity()){
+            reserve(capacity() ? capacity() * 2 : 1);
+        }
+        data()[size()] = value;
+        ++header()->size;
+    }
+
+    void push_back(const T& val){ emplace_back(val); }
+
+    void pop_back(){
+        check_writable();
+        if(size() > 0) --header()->size;
+    }
+
+    // Resize and value initialize the new elements
+    void resize(size_t n, const T& val = T()){
+        check_writable();
+        T value = val; // as in emplace_back
+        reserve(n);
+        for(size_t i=size(); i<n; ++i){
+            data()[i] = value;
+        }
+        header()->size = n;
+    }
+
+    void clear(){
+        check_writable();
+        header()->size = 0;
+    }
+
+    // Flush dirty pages to the file (the kernel does this eventually anyway)
+    void sync(){
+        if(mode_ == Mode::ReadWrite && ::msync(base_, length_, MS_SYNC) < 0) fail("msync");
+    }
+
+    // Accessors
+    T& operator[](size_t i){ return data()[i]; }
+    const T& operator[](size_t i) const { return data()[i]; }
+
+    T& at(size_t i){
+        if(i >= size()) throw std::out_of_range("Index out of range");
+        return data()[i];
+    }
+    const T& at(size_t i) const {
+        if(i >= size()) throw std::out_of_range("Index out of range");
+        return data()[i];
+    }
+
+    T& front(){
+        if(empty()) throw std::logic_error("MappedVector is empty");
+        return data()[0];
+    }
+    const T& front() const {
+        if(empty()) throw std::logic_error("MappedVector is empty");
+        return data()[0];
+    }
+    T& back(){
+        if(empty()) throw std::logic_error("MappedVector is empty");
+        return data()[size()-1];
+    }
+    const T& back() const {
+        if(empty()) throw std::logic_error("MappedVector is empty");
+        return data()[size()-1];
+    }
+
+    iterator begin() noexcept { return data(); }
+    iterator end() noexcept { return data() + size(); }
+    const_iterator begin() const noexcept { return data(); }
+    const_iterator end() const noexcept { return data() + size(); }
+    const_iterator cbegin() const noexcept { return data(); }
+    const_iterator cend() const noexcept { return data() + size(); }
+
+    // The header is shared with writers in other processes, never trust it past our own mapping
+    size_t size() const noexcept {
+        if(!base_) return 0; // moved from
+        size_t n = header()->size;
+        return mode_ == Mode::ReadOnly ? std::min(n, mapped_elements()) : n;
+    }
+    size_t capacity() const noexcept {
+        if(!base_) return 0;
+        size_t n = header()->capacity;
+        return mode_ == Mode::ReadOnly ? std::min(n, mapped_elements()) : n;
+    }
+    bool empty() const noexcept { return size() == 0; }
+    bool read_only() const noexcept { return mode_ == Mode::ReadOnly; }
+
+private:
+    static size_t bytes_for(size_t n){ return sizeof(Header) + n * sizeof(T); }
+    size_t mapped_elements() const noexcept { return (length_ - sizeof(Header)) / sizeof(T); }
+
+    Header* header() noexcept { return reinterpret_cast<Header*>(base_); }
+    const Header* header() const noexcept { return reinterpret_cast<const Header*>(base_); }
+    T* data() noexcept { return reinterpret_cast<T*>(base_ + sizeof(Header)); }
+    const T* data() const noexcept { return reinterpret_cast<const T*>(base_ + sizeof(Header)); }
+
+    void map(size_t len){
+        int prot = mode_ == Mode::ReadOnly ? PROT_READ : (PROT_READ | PROT_WRITE);
+        void* p = ::mmap(nullptr, len, prot, MAP_SHARED, fd_, 0);
+        if(p == MAP_FAILED) fail("mmap");
+        base_ = static_cast<char*>(p);
+        length_ = len;
+    }
+
+    void resize_file(size_t len){
+        if(::ftruncate(fd_, static_cast<off_t>(len)) < 0) fail("ftruncate");
+    }
+
+    void unmap() noexcept {
+        if(base_) ::munmap(base_, length_);
+        base_ = nullptr;
+        length_ = 0;
+    }
+
+    void close() noexcept {
+        if(fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
+    void check_writable() const {
+        if(mode_ == Mode::ReadOnly) throw std::logic_error("MappedVector is read-only");
+    }
+
+    // Throw with the current errno, releasing the file first if we're still in the constructor
+    [[noreturn]] void fail(const char* what){
+        int err = errno;
+        if(!base_){
+            close();
+        }
+        throw std::system_error(err, std::generic_category(), what);
+    }
+
+    Mode mode_;
+    int fd_ = -1;
+    char* base_ = nullptr;
+    size_t length_ = 0;
+};
@@ -0,0 +1,152 @@
+/*
+Tests and benchmark for the thread-caching object pool (see object_pool.hpp)
+
+Every thread repeatedly allocates a window of 64 byte objects and frees them, with glibc malloc
+and with ObjectPool<64>, at 1, 2, 4, ... threads.
+Arguments: operations per thread and maximum number of threads
+*/
+
+#include "object_pool.hpp"
+#include "vector.hpp"
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <latch>
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+
+void test_reuse(){
+    auto& pool = ObjectPool<32>::instance();
+    void* p = pool.allocate();
+    pool.deallocate(p);
+    assert(pool.allocate() == p); // LIFO: the hottest block comes back first
+    pool.deallocate(p);
+
+    auto& aligned = ObjectPool<24, 64>::instance();
+    static_assert(ObjectPool<24, 64>::BlockSize == 64);
+    std::vector<void*> blocks;
+    for(int i=0; i<1000; ++i){
+        blocks.push_back(aligned.allocate());
+        assert(reinterpret_cast<uintptr_t>(blocks.back()) % 64 == 0);
+    }
+    for(void* b : blocks) aligned.deallocate(b);
+}
+
+void test_thread_exit(){
+    // A pool no other test uses, so the counts are exact
+    using Pool = ObjectPool<200>;
+    std::thread([]{
+        void* p = Pool::instance().allocate();
+        Pool::instance().deallocate(p);
+    }).join();
+    // The exiting thread handed its list back: the whole slab is in the depot
+    assert(Pool::instance().slabs() == 1);
+    assert(Pool::instance().depot_blocks() == Pool::SlabSize / Pool::BlockSize);
+}
+
+void test_cross_thread(){
+    // One thread allocates, another frees: the freeing thread returns batches to the depot,
+    // so later rounds reuse them instead of carving new slabs
+    using Pool = ObjectPool<48>;
+    std::vector<void*> blocks(20000);
+    size_t slabs_after_first = 0;
+    for(int round=0; round<10; ++round){
+        std::thread([&]{ for(auto& b : blocks) b = Pool::instance().allocate(); }).join();
+        std::thread([&]{ for(void* b : blocks) Pool::instance().deallocate(b); }).join();
+        if(round == 0) slabs_after_first = Pool::instance().slabs();
+    }
+    assert(Pool::instance().slabs() == slabs_after_first);
+}
+
+struct Counted{
+    static inline int live = 0;
+    int value;
+    explicit Counted(int v) : value(v) {
+        if(v < 0) throw std::invalid_argument("negative");
+        ++live;
+    }
+    ~Counted(){ --live; }
+};
+
+void test_adapters(){
+    {
+        auto p = make_pooled<Counted>(4);
+        static_assert(sizeof(p) == sizeof(Counted*)); // PoolDelete is stateless
+        assert(p->value == 4 && Counted::live == 1);
+
+        bool threw = false;
+        try{ make_pooled<Counted>(-1); }
+        catch(const std::invalid_argument&){ threw = true; }
+        assert(threw && Counted::live == 1);
+
+        auto shared = Custom::allocate_shared<Counted>(PoolAllocator<Counted>(), 5);
+        auto copy = shared;
+        assert(copy->value == 5 && shared.use_count() == 2 && Counted::live == 2);
+    }
+    assert(Counted::live == 0);
+
+    // Vector's buffer falls back to operator new, a capacity of one comes from the pool
+    Vector<int, PoolAllocator<int>> v;
+    for(int i=0; i<1000; ++i) v.push_back(i);
+    for(int i=0; i<1000; ++i) assert(v[i] == i);
+}
+
+constexpr size_t ObjectSize = 64;
+constexpr size_t Window = 64;
+
+struct Malloc{
+    static void* allocate(){ return std::malloc(ObjectSize); }
+    static void deallocate(void* p){ std::free(p); }
+};
+struct Pool{
+    static void* allocate(){ return ObjectPool<ObjectSize>::instance().allocate(); }
+    static void deallocate(void* p){ ObjectPool<ObjectSize>::instance().deallocate(p); }
+};
+
+template <typename Alloc>
+double Benchmark(size_t ops, size_t threads){
+    // Each worker times itself from the moment the latch releases it, the slowest one counts
+    std::latch start(threads);
+    std::vector<double> elapsed(threads);
+    std::vector<std::thread> workers;
+    for(size_t t=0; t<threads; ++t){
+        workers.emplace_back([&, t]{
+            void* window[Window];
+            start.arrive_and_wait();
+            auto begin = std::chrono::high_resolution_clock::now();
+            for(size_t i=0; i<ops; i+=Window){
+                for(auto& p : window){
+                    p = Alloc::allocate();
+                    static_cast<volatile char*>(p)[0] = 1;
+                }
+                for(void* p : window) Alloc::deallocate(p);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            elapsed[t] = std::chrono::duration<double>(end - begin).count();
+        });
+    }
+    for(auto& w : workers) w.join();
+    double seconds = *std::max_element(elapsed.begin(), elapsed.end());
+    return static_cast<double>(ops) * threads / seconds / 1e6; // alloc+free pairs per second, millions
+}
+
+int main(int argc, char** argv){
+    test_reuse();
+    test_thread_exit();
+    test_cross_thread();
+    test_adapters();
+    std::cout << "All object pool tests passed!\n";
+
+    size_t ops = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    size_t max_threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 64;
+    std::cout << ops << " alloc/free pairs of " << ObjectSize << " bytes per thread" << std::endl;
+    for(size_t t=1; t<=max_threads; t*=2){
+        double m = Benchmark<Malloc>(ops, t);
+        double p = Benchmark<Pool>(ops, t);
+        std::cout << t << " threads  malloc: " << m << " M/s  pool: " << p << " M/s  (x" << p / m << ")" << std::endl;
+    }
+}
@@ -0,0 +1,230 @@
+#pragma once
+/*
+Thread-caching pool for fixed-size objects
+
+    void* p = ObjectPool<64>::instance().allocate();
+    ObjectPool<64>::instance().deallocate(p);
+
+    auto node = Custom::allocate_shared<Node>(PoolAllocator<Node>(), ...); // control block from the pool
+    auto task = make_pooled<Task>(...); // Custom::unique_ptr<Task, PoolDelete<Task>>
+
+There is one pool per (block size, alignment), shared by the whole program. Each thread keeps its
+own free list, so allocate/deallocate are a few loads and stores with no atomics or locks. Free
+blocks hold the next pointer of the list themselves.
+
+The global depot under a mutex is only touched once per batch:
+- a thread whose list is empty takes a whole batch from the depot (or carves a new slab into batches)
+- a thread whose list grows to 2 * BatchSize gives BatchSize blocks back, so a thread that frees
+  what another thread allocated (producer/consumer) doesn't hoard memory
+- a thread's list goes back to the depot when the thread exits
+
+Slabs are never returned to the OS before the program exits: the pool keeps its peak size.
+Blocks must not be freed from destructors of other thread_local objects (the cache may be gone).
+*/
+
+#include "custom.hpp"
+#include <cstddef>
+#include <new> // std::align_val_t, std::bad_alloc
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+template <size_t Size, size_t Align = alignof(std::max_align_t)>
+class ObjectPool{
+    static_assert((Align & (Align - 1)) == 0, "Alignment must be a power of two");
+
+    struct Node{
+        Node* next;
+    };
+
+public:
+    static constexpr size_t BlockAlign = std::max(Align, alignof(Node));
+    static constexpr size_t BlockSize = (std::max(Size, sizeof(Node)) + BlockAlign - 1) / BlockAlign * BlockAlign;
+    static constexpr size_t BatchSize = 64;
+    static constexpr size_t SlabSize = std::max(size_t{64} << 10, BlockSize * BatchSize);
+
+    static ObjectPool& instance(){
+        static ObjectPool pool;
+        return pool;
+    }
+
+    void* allocate(){
+        Cache& c = cache();
+        if(!c.head) refill(c);
+        Node* n = c.head;
+        c.head = n->next;
+        --c.count;
+        return n;
+    }
+
+    void deallocate(void* p) noexcept {
+        Cache& c = cache();
+        Node* n = static_cast<Node*>(p);
+        n->next = c.head;
+        c.head = n;
+        if(++c.count >= 2 * BatchSize) give_back_batch(c);
+    }
+
+    // Statistics
+    size_t slabs() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return slabs_.size();
+    }
+    // Free blocks in the depot (not counting the threads' own lists)
+    size_t depot_blocks() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        size_t total = 0;
+        for(const Batch& b : depot_) total += b.count;
+        return total;
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+private:
+    struct Batch{
+        Node* head;
+        size_t count;
+    };
+
+    // A thread's free list, returned to the depot when the thread exits
+    struct Cache{
+        ObjectPool* pool;
+        Node* head = nullptr;
+        size_t count = 0;
+        ~Cache(){
+            if(!head) return;
+            try{
+                pool->push(Batch{head, count});
+            }
+            catch(...){} // the blocks stay in their slab until exit
+        }
+    };
+
+    struct SlabDelete{
+        void operator()(char* slab) const noexcept { ::operator delete(slab, std::align_val_t{BlockAlign}); }
+    };
+
+    ObjectPool() = default;
+    ~ObjectPool(){
+        for(void* slab : slabs_) ::operator delete(slab, std::align_val_t{BlockAlign});
+    }
+
+    static Cache& cache(){
+        // instance() is constructed first, so it outlives every thread's cache
+        static thread_local Cache c{&instance()};
+        return c;
+    }
+
+    void push(Batch b){
+        std::lock_guard<std::mutex> lock(mtx_);
+        depot_.push_back(b);
+    }
+
+    void refill(Cache& c){
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if(!depot_.empty()){
+                Batch b = depot_.back();
+                depot_.pop_back();
+                c.head = b.head;
+                c.count = b.count;
+                return;
+            }
+        }
+        // Carve a new slab outside the lock: the first batch goes to this thread, the rest to the depot
+        // Owned here until slabs_ has it, in case reserve or push_back throws
+        std::unique_ptr<char, SlabDelete> owner(static_cast<char*>(::operator new(SlabSize, std::align_val_t{BlockAlign})));
+        char* slab = owner.get();
+        constexpr size_t blocks = SlabSize / BlockSize;
+        std::vector<Batch> batches;
+        batches.reserve(blocks / BatchSize + 1);
+        for(size_t first=0; first<blocks; first+=BatchSize){
+            size_t last = std::min(first + BatchSize, blocks);
+            for(size_t i=first; i<last; ++i){
+                reinterpret_cast<Node*>(slab + i * BlockSize)->next =
+                    i + 1 < last ? reinterpret_cast<Node*>(slab + (i + 1) * BlockSize) : nullptr;
+            }
+            batches.push_back(Batch{reinterpret_cast<Node*>(slab + first * BlockSize), last - first});
+        }
+        std::lock_guard<std::mutex> lock(mtx_);
+        slabs_.push_back(slab);
+        owner.release();
+        c.head = batches.front().head;
+        c.count = batches.front().count;
+        depot_.insert(depot_.end(), batches.begin() + 1, batches.end());
+    }
+
+    void give_back_batch(Cache& c) noexcept {
+        // Split off the first BatchSize blocks of the list
+        Node* head = c.head;
+        Node* tail = head;
+        for(size_t i=1; i<BatchSize; ++i) tail = tail->next;
+        c.head = tail->next;
+        c.count -= BatchSize;
+        tail->next = nullptr;
+        try{
+            push(Batch{head, BatchSize});
+        }
+        catch(...){
+            // The depot couldn't grow, keep the blocks in this thread
+            tail->next = c.head;
+            c.head = head;
+            c.count += BatchSize;
+        }
+    }
+
+    mutable std::mutex mtx_;
+    std::vector<Batch> depot_;
+    std::vector<void*> slabs_;
+};
+
+// std::allocator compatible adapter: single objects (shared_ptr control blocks, list/map nodes)
+// come from the pool, arrays (Vector's buffer) fall back to ::operator new
+template <typename T>
+class PoolAllocator{
+    using Pool = ObjectPool<sizeof(T), alignof(T)>;
+
+public:
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n){
+        if(n == 1) return static_cast<T*>(Pool::instance().allocate());
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{alignof(T)}));
+    }
+    void deallocate(T* p, size_t n) noexcept {
+        if(n == 1) Pool::instance().deallocate(p);
+        else ::operator delete(p, std::align_val_t{alignof(T)});
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>&) const noexcept { return true; }
+};
+
+// Deleter for Custom::unique_ptr, only for objects created by make_pooled<T> (exactly T, not a derived type)
+template <typename T>
+struct PoolDelete{
+    void operator()(T* p) const noexcept {
+        p->~T();
+        ObjectPool<sizeof(T), alignof(T)>::instance().deallocate(p);
+    }
+};
+
+template <typename T, typename... Args>
+Custom::unique_ptr<T, PoolDelete<T>> make_pooled(Args&&... args){
+    auto& pool = ObjectPool<sizeof(T), alignof(T)>::instance();
+    void* p = pool.allocate();
+    try{
+        return Custom::unique_ptr<T, PoolDelete<T>>(new (p) T(std::forward<Args>(args)...));
+    }
+    catch(...){
+        pool.deallocate(p);
+        throw;
+    }
+}
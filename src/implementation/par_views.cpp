@@ -0,0 +1,170 @@
+/*
+Tests and benchmark for the chunked parallel range adaptors (see par_views.hpp)
+
+The benchmark runs an ingest style pipeline (filter out bad records, parse the rest with a few
+ns of work each) over the same input sequentially with std::views and with par_collect on pools
+of 1, 2, 4 ... threads (counting the calling thread), and prints the time and speedup.
+Arguments: number of records, largest thread count
+*/
+
+#include "par_views.hpp"
+#include "vector.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <span>
+#include <type_traits>
+#include <cmath>
+#include <cassert>
+#include <cstdlib>
+
+template <typename R>
+auto sequential(R&& r){
+    std::vector<std::ranges::range_value_t<R>> out;
+    for(auto&& x : r) out.push_back(x);
+    return out;
+}
+
+void test_chunk_view(){
+    std::vector<int> v(10);
+    std::iota(v.begin(), v.end(), 0);
+    auto chunks = v | par::views::chunk_by_size(4);
+    static_assert(std::ranges::random_access_range<decltype(chunks)>);
+    static_assert(std::ranges::sized_range<decltype(chunks)>);
+    assert(chunks.size() == 3);
+    assert(std::ranges::equal(chunks[0], std::vector<int>{0, 1, 2, 3}));
+    assert(std::ranges::equal(chunks[2], std::vector<int>{8, 9}));
+    assert(std::ranges::equal(*(chunks.end() - 1), chunks[2]));
+    assert(chunks.end() - chunks.begin() == 3);
+
+    assert((v | par::views::chunk_by_size(100)).size() == 1);
+    std::vector<int> empty;
+    assert((empty | par::views::chunk_by_size(3)).empty());
+
+    // Whole range adaptors before chunking, views work as bases too
+    auto firsts = std::views::iota(0, 1000) | std::views::drop(10) | std::views::take(25) | par::views::chunk_by_size(10);
+    assert(firsts.size() == 3 && *firsts[2].begin() == 30);
+
+    bool threw = false;
+    try{ (void)(v | par::views::chunk_by_size(0)); }
+    catch(const std::invalid_argument&){ threw = true; }
+    assert(threw);
+}
+
+void test_collect(ThreadPool& pool){
+    auto odd = [](int x){ return x % 2 != 0; };
+    auto square = [](int x){ return long(x) * x; };
+    for(int n : {0, 1, 999, 100000}){
+        std::vector<int> v(static_cast<size_t>(n));
+        std::iota(v.begin(), v.end(), -n / 2);
+        auto expected = sequential(v | std::views::filter(odd) | std::views::transform(square));
+        for(std::ptrdiff_t chunk : {1, 7, 4096, 1000000}){
+            auto out = v | par::views::chunk_by_size(chunk)
+                         | par::views::per_chunk(std::views::filter(odd) | std::views::transform(square))
+                         | par::par_collect(pool);
+            assert(out == expected);
+        }
+        // Without per_chunk the chunks are just flattened back, without chunking elements are collected
+        assert((v | par::views::chunk_by_size(10) | par::par_collect(pool)) == v);
+        assert((v | std::views::transform(square) | par::par_collect(pool)) == sequential(v | std::views::transform(square)));
+        // No random access: sequential
+        assert((v | std::views::filter(odd) | par::par_collect(pool)) == sequential(v | std::views::filter(odd)));
+    }
+
+    // Strings are elements, not chunks, and so are views that aren't chunks
+    std::vector<std::string> words = {"a", "bb", "ccc"};
+    auto copied = words | par::par_collect(pool);
+    assert(copied == words);
+    std::vector<std::string_view> names = {"alpha", "beta", "gamma"};
+    auto views = names | par::par_collect(pool);
+    static_assert(std::is_same_v<decltype(views), std::vector<std::string_view>>);
+    assert(views == names);
+    std::vector<int> ints = {1, 2, 3, 4};
+    std::vector<std::span<const int>> spans(3, std::span<const int>(ints));
+    std::atomic<size_t> total{0};
+    spans | par::par_for_each(pool, [&](std::span<const int> s){ total += s.size(); });
+    assert(total == 3 * ints.size());
+    std::list<int> linked = {3, 1, 2};
+    assert((linked | par::par_collect(pool)) == (std::vector<int>{3, 1, 2}));
+}
+
+void test_for_each(ThreadPool& pool){
+    std::vector<int> v(100000, 1);
+    std::atomic<long> sum{0};
+    v | par::views::chunk_by_size(1000) | par::views::per_chunk(std::views::transform([](int x){ return x * 3; }))
+      | par::par_for_each(pool, [&](int x){ sum.fetch_add(x, std::memory_order_relaxed); });
+    assert(sum == 300000);
+
+    // Elements by reference: writes go to the input
+    v | par::views::chunk_by_size(333) | par::par_for_each(pool, [](int& x){ x = 2; });
+    assert(std::all_of(v.begin(), v.end(), [](int x){ return x == 2; }));
+    v | par::par_for_each(pool, [](int& x){ ++x; });
+    assert(std::all_of(v.begin(), v.end(), [](int x){ return x == 3; }));
+
+    Vector<int> vec(5000, 1);
+    vec | par::views::chunk_by_size(100) | par::par_for_each(pool, [](int& x){ x = 7; });
+    assert(vec[4999] == 7 && vec[0] == 7);
+
+    bool threw = false;
+    try{
+        v | par::views::chunk_by_size(100) | par::par_for_each(pool, [](int){ throw std::runtime_error("bad record"); });
+    }
+    catch(const std::runtime_error&){ threw = true; }
+    assert(threw);
+}
+
+template <typename F>
+double time_ms(F f){
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void Benchmark(size_t n, size_t max_threads){
+    // Records: every 8th is "bad", the others parsed with some math
+    std::vector<uint32_t> records(n);
+    for(size_t i=0; i<n; ++i) records[i] = static_cast<uint32_t>(i * 2654435761u);
+    auto valid = [](uint32_t r){ return r % 8 != 0; };
+    auto parse = [](uint32_t r){ return std::sqrt(static_cast<double>(r)) * std::sin(static_cast<double>(r)); };
+
+    size_t expected_size = 0;
+    double seq = time_ms([&]{ expected_size = sequential(records | std::views::filter(valid) | std::views::transform(parse)).size(); });
+    std::cout << "\n" << std::left << std::setw(16) << "threads" << std::right << std::setw(12) << "ms" << std::setw(10) << "speedup\n";
+    std::cout << std::left << std::setw(16) << "std::views" << std::right << std::fixed << std::setprecision(1) << std::setw(12) << seq << "\n";
+    for(size_t t=1; t<=max_threads; t*=2){
+        ThreadPool pool(t - 1); // the calling thread takes one chunk
+        size_t size = 0;
+        double ms = time_ms([&]{
+            size = (records | par::views::chunk_by_size(16384)
+                            | par::views::per_chunk(std::views::filter(valid) | std::views::transform(parse))
+                            | par::par_collect(pool)).size();
+        });
+        assert(size == expected_size);
+        std::cout << std::left << std::setw(16) << t << std::right << std::setw(12) << ms << std::setw(9) << seq / ms << "x\n";
+    }
+    std::cout.unsetf(std::ios::fixed);
+}
+
+int main(int argc, char** argv){
+    ThreadPool pool(3);
+    test_chunk_view();
+    test_collect(pool);
+    test_for_each(pool);
+    ThreadPool no_workers(0);
+    test_collect(no_workers);
+    std::cout << "All parallel view tests passed!\n";
+
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1 << 24;
+    size_t max_threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::max(1u, std::thread::hardware_concurrency());
+    std::cout << n << " records, up to " << max_threads << " threads" << std::endl;
+    Benchmark(n, max_threads);
+}
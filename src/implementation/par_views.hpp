@@ -0,0 +1,219 @@
+#pragma once
+/*
+Range adaptors that run a std::views pipeline in chunks on a ThreadPool
+
+    auto out = v | par::views::chunk_by_size(4096)
+                 | par::views::per_chunk(std::views::filter(is_valid) | std::views::transform(parse))
+                 | par::par_collect(pool);                 // std::vector, in the order of v
+    v | std::views::transform(f) | par::par_for_each(pool, [](auto& x){ ... });
+
+The views pipelines of src/ranges.cpp are lazy, so they can't be split across threads as they
+are: a filter_view only knows where its next element is by testing the ones before it. Instead
+the input is cut first: chunk_by_size(n) turns a random access range into a random access range
+of subranges of n elements (the last one shorter), like C++23's views::chunk. per_chunk(adaptor)
+applies an existing pipeline (any std range adaptor, or several joined with |) to every chunk, so
+each chunk is an independent lazy range and the range of chunks is still random access.
+
+par_collect(pool) and par_for_each(pool, f) then hand out the chunks to the threads (the pool's
+workers and the calling thread, one contiguous run of chunks each). par_collect materializes every
+chunk into a std::vector on its thread and concatenates them in order, so the result is what the
+sequential pipeline would give. par_for_each calls f on every element; elements of one chunk are
+visited in order, chunks in parallel. The ranges made by chunk_by_size and per_chunk are flattened
+(only those: a range of string_views or spans is a range of elements); any other random access
+range (v | views::transform(f)) is split by the pool's parallel_for, and a range without random
+access (a filter_view) runs sequentially.
+
+Adaptors that depend on the whole range (take, drop) go before chunk_by_size, or after par_collect.
+Like parallel_algorithms.hpp, the first exception thrown by an operation is rethrown after all
+chunks have finished. These closures only compose with a range on their left (r | adaptor), not
+with each other; C++20 has no way to write user adaptors that join std ones (C++23's
+range_adaptor_closure).
+*/
+
+#include "threadpool.hpp"
+#include "parallel_algorithms.hpp"
+#include <iterator>
+#include <ranges>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace par{
+    // Subranges of n elements of a random access sized view, the last one may be shorter
+    template <std::ranges::view V> requires Range<V>
+    class chunk_view : public std::ranges::view_interface<chunk_view<V>>{
+    public:
+        using base_iterator = std::ranges::iterator_t<V>;
+        using difference_type = std::ranges::range_difference_t<V>;
+
+        class iterator{
+        public:
+            using iterator_concept = std::random_access_iterator_tag;
+            using iterator_category = std::input_iterator_tag; // operator* returns a value
+            using value_type = std::ranges::subrange<base_iterator>;
+            using difference_type = chunk_view::difference_type;
+
+            iterator() = default;
+            iterator(base_iterator first, difference_type size, difference_type n, difference_type index)
+                : first_(first), size_(size), n_(n), index_(index) {}
+
+            value_type operator*() const {
+                difference_type lo = index_ * n_;
+                return {first_ + lo, first_ + std::min(size_, lo + n_)};
+            }
+            value_type operator[](difference_type k) const { return *(*this + k); }
+
+            iterator& operator++(){ ++index_; return *this; }
+            iterator operator++(int){ auto old = *this; ++index_; return old; }
+            iterator& operator--(){ --index_; return *this; }
+            iterator operator--(int){ auto old = *this; --index_; return old; }
+            iterator& operator+=(difference_type k){ index_ += k; return *this; }
+            iterator& operator-=(difference_type k){ index_ -= k; return *this; }
+            friend iterator operator+(iterator it, difference_type k){ return it += k; }
+            friend iterator operator+(difference_type k, iterator it){ return it += k; }
+            friend iterator operator-(iterator it, difference_type k){ return it -= k; }
+            friend difference_type operator-(const iterator& a, const iterator& b){ return a.index_ - b.index_; }
+            friend bool operator==(const iterator& a, const iterator& b){ return a.index_ == b.index_; }
+            friend auto operator<=>(const iterator& a, const iterator& b){ return a.index_ <=> b.index_; }
+
+        private:
+            base_iterator first_{};
+            difference_type size_ = 0, n_ = 1, index_ = 0;
+        };
+
+        chunk_view() = default;
+        chunk_view(V base, difference_type n) : base_(std::move(base)), n_(n){
+            if(n <= 0) throw std::invalid_argument("chunk size must be positive");
+        }
+
+        iterator begin() const { return {std::ranges::begin(base_), total(), n_, 0}; }
+        iterator end() const { return {std::ranges::begin(base_), total(), n_, static_cast<difference_type>(size())}; }
+        size_t size() const { return (std::ranges::size(base_) + static_cast<size_t>(n_) - 1) / static_cast<size_t>(n_); }
+        const V& base() const { return base_; }
+
+    private:
+        difference_type total() const { return static_cast<difference_type>(std::ranges::size(base_)); }
+
+        V base_ = V();
+        difference_type n_ = 1;
+    };
+
+    namespace detail{
+        // per_chunk's function, named so its transform_view can be recognized below
+        template <typename Adaptor>
+        struct ApplyToChunk{
+            Adaptor adaptor;
+            template <typename Chunk>
+            auto operator()(Chunk chunk) const { return chunk | adaptor; }
+        };
+
+        // Ranges of chunks, which get flattened: what chunk_by_size and per_chunk return
+        template <typename R>
+        struct is_chunks : std::false_type {};
+        template <typename V>
+        struct is_chunks<chunk_view<V>> : std::true_type {};
+        template <typename V, typename Adaptor>
+        struct is_chunks<std::ranges::transform_view<V, ApplyToChunk<Adaptor>>> : std::true_type {};
+
+        template <typename R>
+        concept Chunked = is_chunks<std::remove_cvref_t<R>>::value;
+
+        template <typename R>
+        struct element{ using type = std::ranges::range_value_t<R>; };
+        template <Chunked R>
+        struct element<R>{ using type = std::ranges::range_value_t<std::remove_cvref_t<std::ranges::range_reference_t<R>>>; };
+
+        // Calls f on x, or on every element of x if it is a chunk
+        template <bool IsChunk, typename X, typename F>
+        void visit(X&& x, F& f){
+            if constexpr (IsChunk){
+                for(auto&& y : x) std::invoke(f, std::forward<decltype(y)>(y));
+            }
+            else std::invoke(f, std::forward<X>(x));
+        }
+
+        // The adaptors, applied by r | adaptor (hidden friends, so std's operator| on views doesn't interfere)
+        struct ChunkBySize{
+            std::ptrdiff_t n;
+            template <std::ranges::viewable_range R> requires Range<std::views::all_t<R>>
+            friend auto operator|(R&& r, ChunkBySize c){
+                return chunk_view<std::views::all_t<R>>(std::views::all(std::forward<R>(r)), c.n);
+            }
+        };
+
+        template <typename Adaptor>
+        struct PerChunk{
+            Adaptor adaptor;
+            template <std::ranges::viewable_range R>
+            friend auto operator|(R&& r, const PerChunk& c){
+                return std::forward<R>(r) | std::views::transform(ApplyToChunk<Adaptor>{c.adaptor});
+            }
+        };
+
+        template <typename F>
+        struct ForEach{
+            ThreadPool& pool;
+            F f;
+            template <std::ranges::input_range R>
+            friend void operator|(R&& r, ForEach c){
+                constexpr bool chunked = Chunked<R>;
+                if constexpr (Range<R>){
+                    auto first = std::ranges::begin(r);
+                    c.pool.parallel_for(0, std::ranges::size(r), [&](size_t lo, size_t hi){
+                        for(size_t i=lo; i<hi; ++i) visit<chunked>(first[i], c.f);
+                    }, chunked ? 1 : Grain);
+                }
+                else{
+                    for(auto&& x : r) visit<chunked>(std::forward<decltype(x)>(x), c.f);
+                }
+            }
+        };
+
+        struct Collect{
+            ThreadPool& pool;
+            template <std::ranges::input_range R>
+            friend auto operator|(R&& r, Collect c){
+                constexpr bool chunked = Chunked<R>;
+                using T = typename element<R>::type;
+                std::vector<T> out;
+                if constexpr (Range<R>){
+                    size_t n = std::ranges::size(r);
+                    size_t parts = chunked ? std::min(c.pool.size() + 1, n) : chunks(c.pool, n);
+                    // One vector per thread, joined in order
+                    std::vector<std::vector<T>> partial(std::max<size_t>(parts, 1));
+                    auto first = std::ranges::begin(r);
+                    for_each_chunk(c.pool, n, [&](size_t p, size_t lo, size_t hi){
+                        auto keep = [&part = partial[p]](auto&& x){ part.push_back(std::forward<decltype(x)>(x)); };
+                        for(size_t i=lo; i<hi; ++i) visit<chunked>(first[i], keep);
+                    }, parts);
+                    size_t total = 0;
+                    for(auto& part : partial) total += part.size();
+                    out.reserve(total);
+                    for(auto& part : partial) out.insert(out.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+                }
+                else{
+                    auto append = [&out](auto&& x){ out.push_back(std::forward<decltype(x)>(x)); };
+                    for(auto&& x : r) visit<chunked>(std::forward<decltype(x)>(x), append);
+                }
+                return out;
+            }
+        };
+    }
+
+    namespace views{
+        // r | chunk_by_size(n): a random access range of subranges of n elements
+        inline detail::ChunkBySize chunk_by_size(std::ptrdiff_t n){ return {n}; }
+
+        // chunks | per_chunk(adaptor): every chunk | adaptor
+        template <typename Adaptor>
+        detail::PerChunk<Adaptor> per_chunk(Adaptor adaptor){ return {std::move(adaptor)}; }
+    }
+
+    // r | par_for_each(pool, f): f(x) for every element, in parallel
+    template <typename F>
+    detail::ForEach<F> par_for_each(ThreadPool& pool, F f){ return {pool, std::move(f)}; }
+
+    // r | par_collect(pool): the elements in a std::vector, in order, evaluated in parallel
+    inline detail::Collect par_collect(ThreadPool& pool){ return {pool}; }
+}
@@ -0,0 +1,223 @@
+/*
+Tests and scaling benchmark for the parallel algorithms (see parallel_algorithms.hpp)
+
+The benchmark runs every algorithm on the same array with the std algorithm and with pools of
+1, 2, 4 ... threads (counting the calling thread) and prints the time and speedup over std.
+find_if looks for an element in the middle, and one that doesn't exist (a full pass).
+Arguments: array length, largest thread count
+*/
+
+#include "parallel_algorithms.hpp"
+#include "vector.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <random>
+#include <span>
+#include <string>
+#include <cmath>
+#include <mutex>
+#include <cassert>
+#include <cstdlib>
+
+std::vector<int> random_ints(size_t n, unsigned seed = 1){
+    std::mt19937 gen(seed);
+    std::vector<int> v(n);
+    for(auto& x : v) x = static_cast<int>(gen() % 1000000);
+    return v;
+}
+
+void test_chunk_sizes(ThreadPool& pool){
+    // Every chunk has at least Grain elements, or there is a single one
+    for(size_t n : {size_t(1), par::Grain, par::Grain + 1, 2 * par::Grain - 1, 2 * par::Grain, 3 * par::Grain + 7, size_t(100000)}){
+        std::mutex mtx;
+        std::vector<size_t> sizes;
+        pool.parallel_for(0, n, [&](size_t lo, size_t hi){
+            std::lock_guard<std::mutex> lock(mtx);
+            sizes.push_back(hi - lo);
+        }, par::Grain);
+        assert(sizes.size() == 1 || *std::min_element(sizes.begin(), sizes.end()) >= par::Grain);
+        assert(std::accumulate(sizes.begin(), sizes.end(), size_t(0)) == n);
+        size_t parts = par::detail::chunks(pool, n);
+        assert(parts == 1 || n / parts >= par::Grain);
+    }
+}
+
+void test_elementwise(ThreadPool& pool){
+    for(size_t n : {0, 1, 4095, 4097, 100000}){
+        auto v = random_ints(n);
+        auto expected = v;
+        std::for_each(expected.begin(), expected.end(), [](int& x){ x *= 2; });
+        par::for_each(pool, v, [](int& x){ x *= 2; });
+        assert(v == expected);
+
+        std::vector<long> out(n), want(n);
+        std::transform(v.begin(), v.end(), want.begin(), [](int x){ return long(x) * x; });
+        assert(par::transform(pool, v, out.begin(), [](int x){ return long(x) * x; }) == out.end());
+        assert(out == want);
+
+        std::transform(v.begin(), v.end(), expected.begin(), want.begin(), [](int a, int b){ return long(a) - b; });
+        par::transform(pool, v, expected, out.begin(), [](int a, int b){ return long(a) - b; });
+        assert(out == want);
+    }
+}
+
+void test_reductions(ThreadPool& pool){
+    for(size_t n : {0, 1, 5000, 100001}){
+        auto v = random_ints(n, 2);
+        assert(par::reduce(pool, v, 0L) == std::accumulate(v.begin(), v.end(), 0L));
+        assert(par::reduce(pool, v, 7L) == std::accumulate(v.begin(), v.end(), 7L));
+        // Associative but not commutative: chunks must be combined in order
+        std::vector<std::string> words(n / 100 + 1);
+        for(size_t i=0; i<words.size(); ++i) words[i] = std::to_string(i % 10);
+        assert(par::reduce(pool, words, std::string(">")) == std::accumulate(words.begin(), words.end(), std::string(">")));
+
+        auto square = [](int x){ return long(x) * x; };
+        assert(par::transform_reduce(pool, v, 0L, std::plus<>(), square) == std::transform_reduce(v.begin(), v.end(), 0L, std::plus<>(), square));
+        std::vector<long> lv(v.begin(), v.end());
+        assert(par::transform_reduce(pool, lv, lv, 0L) == std::transform_reduce(lv.begin(), lv.end(), lv.begin(), 0L));
+
+        auto even = [](int x){ return x % 2 == 0; };
+        assert(par::count_if(pool, v, even) == static_cast<size_t>(std::count_if(v.begin(), v.end(), even)));
+
+        // Many ties: the first of the smallest / largest like std
+        for(auto& x : v) x %= 100;
+        assert(par::min_element(pool, v) == std::min_element(v.begin(), v.end()));
+        assert(par::max_element(pool, v) == std::max_element(v.begin(), v.end()));
+        auto by_last_digit = [](int a, int b){ return a % 10 < b % 10; };
+        assert(par::max_element(pool, v, by_last_digit) == std::max_element(v.begin(), v.end(), by_last_digit));
+    }
+}
+
+void test_find(ThreadPool& pool){
+    size_t n = 1000000;
+    std::vector<int> v(n, 0);
+    assert(par::find_if(pool, v, [](int x){ return x == 1; }) == v.end());
+    // The first of several matches, in different blocks and chunks
+    for(size_t at : {size_t(0), size_t(5), n / 3, n - 1}){
+        std::fill(v.begin(), v.end(), 0);
+        v[at] = 1;
+        if(at + 100000 < n) v[at + 100000] = 1;
+        v[n - 1] = 1;
+        assert(par::find_if(pool, v, [](int x){ return x == 1; }) - v.begin() == static_cast<long>(at));
+    }
+    std::vector<int> small = {3, 4, 5};
+    assert(*par::find_if(pool, small, [](int x){ return x > 3; }) == 4);
+}
+
+void test_scan(ThreadPool& pool){
+    for(size_t n : {0, 1, 4096, 4097, 100003}){
+        auto v = random_ints(n, 3);
+        std::vector<long> out(n), want(n);
+        std::inclusive_scan(v.begin(), v.end(), want.begin(), std::plus<long>());
+        par::inclusive_scan(pool, v, out.begin(), std::plus<long>());
+        assert(out == want);
+
+        // In place, with another operator
+        auto expected = v;
+        std::inclusive_scan(expected.begin(), expected.end(), expected.begin(), [](int a, int b){ return std::max(a, b); });
+        par::inclusive_scan(pool, v, v.begin(), [](int a, int b){ return std::max(a, b); });
+        assert(v == expected);
+    }
+}
+
+void test_ranges(ThreadPool& pool){
+    // Vector (checked iterators in sanitizer builds), spans and views
+    Vector<int> v;
+    for(int i=1; i<=10000; ++i) v.push_back(i);
+    assert(par::reduce(pool, v, 0) == 10000 * 10001 / 2);
+    assert(*par::find_if(pool, v, [](int x){ return x > 9000; }) == 9001);
+
+    std::vector<int> data(10000, 1);
+    assert(par::reduce(pool, std::span(data).subspan(100), 0) == 9900);
+    assert(par::count_if(pool, std::views::iota(0, 100000), [](int x){ return x % 3 == 0; }) == 33334);
+
+    bool threw = false;
+    try{ par::for_each(pool, data, [](int& x){ if(x == 1) throw std::runtime_error("stop"); }); }
+    catch(const std::runtime_error&){ threw = true; }
+    assert(threw);
+}
+
+template <typename F>
+double time_ms(F f){
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void Benchmark(size_t n, size_t max_threads){
+    std::vector<double> v(n), out(n);
+    std::mt19937 gen(4);
+    for(auto& x : v) x = std::uniform_real_distribution<double>(0.0, 1.0)(gen);
+    auto heavy = [](double x){ return std::sqrt(x) * std::sin(x); }; // a few ns per element, so not memory bound
+    volatile double sink = 0;
+
+    struct Row{ const char* name; std::function<void()> seq; std::function<void(ThreadPool&)> par; };
+    Row rows[] = {
+        {"for_each",         [&]{ std::for_each(out.begin(), out.end(), [&](double& x){ x = heavy(x); }); },
+                             [&](ThreadPool& p){ par::for_each(p, out, [&](double& x){ x = heavy(x); }); }},
+        {"transform",        [&]{ std::transform(v.begin(), v.end(), out.begin(), heavy); },
+                             [&](ThreadPool& p){ par::transform(p, v, out.begin(), heavy); }},
+        {"reduce",           [&]{ sink = std::reduce(v.begin(), v.end(), 0.0); },
+                             [&](ThreadPool& p){ sink = par::reduce(p, v, 0.0); }},
+        {"transform_reduce", [&]{ sink = std::transform_reduce(v.begin(), v.end(), 0.0, std::plus<>(), heavy); },
+                             [&](ThreadPool& p){ sink = par::transform_reduce(p, v, 0.0, std::plus<>(), heavy); }},
+        {"inclusive_scan",   [&]{ std::inclusive_scan(v.begin(), v.end(), out.begin()); },
+                             [&](ThreadPool& p){ par::inclusive_scan(p, v, out.begin()); }},
+        {"find_if (middle)", [&]{ sink = *std::find_if(v.begin(), v.end(), [&](double x){ return x == v[n / 2]; }); },
+                             [&](ThreadPool& p){ sink = *par::find_if(p, v, [&](double x){ return x == v[n / 2]; }); }},
+        {"find_if (none)",   [&]{ sink = std::find_if(v.begin(), v.end(), [](double x){ return x > 2; }) == v.end(); },
+                             [&](ThreadPool& p){ sink = par::find_if(p, v, [](double x){ return x > 2; }) == v.end(); }},
+        {"count_if",         [&]{ sink = static_cast<double>(std::count_if(v.begin(), v.end(), [](double x){ return x < 0.5; })); },
+                             [&](ThreadPool& p){ sink = static_cast<double>(par::count_if(p, v, [](double x){ return x < 0.5; })); }},
+        // Positions, not values: GCC turns *std::min_element into a vectorized minimum of the values
+        {"min_element",      [&]{ sink = static_cast<double>(std::min_element(v.begin(), v.end()) - v.begin()); },
+                             [&](ThreadPool& p){ sink = static_cast<double>(par::min_element(p, v) - v.begin()); }},
+        {"max_element",      [&]{ sink = static_cast<double>(std::max_element(v.begin(), v.end()) - v.begin()); },
+                             [&](ThreadPool& p){ sink = static_cast<double>(par::max_element(p, v) - v.begin()); }},
+    };
+
+    std::vector<size_t> thread_counts;
+    for(size_t t=1; t<=max_threads; t*=2) thread_counts.push_back(t);
+    std::cout << "\n" << std::left << std::setw(20) << "(ms, speedup)" << std::right << std::setw(10) << "std";
+    for(size_t t : thread_counts) std::cout << std::setw(9) << t << " thr" << std::setw(6) << "";
+    std::cout << "\n";
+    std::vector<std::unique_ptr<ThreadPool>> pools;
+    for(size_t t : thread_counts) pools.push_back(std::make_unique<ThreadPool>(t - 1)); // the calling thread takes one chunk
+
+    for(auto& row : rows){
+        double seq = time_ms(row.seq);
+        std::cout << std::left << std::setw(20) << row.name << std::right << std::fixed << std::setprecision(1) << std::setw(10) << seq;
+        for(auto& p : pools){
+            double t = time_ms([&]{ row.par(*p); });
+            std::cout << std::setw(9) << t << std::setw(5) << std::setprecision(1) << seq / t << "x" << std::setw(4) << "";
+        }
+        std::cout << "\n";
+        std::cout.unsetf(std::ios::fixed);
+    }
+}
+
+int main(int argc, char** argv){
+    ThreadPool pool(3);
+    test_chunk_sizes(pool);
+    test_elementwise(pool);
+    test_reductions(pool);
+    test_find(pool);
+    test_scan(pool);
+    test_ranges(pool);
+    ThreadPool no_workers(0);
+    test_reductions(no_workers);
+    test_scan(no_workers);
+    std::cout << "All parallel algorithm tests passed!\n";
+
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1 << 24;
+    size_t max_threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::max(1u, std::thread::hardware_concurrency());
+    std::cout << n << " doubles, up to " << max_threads << " threads" << std::endl;
+    Benchmark(n, max_threads);
+}
@@ -0,0 +1,207 @@
+#pragma once
+/*
+Parallel versions of the standard algorithms on a ThreadPool (see stl_algorithms.cpp for the
+sequential ones), for when std::execution::par isn't available (libstdc++ needs TBB for it)
+
+    par::for_each(pool, v, [](double& x){ x *= 2; });
+    par::transform(pool, v, out.begin(), [](double x){ return x * x; });
+    double sum = par::reduce(pool, v, 0.0);
+    auto it = par::find_if(pool, v, [](double x){ return x < 0; });
+
+Every algorithm takes the pool first (where std takes the execution policy) and a sized random
+access range: std::vector, Vector, std::span, views::iota... The range is split into one chunk
+per thread (the pool's workers and the calling thread), each at least Grain elements, so small
+ranges run on the calling thread alone. Results are the same as the std algorithms as long as
+the operations of reduce, transform_reduce and inclusive_scan are associative: chunks are
+combined in order, but the grouping differs (so float sums can differ in the last bits).
+The first exception thrown by an operation is rethrown once all chunks have finished.
+
+find_if stops early: threads claim blocks of Block elements in order and skip any block after a
+match that has already been found, so finding an element near the front costs about one block per
+thread instead of a pass over the whole range. count_if and min/max_element have to see every element.
+*/
+
+#include "threadpool.hpp"
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <ranges>
+#include <vector>
+
+namespace par{
+    template <typename R>
+    concept Range = std::ranges::random_access_range<R> && std::ranges::sized_range<R>;
+
+    constexpr size_t Grain = 4096;  // fewer elements per chunk aren't worth a thread
+    constexpr size_t Block = 16384; // find_if checks for an earlier match between blocks
+
+    namespace detail{
+        // Number of chunks for n elements: one per thread, at least Grain elements each
+        inline size_t chunks(ThreadPool& pool, size_t n){
+            return std::max<size_t>(1, std::min(pool.size() + 1, n / Grain));
+        }
+
+        // Runs f(c, lo, hi) for the chunks c = 0 .. parts - 1 covering [0, n), returns parts
+        template <typename F>
+        size_t for_each_chunk(ThreadPool& pool, size_t n, F&& f, size_t parts = 0){
+            if(parts == 0) parts = chunks(pool, n);
+            pool.parallel_for(0, parts, [&](size_t c0, size_t c1){
+                for(size_t c=c0; c<c1; ++c) f(c, n * c / parts, n * (c + 1) / parts);
+            });
+            return parts;
+        }
+    }
+
+    template <Range R, typename F>
+    void for_each(ThreadPool& pool, R&& r, F f){
+        auto first = std::ranges::begin(r);
+        pool.parallel_for(0, std::ranges::size(r), [&](size_t lo, size_t hi){
+            for(size_t i=lo; i<hi; ++i) std::invoke(f, first[i]);
+        }, Grain);
+    }
+
+    // out[i] = f(r[i]), returns the end of the output
+    template <Range R, std::random_access_iterator O, typename F>
+    O transform(ThreadPool& pool, R&& r, O out, F f){
+        auto first = std::ranges::begin(r);
+        size_t n = std::ranges::size(r);
+        pool.parallel_for(0, n, [&](size_t lo, size_t hi){
+            for(size_t i=lo; i<hi; ++i) out[i] = std::invoke(f, first[i]);
+        }, Grain);
+        return out + n;
+    }
+
+    // out[i] = f(r1[i], r2[i]) for the length of r1
+    template <Range R1, Range R2, std::random_access_iterator O, typename F>
+    O transform(ThreadPool& pool, R1&& r1, R2&& r2, O out, F f){
+        auto first1 = std::ranges::begin(r1);
+        auto first2 = std::ranges::begin(r2);
+        size_t n = std::ranges::size(r1);
+        pool.parallel_for(0, n, [&](size_t lo, size_t hi){
+            for(size_t i=lo; i<hi; ++i) out[i] = std::invoke(f, first1[i], first2[i]);
+        }, Grain);
+        return out + n;
+    }
+
+    // init op f(r[0]) op f(r[1]) ...: each chunk reduces its part, the parts are combined in order
+    template <Range R, typename T, typename Op, typename F>
+    T transform_reduce(ThreadPool& pool, R&& r, T init, Op op, F f){
+        auto first = std::ranges::begin(r);
+        std::vector<std::optional<T>> partial(pool.size() + 1);
+        size_t parts = detail::for_each_chunk(pool, std::ranges::size(r), [&](size_t c, size_t lo, size_t hi){
+            if(lo == hi) return;
+            T acc = std::invoke(f, first[lo]);
+            for(size_t i=lo+1; i<hi; ++i) acc = std::invoke(op, std::move(acc), std::invoke(f, first[i]));
+            partial[c] = std::move(acc);
+        });
+        for(size_t c=0; c<parts; ++c){
+            if(partial[c]) init = std::invoke(op, std::move(init), std::move(*partial[c]));
+        }
+        return init;
+    }
+
+    // Dot product style: init + r1[0] * r2[0] + ...
+    template <Range R1, Range R2, typename T>
+    T transform_reduce(ThreadPool& pool, R1&& r1, R2&& r2, T init){
+        auto first2 = std::ranges::begin(r2);
+        auto first1 = std::ranges::begin(r1);
+        auto indices = std::views::iota(size_t(0), static_cast<size_t>(std::ranges::size(r1)));
+        return transform_reduce(pool, indices, init, std::plus<>(), [&](size_t i){ return first1[i] * first2[i]; });
+    }
+
+    template <Range R, typename T, typename Op = std::plus<>>
+    T reduce(ThreadPool& pool, R&& r, T init, Op op = Op()){
+        return transform_reduce(pool, r, std::move(init), op, std::identity());
+    }
+
+    template <Range R, typename Pred>
+    size_t count_if(ThreadPool& pool, R&& r, Pred pred){
+        return transform_reduce(pool, r, size_t(0), std::plus<>(), [&](const auto& x){ return std::invoke(pred, x) ? size_t(1) : size_t(0); });
+    }
+
+    // First element with pred(x), or the end of the range
+    template <Range R, typename Pred>
+    auto find_if(ThreadPool& pool, R&& r, Pred pred){
+        auto first = std::ranges::begin(r);
+        size_t n = std::ranges::size(r);
+        if(n <= Block) return std::ranges::find_if(first, first + n, std::ref(pred));
+        std::atomic<size_t> found{n};   // smallest index with a match so far
+        std::atomic<size_t> next{0};    // next block to claim
+        size_t blocks = (n + Block - 1) / Block;
+        pool.parallel_for(0, pool.size() + 1, [&](size_t, size_t){
+            for(;;){
+                size_t b = next.fetch_add(1, std::memory_order_relaxed);
+                size_t lo = b * Block;
+                // Blocks are claimed in order, so once one starts after a match so do all later ones
+                if(b >= blocks || lo > found.load(std::memory_order_relaxed)) return;
+                size_t hi = std::min(n, lo + Block);
+                for(size_t i=lo; i<hi; ++i){
+                    if(std::invoke(pred, first[i])){
+                        size_t current = found.load(std::memory_order_relaxed);
+                        while(i < current && !found.compare_exchange_weak(current, i, std::memory_order_relaxed)){}
+                        return;
+                    }
+                }
+            }
+        });
+        return first + found.load();
+    }
+
+    // First smallest element (by comp) or the end of an empty range
+    template <Range R, typename Comp = std::less<>>
+    auto min_element(ThreadPool& pool, R&& r, Comp comp = Comp()){
+        auto first = std::ranges::begin(r);
+        size_t n = std::ranges::size(r);
+        std::vector<size_t> best(pool.size() + 1, n);
+        size_t parts = detail::for_each_chunk(pool, n, [&](size_t c, size_t lo, size_t hi){
+            if(lo == hi) return;
+            best[c] = static_cast<size_t>(std::min_element(first + lo, first + hi, comp) - first);
+        });
+        size_t m = n;
+        for(size_t c=0; c<parts; ++c){
+            // Only a strictly smaller element of a later chunk replaces the earlier one
+            if(best[c] != n && (m == n || std::invoke(comp, first[best[c]], first[m]))) m = best[c];
+        }
+        return first + m;
+    }
+
+    // First largest element (by comp) or the end of an empty range
+    template <Range R, typename Comp = std::less<>>
+    auto max_element(ThreadPool& pool, R&& r, Comp comp = Comp()){
+        // a is "smaller" than b in the reversed order if b < a, and ties keep the first, like std::max_element
+        return min_element(pool, r, [&](const auto& a, const auto& b){ return std::invoke(comp, b, a); });
+    }
+
+    // out[i] = r[0] op r[1] op ... op r[i]. Two passes: each chunk reduces its part, the chunk
+    // totals are scanned sequentially, then each chunk scans its part starting from the total before it
+    template <Range R, std::random_access_iterator O, typename Op = std::plus<>>
+    O inclusive_scan(ThreadPool& pool, R&& r, O out, Op op = Op()){
+        using T = std::ranges::range_value_t<R>;
+        auto first = std::ranges::begin(r);
+        size_t n = std::ranges::size(r);
+        size_t parts = detail::chunks(pool, n);
+        std::vector<std::optional<T>> totals(parts);
+        detail::for_each_chunk(pool, n, [&](size_t c, size_t lo, size_t hi){
+            if(lo == hi || c + 1 == parts) return; // the last total is never needed
+            T acc = first[lo];
+            for(size_t i=lo+1; i<hi; ++i) acc = std::invoke(op, std::move(acc), first[i]);
+            totals[c] = std::move(acc);
+        }, parts);
+        // carry[c] = everything before chunk c
+        std::vector<std::optional<T>> carry(parts);
+        for(size_t c=1; c<parts; ++c){
+            carry[c] = carry[c - 1] ? std::invoke(op, *carry[c - 1], *totals[c - 1]) : totals[c - 1];
+        }
+        detail::for_each_chunk(pool, n, [&](size_t c, size_t lo, size_t hi){
+            if(lo == hi) return;
+            T acc = carry[c] ? std::invoke(op, *carry[c], first[lo]) : T(first[lo]);
+            out[lo] = acc;
+            for(size_t i=lo+1; i<hi; ++i){
+                acc = std::invoke(op, std::move(acc), first[i]);
+                out[i] = acc;
+            }
+        }, parts);
+        return out + n;
+    }
+}
@@ -0,0 +1,117 @@
+/*
+Tests and benchmark for the parallel fill/copy/clear paths of Vector (see vector.hpp)
+
+Pass the number of elements as the first argument (e.g. 1000000000 for the 1e9 run, which needs
+about 8 GB for the source and the copy). The benchmark runs with 1 (serial), 2, 4, ... threads up to
+the number of hardware threads (or the second argument)
+*/
+
+#include "vector.hpp"
+#include "threadpool.hpp"
+#include <iostream>
+#include <chrono>
+#include <cassert>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
+
+void test_parallel_fill(){
+    ThreadPool pool(3);
+    Vector<int> v(1000000, 42, pool);
+    assert(v.size() == 1000000);
+    for(int x : v) assert(x == 42);
+
+    // Below the grain size everything runs on the calling thread
+    Vector<int> small(10, 7, pool);
+    assert(small.size() == 10 && small.back() == 7);
+}
+
+void test_parallel_copy_and_clear(){
+    ThreadPool pool(4);
+    Vector<std::string> src;
+    for(int i=0; i<300000; ++i) src.push_back(std::to_string(i));
+    Vector<std::string> copy(src, pool);
+    assert(copy.size() == src.size());
+    for(size_t i=0; i<src.size(); ++i) assert(copy[i] == src[i]);
+
+    copy.clear(pool);
+    assert(copy.empty() && copy.capacity() == src.size());
+}
+
+void test_exception_propagates(){
+    struct Throws{
+        Throws() = default;
+        Throws(const Throws&){ throw std::runtime_error("copy failed"); }
+    };
+    ThreadPool pool(2);
+    bool thrown = false;
+    try{
+        Vector<Throws> v(1000000, Throws{}, pool);
+    }
+    catch(const std::runtime_error&){
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+struct Tracked{
+    static inline std::atomic<long> live{0};
+    bool poison = false;
+    Tracked(){ ++live; }
+    Tracked(const Tracked& other) : poison(other.poison) {
+        if(poison) throw std::runtime_error("copy failed");
+        ++live;
+    }
+    ~Tracked(){ --live; }
+};
+
+void test_exception_cleans_up(){
+    // One element in the middle of a chunk can't be copied: the other chunks finish, and everything
+    // constructed in any chunk must be destroyed again
+    ThreadPool pool(3);
+    {
+        Vector<Tracked> src(1000000, Tracked{}, pool);
+        src[700000].poison = true;
+        long before = Tracked::live;
+        bool thrown = false;
+        try{
+            Vector<Tracked> copy(src, pool);
+        }
+        catch(const std::runtime_error&){
+            thrown = true;
+        }
+        assert(thrown && Tracked::live == before);
+    }
+    assert(Tracked::live == 0);
+}
+
+int main(int argc, char** argv){
+    test_parallel_fill();
+    test_parallel_copy_and_clear();
+    test_exception_propagates();
+    test_exception_cleans_up();
+    std::cout << "All parallel Vector tests passed!\n";
+
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000000;
+    size_t max_threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+    max_threads = std::max<size_t>(max_threads, 1);
+    using clock = std::chrono::high_resolution_clock;
+    auto ms = [](auto d){ return std::chrono::duration<double, std::milli>(d).count(); };
+
+    std::cout << "Fill and copy of " << n << " ints" << std::endl;
+    for(size_t threads = 1; threads <= max_threads; threads *= 2){
+        ThreadPool pool(threads - 1); // the calling thread takes one chunk
+
+        auto start = clock::now();
+        Vector<int> filled(n, 1, pool);
+        auto mid = clock::now();
+        Vector<int> copied(filled, pool);
+        auto end = clock::now();
+        assert(copied[n - 1] == 1);
+
+        std::cout << threads << " thread(s)  fill: " << ms(mid - start) << " ms"
+                  << "  copy: " << ms(end - mid) << " ms" << std::endl;
+    }
+}
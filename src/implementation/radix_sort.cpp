@@ -0,0 +1,190 @@
+/*
+Tests and benchmark for the radix sort (see radix_sort.hpp)
+
+The benchmark sorts random keys with std::sort, std::sort(std::execution::par), and radix::sort
+on one thread and on a ThreadPool. std::execution::par needs TBB: link with -ltbb, without TBB
+headers libstdc++ runs it sequentially.
+Arguments: smallest and largest number of keys (10^9 int32 keys need 8GB with the buffers), threads
+*/
+
+#include "radix_sort.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <execution>
+#include <vector>
+#include <string>
+#include <random>
+#include <cmath>
+#include <cassert>
+#include <cstdlib>
+
+template <typename T>
+std::vector<T> random_keys(size_t n, unsigned seed = 1){
+    std::mt19937_64 gen(seed);
+    std::vector<T> v(n);
+    for(auto& x : v){
+        if constexpr (std::is_integral_v<T>) x = static_cast<T>(gen()); // full range, negatives included
+        else x = static_cast<T>(std::uniform_real_distribution<double>(-1e9, 1e9)(gen));
+    }
+    return v;
+}
+
+void test_to_unsigned(){
+    // The order of the mapped keys is the order of the keys
+    assert(radix::to_unsigned(int32_t(-1)) < radix::to_unsigned(int32_t(0)));
+    assert(radix::to_unsigned(INT32_MIN) == 0 && radix::to_unsigned(INT32_MAX) == UINT32_MAX);
+    assert(radix::to_unsigned(-INFINITY) < radix::to_unsigned(-1.5f));
+    assert(radix::to_unsigned(-1.5f) < radix::to_unsigned(-1.0f));
+    assert(radix::to_unsigned(-0.0f) < radix::to_unsigned(0.0f));
+    assert(radix::to_unsigned(0.0f) < radix::to_unsigned(1e-45f));
+    assert(radix::to_unsigned(2.0) < radix::to_unsigned(std::numeric_limits<double>::infinity()));
+    assert(radix::to_unsigned(int8_t(-128)) == 0 && radix::to_unsigned(uint64_t(5)) == 5);
+}
+
+template <typename T>
+void check_sort(std::vector<T> v, ThreadPool& pool){
+    auto expected = v, parallel = v;
+    std::sort(expected.begin(), expected.end());
+    radix::sort(v);
+    assert(v == expected);
+    radix::sort(parallel, pool);
+    assert(parallel == expected);
+}
+
+template <typename T>
+void test_keys(ThreadPool& pool){
+    // Below and above the insertion sort and parallel thresholds
+    for(size_t n : {0, 1, 2, 50, 65, 1000, 70000, 300000}){
+        auto v = random_keys<T>(n, static_cast<unsigned>(n));
+        check_sort(v, pool);
+        // Small keys: the high bytes are skipped, and one bucket gets everything (skewed path)
+        for(auto& x : v) x = static_cast<T>(std::abs(static_cast<double>(x))) % 1000;
+        check_sort(v, pool);
+    }
+}
+
+template <typename T>
+void test_floats(ThreadPool& pool){
+    for(size_t n : {10, 1000, 200000}){
+        auto v = random_keys<T>(n, 3);
+        v[0] = INFINITY;
+        v[n / 2] = -INFINITY;
+        v[n - 1] = std::numeric_limits<T>::denorm_min();
+        v[1] = -std::numeric_limits<T>::max();
+        check_sort(v, pool);
+    }
+    std::vector<T> zeros = {0.0, -0.0, 0.0, -0.0};
+    radix::sort(zeros);
+    assert(std::signbit(zeros[0]) && std::signbit(zeros[1]) && !std::signbit(zeros[2]));
+}
+
+void test_stable_pairs(ThreadPool& pool){
+    // Many equal keys, the values record the original position
+    for(size_t n : {100, 100000}){
+        std::vector<uint32_t> keys(n), values(n);
+        std::mt19937 gen(5);
+        for(size_t i=0; i<n; ++i){
+            keys[i] = gen() % 500 + (i % 2 ? 0x01000000u : 0); // two top bytes, so the MSD split is used
+            values[i] = static_cast<uint32_t>(i);
+        }
+        for(ThreadPool* p : {static_cast<ThreadPool*>(nullptr), &pool}){
+            auto k = keys;
+            auto v = values;
+            if(p) radix::sort_pairs(k, v, *p);
+            else radix::sort_pairs(k, v);
+            assert(std::is_sorted(k.begin(), k.end()));
+            for(size_t i=0; i<n; ++i){
+                assert(keys[v[i]] == k[i]);                      // value moved with its key
+                if(i > 0 && k[i] == k[i - 1]) assert(v[i] > v[i - 1]); // stable
+            }
+        }
+    }
+
+    std::vector<int> k = {1, 2};
+    std::vector<int> v = {1};
+    bool threw = false;
+    try{ radix::sort_pairs(k, v); }
+    catch(const std::invalid_argument&){ threw = true; }
+    assert(threw);
+}
+
+void test_records(ThreadPool& pool){
+    struct Record{ std::string name; double score; };
+    std::vector<Record> records;
+    for(int i=0; i<100000; ++i) records.push_back({"r" + std::to_string(i), static_cast<double>((i * 7919) % 1000) - 500.5});
+    auto expected = records;
+    std::stable_sort(expected.begin(), expected.end(), [](const Record& a, const Record& b){ return a.score < b.score; });
+    radix::sort_by_key(records, [](const Record& r){ return r.score; }, pool);
+    for(size_t i=0; i<records.size(); ++i) assert(records[i].name == expected[i].name);
+
+    std::vector<std::pair<int64_t, char>> pairs = {{3, 'a'}, {-1, 'b'}, {3, 'c'}, {0, 'd'}};
+    radix::sort_by_key(pairs, [](const auto& p){ return p.first; });
+    assert(pairs[0].second == 'b' && pairs[1].second == 'd' && pairs[2].second == 'a' && pairs[3].second == 'c');
+}
+
+void test_vector(ThreadPool& pool){
+    Vector<int16_t> v;
+    for(int i=0; i<1000; ++i) v.push_back(static_cast<int16_t>((i * 12345) % 65536 - 32768));
+    radix::sort(v);
+    assert(std::is_sorted(v.begin(), v.end()));
+
+    Vector<uint64_t> big;
+    for(uint64_t x : random_keys<uint64_t>(100000)) big.push_back(x);
+    radix::sort(big, pool);
+    assert(std::is_sorted(big.begin(), big.end()));
+}
+
+template <typename F>
+double time_ms(F f){
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template <typename T>
+void Benchmark(const char* type, size_t min_n, size_t max_n, ThreadPool& pool){
+    std::cout << "\n" << std::left << std::setw(14) << type << std::right << std::setw(12) << "std::sort" << std::setw(12) << "std par"
+              << std::setw(12) << "radix" << std::setw(14) << "radix pool" << "   (ms)\n";
+    for(size_t n=min_n; n<=max_n; n*=10){
+        auto data = random_keys<T>(n);
+        auto v = data;
+        double t_std = time_ms([&]{ std::sort(v.begin(), v.end()); });
+        v = data;
+        double t_par = time_ms([&]{ std::sort(std::execution::par, v.begin(), v.end()); });
+        v = data;
+        double t_radix = time_ms([&]{ radix::sort(v); });
+        v = data;
+        double t_pool = time_ms([&]{ radix::sort(v, pool); });
+        std::cout << std::left << std::setw(14) << n << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << t_std << std::setw(12) << t_par << std::setw(12) << t_radix << std::setw(14) << t_pool << "\n";
+        std::cout.unsetf(std::ios::fixed);
+        if(max_n / 10 < n) break;
+    }
+}
+
+int main(int argc, char** argv){
+    ThreadPool test_pool(3);
+    test_to_unsigned();
+    test_keys<int32_t>(test_pool);
+    test_keys<uint32_t>(test_pool);
+    test_keys<int64_t>(test_pool);
+    test_keys<int8_t>(test_pool);
+    test_floats<float>(test_pool);
+    test_floats<double>(test_pool);
+    test_stable_pairs(test_pool);
+    test_records(test_pool);
+    test_vector(test_pool);
+    std::cout << "All radix sort tests passed!\n";
+
+    size_t min_n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t max_n = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10000000;
+    size_t threads = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : std::max(1u, std::thread::hardware_concurrency());
+    ThreadPool pool(threads - 1); // the calling thread takes one chunk
+    std::cout << threads << " threads" << std::endl;
+    Benchmark<int32_t>("int32", min_n, max_n, pool);
+    Benchmark<uint64_t>("uint64", min_n, max_n, pool);
+    Benchmark<float>("float", min_n, max_n, pool);
+    Benchmark<double>("double", min_n, max_n, pool);
+}
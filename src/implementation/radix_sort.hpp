@@ -0,0 +1,335 @@
+#pragma once
+/*
+Radix sort for integer and floating point keys, sequential or on a ThreadPool
+
+    radix::sort(v);                                     // Vector<T>, std::vector, std::span...
+    radix::sort(v, pool);                               // multi-threaded
+    radix::sort_pairs(keys, values, pool);              // values reordered with their keys
+    radix::sort_by_key(records, [](const Rec& r){ return r.id; });
+
+Keys are integers of any size (signed or not, not bool), float and double. They are mapped to
+unsigned integers with the same order (to_unsigned): the sign bit of signed integers is flipped,
+negative floats have all bits flipped and positive ones the sign bit set. So -0.0 sorts before
++0.0 and NaNs go to the ends (by their sign bit). The sort is stable, needs a buffer of n
+elements (and n values), so elements must be default constructible, and moves them with move
+assignment.
+
+One pass per byte, each a stable counting sort: count the bytes, turn the counts into offsets,
+move every element to its offset. Bytes above the highest one where the keys differ are skipped,
+and so is any pass where all keys have the same byte (small integers, sorted runs).
+
+Sequential: LSD (least significant byte first), the counts of all bytes in one read.
+Parallel (n >= 2^16): one chunk per thread, each with its own counts, so the threads write to
+disjoint slots. The first pass is on the highest byte (MSD) and splits the array into 256
+buckets that are then sorted independently by LSD, each by one thread, taking the largest first.
+The buckets fit in cache far better than the whole array. If one bucket holds more than half the
+keys the split would leave the threads idle, so it sorts by parallel LSD passes instead.
+*/
+
+#include "threadpool.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace radix{
+    template <typename T>
+    concept Key = (std::is_integral_v<T> && !std::is_same_v<T, bool>)
+               || (std::is_floating_point_v<T> && std::numeric_limits<T>::is_iec559 && (sizeof(T) == 4 || sizeof(T) == 8));
+
+    template <Key T>
+    using unsigned_key_t = std::conditional_t<sizeof(T) == 1, uint8_t,
+                           std::conditional_t<sizeof(T) == 2, uint16_t,
+                           std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>>;
+
+    // Order preserving map to unsigned integers
+    template <Key T>
+    constexpr unsigned_key_t<T> to_unsigned(T x){
+        using U = unsigned_key_t<T>;
+        constexpr U sign = U(1) << (sizeof(T) * 8 - 1);
+        if constexpr (std::is_floating_point_v<T>){
+            U bits = std::bit_cast<U>(x);
+            return (bits & sign) ? U(~bits) : U(bits | sign);
+        }
+        else if constexpr (std::is_signed_v<T>) return static_cast<U>(static_cast<U>(x) ^ sign);
+        else return static_cast<U>(x);
+    }
+
+    namespace detail{
+        constexpr size_t Radix = 256;
+        constexpr size_t InsertionSortMax = 64;
+        constexpr size_t ParallelMin = size_t(1) << 16;
+        using Histogram = std::array<size_t, Radix>;
+
+        struct NoValues{};
+
+        // Sorts T by key_of(T), moving values[i] with element i unless V is NoValues
+        template <typename T, typename V, typename KeyOf>
+        class Sorter{
+            static constexpr bool HasValues = !std::is_same_v<V, NoValues>;
+            using K = std::remove_cvref_t<std::invoke_result_t<KeyOf&, const T&>>;
+            using U = unsigned_key_t<K>;
+
+        public:
+            Sorter(KeyOf key_of, ThreadPool* pool) : key_of_(std::move(key_of)), pool_(pool) {}
+
+            void sort(T* a, V* va, size_t n){
+                if(n < 2) return;
+                bool parallel = pool_ && pool_->size() > 0 && n >= ParallelMin;
+                // Only the bytes up to the highest one where some key differs from the first
+                U diff = parallel ? parallel_diff(a, n) : diff_from(a, key(a[0]), 0, n);
+                if(diff == 0) return;
+                int bytes = (std::bit_width(diff) + 7) / 8;
+
+                auto tmp = std::make_unique_for_overwrite<T[]>(n);
+                std::unique_ptr<V[]> vtmp;
+                if constexpr (HasValues) vtmp = std::make_unique_for_overwrite<V[]>(n);
+                if(parallel){
+                    parallel_sort(a, va, tmp.get(), vtmp.get(), n, bytes);
+                }
+                else if(lsd(a, va, tmp.get(), vtmp.get(), n, bytes)){
+                    move(tmp.get(), vtmp.get(), a, va, 0, n);
+                }
+            }
+
+        private:
+            U key(const T& x) const { return to_unsigned(key_of_(x)); }
+            static size_t digit(U k, int byte){ return static_cast<size_t>((k >> (8 * byte)) & 0xFF); }
+
+            // values + i, but a null NoValues pointer stays null
+            static V* at(V* values, size_t i){
+                if constexpr (HasValues) return values + i;
+                else return values;
+            }
+
+            static void move(T* src, V* vsrc, T* dst, V* vdst, size_t lo, size_t hi){
+                std::move(src + lo, src + hi, dst + lo);
+                if constexpr (HasValues) std::move(vsrc + lo, vsrc + hi, vdst + lo);
+            }
+
+            // Elements [lo, hi) of src to dst at offsets[digit], advancing the offsets
+            void scatter(T* src, V* vsrc, T* dst, V* vdst, size_t lo, size_t hi, int byte, Histogram& offsets) const {
+                for(size_t i=lo; i<hi; ++i){
+                    size_t to = offsets[digit(key(src[i]), byte)]++;
+                    dst[to] = std::move(src[i]);
+                    if constexpr (HasValues) vdst[to] = std::move(vsrc[i]);
+                }
+            }
+
+            void insertion_sort(T* a, V* va, size_t n) const {
+                for(size_t i=1; i<n; ++i){
+                    U k = key(a[i]);
+                    if(key(a[i - 1]) <= k) continue;
+                    T x = std::move(a[i]);
+                    size_t j = i;
+                    if constexpr (HasValues){
+                        V v = std::move(va[i]);
+                        for(; j > 0 && key(a[j - 1]) > k; --j){
+                            a[j] = std::move(a[j - 1]);
+                            va[j] = std::move(va[j - 1]);
+                        }
+                        va[j] = std::move(v);
+                    }
+                    else{
+                        for(; j > 0 && key(a[j - 1]) > k; --j) a[j] = std::move(a[j - 1]);
+                    }
+                    a[j] = std::move(x);
+                }
+            }
+
+            // Sorts a by its lowest bytes, using b as the buffer. Returns true if the result ended up in b
+            bool lsd(T* a, V* va, T* b, V* vb, size_t n, int bytes) const {
+                if(n <= InsertionSortMax){
+                    insertion_sort(a, va, n);
+                    return false;
+                }
+                std::array<Histogram, sizeof(U)> counts{};
+                for(size_t i=0; i<n; ++i){
+                    U k = key(a[i]);
+                    for(int byte=0; byte<bytes; ++byte) ++counts[byte][digit(k, byte)];
+                }
+                bool in_b = false;
+                for(int byte=0; byte<bytes; ++byte){
+                    Histogram& offsets = counts[byte];
+                    if(offsets[digit(key(a[0]), byte)] == n) continue; // all the same
+                    std::exclusive_scan(offsets.begin(), offsets.end(), offsets.begin(), size_t(0));
+                    scatter(a, va, b, vb, 0, n, byte, offsets);
+                    std::swap(a, b);
+                    std::swap(va, vb);
+                    in_b = !in_b;
+                }
+                return in_b;
+            }
+
+            // Bits where some key of [lo, hi) differs from first
+            U diff_from(const T* a, U first, size_t lo, size_t hi) const {
+                U diff = 0;
+                for(size_t i=lo; i<hi; ++i) diff |= key(a[i]) ^ first;
+                return diff;
+            }
+
+            size_t chunks() const { return pool_->size() + 1; }
+            static size_t chunk_begin(size_t n, size_t c, size_t chunks){ return n * c / chunks; }
+
+            U parallel_diff(const T* a, size_t n) const {
+                std::vector<U> diffs(chunks());
+                U first = key(a[0]);
+                pool_->parallel_for(0, chunks(), [&](size_t c0, size_t c1){
+                    for(size_t c=c0; c<c1; ++c) diffs[c] = diff_from(a, first, chunk_begin(n, c, chunks()), chunk_begin(n, c + 1, chunks()));
+                });
+                return std::accumulate(diffs.begin(), diffs.end(), U(0), std::bit_or<U>());
+            }
+
+            // Per chunk counts of one byte, turned into each chunk's first slot per digit (bucket b of
+            // chunk c goes after bucket b of chunks < c). Returns the size of each bucket
+            Histogram count_and_offsets(const T* src, size_t n, int byte, std::vector<Histogram>& offsets) const {
+                size_t parts = chunks();
+                offsets.assign(parts, Histogram{});
+                pool_->parallel_for(0, parts, [&](size_t c0, size_t c1){
+                    for(size_t c=c0; c<c1; ++c){
+                        for(size_t i=chunk_begin(n, c, parts); i<chunk_begin(n, c + 1, parts); ++i) ++offsets[c][digit(key(src[i]), byte)];
+                    }
+                });
+                Histogram sizes{};
+                size_t sum = 0;
+                for(size_t d=0; d<Radix; ++d){
+                    for(size_t c=0; c<parts; ++c){
+                        sizes[d] += offsets[c][d];
+                        size_t count = offsets[c][d];
+                        offsets[c][d] = sum;
+                        sum += count;
+                    }
+                }
+                return sizes;
+            }
+
+            void parallel_scatter(T* src, V* vsrc, T* dst, V* vdst, size_t n, int byte, std::vector<Histogram>& offsets) const {
+                size_t parts = chunks();
+                pool_->parallel_for(0, parts, [&](size_t c0, size_t c1){
+                    for(size_t c=c0; c<c1; ++c) scatter(src, vsrc, dst, vdst, chunk_begin(n, c, parts), chunk_begin(n, c + 1, parts), byte, offsets[c]);
+                });
+            }
+
+            void parallel_move(T* src, V* vsrc, T* dst, V* vdst, size_t n) const {
+                pool_->parallel_for(0, n, [&](size_t lo, size_t hi){ move(src, vsrc, dst, vdst, lo, hi); });
+            }
+
+            void parallel_sort(T* a, V* va, T* b, V* vb, size_t n, int bytes) const {
+                int top = bytes - 1;
+                std::vector<Histogram> offsets;
+                Histogram sizes = count_and_offsets(a, n, top, offsets);
+
+                if(*std::max_element(sizes.begin(), sizes.end()) > n / 2){
+                    // Skewed: parallel LSD over the whole array
+                    bool in_b = false;
+                    for(int byte=0; byte<bytes; ++byte){
+                        sizes = count_and_offsets(a, n, byte, offsets);
+                        if(sizes[digit(key(a[0]), byte)] == n) continue;
+                        parallel_scatter(a, va, b, vb, n, byte, offsets);
+                        std::swap(a, b);
+                        std::swap(va, vb);
+                        in_b = !in_b;
+                    }
+                    if(in_b) parallel_move(a, va, b, vb, n);
+                    return;
+                }
+
+                // MSD: split into buckets by the top byte, into b
+                parallel_scatter(a, va, b, vb, n, top, offsets);
+                if(top == 0){
+                    parallel_move(b, vb, a, va, n);
+                    return;
+                }
+                Histogram starts;
+                std::exclusive_scan(sizes.begin(), sizes.end(), starts.begin(), size_t(0));
+                std::array<size_t, Radix> order;
+                std::iota(order.begin(), order.end(), size_t(0));
+                std::sort(order.begin(), order.end(), [&](size_t x, size_t y){ return sizes[x] > sizes[y]; });
+
+                // Each thread takes the next largest bucket and sorts it by LSD back into a
+                std::atomic<size_t> next{0};
+                pool_->parallel_for(0, chunks(), [&](size_t, size_t){
+                    for(;;){
+                        size_t i = next.fetch_add(1, std::memory_order_relaxed);
+                        if(i >= Radix || sizes[order[i]] == 0) return;
+                        size_t lo = starts[order[i]], len = sizes[order[i]];
+                        if(!lsd(b + lo, at(vb, lo), a + lo, at(va, lo), len, top)) move(b, vb, a, va, lo, lo + len);
+                    }
+                });
+            }
+
+            KeyOf key_of_;
+            ThreadPool* pool_;
+        };
+
+        struct Identity{
+            template <typename T>
+            const T& operator()(const T& x) const { return x; }
+        };
+
+        // Vector (also with its checked iterators) and any contiguous range as a span
+        template <typename T, typename Alloc>
+        std::span<T> as_span(Vector<T, Alloc>& v){ return {v.data(), v.size()}; }
+        template <std::ranges::contiguous_range R>
+        auto as_span(R&& r){ return std::span(std::ranges::data(r), std::ranges::size(r)); }
+
+        template <typename R>
+        using element_t = typename decltype(as_span(std::declval<R&>()))::element_type;
+
+        template <typename K, typename V>
+        void sort_pairs(std::span<K> keys, std::span<V> values, ThreadPool* pool){
+            if(keys.size() != values.size()) throw std::invalid_argument("radix::sort_pairs: keys and values have different lengths");
+            Sorter<K, V, Identity>(Identity{}, pool).sort(keys.data(), values.data(), keys.size());
+        }
+    }
+
+    template <typename R>
+    concept Contiguous = requires(R& r){ detail::as_span(r); };
+
+    template <Contiguous R> requires Key<detail::element_t<R>>
+    void sort(R&& keys){
+        auto s = detail::as_span(keys);
+        detail::Sorter<detail::element_t<R>, detail::NoValues, detail::Identity>(detail::Identity{}, nullptr).sort(s.data(), nullptr, s.size());
+    }
+
+    template <Contiguous R> requires Key<detail::element_t<R>>
+    void sort(R&& keys, ThreadPool& pool){
+        auto s = detail::as_span(keys);
+        detail::Sorter<detail::element_t<R>, detail::NoValues, detail::Identity>(detail::Identity{}, &pool).sort(s.data(), nullptr, s.size());
+    }
+
+    // Sorts records by a key computed from each, e.g. the first member of pairs
+    template <Contiguous R, typename KeyOf> requires Key<std::remove_cvref_t<std::invoke_result_t<KeyOf&, const detail::element_t<R>&>>>
+    void sort_by_key(R&& records, KeyOf key_of){
+        auto s = detail::as_span(records);
+        detail::Sorter<detail::element_t<R>, detail::NoValues, KeyOf>(std::move(key_of), nullptr).sort(s.data(), nullptr, s.size());
+    }
+
+    template <Contiguous R, typename KeyOf> requires Key<std::remove_cvref_t<std::invoke_result_t<KeyOf&, const detail::element_t<R>&>>>
+    void sort_by_key(R&& records, KeyOf key_of, ThreadPool& pool){
+        auto s = detail::as_span(records);
+        detail::Sorter<detail::element_t<R>, detail::NoValues, KeyOf>(std::move(key_of), &pool).sort(s.data(), nullptr, s.size());
+    }
+
+    // Sorts keys and applies the same permutation to values (separate arrays of the same length)
+    template <Contiguous RK, Contiguous RV> requires Key<detail::element_t<RK>>
+    void sort_pairs(RK&& keys, RV&& values){
+        detail::sort_pairs(detail::as_span(keys), detail::as_span(values), nullptr);
+    }
+
+    template <Contiguous RK, Contiguous RV> requires Key<detail::element_t<RK>>
+    void sort_pairs(RK&& keys, RV&& values, ThreadPool& pool){
+        detail::sort_pairs(detail::as_span(keys), detail::as_span(values), &pool);
+    }
+}
@@ -0,0 +1,185 @@
+/*
+Tests and benchmark for the parallel SIMD prefix sums (see scan.hpp)
+
+The tests compare every instruction set, with and without a pool, against std::inclusive_scan and
+std::exclusive_scan for lengths around the register widths and the chunk size. The benchmark scans
+int32, int64 and float arrays with std::inclusive_scan, scan::inclusive_scan on the calling thread,
+and on a ThreadPool, and prints the time per element and the bandwidth (one read and one write).
+Arguments: array length, threads
+*/
+
+#include "scan.hpp"
+#include "vector.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <numeric>
+#include <random>
+#include <span>
+#include <string>
+#include <cassert>
+#include <cstdlib>
+
+constexpr simd::Isa ScanIsas[] = {simd::Isa::Scalar, simd::Isa::AVX2, simd::Isa::AVX512};
+
+// Small integers, so float sums are exact whatever the grouping
+template <typename T>
+std::vector<T> random_values(size_t n, unsigned seed = 1){
+    std::mt19937 gen(seed);
+    std::vector<T> v(n);
+    for(auto& x : v) x = static_cast<T>(static_cast<int>(gen() % 200) - 100);
+    return v;
+}
+
+template <typename T, typename Op>
+void check(const std::vector<T>& v, Op op, ThreadPool* pool){
+    std::vector<T> want(v.size()), out(v.size(), T{7});
+    std::inclusive_scan(v.begin(), v.end(), want.begin(), op);
+    if(pool) scan::inclusive_scan(*pool, v, out.begin(), op);
+    else scan::inclusive_scan(v, out.begin(), op);
+    assert(out == want);
+
+    T init = T{5};
+    std::exclusive_scan(v.begin(), v.end(), want.begin(), init, op);
+    if(pool) assert(scan::exclusive_scan(*pool, v, out.begin(), init, op) == out.end());
+    else scan::exclusive_scan(v, out.begin(), init, op);
+    assert(out == want);
+
+    // In place
+    out = v;
+    if(pool) scan::exclusive_scan(*pool, out, out.begin(), init, op);
+    else scan::exclusive_scan(out, out.begin(), init, op);
+    assert(out == want);
+}
+
+template <typename T>
+void test_lanes(ThreadPool& pool){
+    simd::Isa best = scan::scan_isa();
+    for(simd::Isa isa : ScanIsas){
+        if(!simd::supported(isa)) continue;
+        scan::scan_isa() = isa;
+        // Every tail of a register, then several chunks with uneven ends
+        std::vector<size_t> lengths;
+        for(size_t n=0; n<=40; ++n) lengths.push_back(n);
+        for(size_t n : {scan::Grain - 1, 3 * scan::Grain + 5, 5 * scan::Grain + 17}) lengths.push_back(n);
+        for(size_t n : lengths){
+            auto v = random_values<T>(n, static_cast<unsigned>(n));
+            for(ThreadPool* p : {static_cast<ThreadPool*>(nullptr), &pool}){
+                check(v, scan::Plus(), p);
+                check(v, std::plus<>(), p);
+                check(v, scan::Min(), p);
+                check(v, scan::Max(), p);
+            }
+        }
+    }
+    scan::scan_isa() = best;
+}
+
+void test_wrap_around(){
+    // Integer sums wrap like the SIMD adds
+    std::vector<int32_t> v(100, INT32_MAX);
+    std::vector<int32_t> out(100);
+    scan::inclusive_scan(v, out.begin());
+    for(size_t i=0; i<v.size(); ++i) assert(out[i] == static_cast<int32_t>(static_cast<uint32_t>(INT32_MAX) * (i + 1)));
+
+    std::vector<int64_t> big(50, int64_t(1) << 40), sums(50);
+    scan::inclusive_scan(big, sums.begin());
+    assert(sums.back() == (int64_t(50) << 40));
+}
+
+void test_custom(ThreadPool& pool){
+    // Associative but not commutative: chunks must be combined in order
+    std::vector<std::string> words(1000), out(1000), expected(1000);
+    for(size_t i=0; i<words.size(); ++i) words[i] = std::to_string(i % 10);
+    auto concat = [](std::string a, const std::string& b){ return a + b; };
+    std::inclusive_scan(words.begin(), words.end(), expected.begin(), concat);
+    scan::inclusive_scan(pool, words, out.begin(), concat);
+    assert(out == expected);
+    std::exclusive_scan(words.begin(), words.end(), expected.begin(), std::string(">"), concat);
+    scan::exclusive_scan(pool, words, out.begin(), std::string(">"), concat);
+    assert(out == expected);
+
+    // A custom operator on a SIMD type: the generic path, with a pool
+    std::vector<int64_t> v = random_values<int64_t>(300000, 9), a(v.size()), b(v.size());
+    auto xor_op = [](int64_t x, int64_t y){ return x ^ y; };
+    std::inclusive_scan(v.begin(), v.end(), a.begin(), xor_op);
+    scan::inclusive_scan(pool, v, b.begin(), xor_op);
+    assert(a == b);
+    std::exclusive_scan(v.begin(), v.end(), a.begin(), int64_t(3), xor_op);
+    scan::exclusive_scan(pool, v, b.begin(), int64_t(3), xor_op);
+    assert(a == b);
+
+    // A wider accumulator than the elements, and a different output type
+    std::vector<int32_t> ints(300000, 1 << 20);
+    std::vector<int64_t> wide(ints.size());
+    scan::exclusive_scan(pool, ints, wide.begin(), int64_t(0));
+    assert(wide.back() == int64_t(ints.size() - 1) << 20);
+}
+
+void test_ranges(ThreadPool& pool){
+    // Vector (checked iterators in sanitizer builds), spans and views
+    Vector<float> v;
+    for(int i=0; i<1000; ++i) v.push_back(1.0f);
+    std::vector<float> out(1000);
+    scan::inclusive_scan(pool, v, out.begin());
+    assert(out[999] == 1000.0f);
+
+    std::vector<double> d(200000, 0.5);
+    std::span<double> tail(d.data() + 100000, 100000);
+    scan::inclusive_scan(pool, tail, tail.begin());
+    assert(d[99999] == 0.5 && d.back() == 50000.0);
+
+    std::vector<long> iota(100000);
+    scan::exclusive_scan(pool, std::views::iota(0L, 100000L), iota.begin(), 0L);
+    assert(iota.back() == 99999L * 99998 / 2);
+}
+
+template <typename F>
+double time_ms(F f){
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template <typename T>
+void Benchmark(const char* type, size_t n, ThreadPool& pool){
+    auto v = random_values<T>(n);
+    std::vector<T> out(n);
+    auto row = [&](const char* name, auto f){
+        f(); // warm up (page faults of out)
+        double t = time_ms(f);
+        double gb = 2.0 * static_cast<double>(n * sizeof(T)) / 1e9;
+        std::cout << std::left << std::setw(8) << type << std::setw(26) << name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(10) << t * 1e6 / static_cast<double>(n) << " ns" << std::setprecision(1) << std::setw(10) << gb / (t / 1e3) << " GB/s\n";
+        std::cout.unsetf(std::ios::fixed);
+    };
+    row("std::inclusive_scan", [&]{ std::inclusive_scan(v.begin(), v.end(), out.begin()); });
+    row("scan::inclusive_scan", [&]{ scan::inclusive_scan(v, out.begin()); });
+    row("scan::inclusive_scan pool", [&]{ scan::inclusive_scan(pool, v, out.begin()); });
+    row("std::inclusive_scan max", [&]{ std::inclusive_scan(v.begin(), v.end(), out.begin(), scan::Max()); });
+    row("scan::inclusive_scan max", [&]{ scan::inclusive_scan(pool, v, out.begin(), scan::Max()); });
+    row("std::exclusive_scan", [&]{ std::exclusive_scan(v.begin(), v.end(), out.begin(), T{0}); });
+    row("scan::exclusive_scan pool", [&]{ scan::exclusive_scan(pool, v, out.begin(), T{0}); });
+}
+
+int main(int argc, char** argv){
+    ThreadPool test_pool(3);
+    test_lanes<int32_t>(test_pool);
+    test_lanes<int64_t>(test_pool);
+    test_lanes<float>(test_pool);
+    test_lanes<double>(test_pool);
+    test_wrap_around();
+    test_custom(test_pool);
+    test_ranges(test_pool);
+    std::cout << "All scan tests passed! Scanning with " << simd::name(scan::scan_isa()) << "\n";
+
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1 << 24;
+    size_t threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::max(1u, std::thread::hardware_concurrency());
+    ThreadPool pool(threads - 1); // the calling thread takes one chunk
+    std::cout << n << " elements, " << threads << " threads\n";
+    Benchmark<int32_t>("int32", n, pool);
+    Benchmark<int64_t>("int64", n, pool);
+    Benchmark<float>("float", n, pool);
+}
@@ -0,0 +1,351 @@
+#pragma once
+/*
+Parallel prefix sums (scans) with SIMD inner loops
+
+    scan::inclusive_scan(pool, v, out.begin());            // out[i] = v[0] + ... + v[i]
+    scan::exclusive_scan(pool, v, out.begin(), 0);         // out[i] = 0 + v[0] + ... + v[i - 1]
+    scan::inclusive_scan(v, v.begin(), scan::Max());       // running maximum, in place, one thread
+    scan::inclusive_scan(pool, words, out.begin(), [](std::string a, const std::string& b){ return a + b; });
+
+Same results as std::inclusive_scan / std::exclusive_scan for any associative operator (like
+parallel_algorithms.hpp, the grouping differs, so float sums can differ in the last bits).
+
+Across threads it is the two-pass blocked scan of par::inclusive_scan: the range is split into one
+chunk per thread, each chunk reduces its part, the chunk totals are scanned sequentially, then each
+chunk scans its part starting from the total before it. That reads the input twice and writes it
+once, with no synchronization inside a pass.
+
+Within a chunk, a scan looks inherently sequential (each output needs the previous one), but a
+register of W elements can be scanned in log2(W) steps: add the register shifted up by 1 lane,
+then by 2, then by 4... (Hillis-Steele), filling the shifted-in lanes with the identity of the
+operator. The carry from the previous registers is broadcast to every lane and added, and the new
+carry is the last lane broadcast. Only the carry add is on the critical path from one register to
+the next, so float sums (4 cycle add latency) run several times faster than the scalar loop.
+
+The SIMD path covers Plus (also std::plus), Min and Max on float, double, int32_t and int64_t
+with contiguous input and output (std::vector, std::span, arrays...), compiled for AVX2 and
+AVX-512 like simd_sort.hpp. Anything else, including custom operators and other element types,
+uses the same two passes with a scalar loop. Integer sums wrap around instead of overflowing;
+Min and Max don't handle NaNs.
+*/
+
+#include "simd.hpp"
+#include "parallel_algorithms.hpp"
+#include <array>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <type_traits>
+#include <vector>
+
+namespace scan{
+    using simd::Isa;
+
+    constexpr size_t Grain = 1 << 16; // a SIMD scan is about a nanosecond per element, less isn't worth a thread
+
+    // Operators with a SIMD path. Each is a function object with its identity element
+    struct Plus{
+        template <typename A, typename B>
+        auto operator()(const A& a, const B& b) const {
+            // Wrap around like the SIMD adds (signed overflow would be undefined)
+            if constexpr (std::is_integral_v<A> && std::is_same_v<A, B>) return static_cast<A>(static_cast<std::make_unsigned_t<A>>(a) + static_cast<std::make_unsigned_t<A>>(b));
+            else return a + b;
+        }
+        template <typename T> static constexpr T identity(){ return T{0}; }
+    };
+    struct Min{
+        template <typename T> T operator()(const T& a, const T& b) const { return b < a ? b : a; }
+        template <typename T> static constexpr T identity(){
+            if constexpr (std::is_floating_point_v<T>) return std::numeric_limits<T>::infinity();
+            else return std::numeric_limits<T>::max();
+        }
+    };
+    struct Max{
+        template <typename T> T operator()(const T& a, const T& b) const { return a < b ? b : a; }
+        template <typename T> static constexpr T identity(){
+            if constexpr (std::is_floating_point_v<T>) return -std::numeric_limits<T>::infinity();
+            else return std::numeric_limits<T>::lowest();
+        }
+    };
+
+    namespace detail{
+        // The SIMD operator for Op, void if there is none
+        template <typename Op, typename T> struct simd_op{ using type = void; };
+        template <typename T> struct simd_op<Plus, T>{ using type = Plus; };
+        template <typename T> struct simd_op<Min, T>{ using type = Min; };
+        template <typename T> struct simd_op<Max, T>{ using type = Max; };
+        template <typename T> struct simd_op<std::plus<>, T>{ using type = Plus; };
+        template <typename T> struct simd_op<std::plus<T>, T>{ using type = Plus; };
+
+        template <typename T>
+        concept Lane = std::is_same_v<T, float> || std::is_same_v<T, double> || std::is_same_v<T, int32_t> || std::is_same_v<T, int64_t>;
+
+        template <typename Op, typename T>
+        concept Vectorized = Lane<T> && !std::is_void_v<typename simd_op<std::remove_cvref_t<Op>, T>::type>;
+
+        // Lane i of a register of W lanes takes lane i - K, as indices of 32-bit units (Units per
+        // lane); the first K lanes are replaced afterwards
+        template <size_t W, size_t Units, size_t K>
+        constexpr std::array<int32_t, W * Units> make_shift_table(){
+            std::array<int32_t, W * Units> table{};
+            for(size_t i=K; i<W; ++i){
+                for(size_t u=0; u<Units; ++u) table[i * Units + u] = static_cast<int32_t>((i - K) * Units + u);
+            }
+            return table;
+        }
+        template <size_t W, size_t Units, size_t K>
+        inline constexpr auto shift_table = make_shift_table<W, Units, K>();
+
+        // Every lane takes the last one
+        template <size_t W, size_t Units>
+        constexpr std::array<int32_t, W * Units> make_last_table(){
+            std::array<int32_t, W * Units> table{};
+            for(size_t i=0; i<W * Units; ++i) table[i] = static_cast<int32_t>((W - 1) * Units + i % Units);
+            return table;
+        }
+        template <size_t W, size_t Units>
+        inline constexpr auto last_table = make_last_table<W, Units>();
+    }
+
+#ifdef SIMD_X86
+    // Scan<T> has the register operations of simd.hpp's V<T> (int64_t added here) and:
+    //   permute(r, idx)       lanes reordered by a table of 32-bit unit indices
+    //   blend<Mask>(lo, hi)   lanes of hi where Mask has a bit, of lo elsewhere
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+    namespace avx2{
+        template <typename T> struct Scan;
+
+        template <> struct Scan<float> : simd::avx2::V<float>{
+            static reg permute(reg r, const int32_t* idx){
+                return _mm256_permutevar8x32_ps(r, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx)));
+            }
+            template <unsigned Mask> static reg blend(reg lo, reg hi){ return _mm256_blend_ps(lo, hi, Mask); }
+        };
+
+        template <> struct Scan<double> : simd::avx2::V<double>{
+            static reg permute(reg r, const int32_t* idx){
+                __m256i i = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx));
+                return _mm256_castps_pd(_mm256_permutevar8x32_ps(_mm256_castpd_ps(r), i));
+            }
+            template <unsigned Mask> static reg blend(reg lo, reg hi){ return _mm256_blend_pd(lo, hi, Mask); }
+        };
+
+        template <> struct Scan<int32_t> : simd::avx2::V<int32_t>{
+            static reg permute(reg r, const int32_t* idx){
+                return _mm256_permutevar8x32_epi32(r, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx)));
+            }
+            template <unsigned Mask> static reg blend(reg lo, reg hi){ return _mm256_blend_epi32(lo, hi, Mask); }
+        };
+
+        template <> struct Scan<int64_t>{
+            using reg = __m256i;
+            static constexpr size_t width = 4;
+            static reg load(const int64_t* p){ return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+            static void store(int64_t* p, reg r){ _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), r); }
+            static reg set1(int64_t x){ return _mm256_set1_epi64x(x); }
+            static reg add(reg a, reg b){ return _mm256_add_epi64(a, b); }
+            // No 64-bit min/max before AVX-512: select with a comparison mask
+            static reg min(reg a, reg b){ return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b)); }
+            static reg max(reg a, reg b){ return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b)); }
+            static reg permute(reg r, const int32_t* idx){
+                return _mm256_permutevar8x32_epi32(r, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx)));
+            }
+            // Each 64-bit lane is two bits of the 32-bit blend
+            template <unsigned Mask> static reg blend(reg lo, reg hi){
+                constexpr unsigned units = (Mask & 1 ? 0x3 : 0) | (Mask & 2 ? 0xC : 0) | (Mask & 4 ? 0x30 : 0) | (Mask & 8 ? 0xC0 : 0);
+                return _mm256_blend_epi32(lo, hi, units);
+            }
+        };
+
+#include "scan_kernels.inl"
+    }
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+    namespace avx512{
+        template <typename T> struct Scan;
+
+        // Permutes use the masked form with a full mask to avoid GCC 12's uninitialized warning
+        template <> struct Scan<float> : simd::avx512::V<float>{
+            static reg permute(reg r, const int32_t* idx){ return _mm512_mask_permutexvar_ps(r, 0xFFFF, _mm512_loadu_si512(idx), r); }
+            template <unsigned Mask> static reg blend(reg lo, reg hi){ return _mm512_mask_blend_ps(static_cast<__mmask16>(Mask), lo, hi); }
+        };
+
+        template <> struct Scan<double> : simd::avx512::V<double>{
+            static reg permute(reg r, const int32_t* idx){
+                __m512 x = _mm512_castpd_ps(r);
+                return _mm512_castps_pd(_mm512_mask_permutexvar_ps(x, 0xFFFF, _mm512_loadu_si512(idx), x));
+            }
+            template <unsigned Mask> static reg blend(reg lo, reg hi){ return _mm512_mask_blend_pd(static_cast<__mmask8>(Mask), lo, hi); }
+        };
+
+        template <> struct Scan<int32_t> : simd::avx512::V<int32_t>{
+            static reg permute(reg r, const int32_t* idx){ return _mm512_mask_permutexvar_epi32(r, 0xFFFF, _mm512_loadu_si512(idx), r); }
+            template <unsigned Mask> static reg blend(reg lo, reg hi){ return _mm512_mask_blend_epi32(static_cast<__mmask16>(Mask), lo, hi); }
+        };
+
+        template <> struct Scan<int64_t>{
+            using reg = __m512i;
+            static constexpr size_t width = 8;
+            static reg load(const int64_t* p){ return _mm512_loadu_si512(p); }
+            static void store(int64_t* p, reg r){ _mm512_storeu_si512(p, r); }
+            static reg set1(int64_t x){ return _mm512_set1_epi64(x); }
+            static reg add(reg a, reg b){ return _mm512_add_epi64(a, b); }
+            static reg min(reg a, reg b){ return _mm512_mask_min_epi64(a, 0xFF, a, b); }
+            static reg max(reg a, reg b){ return _mm512_mask_max_epi64(a, 0xFF, a, b); }
+            static reg permute(reg r, const int32_t* idx){ return _mm512_mask_permutexvar_epi32(r, 0xFFFF, _mm512_loadu_si512(idx), r); }
+            template <unsigned Mask> static reg blend(reg lo, reg hi){ return _mm512_mask_blend_epi64(static_cast<__mmask8>(Mask), lo, hi); }
+        };
+
+#include "scan_kernels.inl"
+    }
+#pragma GCC pop_options
+#endif // SIMD_X86
+
+    // Instruction set of the SIMD path, Scalar for the plain loop (settable, for the tests)
+    inline Isa& scan_isa(){
+        static Isa isa = simd::supported(Isa::AVX512) ? Isa::AVX512 : simd::supported(Isa::AVX2) ? Isa::AVX2 : Isa::Scalar;
+        return isa;
+    }
+
+    namespace detail{
+        // Reduces / scans one block [in, in + n) with the SIMD operator Op; carry is everything before it
+        template <typename Op, typename T>
+        T reduce_block(const T* in, size_t n){
+            switch(scan_isa()){
+#ifdef SIMD_X86
+                case Isa::AVX2: return avx2::reduce<Op>(in, n);
+                case Isa::AVX512: return avx512::reduce<Op>(in, n);
+#endif
+                default:{
+                    T acc = Op::template identity<T>();
+                    for(size_t i=0; i<n; ++i) acc = Op()(acc, in[i]);
+                    return acc;
+                }
+            }
+        }
+
+        template <typename Op, bool Exclusive, typename T>
+        void scan_block(const T* in, T* out, size_t n, T carry){
+            switch(scan_isa()){
+#ifdef SIMD_X86
+                case Isa::AVX2: avx2::scan<Op, Exclusive>(in, out, n, carry); return;
+                case Isa::AVX512: avx512::scan<Op, Exclusive>(in, out, n, carry); return;
+#endif
+                default:
+                    for(size_t i=0; i<n; ++i){
+                        T x = in[i]; // read before writing, out may be in
+                        if constexpr (Exclusive){ out[i] = carry; carry = Op()(carry, x); }
+                        else{ carry = Op()(carry, x); out[i] = carry; }
+                    }
+            }
+        }
+
+        // Number of chunks: one per thread, at least Grain elements each
+        inline size_t chunks(ThreadPool* pool, size_t n){
+            return pool ? std::max<size_t>(1, std::min(pool->size() + 1, n / Grain)) : 1;
+        }
+
+        // The two passes over chunks of [0, n): totals[c] = reduce(c) for every chunk but the last,
+        // carries are init op totals[0] op ... op totals[c - 1], then scan(c, carry[c]).
+        // init is empty for an inclusive scan
+        template <typename T, typename Op, typename Reduce, typename ScanChunk>
+        void two_pass(ThreadPool* pool, size_t n, const std::optional<T>& init, Op& op, Reduce reduce, ScanChunk scan){
+            size_t parts = chunks(pool, n);
+            if(parts == 1){
+                scan(size_t(0), n, init);
+                return;
+            }
+            std::vector<std::optional<T>> totals(parts);
+            par::detail::for_each_chunk(*pool, n, [&](size_t c, size_t lo, size_t hi){
+                if(c + 1 < parts) totals[c] = reduce(lo, hi);
+            }, parts);
+            std::vector<std::optional<T>> carry(parts);
+            carry[0] = init;
+            for(size_t c=1; c<parts; ++c){
+                carry[c] = carry[c - 1] ? std::invoke(op, *carry[c - 1], *totals[c - 1]) : totals[c - 1];
+            }
+            par::detail::for_each_chunk(*pool, n, [&](size_t c, size_t lo, size_t hi){
+                scan(lo, hi, std::move(carry[c]));
+            }, parts);
+        }
+
+        // SIMD path: contiguous arrays of a Lane type with a SIMD operator
+        template <typename Op, bool Exclusive, typename T>
+        void vectorized(ThreadPool* pool, const T* in, T* out, size_t n, T init){
+            Op op;
+            two_pass<T>(pool, n, std::optional<T>(init), op,
+                [&](size_t lo, size_t hi){ return reduce_block<Op>(in + lo, hi - lo); },
+                [&](size_t lo, size_t hi, std::optional<T> carry){ scan_block<Op, Exclusive>(in + lo, out + lo, hi - lo, *carry); });
+        }
+
+        // Any random access input, output and associative operator. T is the accumulator type
+        template <bool Exclusive, typename T, typename I, typename O, typename Op>
+        void generic(ThreadPool* pool, I first, O out, size_t n, const std::optional<T>& init, Op& op){
+            two_pass<T>(pool, n, init, op,
+                [&](size_t lo, size_t hi){
+                    T acc = first[lo];
+                    for(size_t i=lo+1; i<hi; ++i) acc = std::invoke(op, std::move(acc), first[i]);
+                    return acc;
+                },
+                [&](size_t lo, size_t hi, std::optional<T> carry){
+                    if(lo == hi) return;
+                    T acc = carry ? std::move(*carry) : T(first[lo]);
+                    size_t i = lo;
+                    if(!carry){ out[i] = acc; ++i; } // inclusive scan from the start of the range
+                    for(; i<hi; ++i){
+                        if constexpr (Exclusive){
+                            T next = std::invoke(op, acc, first[i]); // read before writing, out may be the input
+                            out[i] = std::move(acc);
+                            acc = std::move(next);
+                        }
+                        else{
+                            acc = std::invoke(op, std::move(acc), first[i]);
+                            out[i] = acc;
+                        }
+                    }
+                });
+        }
+
+        template <bool Exclusive, typename T, par::Range R, std::random_access_iterator O, typename Op>
+        O run(ThreadPool* pool, R&& r, O out, const std::optional<T>& init, Op op){
+            using V = std::ranges::range_value_t<R>;
+            size_t n = std::ranges::size(r);
+            if constexpr (std::ranges::contiguous_range<R> && std::contiguous_iterator<O> && Vectorized<Op, V>
+                          && std::is_same_v<std::iter_value_t<O>, V> && std::is_same_v<T, V>){
+                using S = typename simd_op<std::remove_cvref_t<Op>, V>::type;
+                vectorized<S, Exclusive>(pool, std::ranges::data(r), std::to_address(out), n, init ? *init : S::template identity<V>());
+            }
+            else generic<Exclusive, T>(pool, std::ranges::begin(r), out, n, init, op);
+            return out + n;
+        }
+    }
+
+    // out[i] = r[0] op r[1] op ... op r[i], returns the end of the output. out may be r's begin
+    template <par::Range R, std::random_access_iterator O, typename Op = Plus>
+    O inclusive_scan(ThreadPool& pool, R&& r, O out, Op op = Op()){
+        return detail::run<false, std::ranges::range_value_t<R>>(&pool, r, out, {}, op);
+    }
+
+    // out[i] = init op r[0] op ... op r[i - 1], returns the end of the output. out may be r's begin
+    template <par::Range R, std::random_access_iterator O, typename T, typename Op = Plus>
+    O exclusive_scan(ThreadPool& pool, R&& r, O out, T init, Op op = Op()){
+        return detail::run<true, T>(&pool, r, out, std::optional<T>(std::move(init)), op);
+    }
+
+    // On the calling thread only
+    template <par::Range R, std::random_access_iterator O, typename Op = Plus>
+    O inclusive_scan(R&& r, O out, Op op = Op()){
+        return detail::run<false, std::ranges::range_value_t<R>>(nullptr, r, out, {}, op);
+    }
+
+    template <par::Range R, std::random_access_iterator O, typename T, typename Op = Plus>
+    O exclusive_scan(R&& r, O out, T init, Op op = Op()){
+        return detail::run<true, T>(nullptr, r, out, std::optional<T>(std::move(init)), op);
+    }
+}
@@ -0,0 +1,80 @@
+/*
+Generic scan kernels (see scan.hpp), written against Scan<T>. Included once per instruction set
+inside its namespace and #pragma GCC target region, like simd_kernels.inl. No #pragma once on purpose.
+*/
+
+// The SIMD version of an operator
+template <typename T>
+inline typename Scan<T>::reg combine(Plus, typename Scan<T>::reg a, typename Scan<T>::reg b){ return Scan<T>::add(a, b); }
+template <typename T>
+inline typename Scan<T>::reg combine(Min, typename Scan<T>::reg a, typename Scan<T>::reg b){ return Scan<T>::min(a, b); }
+template <typename T>
+inline typename Scan<T>::reg combine(Max, typename Scan<T>::reg a, typename Scan<T>::reg b){ return Scan<T>::max(a, b); }
+
+// Lanes moved up by K, the first K lanes are fill
+template <typename T, size_t K>
+inline typename Scan<T>::reg shift(typename Scan<T>::reg r, typename Scan<T>::reg fill){
+    constexpr size_t Units = sizeof(T) / 4;
+    auto moved = Scan<T>::permute(r, detail::shift_table<Scan<T>::width, Units, K>.data());
+    return Scan<T>::template blend<(1u << K) - 1>(moved, fill);
+}
+
+// The last lane in every lane
+template <typename T>
+inline typename Scan<T>::reg last(typename Scan<T>::reg r){
+    return Scan<T>::permute(r, detail::last_table<Scan<T>::width, sizeof(T) / 4>.data());
+}
+
+// Inclusive scan of one register: log2(W) steps combining every lane with the lane K before it
+template <typename T, typename Op, size_t K = 1>
+inline typename Scan<T>::reg prefix(typename Scan<T>::reg x, typename Scan<T>::reg identity){
+    x = combine<T>(Op(), shift<T, K>(x, identity), x);
+    if constexpr (2 * K < Scan<T>::width) return prefix<T, Op, 2 * K>(x, identity);
+    else return x;
+}
+
+// identity op in[0] op ... op in[n - 1]
+template <typename Op, typename T>
+T reduce(const T* in, size_t n){
+    using S = Scan<T>;
+    constexpr size_t W = S::width;
+    auto acc0 = S::set1(Op::template identity<T>()), acc1 = acc0;
+    size_t i = 0;
+    // Two accumulators to hide the latency of the operation
+    for(; i + 2 * W <= n; i += 2 * W){
+        acc0 = combine<T>(Op(), acc0, S::load(in + i));
+        acc1 = combine<T>(Op(), acc1, S::load(in + i + W));
+    }
+    T lanes[W];
+    S::store(lanes, combine<T>(Op(), acc0, acc1));
+    T result = lanes[0];
+    for(size_t j=1; j<W; ++j) result = Op()(result, lanes[j]);
+    for(; i<n; ++i) result = Op()(result, in[i]);
+    return result;
+}
+
+// out[i] = carry op in[0] op ... op in[i] (in[i - 1] if Exclusive). out may be in
+template <typename Op, bool Exclusive, typename T>
+void scan(const T* in, T* out, size_t n, T carry){
+    using S = Scan<T>;
+    constexpr size_t W = S::width;
+    auto identity = S::set1(Op::template identity<T>());
+    auto c = S::set1(carry);
+    size_t i = 0;
+    for(; i + W <= n; i += W){
+        // The register's own scan doesn't depend on the carry, only the final combine does
+        auto s = prefix<T, Op>(S::load(in + i), identity);
+        auto total = last<T>(s);
+        if constexpr (Exclusive) s = shift<T, 1>(s, identity);
+        S::store(out + i, combine<T>(Op(), c, s));
+        c = combine<T>(Op(), c, total);
+    }
+    T lanes[W];
+    S::store(lanes, c);
+    carry = lanes[0];
+    for(; i<n; ++i){
+        T x = in[i];
+        if constexpr (Exclusive){ out[i] = carry; carry = Op()(carry, x); }
+        else{ carry = Op()(carry, x); out[i] = carry; }
+    }
+}
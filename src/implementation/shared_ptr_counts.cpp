@@ -0,0 +1,119 @@
+/*
+Tests and benchmark for the reference counting policies of Custom::shared_ptr (see custom.hpp)
+
+SeqCst below reproduces the old counting (++ / -- on std::atomic<int>, sequentially consistent)
+so it can be compared with the relaxed/acq_rel MultiThreaded policy and the plain int
+SingleThreaded one. On x86 every atomic read-modify-write is a locked instruction whatever the
+ordering, so the relaxed version mostly saves the fence on the last release there; on ARM the
+difference is larger. Pass the number of copies per thread and the maximum thread count
+*/
+
+#include "custom.hpp"
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cassert>
+#include <cstdlib>
+
+struct SeqCst{
+    using count_type = std::atomic<int>;
+    static void increment(count_type& c) noexcept { ++c; }
+    static bool decrement(count_type& c) noexcept { return --c == 0; }
+    static bool increment_if_nonzero(count_type& c) noexcept {
+        int count = c.load();
+        while(count != 0){
+            if(c.compare_exchange_weak(count, count + 1)) return true;
+        }
+        return false;
+    }
+    static int load(const count_type& c) noexcept { return c.load(); }
+};
+
+struct Tracked{
+    static inline std::atomic<int> destroyed{0};
+    int value = 0;
+    ~Tracked(){ ++destroyed; }
+};
+
+void test_single_threaded(){
+    Tracked::destroyed = 0;
+    {
+        auto p = Custom::make_shared<Tracked, Custom::SingleThreaded>();
+        Custom::shared_ptr<Tracked, Custom::SingleThreaded> q = p;
+        Custom::weak_ptr<Tracked, Custom::SingleThreaded> w = q;
+        assert(p.use_count() == 2);
+        p.reset();
+        assert(q.use_count() == 1 && w.lock()->value == 0);
+        q.reset();
+        assert(w.expired() && Tracked::destroyed == 1);
+    }
+    Custom::shared_ptr<Tracked, Custom::SingleThreaded> raw(new Tracked);
+    assert(raw.use_count() == 1);
+}
+
+void test_concurrent_copies(){
+    // Many threads copying and dropping the same object: it must be destroyed exactly once,
+    // after every write made through it
+    Tracked::destroyed = 0;
+    {
+        auto shared = Custom::make_shared<Tracked>();
+        std::vector<std::thread> threads;
+        for(int t=0; t<4; ++t){
+            threads.emplace_back([p = shared]() mutable {
+                for(int i=0; i<10000; ++i){
+                    Custom::shared_ptr<Tracked> copy = p;
+                    Custom::weak_ptr<Tracked> weak = copy;
+                    assert(weak.lock());
+                }
+            });
+        }
+        shared.reset();
+        for(auto& t : threads) t.join();
+    }
+    assert(Tracked::destroyed == 1);
+}
+
+template <typename Policy>
+double copy_loop(const Custom::shared_ptr<int, Policy>& p, size_t copies){
+    auto start = std::chrono::high_resolution_clock::now();
+    for(size_t i=0; i<copies; ++i){
+        Custom::shared_ptr<int, Policy> copy = p; // increment + decrement
+        asm volatile("" : : "r"(copy.get()) : "memory"); // keep the copy from being optimized out
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template <typename Policy>
+void Benchmark(const char* name, size_t copies, size_t max_threads){
+    auto p = Custom::make_shared<int, Policy>(42);
+    std::cout << name << "  1 thread: " << copy_loop(p, copies) << " ms";
+    if constexpr (!std::is_same_v<Policy, Custom::SingleThreaded>){
+        // Contended: every thread hammers the same control block
+        for(size_t n = 2; n <= max_threads; n *= 2){
+            auto start = std::chrono::high_resolution_clock::now();
+            std::vector<std::thread> threads;
+            for(size_t t=0; t<n; ++t){
+                threads.emplace_back([&p, copies]{ copy_loop(p, copies); });
+            }
+            for(auto& t : threads) t.join();
+            auto end = std::chrono::high_resolution_clock::now();
+            std::cout << "  " << n << " threads: " << std::chrono::duration<double, std::milli>(end - start).count() << " ms";
+        }
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, char** argv){
+    test_single_threaded();
+    test_concurrent_copies();
+    std::cout << "All shared_ptr counting tests passed!\n";
+
+    size_t copies = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000000;
+    size_t max_threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+    std::cout << copies << " copies per thread" << std::endl;
+    Benchmark<SeqCst>("SeqCst (old)  ", copies, max_threads);
+    Benchmark<Custom::MultiThreaded>("MultiThreaded ", copies, max_threads);
+    Benchmark<Custom::SingleThreaded>("SingleThreaded", copies, max_threads);
+}
@@ -0,0 +1,448 @@
+#pragma once
+/*
+Portable SIMD kernels with runtime CPU dispatch
+
+    simd::add(a, b, out, n);       // out[i] = a[i] + b[i]
+    simd::mul(a, b, out, n);       // out[i] = a[i] * b[i]
+    simd::fma(a, b, c, out, n);    // out[i] = a[i] * b[i] + c[i]
+    float d = simd::dot(a, b, n);  // also sum, min, max
+
+for float, double and int32_t arrays of any length and alignment. Integer arithmetic wraps
+modulo 2^32. Float sums and dot products are computed in a different order than a plain loop,
+so they can differ from it in the last bits.
+
+Instruction sets: SSE2, AVX2 (+FMA) and AVX-512F on x86-64, NEON on AArch64, and plain loops
+everywhere. The x86 kernels are all compiled into the same binary with #pragma GCC target (no
+-mavx2 needed) and the first call picks the best one the CPU (and OS) supports. The kernels
+themselves are generic (simd_kernels.inl), each instruction set only provides its register
+type V<T> (expression.hpp builds fused array expressions on the same types).
+
+simd::kernels<T>(isa) gives the kernels of one particular instruction set, e.g. to benchmark them.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace simd{
+    enum class Isa{ Scalar, SSE2, AVX2, AVX512, NEON };
+
+    inline const char* name(Isa isa){
+        switch(isa){
+            case Isa::Scalar: return "scalar";
+            case Isa::SSE2: return "SSE2";
+            case Isa::AVX2: return "AVX2";
+            case Isa::AVX512: return "AVX-512";
+            case Isa::NEON: return "NEON";
+        }
+        return "unknown";
+    }
+
+    template <typename T>
+    struct Kernels{
+        void (*add)(const T* a, const T* b, T* out, size_t n);
+        void (*mul)(const T* a, const T* b, T* out, size_t n);
+        void (*fma)(const T* a, const T* b, const T* c, T* out, size_t n);
+        T (*dot)(const T* a, const T* b, size_t n);
+        T (*sum)(const T* a, size_t n);
+        T (*min)(const T* a, size_t n);
+        T (*max)(const T* a, size_t n);
+    };
+
+    template <typename T>
+    concept Element = std::is_same_v<T, float> || std::is_same_v<T, double> || std::is_same_v<T, int32_t>;
+
+    namespace detail{
+        // Scalar operations, wrapping for integers (signed overflow would be undefined)
+        template <typename T>
+        inline T scalar_add(T a, T b){
+            if constexpr (std::is_integral_v<T>) return static_cast<T>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b));
+            else return a + b;
+        }
+        template <typename T>
+        inline T scalar_mul(T a, T b){
+            if constexpr (std::is_integral_v<T>) return static_cast<T>(static_cast<uint32_t>(a) * static_cast<uint32_t>(b));
+            else return a * b;
+        }
+        template <typename T>
+        inline T scalar_min(T a, T b){ return b < a ? b : a; }
+        template <typename T>
+        inline T scalar_max(T a, T b){ return a < b ? b : a; }
+    }
+
+    // Plain loops, the reference for the tests and the benchmark
+    namespace scalar{
+        template <typename T>
+        void add(const T* a, const T* b, T* out, size_t n){
+            for(size_t i=0; i<n; ++i) out[i] = detail::scalar_add(a[i], b[i]);
+        }
+        template <typename T>
+        void mul(const T* a, const T* b, T* out, size_t n){
+            for(size_t i=0; i<n; ++i) out[i] = detail::scalar_mul(a[i], b[i]);
+        }
+        template <typename T>
+        void fma(const T* a, const T* b, const T* c, T* out, size_t n){
+            for(size_t i=0; i<n; ++i) out[i] = detail::scalar_add(detail::scalar_mul(a[i], b[i]), c[i]);
+        }
+        template <typename T>
+        T dot(const T* a, const T* b, size_t n){
+            T result{};
+            for(size_t i=0; i<n; ++i) result = detail::scalar_add(result, detail::scalar_mul(a[i], b[i]));
+            return result;
+        }
+        template <typename T>
+        T sum(const T* a, size_t n){
+            T result{};
+            for(size_t i=0; i<n; ++i) result = detail::scalar_add(result, a[i]);
+            return result;
+        }
+        template <typename T>
+        T min(const T* a, size_t n){
+            T result = std::numeric_limits<T>::max();
+            for(size_t i=0; i<n; ++i) result = detail::scalar_min(result, a[i]);
+            return result;
+        }
+        template <typename T>
+        T max(const T* a, size_t n){
+            T result = std::numeric_limits<T>::lowest();
+            for(size_t i=0; i<n; ++i) result = detail::scalar_max(result, a[i]);
+            return result;
+        }
+        template <typename T>
+        constexpr Kernels<T> make_kernels(){
+            return Kernels<T>{&add<T>, &mul<T>, &fma<T>, &dot<T>, &sum<T>, &min<T>, &max<T>};
+        }
+    }
+
+#ifdef SIMD_X86
+    // ---------------------------------------------------------------- SSE2 (baseline on x86-64)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+    namespace sse2{
+        template <typename T> struct V;
+
+        template <> struct V<float>{
+            using reg = __m128;
+            static constexpr size_t width = 4;
+            static reg load(const float* p){ return _mm_loadu_ps(p); }
+            static void store(float* p, reg r){ _mm_storeu_ps(p, r); }
+            static reg set1(float x){ return _mm_set1_ps(x); }
+            static reg add(reg a, reg b){ return _mm_add_ps(a, b); }
+            static reg sub(reg a, reg b){ return _mm_sub_ps(a, b); }
+            static reg div(reg a, reg b){ return _mm_div_ps(a, b); }
+            static reg mul(reg a, reg b){ return _mm_mul_ps(a, b); }
+            static reg fma(reg a, reg b, reg c){ return _mm_add_ps(_mm_mul_ps(a, b), c); }
+            static reg min(reg a, reg b){ return _mm_min_ps(a, b); }
+            static reg max(reg a, reg b){ return _mm_max_ps(a, b); }
+        };
+
+        template <> struct V<double>{
+            using reg = __m128d;
+            static constexpr size_t width = 2;
+            static reg load(const double* p){ return _mm_loadu_pd(p); }
+            static void store(double* p, reg r){ _mm_storeu_pd(p, r); }
+            static reg set1(double x){ return _mm_set1_pd(x); }
+            static reg add(reg a, reg b){ return _mm_add_pd(a, b); }
+            static reg sub(reg a, reg b){ return _mm_sub_pd(a, b); }
+            static reg div(reg a, reg b){ return _mm_div_pd(a, b); }
+            static reg mul(reg a, reg b){ return _mm_mul_pd(a, b); }
+            static reg fma(reg a, reg b, reg c){ return _mm_add_pd(_mm_mul_pd(a, b), c); }
+            static reg min(reg a, reg b){ return _mm_min_pd(a, b); }
+            static reg max(reg a, reg b){ return _mm_max_pd(a, b); }
+        };
+
+        template <> struct V<int32_t>{
+            using reg = __m128i;
+            static constexpr size_t width = 4;
+            static reg load(const int32_t* p){ return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+            static void store(int32_t* p, reg r){ _mm_storeu_si128(reinterpret_cast<__m128i*>(p), r); }
+            static reg set1(int32_t x){ return _mm_set1_epi32(x); }
+            static reg add(reg a, reg b){ return _mm_add_epi32(a, b); }
+            static reg sub(reg a, reg b){ return _mm_sub_epi32(a, b); }
+            // SSE2 has no 32-bit multiply (SSE4.1 _mm_mullo_epi32): multiply lanes 0,2 and 1,3
+            // into 64-bit products and keep the low halves
+            static reg mul(reg a, reg b){
+                __m128i even = _mm_mul_epu32(a, b);
+                __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+                return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                          _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+            }
+            static reg fma(reg a, reg b, reg c){ return add(mul(a, b), c); }
+            // No _mm_min_epi32 either: select with a comparison mask
+            static reg min(reg a, reg b){
+                __m128i a_greater = _mm_cmpgt_epi32(a, b);
+                return _mm_or_si128(_mm_and_si128(a_greater, b), _mm_andnot_si128(a_greater, a));
+            }
+            static reg max(reg a, reg b){
+                __m128i a_greater = _mm_cmpgt_epi32(a, b);
+                return _mm_or_si128(_mm_and_si128(a_greater, a), _mm_andnot_si128(a_greater, b));
+            }
+        };
+
+#include "simd_kernels.inl"
+    }
+#pragma GCC pop_options
+
+    // ---------------------------------------------------------------- AVX2 + FMA
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+    namespace avx2{
+        template <typename T> struct V;
+
+        template <> struct V<float>{
+            using reg = __m256;
+            static constexpr size_t width = 8;
+            static reg load(const float* p){ return _mm256_loadu_ps(p); }
+            static void store(float* p, reg r){ _mm256_storeu_ps(p, r); }
+            static reg set1(float x){ return _mm256_set1_ps(x); }
+            static reg add(reg a, reg b){ return _mm256_add_ps(a, b); }
+            static reg sub(reg a, reg b){ return _mm256_sub_ps(a, b); }
+            static reg div(reg a, reg b){ return _mm256_div_ps(a, b); }
+            static reg mul(reg a, reg b){ return _mm256_mul_ps(a, b); }
+            static reg fma(reg a, reg b, reg c){ return _mm256_fmadd_ps(a, b, c); }
+            static reg min(reg a, reg b){ return _mm256_min_ps(a, b); }
+            static reg max(reg a, reg b){ return _mm256_max_ps(a, b); }
+        };
+
+        template <> struct V<double>{
+            using reg = __m256d;
+            static constexpr size_t width = 4;
+            static reg load(const double* p){ return _mm256_loadu_pd(p); }
+            static void store(double* p, reg r){ _mm256_storeu_pd(p, r); }
+            static reg set1(double x){ return _mm256_set1_pd(x); }
+            static reg add(reg a, reg b){ return _mm256_add_pd(a, b); }
+            static reg sub(reg a, reg b){ return _mm256_sub_pd(a, b); }
+            static reg div(reg a, reg b){ return _mm256_div_pd(a, b); }
+            static reg mul(reg a, reg b){ return _mm256_mul_pd(a, b); }
+            static reg fma(reg a, reg b, reg c){ return _mm256_fmadd_pd(a, b, c); }
+            static reg min(reg a, reg b){ return _mm256_min_pd(a, b); }
+            static reg max(reg a, reg b){ return _mm256_max_pd(a, b); }
+        };
+
+        template <> struct V<int32_t>{
+            using reg = __m256i;
+            static constexpr size_t width = 8;
+            static reg load(const int32_t* p){ return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+            static void store(int32_t* p, reg r){ _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), r); }
+            static reg set1(int32_t x){ return _mm256_set1_epi32(x); }
+            static reg add(reg a, reg b){ return _mm256_add_epi32(a, b); }
+            static reg sub(reg a, reg b){ return _mm256_sub_epi32(a, b); }
+            static reg mul(reg a, reg b){ return _mm256_mullo_epi32(a, b); }
+            static reg fma(reg a, reg b, reg c){ return _mm256_add_epi32(_mm256_mullo_epi32(a, b), c); }
+            static reg min(reg a, reg b){ return _mm256_min_epi32(a, b); }
+            static reg max(reg a, reg b){ return _mm256_max_epi32(a, b); }
+        };
+
+#include "simd_kernels.inl"
+    }
+#pragma GCC pop_options
+
+    // ---------------------------------------------------------------- AVX-512F
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+    namespace avx512{
+        template <typename T> struct V;
+
+        // Masked loads and stores for the tail: masked-off lanes are never touched, so they can't fault.
+        // min/max use the masked form with a full mask because GCC 12 warns about the plain one
+        // (its _mm512_undefined_* operand), the instruction is the same
+        template <> struct V<float>{
+            using reg = __m512;
+            static constexpr size_t width = 16;
+            static __mmask16 mask(size_t n){ return static_cast<__mmask16>((1u << n) - 1); }
+            static reg load(const float* p){ return _mm512_loadu_ps(p); }
+            static void store(float* p, reg r){ _mm512_storeu_ps(p, r); }
+            static reg load_partial(const float* p, size_t n, float fill){ return _mm512_mask_loadu_ps(_mm512_set1_ps(fill), mask(n), p); }
+            static void store_partial(float* p, reg r, size_t n){ _mm512_mask_storeu_ps(p, mask(n), r); }
+            static reg set1(float x){ return _mm512_set1_ps(x); }
+            static reg add(reg a, reg b){ return _mm512_add_ps(a, b); }
+            static reg sub(reg a, reg b){ return _mm512_sub_ps(a, b); }
+            static reg div(reg a, reg b){ return _mm512_div_ps(a, b); }
+            static reg mul(reg a, reg b){ return _mm512_mul_ps(a, b); }
+            static reg fma(reg a, reg b, reg c){ return _mm512_fmadd_ps(a, b, c); }
+            static reg min(reg a, reg b){ return _mm512_mask_min_ps(a, 0xFFFF, a, b); }
+            static reg max(reg a, reg b){ return _mm512_mask_max_ps(a, 0xFFFF, a, b); }
+        };
+
+        template <> struct V<double>{
+            using reg = __m512d;
+            static constexpr size_t width = 8;
+            static __mmask8 mask(size_t n){ return static_cast<__mmask8>((1u << n) - 1); }
+            static reg load(const double* p){ return _mm512_loadu_pd(p); }
+            static void store(double* p, reg r){ _mm512_storeu_pd(p, r); }
+            static reg load_partial(const double* p, size_t n, double fill){ return _mm512_mask_loadu_pd(_mm512_set1_pd(fill), mask(n), p); }
+            static void store_partial(double* p, reg r, size_t n){ _mm512_mask_storeu_pd(p, mask(n), r); }
+            static reg set1(double x){ return _mm512_set1_pd(x); }
+            static reg add(reg a, reg b){ return _mm512_add_pd(a, b); }
+            static reg sub(reg a, reg b){ return _mm512_sub_pd(a, b); }
+            static reg div(reg a, reg b){ return _mm512_div_pd(a, b); }
+            static reg mul(reg a, reg b){ return _mm512_mul_pd(a, b); }
+            static reg fma(reg a, reg b, reg c){ return _mm512_fmadd_pd(a, b, c); }
+            static reg min(reg a, reg b){ return _mm512_mask_min_pd(a, 0xFF, a, b); }
+            static reg max(reg a, reg b){ return _mm512_mask_max_pd(a, 0xFF, a, b); }
+        };
+
+        template <> struct V<int32_t>{
+            using reg = __m512i;
+            static constexpr size_t width = 16;
+            static __mmask16 mask(size_t n){ return static_cast<__mmask16>((1u << n) - 1); }
+            static reg load(const int32_t* p){ return _mm512_loadu_si512(p); }
+            static void store(int32_t* p, reg r){ _mm512_storeu_si512(p, r); }
+            static reg load_partial(const int32_t* p, size_t n, int32_t fill){ return _mm512_mask_loadu_epi32(_mm512_set1_epi32(fill), mask(n), p); }
+            static void store_partial(int32_t* p, reg r, size_t n){ _mm512_mask_storeu_epi32(p, mask(n), r); }
+            static reg set1(int32_t x){ return _mm512_set1_epi32(x); }
+            static reg add(reg a, reg b){ return _mm512_add_epi32(a, b); }
+            static reg sub(reg a, reg b){ return _mm512_sub_epi32(a, b); }
+            static reg mul(reg a, reg b){ return _mm512_mullo_epi32(a, b); }
+            static reg fma(reg a, reg b, reg c){ return _mm512_add_epi32(_mm512_mullo_epi32(a, b), c); }
+            static reg min(reg a, reg b){ return _mm512_mask_min_epi32(a, 0xFFFF, a, b); }
+            static reg max(reg a, reg b){ return _mm512_mask_max_epi32(a, 0xFFFF, a, b); }
+        };
+
+#include "simd_kernels.inl"
+    }
+#pragma GCC pop_options
+#endif // SIMD_X86
+
+#ifdef SIMD_NEON
+    // ---------------------------------------------------------------- NEON (baseline on AArch64)
+    namespace neon{
+        template <typename T> struct V;
+
+        template <> struct V<float>{
+            using reg = float32x4_t;
+            static constexpr size_t width = 4;
+            static reg load(const float* p){ return vld1q_f32(p); }
+            static void store(float* p, reg r){ vst1q_f32(p, r); }
+            static reg set1(float x){ return vdupq_n_f32(x); }
+            static reg add(reg a, reg b){ return vaddq_f32(a, b); }
+            static reg sub(reg a, reg b){ return vsubq_f32(a, b); }
+            static reg div(reg a, reg b){ return vdivq_f32(a, b); }
+            static reg mul(reg a, reg b){ return vmulq_f32(a, b); }
+            static reg fma(reg a, reg b, reg c){ return vfmaq_f32(c, a, b); }
+            static reg min(reg a, reg b){ return vminq_f32(a, b); }
+            static reg max(reg a, reg b){ return vmaxq_f32(a, b); }
+        };
+
+        template <> struct V<double>{
+            using reg = float64x2_t;
+            static constexpr size_t width = 2;
+            static reg load(const double* p){ return vld1q_f64(p); }
+            static void store(double* p, reg r){ vst1q_f64(p, r); }
+            static reg set1(double x){ return vdupq_n_f64(x); }
+            static reg add(reg a, reg b){ return vaddq_f64(a, b); }
+            static reg sub(reg a, reg b){ return vsubq_f64(a, b); }
+            static reg div(reg a, reg b){ return vdivq_f64(a, b); }
+            static reg mul(reg a, reg b){ return vmulq_f64(a, b); }
+            static reg fma(reg a, reg b, reg c){ return vfmaq_f64(c, a, b); }
+            static reg min(reg a, reg b){ return vminq_f64(a, b); }
+            static reg max(reg a, reg b){ return vmaxq_f64(a, b); }
+        };
+
+        template <> struct V<int32_t>{
+            using reg = int32x4_t;
+            static constexpr size_t width = 4;
+            static reg load(const int32_t* p){ return vld1q_s32(p); }
+            static void store(int32_t* p, reg r){ vst1q_s32(p, r); }
+            static reg set1(int32_t x){ return vdupq_n_s32(x); }
+            static reg add(reg a, reg b){ return vaddq_s32(a, b); }
+            static reg sub(reg a, reg b){ return vsubq_s32(a, b); }
+            static reg mul(reg a, reg b){ return vmulq_s32(a, b); }
+            static reg fma(reg a, reg b, reg c){ return vmlaq_s32(c, a, b); }
+            static reg min(reg a, reg b){ return vminq_s32(a, b); }
+            static reg max(reg a, reg b){ return vmaxq_s32(a, b); }
+        };
+
+#include "simd_kernels.inl"
+    }
+#endif // SIMD_NEON
+
+    // Whether this build has kernels for isa and the CPU can run them
+    inline bool supported(Isa isa){
+        switch(isa){
+            case Isa::Scalar: return true;
+#ifdef SIMD_X86
+            case Isa::SSE2: return __builtin_cpu_supports("sse2");
+            case Isa::AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+            case Isa::AVX512: return __builtin_cpu_supports("avx512f");
+#endif
+#ifdef SIMD_NEON
+            case Isa::NEON: return true;
+#endif
+            default: return false;
+        }
+    }
+
+    inline Isa best_isa(){
+        for(Isa isa : {Isa::AVX512, Isa::AVX2, Isa::NEON, Isa::SSE2}){
+            if(supported(isa)) return isa;
+        }
+        return Isa::Scalar;
+    }
+
+    template <Element T>
+    const Kernels<T>& kernels(Isa isa){
+        static constexpr Kernels<T> scalar_kernels = scalar::make_kernels<T>();
+#ifdef SIMD_X86
+        static constexpr Kernels<T> sse2_kernels = sse2::make_kernels<T>();
+        static constexpr Kernels<T> avx2_kernels = avx2::make_kernels<T>();
+        static constexpr Kernels<T> avx512_kernels = avx512::make_kernels<T>();
+#endif
+#ifdef SIMD_NEON
+        static constexpr Kernels<T> neon_kernels = neon::make_kernels<T>();
+#endif
+        if(!supported(isa)) throw std::runtime_error(std::string(name(isa)) + " is not supported on this machine");
+        switch(isa){
+#ifdef SIMD_X86
+            case Isa::SSE2: return sse2_kernels;
+            case Isa::AVX2: return avx2_kernels;
+            case Isa::AVX512: return avx512_kernels;
+#endif
+#ifdef SIMD_NEON
+            case Isa::NEON: return neon_kernels;
+#endif
+            default: return scalar_kernels;
+        }
+    }
+
+    // The kernels for the best instruction set, chosen on first use
+    template <Element T>
+    const Kernels<T>& best(){
+        static const Kernels<T>& k = kernels<T>(best_isa());
+        return k;
+    }
+
+    template <Element T>
+    void add(const T* a, const T* b, T* out, size_t n){ best<T>().add(a, b, out, n); }
+    template <Element T>
+    void mul(const T* a, const T* b, T* out, size_t n){ best<T>().mul(a, b, out, n); }
+    template <Element T>
+    void fma(const T* a, const T* b, const T* c, T* out, size_t n){ best<T>().fma(a, b, c, out, n); }
+    template <Element T>
+    T dot(const T* a, const T* b, size_t n){ return best<T>().dot(a, b, n); }
+    template <Element T>
+    T sum(const T* a, size_t n){ return best<T>().sum(a, n); }
+    template <Element T>
+    T min(const T* a, size_t n){
+        if(n == 0) throw std::invalid_argument("simd::min of an empty array");
+        return best<T>().min(a, n);
+    }
+    template <Element T>
+    T max(const T* a, size_t n){
+        if(n == 0) throw std::invalid_argument("simd::max of an empty array");
+        return best<T>().max(a, n);
+    }
+}
@@ -0,0 +1,170 @@
+/*
+Generic SIMD kernels, written once against a register type V<T>:
+
+    V<T>::width                      lanes per register
+    V<T>::reg                        the register type
+    V<T>::load(p) / store(p, r)      unaligned load and store of width elements
+    V<T>::set1(x), add, sub, mul, fma (a * b + c), min, max, div (floating point only)
+    V<T>::load_partial(p, n, fill)   optional: load the first n < width elements, other lanes = fill
+    V<T>::store_partial(p, r, n)     optional: store the first n < width lanes
+
+simd.hpp includes this file once per instruction set, inside that set's namespace and its
+#pragma GCC target region, so every kernel is compiled (and its V<T> calls inlined) for that set.
+No #pragma once on purpose.
+
+Tails: the last n % width elements go through one partial load and store, so no element is
+read or written past the end and no scalar loop is needed. Instruction sets with masked loads
+and stores (AVX-512) provide load_partial/store_partial, the others go through a stack buffer.
+Reductions fill the unused lanes with the operation's identity (0 for sum and dot, +max for min,
+lowest for max) and use four accumulators to hide the latency of dependent adds.
+*/
+
+template <typename T>
+inline typename V<T>::reg load_partial(const T* p, size_t n, T fill){
+    if constexpr (requires{ V<T>::load_partial(p, n, fill); }){
+        return V<T>::load_partial(p, n, fill);
+    }
+    else{
+        alignas(64) T buf[V<T>::width];
+        for(size_t i=0; i<V<T>::width; ++i) buf[i] = i < n ? p[i] : fill;
+        return V<T>::load(buf);
+    }
+}
+
+template <typename T>
+inline void store_partial(T* p, typename V<T>::reg r, size_t n){
+    if constexpr (requires{ V<T>::store_partial(p, r, n); }){
+        V<T>::store_partial(p, r, n);
+    }
+    else{
+        alignas(64) T buf[V<T>::width];
+        V<T>::store(buf, r);
+        std::memcpy(p, buf, n * sizeof(T));
+    }
+}
+
+// Register operations as function objects (lambdas in a template don't get the #pragma GCC target)
+template <typename T>
+struct AddOp{ typename V<T>::reg operator()(typename V<T>::reg x, typename V<T>::reg y) const { return V<T>::add(x, y); } };
+template <typename T>
+struct MulOp{ typename V<T>::reg operator()(typename V<T>::reg x, typename V<T>::reg y) const { return V<T>::mul(x, y); } };
+template <typename T>
+struct MinOp{ typename V<T>::reg operator()(typename V<T>::reg x, typename V<T>::reg y) const { return V<T>::min(x, y); } };
+template <typename T>
+struct MaxOp{ typename V<T>::reg operator()(typename V<T>::reg x, typename V<T>::reg y) const { return V<T>::max(x, y); } };
+
+template <typename T, typename Op>
+inline void binary_kernel(const T* a, const T* b, T* out, size_t n, Op op){
+    using v = V<T>;
+    constexpr size_t W = v::width;
+    size_t i = 0;
+    for(; i + 2 * W <= n; i += 2 * W){
+        v::store(out + i, op(v::load(a + i), v::load(b + i)));
+        v::store(out + i + W, op(v::load(a + i + W), v::load(b + i + W)));
+    }
+    for(; i + W <= n; i += W){
+        v::store(out + i, op(v::load(a + i), v::load(b + i)));
+    }
+    if(i < n){
+        size_t rest = n - i;
+        store_partial(out + i, op(load_partial(a + i, rest, T{}), load_partial(b + i, rest, T{})), rest);
+    }
+}
+
+template <typename T>
+void add(const T* a, const T* b, T* out, size_t n){
+    binary_kernel(a, b, out, n, AddOp<T>());
+}
+
+template <typename T>
+void mul(const T* a, const T* b, T* out, size_t n){
+    binary_kernel(a, b, out, n, MulOp<T>());
+}
+
+// out = a * b + c
+template <typename T>
+void fma(const T* a, const T* b, const T* c, T* out, size_t n){
+    using v = V<T>;
+    constexpr size_t W = v::width;
+    size_t i = 0;
+    for(; i + W <= n; i += W){
+        v::store(out + i, v::fma(v::load(a + i), v::load(b + i), v::load(c + i)));
+    }
+    if(i < n){
+        size_t rest = n - i;
+        store_partial(out + i, v::fma(load_partial(a + i, rest, T{}), load_partial(b + i, rest, T{}),
+                                         load_partial(c + i, rest, T{})), rest);
+    }
+}
+
+// Combine the lanes of r with the scalar version of the operation
+template <typename T, typename ScalarOp>
+inline T horizontal(typename V<T>::reg r, T identity, ScalarOp op){
+    alignas(64) T lanes[V<T>::width];
+    V<T>::store(lanes, r);
+    T result = identity;
+    for(T lane : lanes) result = op(result, lane);
+    return result;
+}
+
+template <typename T, typename VecOp, typename ScalarOp>
+inline T reduce_kernel(const T* a, size_t n, T identity, VecOp op, ScalarOp scalar_op){
+    using v = V<T>;
+    constexpr size_t W = v::width;
+    auto acc0 = v::set1(identity), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    size_t i = 0;
+    for(; i + 4 * W <= n; i += 4 * W){
+        acc0 = op(acc0, v::load(a + i));
+        acc1 = op(acc1, v::load(a + i + W));
+        acc2 = op(acc2, v::load(a + i + 2 * W));
+        acc3 = op(acc3, v::load(a + i + 3 * W));
+    }
+    for(; i + W <= n; i += W){
+        acc0 = op(acc0, v::load(a + i));
+    }
+    if(i < n){
+        acc1 = op(acc1, load_partial(a + i, n - i, identity));
+    }
+    return horizontal<T>(op(op(acc0, acc1), op(acc2, acc3)), identity, scalar_op);
+}
+
+template <typename T>
+T sum(const T* a, size_t n){
+    return reduce_kernel(a, n, T{}, AddOp<T>(), detail::scalar_add<T>);
+}
+
+template <typename T>
+T min(const T* a, size_t n){
+    return reduce_kernel(a, n, std::numeric_limits<T>::max(), MinOp<T>(), detail::scalar_min<T>);
+}
+
+template <typename T>
+T max(const T* a, size_t n){
+    return reduce_kernel(a, n, std::numeric_limits<T>::lowest(), MaxOp<T>(), detail::scalar_max<T>);
+}
+
+template <typename T>
+T dot(const T* a, const T* b, size_t n){
+    using v = V<T>;
+    constexpr size_t W = v::width;
+    auto acc0 = v::set1(T{}), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    size_t i = 0;
+    for(; i + 4 * W <= n; i += 4 * W){
+        acc0 = v::fma(v::load(a + i), v::load(b + i), acc0);
+        acc1 = v::fma(v::load(a + i + W), v::load(b + i + W), acc1);
+        acc2 = v::fma(v::load(a + i + 2 * W), v::load(b + i + 2 * W), acc2);
+        acc3 = v::fma(v::load(a + i + 3 * W), v::load(b + i + 3 * W), acc3);
+    }
+    for(; i + W <= n; i += W){
+        acc0 = v::fma(v::load(a + i), v::load(b + i), acc0);
+    }
+    if(i < n){
+        acc1 = v::fma(load_partial(a + i, n - i, T{}), load_partial(b + i, n - i, T{}), acc1);
+    }
+    return horizontal<T>(v::add(v::add(acc0, acc1), v::add(acc2, acc3)), T{}, detail::scalar_add<T>);
+}
+
+template <typename T>
+constexpr Kernels<T> make_kernels(){
+    return Kernels<T>{&add<T>, &mul<T>, &fma<T>, &dot<T>, &sum<T>, &min<T>, &max<T>};
+}
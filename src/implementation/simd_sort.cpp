@@ -0,0 +1,226 @@
+/*
+Tests and benchmark for the vectorized sort, partition and nth_element (see simd_sort.hpp)
+
+The tests compare every instruction set against the std algorithms for all small lengths (every
+padding of the in-register sort) and for larger arrays of several distributions. The benchmark
+sorts int32 and float arrays from 1K elements up to the given size with std::sort and simd::sort,
+and selects the median with std::nth_element and simd::nth_element. Small sizes are repeated so
+every row sorts about the same number of elements in total.
+Arguments: largest array length (1G = 1073741824 needs 4GB per array) and total elements per row
+*/
+
+#include "simd_sort.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <span>
+#include <random>
+#include <cassert>
+#include <cstdlib>
+
+constexpr simd::Isa SortIsas[] = {simd::Isa::Scalar, simd::Isa::AVX2, simd::Isa::AVX512};
+
+enum class Distribution{ Random, Sorted, Reversed, FewUnique, Equal, OrganPipe };
+constexpr Distribution AllDistributions[] = {Distribution::Random, Distribution::Sorted, Distribution::Reversed,
+                                             Distribution::FewUnique, Distribution::Equal, Distribution::OrganPipe};
+
+const char* name(Distribution d){
+    switch(d){
+        case Distribution::Random: return "random";
+        case Distribution::Sorted: return "sorted";
+        case Distribution::Reversed: return "reversed";
+        case Distribution::FewUnique: return "16 values";
+        case Distribution::Equal: return "all equal";
+        case Distribution::OrganPipe: return "organ pipe";
+    }
+    return "unknown";
+}
+
+template <typename T>
+std::vector<T> make_data(size_t n, Distribution d, unsigned seed = 1){
+    std::mt19937 gen(seed);
+    std::vector<T> v(n);
+    for(size_t i=0; i<n; ++i){
+        if constexpr (std::is_integral_v<T>) v[i] = static_cast<T>(gen()); // full range, negatives included
+        else v[i] = static_cast<T>(std::uniform_real_distribution<double>(-1e6, 1e6)(gen));
+    }
+    switch(d){
+        case Distribution::Random: break;
+        case Distribution::Sorted: std::sort(v.begin(), v.end()); break;
+        case Distribution::Reversed: std::sort(v.begin(), v.end(), std::greater<T>()); break;
+        case Distribution::FewUnique: for(auto& x : v) x = static_cast<T>(gen() % 16); break;
+        case Distribution::Equal: std::fill(v.begin(), v.end(), T{42}); break;
+        case Distribution::OrganPipe:
+            for(size_t i=0; i<n; ++i) v[i] = static_cast<T>(i < n / 2 ? i : n - i);
+            break;
+    }
+    return v;
+}
+
+template <typename T>
+void check_sort(const std::vector<T>& input, simd::Isa isa){
+    auto expected = input, v = input;
+    std::sort(expected.begin(), expected.end());
+    simd::sort(v.data(), v.data() + v.size(), isa);
+    assert(v == expected);
+}
+
+template <typename T>
+void check_partition(const std::vector<T>& input, T pivot, simd::Isa isa){
+    auto v = input;
+    T* mid = simd::partition(v.data(), v.data() + v.size(), pivot, isa);
+    auto count = std::count_if(input.begin(), input.end(), [pivot](T x){ return x < pivot; });
+    assert(mid - v.data() == count);
+    assert(std::all_of(v.data(), mid, [pivot](T x){ return x < pivot; }));
+    assert(std::none_of(mid, v.data() + v.size(), [pivot](T x){ return x < pivot; }));
+    // Same elements
+    auto a = input;
+    std::sort(a.begin(), a.end());
+    std::sort(v.begin(), v.end());
+    assert(a == v);
+}
+
+template <typename T>
+void check_nth_element(const std::vector<T>& input, size_t k, simd::Isa isa){
+    auto expected = input, v = input;
+    std::sort(expected.begin(), expected.end());
+    simd::nth_element(v.data(), v.data() + k, v.data() + v.size(), isa);
+    assert(v[k] == expected[k]);
+    assert(std::all_of(v.begin(), v.begin() + k, [&](T x){ return !(v[k] < x); }));
+    assert(std::all_of(v.begin() + k, v.end(), [&](T x){ return !(x < v[k]); }));
+}
+
+template <typename T>
+void test_small(){
+    // Every length up to a few times the in-register sort (8 AVX-512 registers = 128 ints)
+    for(simd::Isa isa : SortIsas){
+        if(!simd::supported(isa)) continue;
+        for(size_t n=0; n<=300; ++n){
+            for(Distribution d : {Distribution::Random, Distribution::FewUnique, Distribution::Reversed}){
+                auto v = make_data<T>(n, d, static_cast<unsigned>(n));
+                check_sort(v, isa);
+                if(n > 0){
+                    check_partition(v, v[n / 3], isa);
+                    check_nth_element(v, n / 3, isa);
+                    check_nth_element(v, n - 1, isa);
+                }
+            }
+        }
+    }
+}
+
+template <typename T>
+void test_large(){
+    for(simd::Isa isa : SortIsas){
+        if(!simd::supported(isa)) continue;
+        for(size_t n : {1000, 4099, 100000}){
+            for(Distribution d : AllDistributions){
+                auto v = make_data<T>(n, d);
+                check_sort(v, isa);
+                check_partition(v, v[n / 2], isa);
+                check_partition(v, T{0}, isa); // maybe not in the array
+                check_nth_element(v, n / 2, isa);
+                check_nth_element(v, 0, isa);
+            }
+        }
+    }
+}
+
+void test_special_values(){
+    // Extremes and infinities must not be confused with the padding of partial registers
+    std::vector<float> f = {INFINITY, -INFINITY, 0.0f, -0.0f, std::numeric_limits<float>::max(),
+                            std::numeric_limits<float>::lowest(), 1e-45f, INFINITY, 3.0f};
+    std::vector<int32_t> i = {INT32_MAX, INT32_MIN, 0, -1, INT32_MAX, 7, INT32_MIN};
+    for(simd::Isa isa : SortIsas){
+        if(!simd::supported(isa)) continue;
+        auto fs = f;
+        simd::sort(fs.data(), fs.data() + fs.size(), isa);
+        assert(std::is_sorted(fs.begin(), fs.end()) && fs.back() == INFINITY && fs.front() == -INFINITY);
+        check_sort(i, isa);
+    }
+}
+
+void test_containers(){
+    Vector<int32_t> v;
+    for(int32_t x : {5, 3, 9, 1, 7}) v.push_back(x);
+    simd::sort(v);
+    assert(std::is_sorted(v.begin(), v.end()));
+
+    for(int32_t x : {4, 8, 0}) v.push_back(x);
+    auto mid = simd::partition(v, 5);
+    assert(mid - v.begin() == 4); // 1 3 4 0
+    simd::nth_element(v, v.begin() + 2);
+    assert(v[2] == 3);
+
+    std::vector<double> d = {3.5, -1.0, 2.0};
+    simd::sort(d);
+    assert(d == (std::vector<double>{-1.0, 2.0, 3.5}));
+
+    float a[] = {3, 1, 2};
+    simd::sort(a);
+    assert(a[0] == 1 && a[2] == 3);
+
+    std::vector<float> big = make_data<float>(1000, Distribution::Random);
+    std::span<float> half(big.data(), 500); // sorts only the first half
+    simd::sort(half);
+    assert(std::is_sorted(big.begin(), big.begin() + 500) && !std::is_sorted(big.begin(), big.end()));
+    auto nth = half.begin() + 100;
+    simd::nth_element(half, nth);
+    assert(*nth == big[100]);
+}
+
+template <typename F>
+double time_ms(F f){
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template <typename T>
+void Benchmark(const char* type, size_t max_n, size_t total){
+    std::cout << "\n" << std::left << std::setw(22) << type << std::right << std::setw(12) << "std::sort" << std::setw(12) << "simd::sort"
+              << std::setw(10) << "speedup" << std::setw(12) << "std::nth" << std::setw(12) << "simd::nth" << std::setw(10) << "speedup"
+              << "   (ns per element)\n";
+    for(size_t n=1024; n<=max_n; n*=32){
+        size_t reps = std::max<size_t>(1, total / n);
+        for(Distribution d : AllDistributions){
+            auto data = make_data<T>(n, d);
+            std::vector<T> v;
+            double sort_std = 0, sort_simd = 0, nth_std = 0, nth_simd = 0;
+            for(size_t r=0; r<reps; ++r){
+                v = data;
+                sort_std += time_ms([&]{ std::sort(v.begin(), v.end()); });
+                v = data;
+                sort_simd += time_ms([&]{ simd::sort(v); });
+                v = data;
+                nth_std += time_ms([&]{ std::nth_element(v.begin(), v.begin() + n / 2, v.end()); });
+                v = data;
+                nth_simd += time_ms([&]{ simd::nth_element(v, v.begin() + n / 2); });
+            }
+            double per = 1e6 / static_cast<double>(reps * n);
+            std::cout << std::left << std::setw(10) << n << std::setw(12) << name(d) << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(12) << sort_std * per << std::setw(12) << sort_simd * per << std::setw(9) << sort_std / sort_simd << "x"
+                      << std::setw(12) << nth_std * per << std::setw(12) << nth_simd * per << std::setw(9) << nth_std / nth_simd << "x\n";
+        }
+    }
+    std::cout.unsetf(std::ios::fixed);
+}
+
+int main(int argc, char** argv){
+    test_small<int32_t>();
+    test_small<float>();
+    test_small<double>();
+    test_large<int32_t>();
+    test_large<float>();
+    test_large<double>();
+    test_special_values();
+    test_containers();
+    std::cout << "All SIMD sort tests passed! Sorting with " << simd::name(simd::sort_isa()) << "\n";
+
+    size_t max_n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1 << 20;
+    size_t total = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1 << 22;
+    Benchmark<int32_t>("int32", max_n, total);
+    Benchmark<float>("float", max_n, total);
+}
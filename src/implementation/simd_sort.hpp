@@ -0,0 +1,317 @@
+#pragma once
+/*
+Vectorized sort, partition and nth_element for float, double and int32_t
+
+    simd::sort(v);                        // Vector<T>, std::vector, std::span, arrays...
+    simd::sort(first, last);              // or a pointer range
+    auto mid = simd::partition(v, 0.5f);  // elements < 0.5f first, returns the end of them
+    simd::nth_element(v, v.begin() + k);  // v[k] is the k-th smallest, smaller ones before it
+
+Drop-in for std::sort / std::partition(x < pivot) / std::nth_element with the default ordering
+(operator<). The result is the same; only the order of equal elements and, for partition and
+nth_element, the order within each side differ. NaNs are not allowed, as for std::sort.
+
+Quicksort with a vectorized partition: it reads W elements into a register at a time, compares
+them with the pivot in one instruction and writes the smaller ones to the left end and the others
+to the right end, in place. AVX-512 does this with compress stores, AVX2 with a permutation
+looked up from a table indexed by the comparison mask (256 entries of 8 lanes). Blocks of up to
+8 registers are sorted entirely in registers with a bitonic network: each register is sorted by
+log2(W) * (log2(W) + 1) / 2 compare-exchange steps (permute, min, max, blend) and sorted registers
+are merged pairwise. Like introsort, a part that still isn't sorted after 2 log2(n) levels of bad
+pivots is handed to std::sort, so the worst case stays O(n log n).
+
+The kernels are compiled for AVX2 and AVX-512 like simd.hpp (generic code in simd_sort_kernels.inl
+over a per instruction set Sort<T>). Other machines (SSE2, NEON) use the std algorithms.
+*/
+
+#include "simd.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <ranges>
+
+namespace simd{
+    namespace sort_detail{
+        // Permutations of a register of W lanes, as indices of its 32-bit units (Units per lane)
+        template <size_t W, size_t Units, typename LaneOf>
+        constexpr std::array<int32_t, W * Units> permutation(LaneOf lane_of){
+            std::array<int32_t, W * Units> table{};
+            for(size_t i=0; i<W; ++i){
+                for(size_t u=0; u<Units; ++u) table[i * Units + u] = static_cast<int32_t>(lane_of(i) * Units + u);
+            }
+            return table;
+        }
+        // Lane i exchanged with lane i ^ J
+        template <size_t W, size_t Units, size_t J>
+        inline constexpr auto xor_table = permutation<W, Units>([](size_t i){ return i ^ J; });
+        template <size_t W, size_t Units>
+        inline constexpr auto reverse_table = permutation<W, Units>([](size_t i){ return W - 1 - i; });
+
+        // For each comparison mask: the lanes whose bit is set first, then the others
+        template <size_t W, size_t Units>
+        constexpr std::array<std::array<int32_t, 8>, (1u << W)> make_compress_table(){
+            std::array<std::array<int32_t, 8>, (1u << W)> table{};
+            for(unsigned mask=0; mask < (1u << W); ++mask){
+                size_t out = 0;
+                for(int pass=0; pass<2; ++pass){
+                    for(size_t lane=0; lane<W; ++lane){
+                        if(((mask >> lane) & 1) != (pass == 0)) continue;
+                        for(size_t u=0; u<Units; ++u) table[mask][out * Units + u] = static_cast<int32_t>(lane * Units + u);
+                        ++out;
+                    }
+                }
+            }
+            return table;
+        }
+        template <size_t W, size_t Units>
+        inline constexpr auto compress_table = make_compress_table<W, Units>();
+
+        // Lanes that keep the larger value in the compare-exchange step (K, J) of a bitonic sort:
+        // lane i is compared with i ^ J, ascending if i & K is 0
+        template <size_t W, size_t K, size_t J>
+        constexpr unsigned max_lanes(){
+            unsigned mask = 0;
+            for(size_t i=0; i<W; ++i){
+                if(((i & J) != 0) == ((i & K) == 0)) mask |= 1u << i;
+            }
+            return mask;
+        }
+
+        // Padding for partially filled registers, sorts after every value
+        template <typename T>
+        constexpr T largest(){
+            if constexpr (std::is_floating_point_v<T>) return std::numeric_limits<T>::infinity();
+            else return std::numeric_limits<T>::max();
+        }
+
+        template <typename T>
+        T median3(T a, T b, T c){
+            return std::max(std::min(a, b), std::min(std::max(a, b), c));
+        }
+
+        // Median of 3, or of 3 medians of 3 for large arrays
+        template <typename T>
+        T choose_pivot(const T* a, size_t n){
+            if(n < 1024) return median3(a[0], a[n / 2], a[n - 1]);
+            size_t s = n / 8;
+            return median3(median3(a[0], a[s], a[2 * s]),
+                           median3(a[n / 2 - s], a[n / 2], a[n / 2 + s]),
+                           median3(a[n - 1 - 2 * s], a[n - 1 - s], a[n - 1]));
+        }
+    }
+
+#ifdef SIMD_X86
+    // Sort<T> adds to V<T>:
+    //   permute(r, idx)          lanes reordered by a table of 32-bit unit indices
+    //   blend<Mask>(lo, hi)      lanes of hi where Mask has a bit, of lo elsewhere
+    //   below<Inclusive>(v, p)   bit mask of the lanes < p (<= p if Inclusive)
+    //   split(left, right_end, v, mask)   lanes in mask to left, the others to just before right_end,
+    //                                     returns how many went left. May write W elements at both
+    //                                     ends, so both need W free slots.
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+    namespace avx2{
+        template <typename T> struct Sort;
+
+        template <> struct Sort<float>{
+            using reg = __m256;
+            static reg permute(reg r, const int32_t* idx){
+                return _mm256_permutevar8x32_ps(r, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx)));
+            }
+            template <unsigned Mask> static reg blend(reg lo, reg hi){ return _mm256_blend_ps(lo, hi, Mask); }
+            template <bool Inclusive> static unsigned below(reg v, reg p){
+                return _mm256_movemask_ps(_mm256_cmp_ps(v, p, Inclusive ? _CMP_LE_OQ : _CMP_LT_OQ));
+            }
+            static size_t split(float* left, float* right_end, reg v, unsigned mask){
+                reg packed = permute(v, sort_detail::compress_table<8, 1>[mask].data());
+                _mm256_storeu_ps(left, packed);
+                _mm256_storeu_ps(right_end - 8, packed);
+                return std::popcount(mask);
+            }
+        };
+
+        template <> struct Sort<double>{
+            using reg = __m256d;
+            static reg permute(reg r, const int32_t* idx){
+                __m256i i = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx));
+                return _mm256_castps_pd(_mm256_permutevar8x32_ps(_mm256_castpd_ps(r), i));
+            }
+            template <unsigned Mask> static reg blend(reg lo, reg hi){ return _mm256_blend_pd(lo, hi, Mask); }
+            template <bool Inclusive> static unsigned below(reg v, reg p){
+                return _mm256_movemask_pd(_mm256_cmp_pd(v, p, Inclusive ? _CMP_LE_OQ : _CMP_LT_OQ));
+            }
+            static size_t split(double* left, double* right_end, reg v, unsigned mask){
+                reg packed = permute(v, sort_detail::compress_table<4, 2>[mask].data());
+                _mm256_storeu_pd(left, packed);
+                _mm256_storeu_pd(right_end - 4, packed);
+                return std::popcount(mask);
+            }
+        };
+
+        template <> struct Sort<int32_t>{
+            using reg = __m256i;
+            static reg permute(reg r, const int32_t* idx){
+                return _mm256_permutevar8x32_epi32(r, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx)));
+            }
+            template <unsigned Mask> static reg blend(reg lo, reg hi){ return _mm256_blend_epi32(lo, hi, Mask); }
+            template <bool Inclusive> static unsigned below(reg v, reg p){
+                // No unsigned compare in AVX2: v < p is p > v, v <= p is !(v > p)
+                if constexpr (Inclusive) return ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, p))) & 0xFF;
+                else return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(p, v)));
+            }
+            static size_t split(int32_t* left, int32_t* right_end, reg v, unsigned mask){
+                reg packed = permute(v, sort_detail::compress_table<8, 1>[mask].data());
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(left), packed);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(right_end - 8), packed);
+                return std::popcount(mask);
+            }
+        };
+
+#include "simd_sort_kernels.inl"
+    }
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+    namespace avx512{
+        template <typename T> struct Sort;
+
+        // Compress stores write exactly the selected lanes. Permutes use the masked form with a full
+        // mask, like min/max in simd.hpp, to avoid GCC 12's uninitialized warning
+        template <> struct Sort<float>{
+            using reg = __m512;
+            static reg permute(reg r, const int32_t* idx){ return _mm512_mask_permutexvar_ps(r, 0xFFFF, _mm512_loadu_si512(idx), r); }
+            template <unsigned Mask> static reg blend(reg lo, reg hi){ return _mm512_mask_blend_ps(static_cast<__mmask16>(Mask), lo, hi); }
+            template <bool Inclusive> static unsigned below(reg v, reg p){
+                return _mm512_cmp_ps_mask(v, p, Inclusive ? _CMP_LE_OQ : _CMP_LT_OQ);
+            }
+            static size_t split(float* left, float* right_end, reg v, unsigned mask){
+                size_t count = std::popcount(mask);
+                _mm512_mask_compressstoreu_ps(left, static_cast<__mmask16>(mask), v);
+                _mm512_mask_compressstoreu_ps(right_end - (16 - count), static_cast<__mmask16>(~mask), v);
+                return count;
+            }
+        };
+
+        template <> struct Sort<double>{
+            using reg = __m512d;
+            static reg permute(reg r, const int32_t* idx){
+                __m512 x = _mm512_castpd_ps(r);
+                return _mm512_castps_pd(_mm512_mask_permutexvar_ps(x, 0xFFFF, _mm512_loadu_si512(idx), x));
+            }
+            template <unsigned Mask> static reg blend(reg lo, reg hi){ return _mm512_mask_blend_pd(static_cast<__mmask8>(Mask), lo, hi); }
+            template <bool Inclusive> static unsigned below(reg v, reg p){
+                return _mm512_cmp_pd_mask(v, p, Inclusive ? _CMP_LE_OQ : _CMP_LT_OQ);
+            }
+            static size_t split(double* left, double* right_end, reg v, unsigned mask){
+                size_t count = std::popcount(mask);
+                _mm512_mask_compressstoreu_pd(left, static_cast<__mmask8>(mask), v);
+                _mm512_mask_compressstoreu_pd(right_end - (8 - count), static_cast<__mmask8>(~mask), v);
+                return count;
+            }
+        };
+
+        template <> struct Sort<int32_t>{
+            using reg = __m512i;
+            static reg permute(reg r, const int32_t* idx){ return _mm512_mask_permutexvar_epi32(r, 0xFFFF, _mm512_loadu_si512(idx), r); }
+            template <unsigned Mask> static reg blend(reg lo, reg hi){ return _mm512_mask_blend_epi32(static_cast<__mmask16>(Mask), lo, hi); }
+            template <bool Inclusive> static unsigned below(reg v, reg p){
+                return _mm512_cmp_epi32_mask(v, p, Inclusive ? _MM_CMPINT_LE : _MM_CMPINT_LT);
+            }
+            static size_t split(int32_t* left, int32_t* right_end, reg v, unsigned mask){
+                size_t count = std::popcount(mask);
+                _mm512_mask_compressstoreu_epi32(left, static_cast<__mmask16>(mask), v);
+                _mm512_mask_compressstoreu_epi32(right_end - (16 - count), static_cast<__mmask16>(~mask), v);
+                return count;
+            }
+        };
+
+#include "simd_sort_kernels.inl"
+    }
+#pragma GCC pop_options
+#endif // SIMD_X86
+
+    // Best instruction set with sort kernels, Scalar uses the std algorithms
+    inline Isa sort_isa(){
+        static Isa isa = supported(Isa::AVX512) ? Isa::AVX512 : supported(Isa::AVX2) ? Isa::AVX2 : Isa::Scalar;
+        return isa;
+    }
+
+    inline void check_sort_isa(Isa isa){
+        if(!supported(isa)) throw std::runtime_error(std::string(name(isa)) + " is not supported on this machine");
+    }
+
+    template <Element T>
+    void sort(T* first, T* last, Isa isa = sort_isa()){
+        check_sort_isa(isa);
+        switch(isa){
+#ifdef SIMD_X86
+            case Isa::AVX2: avx2::sort(first, static_cast<size_t>(last - first)); return;
+            case Isa::AVX512: avx512::sort(first, static_cast<size_t>(last - first)); return;
+#endif
+            default: std::sort(first, last); return;
+        }
+    }
+
+    // Moves the elements < pivot to the front and returns the end of them
+    template <Element T>
+    T* partition(T* first, T* last, T pivot, Isa isa = sort_isa()){
+        check_sort_isa(isa);
+        switch(isa){
+#ifdef SIMD_X86
+            case Isa::AVX2: return first + avx2::partition(first, static_cast<size_t>(last - first), pivot);
+            case Isa::AVX512: return first + avx512::partition(first, static_cast<size_t>(last - first), pivot);
+#endif
+            default: return std::partition(first, last, [pivot](T x){ return x < pivot; });
+        }
+    }
+
+    template <Element T>
+    void nth_element(T* first, T* nth, T* last, Isa isa = sort_isa()){
+        check_sort_isa(isa);
+        if(nth == last) return;
+        switch(isa){
+#ifdef SIMD_X86
+            case Isa::AVX2: avx2::nth_element(first, static_cast<size_t>(last - first), static_cast<size_t>(nth - first)); return;
+            case Isa::AVX512: avx512::nth_element(first, static_cast<size_t>(last - first), static_cast<size_t>(nth - first)); return;
+#endif
+            default: std::nth_element(first, nth, last); return;
+        }
+    }
+
+    // Contiguous ranges: std::vector, std::array, std::span, C arrays
+    template <std::ranges::contiguous_range R> requires Element<std::ranges::range_value_t<R>>
+    void sort(R&& r){
+        auto* p = std::ranges::data(r);
+        sort(p, p + std::ranges::size(r));
+    }
+
+    template <std::ranges::contiguous_range R> requires Element<std::ranges::range_value_t<R>>
+    auto partition(R&& r, std::ranges::range_value_t<R> pivot){
+        auto* p = std::ranges::data(r);
+        return std::ranges::begin(r) + (partition(p, p + std::ranges::size(r), pivot) - p);
+    }
+
+    template <std::ranges::contiguous_range R> requires Element<std::ranges::range_value_t<R>>
+    void nth_element(R&& r, std::ranges::iterator_t<R> nth){
+        auto* p = std::ranges::data(r);
+        nth_element(p, p + (nth - std::ranges::begin(r)), p + std::ranges::size(r));
+    }
+
+    // Vector, also when its iterators are the checked (non contiguous) ones
+    template <Element T, typename Alloc>
+    void sort(Vector<T, Alloc>& v){
+        sort(v.data(), v.data() + v.size());
+    }
+
+    template <Element T, typename Alloc>
+    typename Vector<T, Alloc>::iterator partition(Vector<T, Alloc>& v, T pivot){
+        return v.begin() + (partition(v.data(), v.data() + v.size(), pivot) - v.data());
+    }
+
+    template <Element T, typename Alloc>
+    void nth_element(Vector<T, Alloc>& v, typename Vector<T, Alloc>::iterator nth){
+        nth_element(v.data(), v.data() + (nth - v.begin()), v.data() + v.size());
+    }
+}
@@ -0,0 +1,185 @@
+/*
+Generic sort kernels (see simd_sort.hpp), written against V<T> of simd.hpp and Sort<T>.
+Included once per instruction set inside its namespace and #pragma GCC target region, like
+simd_kernels.inl. No #pragma once on purpose.
+*/
+
+// One compare-exchange step of a bitonic network within a register
+template <typename T, size_t K, size_t J>
+inline typename V<T>::reg exchange(typename V<T>::reg r){
+    constexpr size_t W = V<T>::width;
+    auto partner = Sort<T>::permute(r, sort_detail::xor_table<W, sizeof(T) / 4, J>.data());
+    return Sort<T>::template blend<sort_detail::max_lanes<W, K, J>()>(V<T>::min(r, partner), V<T>::max(r, partner));
+}
+
+// Full bitonic sort of the lanes of a register
+template <typename T, size_t K = 2, size_t J = 1>
+inline typename V<T>::reg sort_register(typename V<T>::reg r){
+    r = exchange<T, K, J>(r);
+    if constexpr (J > 1) return sort_register<T, K, J / 2>(r);
+    else if constexpr (K < V<T>::width) return sort_register<T, 2 * K, K>(r);
+    else return r;
+}
+
+// Sorts a bitonic register (the second half of a bitonic merge)
+template <typename T, size_t J = V<T>::width / 2>
+inline typename V<T>::reg merge_register(typename V<T>::reg r){
+    r = exchange<T, V<T>::width, J>(r);
+    if constexpr (J > 1) return merge_register<T, J / 2>(r);
+    else return r;
+}
+
+template <typename T>
+inline typename V<T>::reg reverse_register(typename V<T>::reg r){
+    return Sort<T>::permute(r, sort_detail::reverse_table<V<T>::width, sizeof(T) / 4>.data());
+}
+
+constexpr size_t SmallRegisters = 8;
+
+// Sorts up to SmallRegisters * W elements in registers: sort each register, then merge sorted
+// runs of 1, 2, 4 registers pairwise. The run count is padded to a power of two with registers of
+// the largest value.
+template <typename T>
+void sort_small(T* a, size_t n){
+    using v = V<T>;
+    constexpr size_t W = v::width;
+    if(n < 2) return;
+    typename v::reg r[SmallRegisters];
+    size_t regs = std::bit_ceil((n + W - 1) / W);
+    constexpr T fill = sort_detail::largest<T>();
+    for(size_t k=0; k<regs; ++k){
+        size_t at = k * W;
+        r[k] = at + W <= n ? v::load(a + at) : at < n ? load_partial(a + at, n - at, fill) : v::set1(fill);
+        r[k] = sort_register<T>(r[k]);
+    }
+    for(size_t m=1; m<regs; m*=2){
+        for(size_t s=0; s<regs; s+=2*m){
+            // Compare element i of the two runs with element 2m * W - 1 - i: afterwards both halves
+            // are bitonic and the first holds the smaller values
+            for(size_t t=0; t<m; ++t){
+                auto x = r[s + t], y = reverse_register<T>(r[s + 2 * m - 1 - t]);
+                r[s + t] = v::min(x, y);
+                r[s + 2 * m - 1 - t] = reverse_register<T>(v::max(x, y));
+            }
+            for(size_t d=m/2; d>0; d/=2){
+                for(size_t t=s; t<s+2*m; ++t){
+                    if((t - s) & d) continue;
+                    auto x = r[t], y = r[t + d];
+                    r[t] = v::min(x, y);
+                    r[t + d] = v::max(x, y);
+                }
+            }
+            for(size_t t=s; t<s+2*m; ++t) r[t] = merge_register<T>(r[t]);
+        }
+    }
+    for(size_t k=0; k * W < n; ++k){
+        size_t at = k * W;
+        if(at + W <= n) v::store(a + at, r[k]);
+        else store_partial(a + at, r[k], n - at);
+    }
+}
+
+// In-place partition of n >= 2W elements, returns the number of elements < pivot (<= if Inclusive).
+// The first and last register are held back, which leaves W free slots at each end to write to;
+// every later register is read from the end with less free space, so both keep at least W.
+template <typename T, bool Inclusive = false>
+size_t partition(T* a, size_t n, T pivot){
+    using v = V<T>;
+    constexpr size_t W = v::width;
+    if(n < 2 * W){
+        T* mid = std::partition(a, a + n, [pivot](T x){ return Inclusive ? !(pivot < x) : x < pivot; });
+        return static_cast<size_t>(mid - a);
+    }
+    auto p = v::set1(pivot);
+    auto first = v::load(a), last = v::load(a + n - W);
+    size_t l = W, r = n - W;   // unread elements: [l, r)
+    size_t lw = 0, rw = n;     // written: [0, lw) and [rw, n)
+    while(r - l >= W){
+        typename v::reg x;
+        if(l - lw <= rw - r){
+            x = v::load(a + l);
+            l += W;
+        }
+        else{
+            r -= W;
+            x = v::load(a + r);
+        }
+        size_t count = Sort<T>::split(a + lw, a + rw, x, Sort<T>::template below<Inclusive>(x, p));
+        lw += count;
+        rw -= W - count;
+    }
+    // The last r - l < W unread elements and the two held back registers fill the 2W + r - l slots left
+    alignas(64) T buf[3 * W];
+    size_t rest = r - l;
+    std::copy(a + l, a + r, buf);
+    v::store(buf + rest, first);
+    v::store(buf + rest + W, last);
+    for(size_t i=0; i<rest+2*W; ++i){
+        if(Inclusive ? !(pivot < buf[i]) : buf[i] < pivot) a[lw++] = buf[i];
+        else a[--rw] = buf[i];
+    }
+    return lw;
+}
+
+// Quicksort down to blocks for sort_small, std::sort once depth runs out (too many bad pivots)
+template <typename T>
+void sort(T* a, size_t n, int depth){
+    while(n > SmallRegisters * V<T>::width){
+        if(depth-- == 0){
+            std::sort(a, a + n);
+            return;
+        }
+        T pivot = sort_detail::choose_pivot(a, n);
+        size_t mid = partition(a, n, pivot);
+        if(mid == 0){
+            // The pivot is the smallest value: its copies go first and are done
+            mid = partition<T, true>(a, n, pivot);
+            a += mid;
+            n -= mid;
+            continue;
+        }
+        // Recurse into the smaller side, loop on the larger one, so the stack stays O(log n)
+        if(mid < n - mid){
+            sort(a, mid, depth);
+            a += mid;
+            n -= mid;
+        }
+        else{
+            sort(a + mid, n - mid, depth);
+            n = mid;
+        }
+    }
+    sort_small(a, n);
+}
+
+template <typename T>
+void sort(T* a, size_t n){
+    sort(a, n, 2 * static_cast<int>(std::bit_width(n)));
+}
+
+// Quickselect: only the side containing k is partitioned further
+template <typename T>
+void nth_element(T* a, size_t n, size_t k){
+    int depth = 2 * static_cast<int>(std::bit_width(n));
+    while(n > SmallRegisters * V<T>::width){
+        if(depth-- == 0){
+            std::nth_element(a, a + k, a + n);
+            return;
+        }
+        T pivot = sort_detail::choose_pivot(a, n);
+        size_t mid = partition(a, n, pivot);
+        if(mid == 0){
+            mid = partition<T, true>(a, n, pivot);
+            if(k < mid) return; // a[k] is a copy of the smallest value
+        }
+        if(k < mid){
+            n = mid;
+        }
+        else{
+            a += mid;
+            n -= mid;
+            k -= mid;
+        }
+    }
+    sort_small(a, n);
+}
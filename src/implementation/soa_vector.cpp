@@ -0,0 +1,168 @@
+/*
+Tests and benchmark for SoAVector (see soa_vector.hpp)
+
+The benchmark sums one field over N records stored as Vector<Record> (array of structs) and as
+SoAVector (struct of arrays). Pass the number of records as the first argument, e.g. 100000000
+*/
+
+#include "soa_vector.hpp"
+#include <iostream>
+#include <chrono>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <numeric>
+#include <stdexcept>
+
+struct Record{
+    double price;
+    int32_t quantity;
+    int32_t id;
+    int64_t timestamp;
+    char tag[8];
+};
+
+using Records = SoAVector<double, int32_t, int32_t, int64_t>;
+
+void test_rows_and_columns(){
+    Records soa;
+    assert(soa.empty());
+    for(int i=0; i<1000; ++i) soa.push_back(i * 1.5, i, -i, int64_t{i} * 1000);
+    assert(soa.size() == 1000);
+
+    // Proxy reference, reads and writes go to the columns
+    auto [price, qty, id, ts] = soa[10];
+    assert(price == 15.0 && qty == 10 && id == -10 && ts == 10000);
+    qty = 42;
+    std::get<0>(soa[11]) = 0.5;
+    assert(soa.column<1>()[10] == 42);
+    assert(std::get<0>(soa.at(11)) == 0.5);
+
+    // Columns are contiguous and cache line aligned
+    auto prices = soa.column<0>();
+    assert(prices.size() == 1000);
+    assert(reinterpret_cast<uintptr_t>(prices.data()) % 64 == 0);
+    assert(reinterpret_cast<uintptr_t>(soa.column<3>().data()) % 64 == 0);
+
+    soa.pop_back();
+    assert(soa.size() == 999 && soa.column<2>().size() == 999);
+    soa.resize(2000);
+    assert(std::get<3>(soa[1999]) == 0);
+}
+
+void test_const_and_at(){
+    Records soa;
+    soa.push_back(Records::value_type{1.0, 2, 3, 4});
+    const Records& c = soa;
+    assert(std::get<2>(c[0]) == 3);
+    bool thrown = false;
+    try{
+        c.at(1);
+    }
+    catch(const std::out_of_range&){
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+// Copies and default constructions throw while fail is set
+struct Fragile{
+    static inline bool fail = false;
+    int value = 0;
+    Fragile(){ if(fail) throw std::runtime_error("construction failed"); }
+    Fragile(int v) : value(v) {}
+    Fragile(const Fragile& other) : value(other.value) { if(fail) throw std::runtime_error("copy failed"); }
+    Fragile& operator=(const Fragile&) = default;
+};
+
+void test_columns_stay_in_step(){
+    SoAVector<int, Fragile, double> soa;
+    for(int i=0; i<5; ++i) soa.push_back(i, Fragile(i), i * 0.5);
+
+    auto in_step = [&](size_t n){
+        return soa.size() == n && soa.column<0>().size() == n && soa.column<1>().size() == n
+            && soa.column<2>().size() == n;
+    };
+    Fragile::fail = true;
+    bool thrown = false;
+    try{
+        soa.push_back(5, Fragile(5), 2.5); // the int column gets its value first
+    }
+    catch(const std::runtime_error&){
+        thrown = true;
+    }
+    assert(thrown && in_step(5));
+
+    thrown = false;
+    try{
+        soa.resize(20);
+    }
+    catch(const std::runtime_error&){
+        thrown = true;
+    }
+    assert(thrown && in_step(5) && std::get<1>(soa[4]).value == 4);
+
+    Fragile::fail = false;
+    soa.push_back(5, Fragile(5), 2.5);
+    soa.resize(8);
+    assert(in_step(8) && std::get<0>(soa[5]) == 5);
+}
+
+// Marked noinline so the benchmark measures the loop, not whatever the optimizer makes of main
+[[gnu::noinline]] double sum_aos(const Vector<Record>& v){
+    double sum = 0;
+    for(size_t i=0; i<v.size(); ++i) sum += v[i].price;
+    return sum;
+}
+
+[[gnu::noinline]] double sum_soa(std::span<const double> prices){
+    // Aligned, contiguous doubles. With -O3 -ffast-math this becomes packed adds
+    const double* p = std::assume_aligned<64>(prices.data());
+    double sum = 0;
+    for(size_t i=0; i<prices.size(); ++i) sum += p[i];
+    return sum;
+}
+
+[[gnu::noinline]] int64_t sum_aos_quantity(const Vector<Record>& v){
+    int64_t sum = 0;
+    for(size_t i=0; i<v.size(); ++i) sum += v[i].quantity;
+    return sum;
+}
+
+[[gnu::noinline]] int64_t sum_soa_quantity(std::span<const int32_t> quantities){
+    // Integer adds are associative, so this vectorizes even without -ffast-math
+    return std::accumulate(quantities.begin(), quantities.end(), int64_t{0});
+}
+
+int main(int argc, char** argv){
+    test_rows_and_columns();
+    test_const_and_at();
+    test_columns_stay_in_step();
+    std::cout << "All SoAVector tests passed!\n";
+
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000000;
+    Vector<Record> aos;
+    aos.reserve(n);
+    Records soa;
+    soa.reserve(n);
+    for(size_t i=0; i<n; ++i){
+        Record r{i * 0.25, static_cast<int32_t>(i & 1023), static_cast<int32_t>(i), static_cast<int64_t>(i), {}};
+        aos.push_back(r);
+        soa.push_back(r.price, r.quantity, r.id, r.timestamp);
+    }
+
+    using clock = std::chrono::high_resolution_clock;
+    auto ms = [](auto d){ return std::chrono::duration<double, std::milli>(d).count(); };
+    auto time = [&](const char* name, auto f){
+        auto start = clock::now();
+        auto result = f();
+        auto end = clock::now();
+        std::cout << name << ms(end - start) << " ms (sum " << result << ")" << std::endl;
+    };
+
+    std::cout << "Field sums over " << n << " records (" << sizeof(Record) << " bytes each)" << std::endl;
+    time("Vector<Record> price:    ", [&]{ return sum_aos(aos); });
+    time("SoAVector price column:  ", [&]{ return sum_soa(soa.column<0>()); });
+    time("Vector<Record> quantity: ", [&]{ return sum_aos_quantity(aos); });
+    time("SoAVector quantity column: ", [&]{ return sum_soa_quantity(soa.column<1>()); });
+}
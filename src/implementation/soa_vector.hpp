@@ -0,0 +1,136 @@
+#pragma once
+/*
+Structure-of-arrays container: SoAVector<double, int, int> stores three separate, cache line
+aligned arrays instead of one array of {double, int, int}
+
+Each column is a Vector<Field, AlignedAllocator<Field>>, so growth, construction and allocation
+are exactly Vector's. Scanning one field through column<I>() reads only that field's bytes and the
+loop over a plain span is easy for the compiler to vectorize.
+Rows are accessed through proxy references (a tuple of references, one per column), which also
+work with structured bindings: auto [price, qty, id] = soa[i];
+*/
+
+#include "vector.hpp"
+#include "aligned_allocator.hpp"
+#include <tuple>
+#include <span>
+#include <utility> // std::index_sequence
+#include <stdexcept>
+
+template <typename... Fields>
+class SoAVector{
+    static_assert(sizeof...(Fields) > 0, "SoAVector needs at least one field");
+
+    template <typename F>
+    using Column = Vector<F, AlignedAllocator<F>>;
+    using Indices = std::index_sequence_for<Fields...>;
+
+public:
+    using reference = std::tuple<Fields&...>;
+    using const_reference = std::tuple<const Fields&...>;
+    using value_type = std::tuple<Fields...>;
+
+    template <size_t I>
+    using field_type = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+    SoAVector() = default;
+
+    void reserve(size_t n){
+        for_each_column([n](auto& col){ col.reserve(n); });
+    }
+
+    void push_back(const Fields&... values){
+        push_back_impl(Indices{}, values...);
+    }
+    void push_back(const value_type& row){
+        std::apply([this](const Fields&... values){ push_back(values...); }, row);
+    }
+
+    void pop_back(){
+        for_each_column([](auto& col){ col.pop_back(); });
+    }
+
+    // If a column fails to grow, the ones already resized go back to the old size
+    void resize(size_t n){
+        size_t old = size();
+        try{
+            for_each_column([n](auto& col){ col.resize(n); });
+        }
+        catch(...){
+            for_each_column([old](auto& col){ col.resize(old); }); // only shrinks, can't throw
+            throw;
+        }
+    }
+
+    void clear() noexcept {
+        for_each_column([](auto& col){ col.clear(); });
+    }
+
+    void shrink_to_fit(){
+        for_each_column([](auto& col){ col.shrink_to_fit(); });
+    }
+
+    // Row access through proxy references
+    reference operator[](size_t i){ return row(i, Indices{}); }
+    const_reference operator[](size_t i) const { return row(i, Indices{}); }
+
+    reference at(size_t i){
+        if(i >= size()) throw std::out_of_range("Index out of range");
+        return row(i, Indices{});
+    }
+    const_reference at(size_t i) const {
+        if(i >= size()) throw std::out_of_range("Index out of range");
+        return row(i, Indices{});
+    }
+
+    // Direct access to one field of every row
+    template <size_t I>
+    std::span<field_type<I>> column() noexcept {
+        auto& col = std::get<I>(columns_);
+        return {col.data(), col.size()};
+    }
+    template <size_t I>
+    std::span<const field_type<I>> column() const noexcept {
+        const auto& col = std::get<I>(columns_);
+        return {col.data(), col.size()};
+    }
+
+    // All columns have the same size, the first one is the reference
+    size_t size() const noexcept { return std::get<0>(columns_).size(); }
+    size_t capacity() const noexcept { return std::get<0>(columns_).capacity(); }
+    bool empty() const noexcept { return size() == 0; }
+
+private:
+    template <size_t... I>
+    void push_back_impl(std::index_sequence<I...>, const Fields&... values){
+        // Reserve every column first so a failed allocation can't leave the columns out of step
+        if(size() == capacity()){
+            reserve(capacity() ? capacity() * 2 : 1);
+        }
+        // A copy can still throw: take the value back out of the columns that got one
+        size_t pushed = 0;
+        try{
+            ((std::get<I>(columns_).push_back(values), ++pushed), ...);
+        }
+        catch(...){
+            ((I < pushed ? std::get<I>(columns_).pop_back() : void()), ...);
+            throw;
+        }
+    }
+
+    template <size_t... I>
+    reference row(size_t i, std::index_sequence<I...>){
+        return reference(std::get<I>(columns_)[i]...);
+    }
+    template <size_t... I>
+    const_reference row(size_t i, std::index_sequence<I...>) const {
+        return const_reference(std::get<I>(columns_)[i]...);
+    }
+
+    template <typename F>
+    void for_each_column(F f){
+        std::apply([&f](auto&... cols){ (f(cols), ...); }, columns_);
+    }
+
+    std::tuple<Column<Fields>...> columns_;
+};
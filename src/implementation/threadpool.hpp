@@ -0,0 +1,127 @@
+#pragma once
+/*
+Fixed size thread pool (see threadpool.cpp for a demo)
+
+parallel_for() splits an index range into one chunk per worker, runs them on the pool and on the
+calling thread, and waits for all of them. Don't call it from inside a pool task: the task would
+block a worker waiting on chunks that may be queued behind it.
+*/
+
+#include <queue>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <latch>
+#include <exception>
+#include <algorithm>
+#include <cstddef>
+
+class ThreadPool{
+public:
+    // Constructor
+    ThreadPool(size_t num_threads) : stop_(false){
+        for(size_t i=0; i<num_threads; ++i){
+            threads_.emplace_back([this](){
+                for(;;){
+                    std::unique_lock<std::mutex> lock{mtx_};
+                    // Wait until the thread is stopped or there is a task in the queue
+                    cv_.wait(lock, [this](){ return stop_ || !tasks_.empty(); });
+                    if(stop_ && tasks_.empty()) return;
+                    // Otherwise pop task from queue and execute
+                    auto task = std::move(tasks_.front());
+                    tasks_.pop();
+                    lock.unlock();
+                    // Execute the task
+                    task();
+                }
+            });
+        }
+    }
+    // Destructor
+    ~ThreadPool(){
+        {
+            // Set under the lock so a worker can't miss the notification between its check and wait
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+
+        // Join all threads
+        for(auto& t : threads_){
+            if(t.joinable()){
+                t.join();
+            }
+        }
+    }
+
+    template <typename F>
+    void queueTask(F&& f){
+        std::lock_guard<std::mutex> lock(mtx_);
+        tasks_.push(std::forward<F>(f));
+        cv_.notify_one();
+    }
+
+    size_t size() const noexcept { return threads_.size(); }
+
+    // Call f(lo, hi) on disjoint chunks covering [begin, end), chunks have at least grain indices.
+    // The first exception thrown by a chunk is rethrown here once all chunks have finished
+    template <typename F>
+    void parallel_for(size_t begin, size_t end, F&& f, size_t grain = 1){
+        if(end <= begin) return;
+        size_t n = end - begin;
+        grain = std::max<size_t>(grain, 1);
+        size_t chunks = std::min(size() + 1, n / grain); // workers + calling thread, rounded down so none is short
+        if(chunks <= 1){
+            f(begin, end);
+            return;
+        }
+
+        std::latch done(static_cast<std::ptrdiff_t>(chunks - 1));
+        std::exception_ptr error;
+        std::mutex error_mtx;
+        auto run = [&](size_t lo, size_t hi){
+            try{
+                f(lo, hi);
+            }
+            catch(...){
+                std::lock_guard<std::mutex> lock(error_mtx);
+                if(!error) error = std::current_exception();
+            }
+        };
+        auto bound = [&](size_t c){ return begin + n * c / chunks; }; // chunk c is [bound(c), bound(c + 1))
+        size_t c = 1;
+        try{
+            for(; c<chunks; ++c){
+                queueTask([&run, &done, lo = bound(c), hi = bound(c + 1)](){
+                    run(lo, hi);
+                    done.count_down();
+                });
+            }
+        }
+        catch(...){
+            // Couldn't queue a task. The queued ones use run and done from this frame, so do the
+            // rest here and wait for them before the exception leaves
+            {
+                std::lock_guard<std::mutex> lock(error_mtx);
+                if(!error) error = std::current_exception();
+            }
+            for(; c<chunks; ++c){
+                run(bound(c), bound(c + 1));
+                done.count_down();
+            }
+        }
+        run(begin, bound(1));
+        done.wait();
+        if(error) std::rethrow_exception(error);
+    }
+
+private:
+    std::atomic<bool> stop_;
+    std::mutex mtx_;
+    std::vector<std::thread> threads_;
+    std::queue<std::function<void()>> tasks_;
+    std::condition_variable cv_;
+};
@@ -0,0 +1,118 @@
+/*
+Tests and benchmark for allocation tracking (see tracking_allocator.hpp)
+
+This file also replaces global operator new, so the final report attributes everything the
+program allocated, including the benchmark's untracked baseline (charged to "global new").
+The benchmark times a std::list push/pop loop with a plain allocator, full tracking and 1/64
+sampling.
+Arguments: number of list operations
+*/
+
+#define TRACKING_REPLACE_GLOBAL_NEW
+#include "tracking_allocator.hpp"
+#include "vector.hpp"
+#include <iostream>
+#include <chrono>
+#include <list>
+#include <thread>
+#include <cassert>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+void test_per_container(){
+    auto& orders = tracking::stats("test:orders");
+    auto& prices = tracking::stats("test:prices");
+    {
+        Vector<int, TrackingAllocator<int>> a{TrackingAllocator<int>("test:orders")};
+        Vector<double, TrackingAllocator<double>> b{TrackingAllocator<double>("test:prices")};
+        for(int i=0; i<1000; ++i) a.push_back(i);
+        b.push_back(1.0);
+        assert(orders.live_bytes() == static_cast<int64_t>(a.capacity() * sizeof(int)));
+        assert(prices.live_bytes() == static_cast<int64_t>(b.capacity() * sizeof(double)));
+        assert(orders.allocations() > 1); // it grew several times
+    }
+    assert(orders.live_bytes() == 0 && prices.live_bytes() == 0);
+    assert(orders.allocations() == orders.deallocations());
+    assert(orders.peak_bytes() >= static_cast<int64_t>(1000 * sizeof(int)));
+}
+
+void test_rebind(){
+    // List nodes are allocated by a rebound copy, which keeps the tag
+    auto& nodes = tracking::stats("test:list");
+    {
+        std::list<int, TrackingAllocator<int>> list(TrackingAllocator<int>("test:list"));
+        for(int i=0; i<100; ++i) list.push_back(i);
+        assert(nodes.allocations() == 100 && nodes.live_bytes() > static_cast<int64_t>(100 * sizeof(int)));
+    }
+    assert(nodes.live_bytes() == 0);
+}
+
+void test_scopes(){
+    // std::string and std::vector call ::operator new directly (a new expression may be optimized away)
+    auto& parse = tracking::stats("test:parse");
+    auto& inner_stats = tracking::stats("test:inner"); // registering a tag allocates too
+    std::string leaked_out;
+    {
+        tracking::AllocationScope scope("test:parse");
+        leaked_out.assign(400, 'x');
+        {
+            tracking::AllocationScope inner("test:inner");
+            std::vector<int> temporary(10);
+        }
+        assert(parse.allocations() == 1 && parse.live_bytes() > 400);
+    }
+    // Freed outside the scope, still credited back to it
+    std::string().swap(leaked_out);
+    assert(parse.live_bytes() == 0 && parse.deallocations() == 1);
+    assert(inner_stats.allocations() == 1);
+
+    // Threads have their own scopes
+    std::thread([]{
+        tracking::AllocationScope scope("test:thread");
+        std::vector<int> temporary(10);
+    }).join();
+    assert(tracking::stats("test:thread").allocations() == 1);
+}
+
+void test_sampling(){
+    constexpr uint32_t Rate = 16;
+    auto& sampled = tracking::stats("test:sampled", Rate);
+    {
+        std::list<int, TrackingAllocator<int>> list(TrackingAllocator<int>("test:sampled", Rate));
+        for(int i=0; i<100000; ++i) list.push_back(i);
+        // An estimate: close to the real count, a multiple of the rate
+        assert(sampled.allocations() % Rate == 0);
+        assert(sampled.allocations() > 50000 && sampled.allocations() < 200000);
+    }
+    // Exact for live bytes: every recorded block was also recorded when it was freed
+    assert(sampled.live_bytes() == 0);
+}
+
+template <typename Alloc>
+void Benchmark(const char* name, Alloc alloc, size_t ops){
+    std::list<int, Alloc> list(alloc);
+    auto start = std::chrono::high_resolution_clock::now();
+    for(size_t i=0; i<ops; ++i){
+        list.push_back(static_cast<int>(i));
+        if(list.size() > 1000) list.pop_front();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << name << ": " << std::chrono::duration<double, std::nano>(end - start).count() / ops << " ns per push/pop" << std::endl;
+}
+
+int main(int argc, char** argv){
+    test_per_container();
+    test_rebind();
+    test_scopes();
+    test_sampling();
+    std::cout << "All tracking allocator tests passed!\n";
+
+    size_t ops = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    if(ops == 0) return 0;
+    Benchmark("std::allocator (global new)  ", std::allocator<int>(), ops);
+    Benchmark("TrackingAllocator            ", TrackingAllocator<int>("bench:full"), ops);
+    Benchmark("TrackingAllocator, 1/64      ", TrackingAllocator<int>("bench:sampled", 64), ops);
+    std::cout << "\n";
+    tracking::report(std::cout);
+}
@@ -0,0 +1,264 @@
+#pragma once
+/*
+Allocation tracking: per-tag counts, bytes, live bytes and peak
+
+    Vector<Order, TrackingAllocator<Order>> orders{TrackingAllocator<Order>("orders")};
+    std::list<int, TrackingAllocator<int>> nodes(TrackingAllocator<int>("nodes", 64)); // 1 in 64 sampled
+    tracking::report(std::cout);
+
+TrackingAllocator<T, Alloc> wraps any allocator (std::allocator by default, or e.g.
+HugePageAllocator, ArenaAllocator) and charges everything it allocates to its tag. Copies and
+rebound copies (list nodes, shared_ptr control blocks) keep the tag, so every container built
+with its own tag is accounted for separately. The tag's statistics are looked up once, when the
+allocator is constructed; after that each allocation is a few relaxed atomic adds.
+
+Sampling: with a sample rate of N only blocks whose address hashes to 0 mod N are recorded and
+the report multiplies by N. The decision depends only on the address, so a block is either
+recorded both when it is allocated and when it is freed or not at all, and live bytes stay
+consistent. A tag's rate is fixed when the tag is first used.
+
+Global operator new: define TRACKING_REPLACE_GLOBAL_NEW before including this header in exactly
+one .cpp file of the program. Plain new/delete are then charged to the innermost
+tracking::AllocationScope of the calling thread ("global new" outside any scope), except blocks
+a TrackingAllocator gets from its wrapped allocator, which are charged to its tag only. Each block
+carries a 16 byte header with its size and tag, so it is credited back to the right tag even
+when it is freed somewhere else. Over-aligned new (std::align_val_t) is not tracked.
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace tracking{
+    class Stats{
+    public:
+        explicit constexpr Stats(uint32_t sample_rate = 1) noexcept : sample_rate_(sample_rate ? sample_rate : 1) {}
+
+        // Whether the block at p is recorded, the same answer at allocation and deallocation
+        bool sampled(const void* p) const noexcept {
+            if(sample_rate_ == 1) return true;
+            uint64_t h = (reinterpret_cast<uintptr_t>(p) >> 4) * 0x9E3779B97F4A7C15ull;
+            return (h >> 32) % sample_rate_ == 0;
+        }
+
+        void on_allocate(const void* p, size_t bytes) noexcept {
+            if(!sampled(p)) return;
+            allocations_.fetch_add(1, std::memory_order_relaxed);
+            bytes_.fetch_add(bytes, std::memory_order_relaxed);
+            int64_t live = live_.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed) + static_cast<int64_t>(bytes);
+            int64_t peak = peak_.load(std::memory_order_relaxed);
+            while(live > peak && !peak_.compare_exchange_weak(peak, live, std::memory_order_relaxed)){}
+        }
+        void on_deallocate(const void* p, size_t bytes) noexcept {
+            if(!sampled(p)) return;
+            deallocations_.fetch_add(1, std::memory_order_relaxed);
+            live_.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+        }
+
+        // Estimates: recorded values times the sample rate
+        uint64_t allocations() const noexcept { return allocations_.load(std::memory_order_relaxed) * sample_rate_; }
+        uint64_t deallocations() const noexcept { return deallocations_.load(std::memory_order_relaxed) * sample_rate_; }
+        uint64_t bytes() const noexcept { return bytes_.load(std::memory_order_relaxed) * sample_rate_; }
+        int64_t live_bytes() const noexcept { return live_.load(std::memory_order_relaxed) * sample_rate_; }
+        int64_t peak_bytes() const noexcept { return peak_.load(std::memory_order_relaxed) * sample_rate_; }
+        uint32_t sample_rate() const noexcept { return sample_rate_; }
+
+    private:
+        const uint32_t sample_rate_;
+        std::atomic<uint64_t> allocations_{0};
+        std::atomic<uint64_t> deallocations_{0};
+        std::atomic<uint64_t> bytes_{0};
+        std::atomic<int64_t> live_{0};
+        std::atomic<int64_t> peak_{0};
+    };
+
+    class Registry{
+    public:
+        static Registry& instance(){
+            // Never destroyed: blocks freed during static destruction still update their Stats
+            static Registry* registry = new Registry;
+            return *registry;
+        }
+
+        // The Stats for tag, created with sample_rate on first use. The reference stays valid forever
+        Stats& stats(const std::string& tag, uint32_t sample_rate = 1){
+            std::lock_guard<std::mutex> lock(mtx_);
+            return tags_.try_emplace(tag, sample_rate).first->second;
+        }
+
+        // Snapshot of all tags, biggest peak first
+        std::vector<std::pair<std::string, const Stats*>> snapshot() const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            std::vector<std::pair<std::string, const Stats*>> result;
+            for(const auto& [tag, stats] : tags_) result.emplace_back(tag, &stats);
+            std::sort(result.begin(), result.end(), [](const auto& a, const auto& b){
+                return a.second->peak_bytes() > b.second->peak_bytes();
+            });
+            return result;
+        }
+
+    private:
+        Registry() = default;
+        mutable std::mutex mtx_;
+        std::map<std::string, Stats> tags_; // map nodes don't move, so Stats& stay valid
+    };
+
+    // Global operator new outside any AllocationScope. Not in the registry, so it works before main
+    inline Stats global_new_stats;
+
+    inline Stats& stats(const std::string& tag, uint32_t sample_rate = 1){
+        return Registry::instance().stats(tag, sample_rate);
+    }
+
+    // Table of every tag: allocations, frees, total bytes, live bytes, peak live bytes.
+    // Sampled tags are estimates and marked with ~
+    inline void report(std::ostream& os){
+        auto rows = Registry::instance().snapshot();
+        if(global_new_stats.allocations() > 0) rows.emplace_back("global new", &global_new_stats);
+        os << std::left << std::setw(24) << "tag" << std::right
+           << std::setw(12) << "allocs" << std::setw(12) << "frees"
+           << std::setw(14) << "bytes" << std::setw(14) << "live" << std::setw(14) << "peak" << "\n";
+        for(const auto& [tag, s] : rows){
+            std::string name = s->sample_rate() > 1 ? "~" + tag + " (1/" + std::to_string(s->sample_rate()) + ")" : tag;
+            os << std::left << std::setw(24) << name << std::right
+               << std::setw(12) << s->allocations() << std::setw(12) << s->deallocations()
+               << std::setw(14) << s->bytes() << std::setw(14) << s->live_bytes()
+               << std::setw(14) << s->peak_bytes() << "\n";
+        }
+    }
+
+    // Global operator new charges the innermost scope of the calling thread
+    inline thread_local Stats* current_scope = nullptr;
+    // Set while a TrackingAllocator calls its wrapped allocator, so global new doesn't count the block twice
+    inline thread_local bool inside_tracking_allocator = false;
+
+    class AllocationScope{
+    public:
+        explicit AllocationScope(const std::string& tag, uint32_t sample_rate = 1)
+            : previous_(current_scope) {
+            Stats& s = stats(tag, sample_rate); // may allocate, still charged to the previous scope
+            current_scope = &s;
+        }
+        ~AllocationScope(){ current_scope = previous_; }
+
+        AllocationScope(const AllocationScope&) = delete;
+        AllocationScope& operator=(const AllocationScope&) = delete;
+
+    private:
+        Stats* previous_;
+    };
+}
+
+template <typename T, typename Alloc = std::allocator<T>>
+class TrackingAllocator{
+    using Traits = std::allocator_traits<Alloc>;
+
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind{ using other = TrackingAllocator<U, typename Traits::template rebind_alloc<U>>; };
+
+    TrackingAllocator() : TrackingAllocator("untagged") {}
+    explicit TrackingAllocator(const std::string& tag, uint32_t sample_rate = 1, const Alloc& alloc = Alloc())
+        : alloc_(alloc), stats_(&tracking::stats(tag, sample_rate)) {}
+    template <typename U, typename A>
+    TrackingAllocator(const TrackingAllocator<U, A>& other) noexcept
+        : alloc_(other.inner()), stats_(&other.stats()) {}
+
+    T* allocate(size_t n){
+        tracking::inside_tracking_allocator = true;
+        T* p;
+        try{
+            p = Traits::allocate(alloc_, n);
+        }
+        catch(...){
+            tracking::inside_tracking_allocator = false;
+            throw;
+        }
+        tracking::inside_tracking_allocator = false;
+        stats_->on_allocate(p, n * sizeof(T));
+        return p;
+    }
+    void deallocate(T* p, size_t n) noexcept {
+        stats_->on_deallocate(p, n * sizeof(T));
+        Traits::deallocate(alloc_, p, n);
+    }
+
+    // Forwarded when the wrapped allocator can grow in place (see Vector::reserve)
+    T* reallocate(T* p, size_t old_n, size_t new_n) requires requires(Alloc a, T* q, size_t n){ a.reallocate(q, n, n); } {
+        T* q = alloc_.reallocate(p, old_n, new_n);
+        stats_->on_deallocate(p, old_n * sizeof(T));
+        stats_->on_allocate(q, new_n * sizeof(T));
+        return q;
+    }
+
+    const Alloc& inner() const noexcept { return alloc_; }
+    tracking::Stats& stats() const noexcept { return *stats_; }
+
+    template <typename U, typename A>
+    bool operator==(const TrackingAllocator<U, A>& other) const noexcept {
+        return alloc_ == other.inner() && stats_ == &other.stats();
+    }
+
+private:
+    Alloc alloc_;
+    tracking::Stats* stats_;
+};
+
+#ifdef TRACKING_REPLACE_GLOBAL_NEW
+namespace tracking::detail{
+    // Before every block, keeps max_align_t alignment
+    struct alignas(std::max_align_t) Header{
+        Stats* stats; // nullptr for blocks already charged by a TrackingAllocator
+        size_t size;
+    };
+    static_assert(sizeof(Header) == alignof(std::max_align_t));
+
+    // noinline: GCC would otherwise see malloc/free behind new/delete and warn about a mismatch
+    [[gnu::noinline]] inline void* allocate(size_t n) noexcept {
+        void* raw = std::malloc(sizeof(Header) + n);
+        if(!raw) return nullptr;
+        Stats* s = inside_tracking_allocator ? nullptr : current_scope ? current_scope : &global_new_stats;
+        auto* header = static_cast<Header*>(raw);
+        header->stats = s;
+        header->size = n;
+        if(s) s->on_allocate(header + 1, n);
+        return header + 1;
+    }
+    [[gnu::noinline]] inline void deallocate(void* p) noexcept {
+        if(!p) return;
+        auto* header = static_cast<Header*>(p) - 1;
+        if(header->stats) header->stats->on_deallocate(p, header->size);
+        std::free(header);
+    }
+}
+
+void* operator new(size_t n){
+    if(void* p = tracking::detail::allocate(n)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t n){
+    if(void* p = tracking::detail::allocate(n)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(size_t n, const std::nothrow_t&) noexcept { return tracking::detail::allocate(n); }
+void* operator new[](size_t n, const std::nothrow_t&) noexcept { return tracking::detail::allocate(n); }
+void operator delete(void* p) noexcept { tracking::detail::deallocate(p); }
+void operator delete[](void* p) noexcept { tracking::detail::deallocate(p); }
+void operator delete(void* p, size_t) noexcept { tracking::detail::deallocate(p); }
+void operator delete[](void* p, size_t) noexcept { tracking::detail::deallocate(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { tracking::detail::deallocate(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { tracking::detail::deallocate(p); }
+
+#endif
@@ -0,0 +1,154 @@
+/*
+Tests for Custom::unique_ptr with custom deleters and arrays (see custom.hpp)
+
+A deleter is any callable taking the pointer. Stateless deleters (default_delete, empty structs,
+captureless lambdas) cost nothing, which is checked with static_asserts below. Deleters with state
+(a length for munmap) or function pointers cost what they store.
+*/
+
+#include "custom.hpp"
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+struct FileCloser{
+    void operator()(std::FILE* f) const noexcept { std::fclose(f); }
+};
+
+// munmap needs the length, so this deleter has state
+struct Unmapper{
+    size_t length = 0;
+    void operator()(void* p) const noexcept { munmap(p, length); }
+};
+
+// A file descriptor isn't a pointer: the deleter names a handle type with pointer-like nullability
+struct FdCloser{
+    struct pointer{
+        int fd = -1;
+        pointer() = default;
+        pointer(std::nullptr_t) {}
+        explicit pointer(int f) : fd(f) {}
+        friend bool operator==(pointer a, std::nullptr_t) { return a.fd < 0; }
+    };
+    void operator()(pointer p) const noexcept { close(p.fd); }
+};
+
+inline auto lambda_deleter = [](int* p){ delete p; };
+
+// Zero overhead for stateless deleters
+static_assert(sizeof(Custom::unique_ptr<int>) == sizeof(int*));
+static_assert(sizeof(Custom::unique_ptr<int[]>) == sizeof(int*));
+static_assert(sizeof(Custom::unique_ptr<std::FILE, FileCloser>) == sizeof(std::FILE*));
+static_assert(sizeof(Custom::unique_ptr<int, decltype(lambda_deleter)>) == sizeof(int*));
+// Deleters with state pay for it
+static_assert(sizeof(Custom::unique_ptr<void, Unmapper>) == sizeof(void*) + sizeof(size_t));
+static_assert(sizeof(Custom::unique_ptr<int, void(*)(int*)>) == 2 * sizeof(void*));
+// A function pointer deleter has to be passed in, value initialized it would be null
+static_assert(!std::is_constructible_v<Custom::unique_ptr<std::FILE, int(*)(std::FILE*)>, std::FILE*>);
+static_assert(!std::is_default_constructible_v<Custom::unique_ptr<std::FILE, int(*)(std::FILE*)>>);
+static_assert(std::is_constructible_v<Custom::unique_ptr<std::FILE, int(*)(std::FILE*)>, std::FILE*, int(*)(std::FILE*)>);
+
+struct Counted{
+    static inline int live = 0;
+    Counted(){ ++live; }
+    virtual ~Counted(){ --live; }
+};
+struct Derived : Counted{};
+
+// Counts calls, stands in for returning objects to a pool
+struct PoolReturn{
+    int* returned;
+    void operator()(Counted* p) const noexcept { delete p; ++*returned; }
+};
+
+void test_basics(){
+    {
+        auto p = Custom::make_unique<Counted>();
+        assert(Counted::live == 1);
+        Custom::unique_ptr<Counted> q = std::move(p);
+        assert(!p && q);
+        Counted* raw = q.release();
+        assert(!q && Counted::live == 1);
+        q.reset(raw);
+        q.reset();
+        assert(Counted::live == 0);
+
+        // Derived to base, deleted through the virtual destructor
+        Custom::unique_ptr<Counted> base = Custom::make_unique<Derived>();
+        assert(Counted::live == 1);
+    }
+    assert(Counted::live == 0);
+
+    bool threw = false;
+    try{ Custom::unique_ptr<int> empty; *empty = 1; }
+    catch(const std::runtime_error&){ threw = true; }
+    assert(threw);
+}
+
+void test_deleters(){
+    int returned = 0;
+    {
+        Custom::unique_ptr<Counted, PoolReturn> p(new Counted, PoolReturn{&returned});
+        Custom::unique_ptr<Counted, PoolReturn> q(nullptr, PoolReturn{&returned});
+        q = std::move(p); // the deleter moves along with the pointer
+        assert(returned == 0 && q.get_deleter().returned == &returned);
+    }
+    assert(returned == 1 && Counted::live == 0);
+
+    {
+        Custom::unique_ptr<std::FILE, FileCloser> file(std::tmpfile());
+        assert(file);
+        std::fputs("hello", file.get());
+    }
+
+    {
+        size_t length = 1 << 20;
+        void* region = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        assert(region != MAP_FAILED);
+        Custom::unique_ptr<void, Unmapper> mapping(region, Unmapper{length});
+        std::memset(mapping.get(), 1, length);
+        assert(mapping.get_deleter().length == length);
+    }
+
+    int fd_number = -1;
+    {
+        Custom::unique_ptr<int, FdCloser> fd(FdCloser::pointer(open("/dev/null", O_RDONLY)));
+        assert(fd);
+        fd_number = fd.get().fd;
+        assert(fcntl(fd_number, F_GETFD) != -1);
+    }
+    assert(fcntl(fd_number, F_GETFD) == -1); // closed
+}
+
+void test_arrays(){
+    {
+        auto a = Custom::make_unique<Counted[]>(3);
+        assert(Counted::live == 3);
+        Custom::unique_ptr<Counted[]> b = std::move(a);
+        assert(!a && Counted::live == 3);
+    } // delete[]
+    assert(Counted::live == 0);
+
+    auto zeros = Custom::make_unique<int[]>(100);
+    for(int i=0; i<100; ++i) assert(zeros[i] == 0);
+
+    // Not zeroed, only valid to write before reading
+    auto buffer = Custom::make_unique_for_overwrite<char[]>(4096);
+    std::memset(buffer.get(), 'x', 4096);
+    assert(buffer[4095] == 'x');
+    auto single = Custom::make_unique_for_overwrite<int>();
+    *single = 7;
+    assert(*single == 7);
+}
+
+int main(){
+    test_basics();
+    test_deleters();
+    test_arrays();
+    std::cout << "All unique_ptr tests passed!\n";
+}
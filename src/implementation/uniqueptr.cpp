@@ -1,76 +1,165 @@
 #include <iostream>
 #include <utility>
+#include <type_traits>
+#include <cstddef>
+#include <cstdio>
 
 namespace JS{
     template<typename T>
-    class unique_ptr{
+    struct default_delete{
+        void operator()(T* p) const { delete p; }
+    };
+    template<typename T>
+    struct default_delete<T[]>{
+        void operator()(T* p) const { delete[] p; }
+    };
+
+    // Empty base optimization: an empty deleter is stored as a base class, which takes no space,
+    // so unique_ptr stays the size of a pointer. Anything else (function pointers, deleters with
+    // state, final classes) is stored as a member
+    template<typename Deleter, bool Empty = std::is_empty_v<Deleter> && !std::is_final_v<Deleter>>
+    class deleter_storage : private Deleter{
+    public:
+        deleter_storage() = default;
+        deleter_storage(Deleter d) : Deleter(std::move(d)){}
+        Deleter& get_deleter(){ return *this; }
+        const Deleter& get_deleter() const { return *this; }
+    };
+    template<typename Deleter>
+    class deleter_storage<Deleter, false>{
     public:
-        // Default constructors
-        unique_ptr() : ptr_(nullptr){}
+        deleter_storage() = default;
+        deleter_storage(Deleter d) : deleter_(std::move(d)){}
+        Deleter& get_deleter(){ return deleter_; }
+        const Deleter& get_deleter() const { return deleter_; }
+    private:
+        Deleter deleter_{};
+    };
+
+    // Ownership logic shared by unique_ptr<T> and unique_ptr<T[]>
+    template<typename T, typename Deleter>
+    class unique_ptr_base : public deleter_storage<Deleter>{
+        using Storage = deleter_storage<Deleter>;
+    public:
+        // Default constructors (not for function pointer deleters, they would be null)
+        unique_ptr_base() requires (std::is_default_constructible_v<Deleter> && !std::is_pointer_v<Deleter>) : ptr_(nullptr){}
         // Constructor
-        unique_ptr(T* ptr) : ptr_(ptr){}
+        unique_ptr_base(T* ptr) requires (std::is_default_constructible_v<Deleter> && !std::is_pointer_v<Deleter>) : ptr_(ptr){}
+        unique_ptr_base(T* ptr, Deleter d) : Storage(std::move(d)), ptr_(ptr){}
         // Destructor
-        ~unique_ptr() {
-            if(ptr_) delete ptr_;
+        ~unique_ptr_base() {
+            if(ptr_) this->get_deleter()(ptr_);
         }
         // Move constructor
-        unique_ptr(unique_ptr&& other) noexcept {
+        unique_ptr_base(unique_ptr_base&& other) noexcept : Storage(std::move(other.get_deleter())) {
             ptr_ = std::exchange(other.ptr_, nullptr);
         }
         // Move assignment operator
-        unique_ptr& operator=(unique_ptr&& other) noexcept {
+        unique_ptr_base& operator=(unique_ptr_base&& other) noexcept {
             if(this == &other){
                 return *this;
             }
-            if(ptr_) delete ptr_;
-            ptr_ = std::exchange(other.ptr_, nullptr);
+            reset(std::exchange(other.ptr_, nullptr));
+            this->get_deleter() = std::move(other.get_deleter());
             return *this;
         }
         // Delete the copy assignment operator
-        unique_ptr& operator=(const unique_ptr& other) = delete;
+        unique_ptr_base& operator=(const unique_ptr_base& other) = delete;
         // Delete the copy constructor
-        unique_ptr(const unique_ptr& other) = delete;
-        // Dereference operator
-        T& operator*(){
-            return *ptr_;
-        }
-        // Const dereference operator
-        T& operator*() const {
-            return *ptr_;
-        }
-        // Arrow operator
-        T* operator->(){
-            return ptr_;
-        }
-        // Const arrow operator
-        T* operator->() const {
-            return ptr_;
-        }
-        // Get function 
-        T* get() {
-            return ptr_;
-        }
+        unique_ptr_base(const unique_ptr_base& other) = delete;
+        // Get function
         T* get() const {
             return ptr_;
         }
         void reset(T* p = nullptr){
             if(p == ptr_) return;
-            if(ptr_) delete ptr_;
+            if(ptr_) this->get_deleter()(ptr_);
             ptr_ = p;
         }
-        void release(){
-            delete ptr_;
-            ptr_ = nullptr;
+        // Give up ownership without deleting
+        T* release(){
+            return std::exchange(ptr_, nullptr);
+        }
+        explicit operator bool() const {
+            return ptr_ != nullptr;
         }
 
-    private:
+    protected:
         T* ptr_;
     };
+
+    template<typename T, typename Deleter = default_delete<T>>
+    class unique_ptr : public unique_ptr_base<T, Deleter>{
+    public:
+        using unique_ptr_base<T, Deleter>::unique_ptr_base;
+        // Dereference operator
+        T& operator*() const {
+            return *this->ptr_;
+        }
+        // Arrow operator
+        T* operator->() const {
+            return this->ptr_;
+        }
+    };
+
+    // Arrays are indexed instead of dereferenced and freed with delete[]
+    template<typename T, typename Deleter>
+    class unique_ptr<T[], Deleter> : public unique_ptr_base<T, Deleter>{
+    public:
+        using unique_ptr_base<T, Deleter>::unique_ptr_base;
+        T& operator[](size_t i) const {
+            return this->ptr_[i];
+        }
+    };
+
+    template<typename T, typename... Args> requires (!std::is_array_v<T>)
+    unique_ptr<T> make_unique(Args&&... args){
+        return unique_ptr<T>(new T(std::forward<Args>(args)...));
+    }
+    template<typename T> requires std::is_unbounded_array_v<T>
+    unique_ptr<T> make_unique(size_t n){
+        return unique_ptr<T>(new std::remove_extent_t<T>[n]()); // zeroed
+    }
+    // Skips the zeroing for buffers that are about to be overwritten anyway
+    template<typename T> requires (!std::is_array_v<T>)
+    unique_ptr<T> make_unique_for_overwrite(){
+        return unique_ptr<T>(new T);
+    }
+    template<typename T> requires std::is_unbounded_array_v<T>
+    unique_ptr<T> make_unique_for_overwrite(size_t n){
+        return unique_ptr<T>(new std::remove_extent_t<T>[n]);
+    }
 }
 
+struct FileCloser{
+    void operator()(std::FILE* f) const { std::fclose(f); }
+};
+
+// Stateless deleters cost nothing, a function pointer costs a word
+static_assert(sizeof(JS::unique_ptr<int>) == sizeof(int*));
+static_assert(sizeof(JS::unique_ptr<int[]>) == sizeof(int*));
+static_assert(sizeof(JS::unique_ptr<std::FILE, FileCloser>) == sizeof(std::FILE*));
+static_assert(sizeof(JS::unique_ptr<std::FILE, int(*)(std::FILE*)>) == 2 * sizeof(void*));
+static_assert(!std::is_constructible_v<JS::unique_ptr<std::FILE, int(*)(std::FILE*)>, std::FILE*>); // needs the function
+static_assert(!std::is_default_constructible_v<JS::unique_ptr<std::FILE, int(*)(std::FILE*)>>);
+
 using namespace std;
 
 int main(){
     JS::unique_ptr<int> p(new int{5});
     cout << "The integer pointed to by the unique ptr is " << *p << endl;
-}
\ No newline at end of file
+
+    auto arr = JS::make_unique<int[]>(4);
+    arr[3] = 7;
+    cout << "The last element of the unique ptr array is " << arr[3] << endl;
+
+    auto buffer = JS::make_unique_for_overwrite<char[]>(64);
+    snprintf(buffer.get(), 64, "written without zeroing first");
+    cout << buffer.get() << endl;
+
+    // fclose instead of delete
+    JS::unique_ptr<FILE, FileCloser> file(tmpfile());
+    fputs("hello", file.get());
+    JS::unique_ptr<FILE, int(*)(FILE*)> file2(tmpfile(), &fclose);
+    cout << "Files are closed by their deleters" << endl;
+}
@@ -0,0 +1,503 @@
+#pragma once
+/*
+This is an example of a memory efficient vector
+*/
+
+#include <new> // placement new
+#include <utility> // std::exchange, std::move, std::forward
+#include <memory>
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept> // std::out_of_range exception
+#include <iterator>
+#include <concepts>
+#include <type_traits>
+#include <compare>
+#include <mutex>
+#include <vector>
+#include "threadpool.hpp"
+
+// AddressSanitizer builds (or -DVECTOR_CHECKED_ITERATORS=1) replace Vector's raw pointer iterators
+// with checked ones that detect use after reallocation and out of range access. Not tied to NDEBUG,
+// since plain builds without -DNDEBUG are the normal case here. Define it as 0 to turn them off
+#ifndef VECTOR_CHECKED_ITERATORS
+#if defined(__SANITIZE_ADDRESS__) // GCC
+#define VECTOR_CHECKED_ITERATORS 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) // Clang
+#define VECTOR_CHECKED_ITERATORS 1
+#endif
+#endif
+#ifndef VECTOR_CHECKED_ITERATORS
+#define VECTOR_CHECKED_ITERATORS 0
+#endif
+#endif
+
+// Allocators that can grow a block without copying it (e.g. with mremap) expose reallocate()
+template <typename Alloc, typename T>
+concept ReallocatingAllocator = requires(Alloc a, T* p, size_t n){
+    { a.reallocate(p, n, n) } -> std::same_as<T*>;
+};
+
+template <typename T, typename Alloc = std::allocator<T>>
+class Vector{
+    using Traits = std::allocator_traits<Alloc>;
+
+public:
+    // types (these must exist in accordance with the CPP standard)
+    using value_type = T;
+    using allocator_type = Alloc;
+    
+    // Default constructor
+    Vector() noexcept : Vector{Alloc()} {}
+
+    // Allocator-accepting ctor
+    explicit Vector(const Alloc& alloc) noexcept 
+    : alloc_(alloc), data_(nullptr), size_(0), capacity_(0) {}
+
+    // Reserve but don't construct
+    explicit Vector(size_t n, const Alloc& alloc = Alloc())
+    : alloc_(alloc), data_(Traits::allocate(alloc_, n)), size_(0), capacity_(n) {}
+
+    // Use placement new to copy construct n elements
+    explicit Vector(size_t n, const T& val, const Alloc& alloc = Alloc())
+    : Vector(n, alloc) {
+        size_ = n;
+        for(size_t i=0; i<size_; i++){
+            Traits::construct(alloc_, data_+i, val);
+            // new(data_+i) T(val); // placement new
+        }
+    }
+
+    // Initialize using initialzer list
+    Vector(std::initializer_list<T> list, const Alloc& alloc = Alloc())
+    : Vector(alloc) {
+        for(const T& v: list){
+            push_back(v);
+        }
+    }
+    // Copy constructor
+    Vector(const Vector& other) 
+    : Vector(other.size_, other.alloc_) {
+        size_ = other.size_;
+        for(size_t i=0; i<size_; ++i){
+            Traits::construct(alloc_, data_+i, other.data_[i]);
+            // new(data_+i) T(other.data_[i]);
+        }
+    }
+    // Parallel fill and copy for very large vectors. Each worker constructs its own slice,
+    // so the pages are also first touched (and placed, on NUMA machines) by the worker using them.
+    // Small vectors stay on the calling thread
+    Vector(size_t n, const T& val, ThreadPool& pool, const Alloc& alloc = Alloc())
+    : Vector(n, alloc) {
+        parallel_construct(n, pool, [&](size_t i){ Traits::construct(alloc_, data_+i, val); });
+        size_ = n;
+    }
+    Vector(const Vector& other, ThreadPool& pool)
+    : Vector(other.size_, other.alloc_) {
+        parallel_construct(other.size_, pool, [&](size_t i){ Traits::construct(alloc_, data_+i, other.data_[i]); });
+        size_ = other.size_;
+    }
+    // Move constructor
+    Vector(Vector&& other) noexcept 
+    :   alloc_(std::move(other.alloc_)),
+        data_(std::exchange(other.data_, nullptr)), 
+        size_(std::exchange(other.size_, 0)),
+        capacity_(std::exchange(other.capacity_, 0)) {
+        other.invalidate_iterators();
+    }
+    
+    friend void swap(Vector& a, Vector& b) noexcept {
+        using std::swap;
+        swap(a.data_, b.data_);
+        swap(a.size_, b.size_);
+        swap(a.capacity_, b.capacity_);
+        swap(a.alloc_, b.alloc_);
+        a.invalidate_iterators();
+        b.invalidate_iterators();
+    }
+    // Copy assignment operator 
+    Vector& operator=(const Vector& other) {
+        if(this==&other) return *this;
+        // Copy and swap
+        Vector temp(other); // Make copy using copy constructor
+        swap(*this, temp);
+        return *this;
+    }
+    // Move assignment operator
+    Vector& operator=(Vector&& other) noexcept {
+        if(this==&other) return *this;
+        clear();
+        if(data_){
+            Traits::deallocate(alloc_, data_, capacity_);
+            // ::operator delete(data_);
+        }
+        invalidate_iterators();
+        other.invalidate_iterators();
+        using std::exchange;
+        size_ = exchange(other.size_, 0);
+        capacity_ = exchange(other.capacity_, 0);
+        data_ = exchange(other.data_, nullptr);
+        return *this;
+    }
+
+    ~Vector() noexcept {
+        invalidate_iterators();
+        clear();
+        if(data_){
+            Traits::deallocate(alloc_, data_, capacity_);
+            // ::operator delete(data_);
+        }
+    }
+    // Reserve raw memory
+    void reserve(size_t n){
+        if(n <= capacity_) return;
+        invalidate_iterators();
+        // Trivially copyable elements can be moved by the allocator itself
+        if constexpr (ReallocatingAllocator<Alloc, T> && std::is_trivially_copyable_v<T>){
+            data_ = alloc_.reallocate(data_, capacity_, n);
+            capacity_ = n;
+            return;
+        }
+        relocate(n);
+    }
+
+    // Function to forward constructor arguments and insert
+    template<typename... Args>
+    void emplace_back(Args&&... args){
+        if(size_>=capacity_){
+            // args may refer into this vector (v.push_back(v[0])), and reserve moves the elements
+            // (or mremaps them away), so build the new element before the old storage goes
+            T tmp(std::forward<Args>(args)...);
+            reserve(capacity_? capacity_ * 2 : 1);
+            Traits::construct(alloc_, data_ + size_, std::move(tmp));
+        }
+        else{
+            Traits::construct(alloc_, data_ + size_, std::forward<Args>(args)...);
+            // new (data_ + size_) T(std::forward<Args>(args)...);
+        }
+        ++size_;
+    }
+    
+    void push_back(const T& val){ emplace_back(val); }
+    void push_back(T&& val){ emplace_back(std::move(val)); }
+
+    void pop_back(){
+        if(size_>0){
+            --size_;
+            Traits::destroy(alloc_, data_+size_);
+            // data_[size_].~T();
+        }
+    }
+
+    // Resize and default construct. If a constructor throws, the size is unchanged
+    void resize(size_t n){
+        if(n <= size_){
+            for(size_t i=n; i<size_; ++i){
+                Traits::destroy(alloc_, data_+i);
+                // data_[i].~T();
+            }
+            size_ = n;
+            return;
+        }
+        reserve(n);
+        construct_back(n);
+    }
+    // Resize and value construct
+    void resize(size_t n, const T& val){
+        if(n <= size_){
+            resize(n);
+            return;
+        }
+        if(n > capacity_){
+            T copy(val); // val may be one of our elements, which reserve moves
+            reserve(n);
+            construct_back(n, copy);
+            return;
+        }
+        construct_back(n, val);
+    }
+
+    void shrink_to_fit(){
+        invalidate_iterators();
+        if(size_==0){
+            Traits::deallocate(alloc_, data_, capacity_);
+            // ::operator delete(data_);
+            data_ = nullptr;
+            capacity_=0;
+        }
+        else{
+            relocate(size_);
+        }
+    }
+
+    // Clear the vector, keep the capacity
+    void clear() noexcept {
+        for(size_t i=0; i<size_; i++){
+            Traits::destroy(alloc_, data_+i);
+            // data_[i].~T();
+        }
+        size_ = 0;
+    }
+    // Destroy the elements in parallel, keep the capacity
+    void clear(ThreadPool& pool){
+        if constexpr (!std::is_trivially_destructible_v<T>){
+            pool.parallel_for(0, size_, [&](size_t lo, size_t hi){
+                for(size_t i=lo; i<hi; ++i){
+                    Traits::destroy(alloc_, data_+i);
+                }
+            }, ParallelGrain);
+        }
+        size_ = 0;
+    }
+
+    // Accessors
+    T& front() {
+        if(empty()) throw std::logic_error("Vector is empty");
+        return data_[0]; 
+    }
+    const T& front() const {
+        if(empty()) throw std::logic_error("Vector is empty");
+        return data_[0];
+    }
+    T& back() {
+        if(empty()) throw std::logic_error("Vector is empty");
+        return data_[size_-1];
+    }
+    const T& back() const {
+        if(empty()) throw std::logic_error("Vector is empty");
+        return data_[size_-1];
+    }
+
+    T& operator[](size_t i){ return data_[i]; }
+    const T& operator[](size_t i) const { return data_[i]; }
+
+    // Bounds-checked accessors
+    T& at(size_t i){
+        if(i>=size_) throw std::out_of_range("Index out of range");
+        return data_[i];
+    }
+    const T& at(size_t i) const {
+        if(i>=size_) throw std::out_of_range("Index out of range");
+        return data_[i];
+    }
+
+#if VECTOR_CHECKED_ITERATORS
+    // Random access iterator that remembers its vector and the vector's generation when it was
+    // created. Every reallocation bumps the generation, so any later use of the iterator throws
+    template <bool Const>
+    class checked_iterator{
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const T*, T*>;
+        using reference = std::conditional_t<Const, const T&, T&>;
+
+        checked_iterator() = default;
+        checked_iterator(const Vector* owner, size_t index) noexcept
+        : owner_(owner), index_(index), generation_(owner->generation_) {}
+        // iterator -> const_iterator
+        template <bool OtherConst> requires (Const && !OtherConst)
+        checked_iterator(const checked_iterator<OtherConst>& other) noexcept
+        : owner_(other.owner_), index_(other.index_), generation_(other.generation_) {}
+
+        reference operator*() const { check_deref(index_); return ptr()[index_]; }
+        pointer operator->() const { check_deref(index_); return ptr() + index_; }
+        reference operator[](difference_type n) const { check_deref(index_ + n); return ptr()[index_ + n]; }
+
+        checked_iterator& operator+=(difference_type n){ check_range(index_ + n); index_ += n; return *this; }
+        checked_iterator& operator-=(difference_type n){ return *this += -n; }
+        checked_iterator& operator++(){ return *this += 1; }
+        checked_iterator& operator--(){ return *this -= 1; }
+        checked_iterator operator++(int){ checked_iterator tmp = *this; ++*this; return tmp; }
+        checked_iterator operator--(int){ checked_iterator tmp = *this; --*this; return tmp; }
+
+        friend checked_iterator operator+(checked_iterator it, difference_type n){ return it += n; }
+        friend checked_iterator operator+(difference_type n, checked_iterator it){ return it += n; }
+        friend checked_iterator operator-(checked_iterator it, difference_type n){ return it -= n; }
+        friend difference_type operator-(const checked_iterator& a, const checked_iterator& b){
+            a.check_compatible(b);
+            return static_cast<difference_type>(a.index_) - static_cast<difference_type>(b.index_);
+        }
+        friend bool operator==(const checked_iterator& a, const checked_iterator& b){
+            a.check_compatible(b);
+            return a.index_ == b.index_;
+        }
+        friend std::strong_ordering operator<=>(const checked_iterator& a, const checked_iterator& b){
+            a.check_compatible(b);
+            return a.index_ <=> b.index_;
+        }
+
+    private:
+        friend class checked_iterator<!Const>;
+
+        pointer ptr() const noexcept { return const_cast<Vector*>(owner_)->data_; }
+
+        void check_valid() const {
+            if(!owner_) throw std::logic_error("Vector iterator is not attached to a vector");
+            if(generation_ != owner_->generation_) throw std::logic_error("Vector iterator used after reallocation");
+        }
+        // Positions [0, size] are valid for arithmetic, [0, size) for dereferencing
+        void check_range(difference_type i) const {
+            check_valid();
+            if(i < 0 || static_cast<size_t>(i) > owner_->size_) throw std::out_of_range("Vector iterator out of range");
+        }
+        void check_deref(difference_type i) const {
+            check_valid();
+            if(i < 0 || static_cast<size_t>(i) >= owner_->size_) throw std::out_of_range("Vector iterator out of range");
+        }
+        void check_compatible(const checked_iterator& other) const {
+            if(!owner_ && !other.owner_) return;
+            check_valid();
+            other.check_valid();
+            if(owner_ != other.owner_) throw std::logic_error("Comparing iterators of different vectors");
+        }
+
+        const Vector* owner_ = nullptr;
+        difference_type index_ = 0;
+        size_t generation_ = 0;
+    };
+
+    using iterator = checked_iterator<false>;
+    using const_iterator = checked_iterator<true>;
+
+    // Mutable iterators
+    iterator begin() noexcept { return iterator(this, 0); }
+    iterator end() noexcept { return iterator(this, size_); }
+    // Const iterators
+    const_iterator begin() const noexcept { return const_iterator(this, 0); }
+    const_iterator end() const noexcept { return const_iterator(this, size_); }
+    // Read only iterators
+    const_iterator cbegin() const noexcept { return const_iterator(this, 0); }
+    const_iterator cend() const noexcept { return const_iterator(this, size_); }
+#else
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    // Mutable iterators
+    iterator begin() noexcept { return data_; }
+    iterator end() noexcept { return data_ + size_; }
+    // Const iterators
+    const_iterator begin() const noexcept { return data_; }
+    const_iterator end() const noexcept { return data_ + size_; }
+    // Read only iterators
+    const_iterator cbegin() const noexcept { return data_; }
+    const_iterator cend() const noexcept { return data_ + size_; }
+#endif
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    // Mutable reverse iterator
+    reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+    reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+    // Const reverse iterators
+    const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+    const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+    // Read only reverse iterators
+    const_reverse_iterator crbegin() const noexcept { return const_reverse_iterator(end()); }
+    const_reverse_iterator crend() const noexcept { return const_reverse_iterator(begin()); }
+
+    // Raw pointer to the elements, never checked
+    T* data() noexcept { return data_; }
+    const T* data() const noexcept { return data_; }
+
+    size_t capacity() const noexcept { return capacity_; }
+    size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0;}
+    
+    allocator_type get_allocator() const noexcept { return alloc_; }
+
+private:
+    // Minimum number of elements per task in the parallel paths
+    static constexpr size_t ParallelGrain = size_t{1} << 16;
+
+    // construct(i) for every i in [0, n) on the pool. If one throws, every element constructed so far
+    // is destroyed before the exception leaves (size_ is still 0, the destructor won't do it)
+    template <typename F>
+    void parallel_construct(size_t n, ThreadPool& pool, F construct){
+        std::mutex mtx;
+        std::vector<std::pair<size_t, size_t>> finished; // chunks that were fully constructed
+        finished.reserve(pool.size() + 1); // one per chunk at most, so recording one can't throw
+        try{
+            pool.parallel_for(0, n, [&](size_t lo, size_t hi){
+                size_t i = lo;
+                try{
+                    for(; i<hi; ++i) construct(i);
+                }
+                catch(...){
+                    for(size_t j=lo; j<i; ++j) Traits::destroy(alloc_, data_+j);
+                    throw;
+                }
+                std::lock_guard<std::mutex> lock(mtx);
+                finished.emplace_back(lo, hi);
+            }, ParallelGrain);
+        }
+        catch(...){
+            for(auto [lo, hi] : finished){
+                for(size_t j=lo; j<hi; ++j) Traits::destroy(alloc_, data_+j);
+            }
+            throw;
+        }
+    }
+
+    // Moves the elements to a new block of n. Strong guarantee: the elements are moved only if
+    // that can't throw (copied otherwise), and the old block is released once all of them are over
+    void relocate(size_t n){
+        T* newdata = Traits::allocate(alloc_, n);
+        // T* newdata = allocate(n);
+        size_t i = 0;
+        try{
+            for(; i<size_; ++i){
+                Traits::construct(alloc_, newdata + i, std::move_if_noexcept(data_[i]));
+                // new (newdata + i) T(std::move(data_[i]));
+            }
+        }
+        catch(...){
+            for(size_t j=0; j<i; ++j) Traits::destroy(alloc_, newdata + j);
+            Traits::deallocate(alloc_, newdata, n);
+            throw;
+        }
+        for(i=0; i<size_; ++i) Traits::destroy(alloc_, data_ + i);
+        // Delete the previous heap block
+        if(data_){
+            Traits::deallocate(alloc_, data_, capacity_);
+        }
+        // ::operator delete(data_);
+        data_ = newdata;
+        capacity_ = n;
+    }
+
+    // Constructs [size_, n) from args (n <= capacity_). If one throws, the ones built are destroyed
+    template <typename... Args>
+    void construct_back(size_t n, const Args&... args){
+        size_t i = size_;
+        try{
+            for(; i<n; ++i) Traits::construct(alloc_, data_ + i, args...);
+        }
+        catch(...){
+            for(size_t j=size_; j<i; ++j) Traits::destroy(alloc_, data_ + j);
+            throw;
+        }
+        size_ = n;
+    }
+
+    // Called whenever data_ changes, compiles to nothing without checked iterators
+    void invalidate_iterators() noexcept {
+#if VECTOR_CHECKED_ITERATORS
+        ++generation_;
+#endif
+    }
+
+    // Function to heap allocate raw memory for n instances of T
+    // static T* allocate(size_t n){
+    //     return static_cast<T*>(::operator new(n * sizeof(T)));
+    // }
+
+    Alloc alloc_;
+    T* data_;
+    size_t size_, capacity_;
+#if VECTOR_CHECKED_ITERATORS
+    size_t generation_ = 0;
+#endif
+};
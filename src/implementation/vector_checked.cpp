@@ -0,0 +1,106 @@
+/*
+Tests for Vector's checked iterators (see VECTOR_CHECKED_ITERATORS in vector.hpp)
+
+Build it twice:
+  g++ -std=c++20 -DVECTOR_CHECKED_ITERATORS=1 vector_checked.cpp
+  (or -fsanitize=address)                        -> checked iterators, runtime tests below
+  g++ -std=c++20 -O2 vector_checked.cpp          -> default, the static_asserts prove the iterators
+                                                   are raw pointers and the layout is unchanged,
+                                                   so the generated code is the same as before
+*/
+
+#include "vector.hpp"
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <cassert>
+#include <algorithm>
+
+#if !VECTOR_CHECKED_ITERATORS
+// Default build: no wrapper and no generation counter
+static_assert(std::is_same_v<Vector<int>::iterator, int*>);
+static_assert(std::is_same_v<Vector<int>::const_iterator, const int*>);
+static_assert(std::is_same_v<Vector<std::string>::iterator, std::string*>);
+static_assert(std::contiguous_iterator<Vector<int>::iterator>);
+
+struct VectorLayout{
+    std::allocator<int> alloc;
+    int* data;
+    size_t size, capacity;
+};
+static_assert(sizeof(Vector<int>) == sizeof(VectorLayout));
+#else
+static_assert(std::random_access_iterator<Vector<int>::iterator>);
+static_assert(std::random_access_iterator<Vector<int>::const_iterator>);
+
+template <typename Exception, typename F>
+bool throws(F f){
+    try{
+        f();
+    }
+    catch(const Exception&){
+        return true;
+    }
+    return false;
+}
+
+void test_use_after_reserve(){
+    Vector<int> v{1, 2, 3};
+    auto it = v.begin();
+    assert(*it == 1);
+    v.reserve(100); // reallocates, it now points into freed memory
+    assert(throws<std::logic_error>([&]{ return *it; }));
+    assert(throws<std::logic_error>([&]{ ++it; }));
+    // Fresh iterators are fine
+    assert(*v.begin() == 1);
+}
+
+void test_use_after_push_back(){
+    Vector<std::string> v;
+    v.push_back("a");
+    auto it = v.cbegin();
+    v.push_back("b"); // capacity 1 -> 2
+    assert(throws<std::logic_error>([&]{ return it->size(); }));
+}
+
+void test_out_of_range(){
+    Vector<int> v{1, 2, 3};
+    assert(throws<std::out_of_range>([&]{ return *v.end(); }));
+    assert(throws<std::out_of_range>([&]{ return v.begin() + 4; }));
+    assert(throws<std::out_of_range>([&]{ return v.begin() - 1; }));
+    assert(throws<std::out_of_range>([&]{ return v.begin()[3]; }));
+    auto last = v.end() - 1;
+    v.pop_back(); // no reallocation, but last is now past the end
+    assert(throws<std::out_of_range>([&]{ return *last; }));
+}
+
+void test_mixing_vectors(){
+    Vector<int> a{1, 2}, b{1, 2};
+    assert(throws<std::logic_error>([&]{ return a.begin() == b.begin(); }));
+    swap(a, b); // iterators taken before a swap are invalidated too
+    assert(a.end() - a.begin() == 2);
+}
+
+void test_algorithms_still_work(){
+    Vector<int> v{5, 3, 1, 4, 2};
+    std::sort(v.begin(), v.end());
+    assert(std::is_sorted(v.cbegin(), v.cend()));
+    Vector<int>::const_iterator c = v.begin(); // iterator -> const_iterator
+    assert(c == v.cbegin());
+    assert(*std::find(v.rbegin(), v.rend(), 2) == 2);
+    assert(std::distance(v.begin(), v.end()) == 5);
+}
+#endif
+
+int main(){
+#if VECTOR_CHECKED_ITERATORS
+    test_use_after_reserve();
+    test_use_after_push_back();
+    test_out_of_range();
+    test_mixing_vectors();
+    test_algorithms_still_work();
+    std::cout << "All checked iterator tests passed!\n";
+#else
+    std::cout << "Unchecked build: Vector iterators are raw pointers\n";
+#endif
+}
@@ -1,28 +1,138 @@
-#include <arm_neon.h>
+/*
+Example of SIMD: portable kernels with runtime dispatch (see implementation/simd.hpp)
+
+The tests compare every instruction set the machine supports against plain loops, for lengths
+that leave every possible tail and for misaligned pointers. The benchmark times each kernel for
+each instruction set.
+Arguments: array length and repetitions
+*/
+
+#include "implementation/simd.hpp"
 #include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cassert>
+#include <cstdlib>
 
-// Example of using ARM NEON for SIMD
+constexpr simd::Isa AllIsas[] = {simd::Isa::Scalar, simd::Isa::SSE2, simd::Isa::AVX2, simd::Isa::AVX512, simd::Isa::NEON};
 
-void vector_addition(const float* a, const float* b, float* result, int size) {
-    for (int i = 0; i < size; i += 4) { // Process 4 floats at a time
-        float32x4_t va = vld1q_f32(&a[i]); // Load 4 floats from array a
-        float32x4_t vb = vld1q_f32(&b[i]); // Load 4 floats from array b
-        float32x4_t vresult = vaddq_f32(va, vb); // Add the vectors
-        vst1q_f32(&result[i], vresult); // Store the result
+template <typename T>
+std::vector<T> random_values(size_t n, unsigned seed){
+    std::mt19937 gen(seed);
+    std::vector<T> v(n);
+    for(auto& x : v){
+        if constexpr (std::is_integral_v<T>) x = static_cast<T>(gen()); // full range, so products wrap
+        else x = static_cast<T>(std::uniform_real_distribution<double>(-1.0, 1.0)(gen));
     }
+    return v;
+}
+
+template <typename T>
+bool close(T a, T b, size_t n){
+    if constexpr (std::is_integral_v<T>) return a == b;
+    else return std::abs(a - b) <= std::numeric_limits<T>::epsilon() * 4 * (n + 1);
 }
 
-int main() {
-    float a[4] = {1.0f, 2.0f, 3.0f, 4.0f};
-    float b[4] = {5.0f, 6.0f, 7.0f, 8.0f};
-    float result[4];
+template <typename T>
+void test_kernels(){
+    for(simd::Isa isa : AllIsas){
+        if(!simd::supported(isa)) continue;
+        const auto& k = simd::kernels<T>(isa);
+        // Every tail length of the widest registers, and an offset of one element so nothing is aligned
+        for(size_t n=0; n<=70; ++n){
+            for(size_t offset : {0, 1}){
+                auto a = random_values<T>(n + offset, 1);
+                auto b = random_values<T>(n + offset, 2);
+                auto c = random_values<T>(n + offset, 3);
+                const T* pa = a.data() + offset;
+                const T* pb = b.data() + offset;
+                const T* pc = c.data() + offset;
 
-    vector_addition(a, b, result, 4);
+                // One guard element after the output checks nothing is written past the end
+                std::vector<T> out(n + 1, T{7}), expected(n + 1, T{7});
+                k.add(pa, pb, out.data(), n);
+                simd::scalar::add(pa, pb, expected.data(), n);
+                assert(out == expected);
+                k.mul(pa, pb, out.data(), n);
+                simd::scalar::mul(pa, pb, expected.data(), n);
+                assert(out == expected);
+                k.fma(pa, pb, pc, out.data(), n);
+                simd::scalar::fma(pa, pb, pc, expected.data(), n);
+                for(size_t i=0; i<=n; ++i) assert(close(out[i], expected[i], 1)); // fused: one rounding less
+                assert(out[n] == T{7});
 
-    for (int i = 0; i < 4; i++) {
-        std::cout << result[i] << " ";
+                assert(close(k.sum(pa, n), simd::scalar::sum(pa, n), n));
+                assert(close(k.dot(pa, pb, n), simd::scalar::dot(pa, pb, n), n));
+                if(n > 0){
+                    assert(k.min(pa, n) == simd::scalar::min(pa, n));
+                    assert(k.max(pa, n) == simd::scalar::max(pa, n));
+                }
+            }
+        }
     }
-    std::cout << std::endl;
+}
+
+void test_dispatch(){
+    float a[] = {1, 2, 3, 4, 5, 6, 7};
+    float b[] = {7, 6, 5, 4, 3, 2, 1};
+    float out[7];
+    simd::add(a, b, out, 7);
+    for(float x : out) assert(x == 8);
+    assert(simd::sum(a, 7) == 28);
+    assert(simd::dot(a, b, 7) == 84);
+    assert(simd::min(a, 7) == 1 && simd::max(b, 7) == 7);
+
+    bool threw = false;
+    try{ simd::min(a, 0); }
+    catch(const std::invalid_argument&){ threw = true; }
+    assert(threw);
+}
+
+template <typename F>
+double time_ms(size_t reps, F f){
+    auto start = std::chrono::high_resolution_clock::now();
+    for(size_t r=0; r<reps; ++r) f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template <typename T>
+void Benchmark(const char* type, size_t n, size_t reps){
+    auto a = random_values<T>(n, 1), b = random_values<T>(n, 2), c = random_values<T>(n, 3);
+    std::vector<T> out(n);
+    volatile T sink{};
+
+    std::cout << "\n" << type << " (ms)" << std::setw(10) << "add" << std::setw(10) << "mul" << std::setw(10) << "fma"
+              << std::setw(10) << "dot" << std::setw(10) << "sum" << std::setw(10) << "min" << std::setw(10) << "max" << "\n";
+    for(simd::Isa isa : AllIsas){
+        if(!simd::supported(isa)) continue;
+        const auto& k = simd::kernels<T>(isa);
+        std::cout << std::left << std::setw(12) << simd::name(isa) << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(10) << time_ms(reps, [&]{ k.add(a.data(), b.data(), out.data(), n); })
+                  << std::setw(10) << time_ms(reps, [&]{ k.mul(a.data(), b.data(), out.data(), n); })
+                  << std::setw(10) << time_ms(reps, [&]{ k.fma(a.data(), b.data(), c.data(), out.data(), n); })
+                  << std::setw(10) << time_ms(reps, [&]{ sink = k.dot(a.data(), b.data(), n); })
+                  << std::setw(10) << time_ms(reps, [&]{ sink = k.sum(a.data(), n); })
+                  << std::setw(10) << time_ms(reps, [&]{ sink = k.min(a.data(), n); })
+                  << std::setw(10) << time_ms(reps, [&]{ sink = k.max(a.data(), n); }) << "\n";
+    }
+    std::cout.unsetf(std::ios::fixed);
+}
+
+int main(int argc, char** argv){
+    test_kernels<float>();
+    test_kernels<double>();
+    test_kernels<int32_t>();
+    test_dispatch();
+    std::cout << "All SIMD tests passed! Dispatching to " << simd::name(simd::best_isa()) << "\n";
 
-    return 0;
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4096; // fits in L1/L2, so compute bound
+    size_t reps = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000;
+    std::cout << n << " elements, " << reps << " repetitions" << std::endl;
+    Benchmark<float>("float ", n, reps);
+    Benchmark<double>("double", n, reps);
+    Benchmark<int32_t>("int32 ", n, reps);
 }